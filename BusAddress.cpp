@@ -0,0 +1,262 @@
+// C++
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+#include "BusAddress.h"
+
+namespace dbus
+{
+    namespace
+    {
+        bool isOptionallyEscaped(char c)
+        {
+            return std::isalnum(static_cast<unsigned char>(c)) or (std::strchr("-_/.\\*", c) != nullptr);
+        }
+
+        DBusError unescape(std::string const& value, std::string& out)
+        {
+            out.clear();
+            out.reserve(value.size());
+            for (std::size_t i = 0; i < value.size(); ++i)
+            {
+                if (value[i] != '%')
+                {
+                    out += value[i];
+                    continue;
+                }
+
+                if (((i + 2) >= value.size()) or
+                    not std::isxdigit(static_cast<unsigned char>(value[i + 1])) or
+                    not std::isxdigit(static_cast<unsigned char>(value[i + 2])))
+                {
+                    return EERROR("Invalid escape sequence in: " + value);
+                }
+                out += static_cast<char>(std::stoi(value.substr(i + 1, 2), nullptr, 16));
+                i += 2;
+            }
+            return ESUCCESS;
+        }
+
+        std::string escape(std::string const& value)
+        {
+            static char const HEX[] = "0123456789abcdef";
+            std::string out;
+            for (char c : value)
+            {
+                if (isOptionallyEscaped(c))
+                {
+                    out += c;
+                    continue;
+                }
+                out += '%';
+                out += HEX[(static_cast<unsigned char>(c) >> 4) & 0xF];
+                out += HEX[static_cast<unsigned char>(c) & 0xF];
+            }
+            return out;
+        }
+
+        std::vector<std::string> split(std::string const& str, char separator)
+        {
+            std::vector<std::string> tokens;
+            std::size_t start = 0;
+            while (true)
+            {
+                std::size_t end = str.find(separator, start);
+                tokens.push_back(str.substr(start, end - start));
+                if (end == std::string::npos)
+                {
+                    return tokens;
+                }
+                start = end + 1;
+            }
+        }
+
+        // Lower is cheaper. Transports that DBusConnection cannot use are not ranked.
+        int32_t cost(BusAddress const& address)
+        {
+            if (address.transport != "unix")
+            {
+                return -1;
+            }
+
+            if (address.isAbstract() or (address.param("path") != nullptr))
+            {
+                return 0;
+            }
+            return -1; // dir=, tmpdir= and runtime= are listen only.
+        }
+    }
+
+
+    std::string const* BusAddress::param(std::string const& key) const
+    {
+        auto it = params.find(key);
+        if (it == params.end())
+        {
+            return nullptr;
+        }
+        return &it->second;
+    }
+
+
+    std::string BusAddress::str() const
+    {
+        std::string out = transport + ":";
+        bool first = true;
+        for (auto const& param : params)
+        {
+            if (not first)
+            {
+                out += ",";
+            }
+            out += param.first + "=" + escape(param.second);
+            first = false;
+        }
+        return out;
+    }
+
+
+    DBusError parseAddresses(std::string const& addresses, std::vector<BusAddress>& out)
+    {
+        out.clear();
+        for (auto const& entry : split(addresses, ';'))
+        {
+            if (entry.empty())
+            {
+                continue;
+            }
+
+            std::size_t colon = entry.find(':');
+            if ((colon == std::string::npos) or (colon == 0))
+            {
+                return EERROR("Missing transport in address: " + entry);
+            }
+
+            BusAddress address;
+            address.transport = entry.substr(0, colon);
+
+            std::string const params = entry.substr(colon + 1);
+            if (not params.empty())
+            {
+                for (auto const& param : split(params, ','))
+                {
+                    std::size_t equal = param.find('=');
+                    if ((equal == std::string::npos) or (equal == 0))
+                    {
+                        return EERROR("Invalid key=value in address: " + entry);
+                    }
+
+                    std::string value;
+                    DBusError err = unescape(param.substr(equal + 1), value);
+                    if (err)
+                    {
+                        return err;
+                    }
+
+                    if (not address.params.emplace(param.substr(0, equal), std::move(value)).second)
+                    {
+                        return EERROR("Duplicated key in address: " + entry);
+                    }
+                }
+            }
+
+            out.push_back(std::move(address));
+        }
+
+        if (out.empty())
+        {
+            return EERROR("Empty address: " + addresses);
+        }
+        return ESUCCESS;
+    }
+
+
+    std::vector<BusAddress> connectionCandidates(std::vector<BusAddress> const& addresses)
+    {
+        std::vector<BusAddress> candidates;
+        for (auto const& address : addresses)
+        {
+            if (cost(address) >= 0)
+            {
+                candidates.push_back(address);
+            }
+        }
+
+        std::stable_sort(candidates.begin(), candidates.end(), [](BusAddress const& lhs, BusAddress const& rhs)
+        {
+            if (cost(lhs) != cost(rhs))
+            {
+                return cost(lhs) < cost(rhs);
+            }
+            return lhs.isAbstract() and not rhs.isAbstract();
+        });
+
+        return candidates;
+    }
+
+
+    DBusError unixSocketAddress(BusAddress const& address, struct sockaddr_un& sa, socklen_t& sa_size)
+    {
+        if (address.transport != "unix")
+        {
+            return EERROR("Unsupported transport: " + address.transport);
+        }
+
+        std::memset(&sa, 0, sizeof(struct sockaddr_un));
+        sa.sun_family = AF_UNIX;
+
+        std::string const* path = address.param("path");
+        std::string const* abstract = address.param("abstract");
+        if ((path == nullptr) == (abstract == nullptr))
+        {
+            return EERROR("Expected exactly one of path= or abstract= in: " + address.str());
+        }
+
+        std::string const& name = path ? *path : *abstract;
+        uint32_t const offset = path ? 0 : 1; // abstract socket names start with a nul byte.
+        if ((name.size() + offset) >= sizeof(sa.sun_path))
+        {
+            return EERROR("Socket name too long: " + name);
+        }
+
+        std::memcpy(sa.sun_path + offset, name.data(), name.size());
+        sa_size = offsetof(struct sockaddr_un, sun_path) + offset + name.size() + (path ? 1 : 0);
+        return ESUCCESS;
+    }
+
+
+    std::string systemBusAddress()
+    {
+        char const* env = std::getenv("DBUS_SYSTEM_BUS_ADDRESS");
+        if ((env != nullptr) and (*env != '\0'))
+        {
+            return env;
+        }
+        return "unix:path=/var/run/dbus/system_bus_socket";
+    }
+
+
+    std::string userBusAddress()
+    {
+        char const* runtime = std::getenv("XDG_RUNTIME_DIR");
+        if ((runtime == nullptr) or (*runtime == '\0'))
+        {
+            return "";
+        }
+        return "unix:path=" + escape(std::string(runtime) + "/bus");
+    }
+
+
+    std::string sessionBusAddress()
+    {
+        char const* env = std::getenv("DBUS_SESSION_BUS_ADDRESS");
+        if ((env != nullptr) and (*env != '\0'))
+        {
+            return env;
+        }
+        return userBusAddress();
+    }
+}
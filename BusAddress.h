@@ -0,0 +1,44 @@
+#ifndef DBUS_BUS_ADDRESS_H
+#define DBUS_BUS_ADDRESS_H
+
+// C++
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// POSIX
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "DBusError.h"
+
+namespace dbus
+{
+    // One entry of a D-Bus server address: "transport:key=value,key=value" (values are unescaped).
+    struct BusAddress
+    {
+        std::string transport;
+        std::unordered_map<std::string, std::string> params;
+
+        std::string const* param(std::string const& key) const;
+        bool isAbstract() const { return (transport == "unix") and (param("abstract") != nullptr); }
+        std::string str() const;
+    };
+
+    // Parse an address list ("unix:path=/run/dbus/bus;unix:abstract=/tmp/dbus-x,guid=...").
+    DBusError parseAddresses(std::string const& addresses, std::vector<BusAddress>& out);
+
+    // Connectable entries, in the order they should be tried: supported transports only, abstract sockets
+    // first when costs are equal (no filesystem path lookup), list order otherwise.
+    std::vector<BusAddress> connectionCandidates(std::vector<BusAddress> const& addresses);
+
+    // Translate a unix transport address (path= or abstract=) to a socket address.
+    DBusError unixSocketAddress(BusAddress const& address, struct sockaddr_un& sa, socklen_t& sa_size);
+
+    // Well known bus addresses, from environment or defaults.
+    std::string systemBusAddress();  // DBUS_SYSTEM_BUS_ADDRESS or unix:path=/var/run/dbus/system_bus_socket
+    std::string userBusAddress();    // unix:path=$XDG_RUNTIME_DIR/bus
+    std::string sessionBusAddress(); // DBUS_SESSION_BUS_ADDRESS or user bus
+}
+
+#endif
@@ -0,0 +1,154 @@
+// C++
+#include <algorithm>
+#include <iomanip>
+
+#include "BusMonitor.h"
+
+using namespace std::chrono;
+
+
+namespace dbus
+{
+    DBusError BusMonitor::start(std::vector<MatchRule> const& rules)
+    {
+        return connection_.becomeMonitor(rules);
+    }
+
+
+    DBusError BusMonitor::startLog(std::string const& path, uint32_t ring_size)
+    {
+        auto log = std::make_unique<WireCapture>();
+        DBusError err = log->open(path, ring_size);
+        if (err)
+        {
+            return err;
+        }
+
+        log_ = std::move(log);
+        return ESUCCESS;
+    }
+
+
+    void BusMonitor::stopLog()
+    {
+        log_.reset(); // flushes.
+    }
+
+
+    DBusError BusMonitor::run(milliseconds duration)
+    {
+        auto deadline = steady_clock::now() + duration;
+        while (true)
+        {
+            milliseconds remaining = duration_cast<milliseconds>(deadline - steady_clock::now());
+            if (remaining <= 0ms)
+            {
+                return ESUCCESS;
+            }
+
+            DBusError err = poll(remaining);
+            if (err)
+            {
+                if (err.code() == ERROR_CODE::TIMEOUT)
+                {
+                    return ESUCCESS;
+                }
+                return err;
+            }
+        }
+    }
+
+
+    DBusError BusMonitor::poll(milliseconds timeout)
+    {
+        uint8_t const* frame;
+        uint32_t frame_size;
+        DBusError err = connection_.recvFrame(frame, frame_size, timeout);
+        if (err)
+        {
+            return err;
+        }
+
+        frames_++;
+        bytes_ += frame_size;
+        if (log_)
+        {
+            log_->record(trace::DIRECTION::IN, frame, frame_size);
+        }
+        if (collectStats_)
+        {
+            account(frame, frame_size);
+        }
+        return ESUCCESS;
+    }
+
+
+    void BusMonitor::account(uint8_t const* frame, uint32_t frame_size)
+    {
+        HeaderView header;
+        if (DBusMessage::scanHeader(frame, frame_size, header))
+        {
+            header = HeaderView{}; // malformed: accounted as INVALID.
+        }
+        std::string_view const member = (header.type == MESSAGE_TYPE::ERROR) ? header.errorName : header.member;
+
+        key_.assign(1, static_cast<char>(header.type));
+        key_.append(header.interface);
+        key_ += '\0';
+        key_.append(member);
+
+        auto it = stats_.find(key_);
+        if (it == stats_.end())
+        {
+            Entry entry{header.type, std::string(header.interface), std::string(member)};
+            it = stats_.emplace(key_, std::move(entry)).first;
+        }
+        it->second.messages++;
+        it->second.bytes += frame_size;
+    }
+
+
+    uint64_t BusMonitor::logged() const
+    {
+        return log_ ? log_->captured() : 0;
+    }
+
+
+    uint64_t BusMonitor::dropped() const
+    {
+        return log_ ? log_->dropped() : 0;
+    }
+
+
+    std::vector<BusMonitor::Entry> BusMonitor::stats() const
+    {
+        std::vector<Entry> entries;
+        entries.reserve(stats_.size());
+        for (auto const& entry : stats_)
+        {
+            entries.push_back(entry.second);
+        }
+        std::sort(entries.begin(), entries.end(), [](Entry const& a, Entry const& b) { return a.bytes > b.bytes; });
+        return entries;
+    }
+
+
+    void BusMonitor::resetStats()
+    {
+        stats_.clear();
+        frames_ = 0;
+        bytes_ = 0;
+    }
+
+
+    std::ostream& operator<<(std::ostream& out, std::vector<BusMonitor::Entry> const& stats)
+    {
+        for (auto const& entry : stats)
+        {
+            out << std::setw(12) << entry.messages << std::setw(14) << entry.bytes << "  "
+                << str(entry.type) << " " << (entry.interface.empty() ? "-" : entry.interface)
+                << " " << (entry.member.empty() ? "-" : entry.member) << std::endl;
+        }
+        return out;
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef DBUS_BUS_MONITOR_H
+#define DBUS_BUS_MONITOR_H
+
+// C++
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+
+#include "DBusConnection.h"
+
+namespace dbus
+{
+    // Bus traffic profiler on a monitor connection (DBusConnection::becomeMonitor()). Frames are taken raw
+    // from the connection receive buffer, bodies are never decoded:
+    // - log: frames go to a trace file (WireCapture format, replayed by dbus_replay). The connection thread
+    //   only copies them into the capture ring; when the writer falls behind, frames are dropped and counted
+    //   rather than slowing the reads down.
+    // - stats: messages and bytes per (type, interface, member), from a header scan (member: error name for
+    //   errors, none for replies).
+    //
+    // Not thread safe: used by the connection owner only.
+    class BusMonitor
+    {
+    public:
+        struct Entry
+        {
+            MESSAGE_TYPE type;
+            std::string interface;
+            std::string member;
+            uint64_t messages{0};
+            uint64_t bytes{0};
+        };
+
+        explicit BusMonitor(DBusConnection& connection) : connection_(connection) {}
+
+        BusMonitor(BusMonitor const&) = delete;
+        BusMonitor& operator=(BusMonitor const&) = delete;
+
+        DBusError start(std::vector<MatchRule> const& rules = {}); // BecomeMonitor().
+
+        DBusError startLog(std::string const& path, uint32_t ring_size = 16 * 1024 * 1024); // ring_size: power of two.
+        void stopLog();
+        void collectStats(bool enable) { collectStats_ = enable; }
+
+        // Take frames in until duration elapsed (TIMEOUT is not an error then) or the connection fails.
+        DBusError run(milliseconds duration);
+        DBusError poll(milliseconds timeout); // one frame.
+
+        uint64_t frames() const { return frames_; }
+        uint64_t bytes() const { return bytes_; }
+        uint64_t logged() const;  // frames written to the log.
+        uint64_t dropped() const; // frames the log missed.
+
+        std::vector<Entry> stats() const; // by decreasing bytes.
+        void resetStats();
+
+    private:
+        void account(uint8_t const* frame, uint32_t frame_size);
+
+        DBusConnection& connection_;
+        std::unique_ptr<WireCapture> log_;
+        bool collectStats_{false};
+
+        uint64_t frames_{0};
+        uint64_t bytes_{0};
+        std::unordered_map<std::string, Entry> stats_; // by key_.
+        std::string key_;                               // scratch: type, interface, member of the last frame.
+    };
+
+    std::ostream& operator<<(std::ostream& out, std::vector<BusMonitor::Entry> const& stats);
+}
+
+#endif
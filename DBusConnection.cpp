@@ -1,15 +1,26 @@
 // C++
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <random>
 #include <regex>
 #include <iostream>
-#include <fstream>
 
 // POSIX
+#include <poll.h>
+#include <sched.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <fcntl.h>
 #include <unistd.h>
 
 #include "helpers.h"
+#include "BusAddress.h"
 #include "DBusConnection.h"
 
 
@@ -23,20 +34,337 @@ namespace dbus
         std::string const ENDLINE   {"\r\n"};
         std::string const NEGOCIATE {"NEGOTIATE_UNIX_FD"};
         std::string const BEGIN     {"BEGIN"};
+        std::string const OK        {"OK"};
+        std::string const AGREE     {"AGREE_UNIX_FD"};
+        std::string const ERROR     {"ERROR"};
     }
 
+    constexpr milliseconds CONNECT_TIMEOUT{500};
+
+    DBusConnection::~DBusConnection()
+    {
+#ifdef DBUS_ENABLE_IO_URING
+        uring_.reset(); // before its socket.
+#endif
+        if (fd_ >= 0)
+        {
+            close(fd_);
+        }
+
+        if (listenFd_ >= 0)
+        {
+            close(listenFd_);
+        }
+
+        if (timerFd_ >= 0)
+        {
+            close(timerFd_);
+        }
+    }
+
+
     DBusError DBusConnection::connect(BUS_TYPE bus)
     {
-        //-------- connect socket --------//
-        DBusError err = initSocket(bus);
+        std::string address;
+        switch (bus)
+        {
+            case BUS_SYSTEM:  { address = systemBusAddress();  break; }
+            case BUS_SESSION: { address = sessionBusAddress(); break; }
+            case BUS_USER:    { address = userBusAddress();    break; }
+        }
+
+        if (address.empty())
+        {
+            return EERROR("No bus address (is XDG_RUNTIME_DIR set?)");
+        }
+
+        return connect(address);
+    }
+
+
+    DBusError DBusConnection::connect(std::string const& address)
+    {
+        return connectFirst(address, true);
+    }
+
+
+    DBusError DBusConnection::attach(int fd)
+    {
+        connectReport_.clear();
+        ConnectAttempt attempt;
+        attempt.address = "fd:" + std::to_string(fd);
+
+        fd_ = fd;
+        return handshake(true, attempt);
+    }
+
+
+    DBusError DBusConnection::connectPeer(std::string const& address)
+    {
+        peer_ = true;
+        return connectFirst(address, false);
+    }
+
+
+    DBusError DBusConnection::connectFirst(std::string const& addresses, bool with_hello)
+    {
+        connectReport_.clear();
+
+        std::vector<BusAddress> parsed;
+        DBusError err = parseAddresses(addresses, parsed);
+        if (err)
+        {
+            return err;
+        }
+
+        std::vector<BusAddress> const candidates = connectionCandidates(parsed);
+        if (candidates.empty())
+        {
+            return EERROR("No supported transport in: " + addresses);
+        }
+
+        // Try each address in turn, until one answers.
+        DBusError failures = EERROR("Cannot connect to: " + addresses);
+        for (auto const& candidate : candidates)
+        {
+            ConnectAttempt attempt;
+            attempt.address = candidate.str();
+
+            auto start = steady_clock::now();
+            err = initSocket(candidate);
+            attempt.socket = duration_cast<nanoseconds>(steady_clock::now() - start);
+            if (err)
+            {
+                attempt.failure = "socket";
+                connectReport_.push_back(attempt);
+                failures += std::move(err);
+                closeSocket();
+                continue;
+            }
+
+            err = handshake(with_hello, attempt);
+            if (not err)
+            {
+                return ESUCCESS;
+            }
+            failures += std::move(err);
+            closeSocket();
+        }
+
+        return failures;
+    }
+
+
+    DBusError DBusConnection::handshake(bool with_hello, ConnectAttempt& attempt)
+    {
+        auto start = steady_clock::now();
+        DBusError err = setupSocket();
+        if (not err)
+        {
+            err = authenticate();
+        }
+        attempt.auth = duration_cast<nanoseconds>(steady_clock::now() - start);
+        if (err)
+        {
+            attempt.failure = "auth";
+            connectReport_.push_back(attempt);
+            return err;
+        }
+
+        if (with_hello)
+        {
+            start = steady_clock::now();
+            err = hello();
+            attempt.hello = duration_cast<nanoseconds>(steady_clock::now() - start);
+            if (err)
+            {
+                attempt.failure = "hello";
+                connectReport_.push_back(attempt);
+                return err;
+            }
+        }
+
+        connectReport_.push_back(attempt);
+        return ESUCCESS;
+    }
+
+
+    void DBusConnection::closeSocket()
+    {
+#ifdef DBUS_ENABLE_IO_URING
+        uring_.reset();
+#endif
+        if (fd_ >= 0)
+        {
+            close(fd_);
+            fd_ = -1;
+        }
+    }
+
+
+    DBusError DBusConnection::setBackend(IO_BACKEND backend)
+    {
+        if (fd_ < 0)
+        {
+            return EERROR("Not connected");
+        }
+        if (backend == this->backend())
+        {
+            return ESUCCESS;
+        }
+        if (backend == BACKEND_POSIX)
+        {
+            return EERROR("The io_uring backend stays until the connection closes");
+        }
+
+#ifdef DBUS_ENABLE_IO_URING
+        auto uring = std::make_unique<UringTransport>();
+        DBusError err = uring->open(fd_);
+        if (err)
+        {
+            err += EERROR("io_uring backend unavailable");
+            return err;
+        }
+        uring_ = std::move(uring);
+        return ESUCCESS;
+#else
+        return EERROR("io_uring backend not compiled in (ENABLE_IO_URING)");
+#endif
+    }
+
+
+    DBusError DBusConnection::setBusyPoll(microseconds spin, int cpu)
+    {
+        if (cpu >= 0)
+        {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(cpu, &cpus);
+            if (sched_setaffinity(0, sizeof(cpus), &cpus) < 0)
+            {
+                return ESYSTEM(errno);
+            }
+        }
+        spin_ = spin;
+        return ESUCCESS;
+    }
+
+
+    DBusConnection::IO_BACKEND DBusConnection::backend() const
+    {
+#ifdef DBUS_ENABLE_IO_URING
+        if (uring_)
+        {
+            return BACKEND_URING;
+        }
+#endif
+        return BACKEND_POSIX;
+    }
+
+
+    DBusError DBusConnection::listen(std::string const& address)
+    {
+        std::vector<BusAddress> parsed;
+        DBusError err = parseAddresses(address, parsed);
+        if (err)
+        {
+            return err;
+        }
+
+        struct sockaddr_un sa;
+        socklen_t sa_size;
+        err = unixSocketAddress(parsed.front(), sa, sa_size);
+        if (err)
+        {
+            return err;
+        }
+
+        if (listenFd_ >= 0)
+        {
+            close(listenFd_); // listening again: the new address replaces the previous one.
+            listenFd_ = -1;
+        }
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            return ESYSTEM(errno);
+        }
+
+        struct stat st;
+        if ((sa.sun_path[0] != '\0') and (lstat(sa.sun_path, &st) == 0) and S_ISSOCK(st.st_mode))
+        {
+            unlink(sa.sun_path); // remove a stale socket, never another kind of file.
+        }
+
+        if ((bind(fd, (struct sockaddr*)&sa, sa_size) < 0) or (::listen(fd, 1) < 0))
+        {
+            int const errnum = errno;
+            close(fd);
+            return ESYSTEM(errnum);
+        }
+
+        listenFd_ = fd;
+        return ESUCCESS;
+    }
+
+
+    DBusError DBusConnection::accept(milliseconds timeout)
+    {
+        if (listenFd_ < 0)
+        {
+            return EERROR("Not listening");
+        }
+
+        struct pollfd pfd{listenFd_, POLLIN, 0};
+        int rc = poll(&pfd, 1, timeout.count());
+        if (rc < 0)
+        {
+            return ESYSTEM(errno);
+        }
+        if (rc == 0)
+        {
+            return ECODE(ERROR_CODE::TIMEOUT, "timeout");
+        }
+
+        fd_ = accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd_ < 0)
+        {
+            return ESYSTEM(errno);
+        }
+        close(listenFd_); // one to one connection.
+        listenFd_ = -1;
+
+        DBusError err = setupSocket();
         if (err)
         {
             return err;
         }
 
+        peer_ = true;
+        err = acceptAuthentication(timeout);
+        if (err)
+        {
+            err += EERROR("");
+            return err;
+        }
+
+        return ESUCCESS;
+    }
+
+
+    DBusError DBusConnection::authenticate()
+    {
+        // Credentials byte.
+        int rc = write(fd_, "\0", 1);
+        if (rc < 0)
+        {
+            return ESYSTEM(errno);
+        }
+
         //-------- start authentication --------//
         // discover supported mode
-        err = writeAuthRequest(auth::AUTH);
+        DBusError err = writeAuthRequest(auth::AUTH);
         if (err)
         {
             return err;
@@ -57,18 +385,11 @@ namespace dbus
             std::sregex_token_iterator()
         };
 
-        std::cout << "Supported AUTH mode: " << std::endl;
-        for (auto i : supported_auth)
+        if (std::find(supported_auth.begin(), supported_auth.end(), auth::EXTERNAL) == supported_auth.end())
         {
-            if (i == auth::REJECTED)
-            {
-                continue;
-            }
-            std::cout << i << std::endl;
+            return EERROR("EXTERNAL authentication not supported: " + reply);
         }
 
-        //TODO select mode
-
         //-------- EXTERNAL mode --------//
 
         // create UID string to authenticate
@@ -78,7 +399,6 @@ namespace dbus
         {
             ss << std::hex << int(i);
         }
-        std::cout << ss.str() << std::endl;
 
         err = writeAuthRequest(ss.str());
         if (err)
@@ -92,7 +412,11 @@ namespace dbus
         {
             return err;
         }
-        std::cout << reply << std::endl;
+
+        if (reply.compare(0, auth::OK.size(), auth::OK) != 0)
+        {
+            return EERROR("Authentication rejected: " + reply);
+        }
 
         //-------- Nego UNIX FD --------//
         err = writeAuthRequest(auth::NEGOCIATE);
@@ -108,7 +432,6 @@ namespace dbus
             err += EERROR("");
             return err;
         }
-        std::cout << reply << std::endl;
 
         //-------- We are ready: BEGIN --------//
         err = writeAuthRequest(auth::BEGIN);
@@ -118,6 +441,97 @@ namespace dbus
             return err;
         }
 
+        return ESUCCESS;
+    }
+
+
+    DBusError DBusConnection::acceptAuthentication(milliseconds timeout)
+    {
+        // Credentials byte.
+        uint8_t credentials;
+        DBusError err = readData(&credentials, 1, timeout);
+        if (err)
+        {
+            return err;
+        }
+        if (credentials != 0)
+        {
+            return EERROR("Invalid credentials byte");
+        }
+
+        struct ucred peer_credentials;
+        socklen_t size = sizeof(struct ucred);
+        if (getsockopt(fd_, SOL_SOCKET, SO_PEERCRED, &peer_credentials, &size) < 0)
+        {
+            return ESYSTEM(errno);
+        }
+
+        std::stringstream guid;
+        std::random_device random;
+        for (int i = 0; i < 4; ++i)
+        {
+            guid << std::hex << std::setfill('0') << std::setw(8) << random();
+        }
+
+        bool authenticated = false;
+        while (true)
+        {
+            std::string line;
+            err = readAuthLine(line, timeout);
+            if (err)
+            {
+                err += EERROR("");
+                return err;
+            }
+
+            std::string const EXTERNAL_PREFIX{auth::AUTH + " " + auth::EXTERNAL + " "};
+            if (line.compare(0, EXTERNAL_PREFIX.size(), EXTERNAL_PREFIX) == 0)
+            {
+                // hex encoded uid: peer input, rejected when malformed.
+                std::string uid;
+                std::string const hex = line.substr(EXTERNAL_PREFIX.size());
+                bool valid = (hex.size() % 2) == 0;
+                for (std::size_t i = 0; valid and (i < hex.size()); i += 2)
+                {
+                    valid = std::isxdigit(static_cast<unsigned char>(hex[i])) and
+                            std::isxdigit(static_cast<unsigned char>(hex[i + 1]));
+                    if (valid)
+                    {
+                        uid += static_cast<char>(std::stoi(hex.substr(i, 2), nullptr, 16));
+                    }
+                }
+
+                authenticated = valid and (uid == std::to_string(peer_credentials.uid));
+                err = writeAuthRequest(authenticated ? (auth::OK + " " + guid.str()) : (auth::REJECTED + " " + auth::EXTERNAL));
+            }
+            else if (line.compare(0, auth::AUTH.size(), auth::AUTH) == 0)
+            {
+                err = writeAuthRequest(auth::REJECTED + " " + auth::EXTERNAL);
+            }
+            else if ((line == auth::NEGOCIATE) and authenticated)
+            {
+                err = writeAuthRequest(auth::AGREE);
+            }
+            else if ((line == auth::BEGIN) and authenticated)
+            {
+                return ESUCCESS;
+            }
+            else
+            {
+                err = writeAuthRequest(auth::ERROR);
+            }
+
+            if (err)
+            {
+                err += EERROR("");
+                return err;
+            }
+        }
+    }
+
+
+    DBusError DBusConnection::hello()
+    {
         //-------- Send Hello() and get our unique name --------//
         DBusMessage hello;
         hello.prepareCall("org.freedesktop.DBus",
@@ -126,7 +540,7 @@ namespace dbus
                           "Hello");
 
         DBusMessage uniqueName;
-        err = send(std::move(hello));
+        DBusError err = send(std::move(hello));
         if (err)
         {
             err += EERROR("");
@@ -139,7 +553,6 @@ namespace dbus
             err += EERROR("");
             return err;
         }
-        std::cout << uniqueName.dump() << std::endl;
         std::string myName;
         err = uniqueName.extractArgument(myName);
         if (err)
@@ -147,148 +560,1211 @@ namespace dbus
             err += EERROR("");
             return err;
         }
-        std::cout << "My name is " << myName << std::endl;
+        name_ = myName;
+        return ESUCCESS;
+    }
+
+
+    DBusError DBusConnection::readFrame(uint32_t& frame_size, milliseconds timeout)
+    {
+        // Start with fixed length header part and fields size: it gives us the frame size.
+        frame_.resize(DBusMessage::FRAME_PREFIX_SIZE);
+        DBusError err = readData(frame_.data(), DBusMessage::FRAME_PREFIX_SIZE, timeout);
+        if (err)
+        {
+            return err;
+        }
+
+        err = DBusMessage::frameSize(frame_.data(), frame_size);
+        if (err)
+        {
+            err += EERROR("");
+            return err;
+        }
+        if (frame_size < DBusMessage::FRAME_PREFIX_SIZE)
+        {
+            return EERROR("Invalid frame size: " + std::to_string(frame_size));
+        }
+
+        // Next read header fields, padding and body at once.
+        frame_.resize(frame_size);
+        err = readData(frame_.data() + DBusMessage::FRAME_PREFIX_SIZE, frame_size - DBusMessage::FRAME_PREFIX_SIZE, timeout);
+        if (err)
+        {
+            err += EERROR("");
+            return err;
+        }
+
+        if (capture_)
+        {
+            capture_->record(trace::DIRECTION::IN, frame_.data(), frame_size);
+        }
+        return ESUCCESS;
+    }
+
+
+    DBusError DBusConnection::recv(DBusMessage& msg, milliseconds timeout)
+    {
+        auto deadline = steady_clock::now() + timeout;
+        while (true)
+        {
+            milliseconds remaining = std::max(0ms, duration_cast<milliseconds>(deadline - steady_clock::now()));
+            if (timerArmed_)
+            {
+                DBusError err = waitReadable(remaining);
+                if (err)
+                {
+                    return err;
+                }
+            }
+
+            bool delivered;
+            DBusError err = recvOne(msg, remaining, delivered);
+            if (err)
+            {
+                return err;
+            }
+            if (delivered)
+            {
+                return ESUCCESS;
+            }
+        }
+    }
+
+
+    DBusError DBusConnection::recvFrame(uint8_t const*& frame, uint32_t& frame_size, milliseconds timeout)
+    {
+        DBusError err = readFrame(frame_size, timeout);
+        if (err)
+        {
+            return err;
+        }
+
+        DBUS_METRICS(metrics_.messageIn(static_cast<MESSAGE_TYPE>(frame_[1]), frame_size));
+        frame = frame_.data();
+        return ESUCCESS;
+    }
+
+
+    DBusError DBusConnection::becomeMonitor(std::vector<MatchRule> const& rules, milliseconds timeout)
+    {
+        if (peer_)
+        {
+            return EERROR("No bus to monitor on peer connections");
+        }
+
+        std::vector<std::string> strs;
+        strs.reserve(rules.size());
+        for (auto const& rule : rules)
+        {
+            strs.push_back(rule.str());
+        }
+
+        DBusMessage become;
+        become.prepareCall("org.freedesktop.DBus", "/org/freedesktop/DBus", "org.freedesktop.DBus.Monitoring", "BecomeMonitor");
+        become.addArgument(strs);
+        become.addArgument(uint32_t{0}); // flags.
+
+        DBusMessage reply;
+        DBusError err = call(std::move(become), reply, timeout);
+        if (err)
+        {
+            err += EERROR("BecomeMonitor");
+            return err;
+        }
+        return ESUCCESS;
+    }
+
+
+    DBusError DBusConnection::recvOne(DBusMessage& msg, milliseconds timeout, bool& delivered)
+    {
+        delivered = false;
+        uint32_t frame_size;
+        DBusError err = readFrame(frame_size, timeout);
+        if (err)
+        {
+            return err;
+        }
+
+        MESSAGE_TYPE const type = static_cast<MESSAGE_TYPE>(frame_[1]);
+        if ((type == MESSAGE_TYPE::SIGNAL) and not matches_.empty())
+        {
+            // Broadcast signals no rule wants are dropped after a header scan, before the body is decoded.
+            // Signals addressed to us are always delivered: matches only concern broadcasts.
+            HeaderView header;
+            err = DBusMessage::scanHeader(frame_.data(), frame_size, header);
+            if (err)
+            {
+                return err;
+            }
+            bool const unicast = (not header.destination.empty()) and (header.destination == name_);
+
+            matches_.match(header, matched_);
+            if (matched_.empty() and not unicast)
+            {
+                DBUS_METRICS(metrics_.messageIn(type, frame_size));
+                DBUS_METRICS(metrics_.signalFiltered());
+                return ESUCCESS;
+            }
+
+            if (dropStale_ and namesTracked_ and not unicast)
+            {
+                // Matched only through a well-known sender name that the sender does not own anymore.
+                matched_.erase(std::remove_if(matched_.begin(), matched_.end(), [this, &header](uint32_t id)
+                {
+                    return staleSender(id, header.sender);
+                }), matched_.end());
+
+                if (matched_.empty())
+                {
+                    DBUS_METRICS(metrics_.messageIn(type, frame_size));
+                    DBUS_METRICS(metrics_.staleSignal());
+                    return ESUCCESS;
+                }
+            }
+        }
+
+        if (not strings_ or strings_->full())
+        {
+            strings_ = std::make_shared<InternTable>(); // messages still referring the old one keep it alive.
+        }
+        err = msg.deserialize(frame_.data(), frame_size, strings_);
+        if (err)
+        {
+            return err;
+        }
+
+        DBUS_METRICS(metrics_.messageIn(msg.type(), frame_size));
+        DBUS_METRICS(trackReply(msg, steady_clock::now()));
+
+        if (msg.isSignal() and not matches_.empty() and not matched_.empty() and not dispatchSignal(msg))
+        {
+            return ESUCCESS; // consumed by handlers.
+        }
+        if ((msg.isReply() or msg.isError()) and not asyncCalls_.empty() and dispatchReply(msg))
+        {
+            return ESUCCESS;
+        }
+        delivered = true;
+        return ESUCCESS;
+    }
+
+
+    bool DBusConnection::dispatchReply(DBusMessage& msg)
+    {
+        auto it = asyncCalls_.find(msg.replySerial());
+        if (it == asyncCalls_.end())
+        {
+            return false;
+        }
+
+        AsyncCall pending = std::move(it->second);
+        asyncCalls_.erase(it);
+        timers_.cancel(pending.timer);
+        disarmTimer();
+
+        DBusError err;
+        if (msg.isError())
+        {
+            err = ECODE(ERROR_CODE::REMOTE, msg.errorMessage());
+        }
+        pending.handler(std::move(err), msg);
+        return true;
+    }
+
+
+    DBusError DBusConnection::callAsync(DBusMessage&& msg, ReplyHandler handler, milliseconds timeout)
+    {
+        if (not msg.expectReply())
+        {
+            return EERROR("Not a method call expecting a reply");
+        }
+
+        DBusError err = initTimer();
+        if (err)
+        {
+            return err;
+        }
+
+        uint32_t const serial = msg.serial();
+        err = send(std::move(msg));
+        if (err)
+        {
+            return err;
+        }
+
+        uint64_t const now = currentTick();
+        if (timers_.empty())
+        {
+            timers_.advance(now, expired_); // idle wheel: jump to the current tick.
+        }
+
+        uint64_t const ticks = (timeout.count() + TIMER_TICK.count() - 1) / TIMER_TICK.count();
+        asyncCalls_[serial] = {std::move(handler), timers_.add(now + ticks, serial)};
+        armTimer(tickTime(now + ticks));
+        return ESUCCESS;
+    }
+
+
+    bool DBusConnection::cancelCall(uint32_t serial)
+    {
+        auto it = asyncCalls_.find(serial);
+        if (it == asyncCalls_.end())
+        {
+            return false;
+        }
+
+        timers_.cancel(it->second.timer);
+        asyncCalls_.erase(it);
+        disarmTimer();
+
+        DBUS_METRICS(untrackCall(serial));
+        return true;
+    }
+
+
+    DBusError DBusConnection::waitReadable(milliseconds timeout)
+    {
+        auto deadline = steady_clock::now() + timeout;
+        while (timerArmed_)
+        {
+            milliseconds remaining = std::max(0ms, duration_cast<milliseconds>(deadline - steady_clock::now()));
+            struct pollfd fds[2] = {{pollFd(), POLLIN, 0}, {timerFd_, POLLIN, 0}};
+            bool const pending = buffered(); // readable without the socket telling.
+            int rc = poll(fds, 2, pending ? 0 : remaining.count());
+            if (rc < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return ESYSTEM(errno);
+            }
+
+            if ((rc == 0) and not pending)
+            {
+                DBUS_METRICS(metrics_.timeout());
+                return ECODE(ERROR_CODE::TIMEOUT, "timeout");
+            }
+
+            if (fds[1].revents & POLLIN)
+            {
+                expireCalls();
+            }
+
+            if (pending or fds[0].revents)
+            {
+                return ESUCCESS; // data (or hang up, reported by the read).
+            }
+        }
+        return ESUCCESS; // no deadline left: plain reads.
+    }
+
+
+    void DBusConnection::expireCalls()
+    {
+        uint64_t ticks;
+        if (read(timerFd_, &ticks, sizeof(ticks)) < 0)
+        {
+            return; // EAGAIN: not expired yet.
+        }
+        DBUS_METRICS(metrics_.timerWakeup());
+        timerDeadline_ = steady_clock::time_point::max(); // one-shot: fired.
+
+        // Handlers may recv() on this connection (and expire calls): keep our own list.
+        std::vector<uint32_t> expired;
+        expired.swap(expired_);
+        timers_.advance(currentTick(), expired);
+        for (uint32_t serial : expired)
+        {
+            auto it = asyncCalls_.find(serial);
+            if (it == asyncCalls_.end())
+            {
+                continue;
+            }
+
+            ReplyHandler handler = std::move(it->second.handler);
+            asyncCalls_.erase(it);
+            DBUS_METRICS(callTimedOut(serial));
+
+            DBusMessage none;
+            handler(ECODE(ERROR_CODE::TIMEOUT, "timeout"), none);
+        }
+
+        expired.clear();
+        if (expired_.capacity() < expired.capacity())
+        {
+            expired_.swap(expired);
+        }
+
+        flushSignals();
+        armNext();
+    }
+
+
+    void DBusConnection::flushSignals()
+    {
+        if (coalescer_.empty())
+        {
+            return;
+        }
+
+        // Handlers may recv() on this connection (and flush signals): keep our own list.
+        std::vector<SignalCoalescer::Ready> ready;
+        ready.swap(ready_);
+        coalescer_.due(steady_clock::now(), ready);
+        for (auto& signal : ready)
+        {
+            auto it = handlers_.find(signal.id);
+            if ((it == handlers_.end()) or not it->second)
+            {
+                continue; // removed meanwhile.
+            }
+            SignalHandler handler = it->second;
+            handler(signal.signal);
+        }
+
+        ready.clear();
+        if (ready_.capacity() < ready.capacity())
+        {
+            ready_.swap(ready);
+        }
+    }
+
+
+    DBusError DBusConnection::initTimer()
+    {
+        if (timerFd_ < 0)
+        {
+            timerFd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+            if (timerFd_ < 0)
+            {
+                return ESYSTEM(errno);
+            }
+            timerEpoch_ = steady_clock::now();
+        }
+        return ESUCCESS;
+    }
+
+
+    void DBusConnection::disarmTimer()
+    {
+        if (timers_.empty() and coalescer_.empty() and timerArmed_)
+        {
+            struct itimerspec spec{};
+            timerfd_settime(timerFd_, 0, &spec, nullptr);
+            timerArmed_ = false;
+            timerDeadline_ = steady_clock::time_point::max();
+        }
+    }
+
+
+    void DBusConnection::armTimer(steady_clock::time_point deadline)
+    {
+        if (timerArmed_ and (deadline >= timerDeadline_))
+        {
+            return; // woken up before anyway.
+        }
+
+        // One-shot, absolute: steady_clock is CLOCK_MONOTONIC.
+        nanoseconds const at = std::max(nanoseconds(1), duration_cast<nanoseconds>(deadline.time_since_epoch()));
+        struct itimerspec spec{};
+        spec.it_value.tv_sec = duration_cast<seconds>(at).count();
+        spec.it_value.tv_nsec = (at % seconds(1)).count();
+        timerfd_settime(timerFd_, TFD_TIMER_ABSTIME, &spec, nullptr);
+        timerArmed_ = true;
+        timerDeadline_ = deadline;
+    }
+
+
+    void DBusConnection::armNext()
+    {
+        if (timers_.empty() and coalescer_.empty())
+        {
+            disarmTimer();
+            return;
+        }
+
+        steady_clock::time_point next = coalescer_.nextDue();
+        if (not timers_.empty())
+        {
+            next = std::min(next, tickTime(timers_.nextExpiry()));
+        }
+        armTimer(next);
+    }
+
+
+    steady_clock::time_point DBusConnection::tickTime(uint64_t tick) const
+    {
+        return timerEpoch_ + tick * TIMER_TICK;
+    }
+
+
+    uint64_t DBusConnection::currentTick() const
+    {
+        return duration_cast<milliseconds>(steady_clock::now() - timerEpoch_).count() / TIMER_TICK.count();
+    }
+
+
+    bool DBusConnection::dispatchSignal(DBusMessage& msg)
+    {
+        // Handlers may recv() (i.e. call()) on this connection: keep our own copy of the matched ids.
+        std::vector<uint32_t> ids;
+        ids.swap(matched_);
+
+        bool deliver = false;
+        for (uint32_t id : ids)
+        {
+            auto it = handlers_.find(id);
+            if (it == handlers_.end())
+            {
+                continue; // removed meanwhile.
+            }
+
+            if (not it->second)
+            {
+                deliver = true; // no handler: the caller of recv() gets it.
+                continue;
+            }
+
+            if (coalescer_.holds(id))
+            {
+                msg.rewind();
+                SignalCoalescer::RESULT const result = coalescer_.add(id, msg, steady_clock::now());
+                if ((result == SignalCoalescer::MERGED) or (result == SignalCoalescer::DROPPED))
+                {
+                    DBUS_METRICS(metrics_.signalCoalesced(result == SignalCoalescer::MERGED));
+                }
+                if (result != SignalCoalescer::PASSED)
+                {
+                    armTimer(coalescer_.nextDue());
+                    continue;
+                }
+            }
+
+            SignalHandler handler = it->second; // the handler may remove its own match.
+            msg.rewind();
+            handler(msg);
+        }
+
+        msg.rewind();
+        if (matched_.capacity() < ids.capacity())
+        {
+            matched_.swap(ids);
+        }
+        return deliver;
+    }
+
+
+    DBusError DBusConnection::addMatch(MatchRule const& rule, SignalHandler handler, uint32_t& id)
+    {
+        if (not peer_)
+        {
+            DBusMessage add;
+            add.prepareCall("org.freedesktop.DBus", "/org/freedesktop/DBus", "org.freedesktop.DBus", "AddMatch");
+            add.addArgument(rule.str());
+
+            DBusMessage reply;
+            DBusError err = call(std::move(add), reply, 1000ms);
+            if (err)
+            {
+                err += EERROR("AddMatch");
+                return err;
+            }
+        }
+
+        id = matches_.add(rule);
+        handlers_.emplace(id, std::move(handler));
+        return ESUCCESS;
+    }
+
+
+    DBusError DBusConnection::addMatch(MatchRule const& rule, std::shared_ptr<SubscriberQueue> queue, uint32_t& id)
+    {
+        if (not queue)
+        {
+            return EERROR("No subscriber queue");
+        }
+
+        auto match_id = std::make_shared<uint32_t>(0);
+        auto handler = [this, queue, match_id](DBusMessage& signal)
+        {
+            SubscriberQueue::RESULT const result = queue->push(signal);
+            if (result != SubscriberQueue::QUEUED)
+            {
+                DBUS_METRICS(metrics_.queueOverflow());
+            }
+            if (result == SubscriberQueue::DISCONNECTED)
+            {
+                dropMatch(*match_id);
+            }
+        };
+
+        DBusError err = addMatch(rule, std::move(handler), id);
+        if (err)
+        {
+            return err;
+        }
+        *match_id = id;
+        return ESUCCESS;
+    }
+
+
+    bool DBusConnection::forgetMatch(uint32_t id, std::string& rule)
+    {
+        MatchRule const* match = matches_.rule(id);
+        if (match == nullptr)
+        {
+            return false;
+        }
+
+        rule = match->str();
+        matches_.remove(id);
+        handlers_.erase(id);
+        coalescer_.remove(id);
+        disarmTimer();
+        return true;
+    }
+
+
+    void DBusConnection::dropMatch(uint32_t id)
+    {
+        std::string rule;
+        if (not forgetMatch(id, rule) or peer_)
+        {
+            return;
+        }
+
+        DBusMessage remove;
+        remove.prepareCall("org.freedesktop.DBus", "/org/freedesktop/DBus", "org.freedesktop.DBus", "RemoveMatch");
+        remove.addArgument(rule);
+        callAsync(std::move(remove), [](DBusError, DBusMessage&) {}, 1000ms); // the local match is gone anyway.
+    }
+
+
+    DBusError DBusConnection::removeMatch(uint32_t id)
+    {
+        std::string str;
+        if (not forgetMatch(id, str))
+        {
+            return EERROR("Unknown match id " + std::to_string(id));
+        }
+
+        if (not peer_)
+        {
+            DBusMessage remove;
+            remove.prepareCall("org.freedesktop.DBus", "/org/freedesktop/DBus", "org.freedesktop.DBus", "RemoveMatch");
+            remove.addArgument(str);
+
+            DBusMessage reply;
+            DBusError err = call(std::move(remove), reply, 1000ms);
+            if (err)
+            {
+                err += EERROR("RemoveMatch");
+                return err;
+            }
+        }
+        return ESUCCESS;
+    }
+
+
+    DBusError DBusConnection::setCoalescing(uint32_t id, SignalCoalescer::POLICY policy, milliseconds window)
+    {
+        auto it = handlers_.find(id);
+        if (it == handlers_.end())
+        {
+            return EERROR("Unknown match id " + std::to_string(id));
+        }
+        if (not it->second)
+        {
+            return EERROR("Signals of subscriptions without handler are not coalesced");
+        }
+
+        DBusError err = initTimer();
+        if (err)
+        {
+            return err;
+        }
+        coalescer_.setPolicy(id, policy, window);
+        return ESUCCESS;
+    }
+
+
+    DBusError DBusConnection::trackNames()
+    {
+        if (peer_)
+        {
+            return EERROR("No bus names on peer to peer connections");
+        }
+
+        // Subscribe first: owner changes that happen meanwhile are applied in order with the replies.
+        DBusError err = watchNameOwners();
+        if (err)
+        {
+            return err;
+        }
+
+        auto list = [this](char const* method, std::vector<std::string>& names)
+        {
+            DBusMessage request;
+            request.prepareCall("org.freedesktop.DBus", "/org/freedesktop/DBus", "org.freedesktop.DBus", method);
+
+            DBusMessage reply;
+            DBusError err = call(std::move(request), reply, 1000ms);
+            if (not err)
+            {
+                err = reply.extractArgument(names);
+            }
+            if (err)
+            {
+                err += EERROR(method);
+            }
+            return err;
+        };
+
+        std::vector<std::string> names;
+        std::vector<std::string> activatable;
+        err = list("ListNames", names);
+        if (not err)
+        {
+            err = list("ListActivatableNames", activatable);
+        }
+        if (err)
+        {
+            return err;
+        }
+
+        activatable_ = std::unordered_set<std::string>(activatable.begin(), activatable.end());
+        for (auto const& name : names)
+        {
+            if (name[0] == ':')
+            {
+                setOwner(name, name);
+                continue;
+            }
+
+            std::string owner;
+            if (not nameOwner(name, owner))
+            {
+                setOwner(name, owner);
+            }
+        }
+
+        namesTracked_ = true;
+        return ESUCCESS;
+    }
+
+
+    DBusError DBusConnection::nameOwner(std::string const& name, std::string& owner)
+    {
+        auto it = owners_.find(name);
+        if (it != owners_.end())
+        {
+            DBUS_METRICS(metrics_.nameLookup(true));
+            owner = it->second;
+            return ESUCCESS;
+        }
+
+        DBUS_METRICS(metrics_.nameLookup(false));
+        if (namesTracked_)
+        {
+            return ECODE(ERROR_CODE::REMOTE, "org.freedesktop.DBus.Error.NameHasNoOwner: " + name);
+        }
+
+        DBusError err = watchNameOwners(); // keep the answer current.
+        if (err)
+        {
+            return err;
+        }
+
+        DBusMessage get;
+        get.prepareCall("org.freedesktop.DBus", "/org/freedesktop/DBus", "org.freedesktop.DBus", "GetNameOwner");
+        get.addArgument(name);
+
+        DBusMessage reply;
+        err = call(std::move(get), reply, 1000ms);
+        if (not err)
+        {
+            err = reply.extractArgument(owner);
+        }
+        if (err)
+        {
+            return err;
+        }
+
+        setOwner(name, owner);
+        return ESUCCESS;
+    }
+
+
+    bool DBusConnection::hasOwner(std::string const& name) const
+    {
+        return owners_.find(name) != owners_.end();
+    }
+
+
+    DBusError DBusConnection::watchNameOwners()
+    {
+        if (ownersMatch_ != 0)
+        {
+            return ESUCCESS;
+        }
+
+        MatchRule rule;
+        rule.sender = "org.freedesktop.DBus";
+        rule.path = "/org/freedesktop/DBus";
+        rule.interface = "org.freedesktop.DBus";
+        rule.member = "NameOwnerChanged";
+        return addMatch(rule, [this](DBusMessage& signal) { nameOwnerChanged(signal); }, ownersMatch_);
+    }
+
+
+    void DBusConnection::nameOwnerChanged(DBusMessage& signal)
+    {
+        // NameOwnerChanged(s name, s old_owner, s new_owner)
+        std::string name;
+        std::string old_owner;
+        std::string new_owner;
+        if (signal.extractArgument(name) or signal.extractArgument(old_owner) or signal.extractArgument(new_owner))
+        {
+            return;
+        }
+
+        if (new_owner.empty())
+        {
+            removeOwner(name);
+            return;
+        }
+        setOwner(name, new_owner);
+    }
+
+
+    void DBusConnection::setOwner(std::string const& name, std::string const& owner)
+    {
+        auto it = owners_.find(name);
+        if (it != owners_.end())
+        {
+            it->second = owner;
+            return;
+        }
+
+        it = owners_.emplace(name, owner).first;
+        if (name[0] == ':')
+        {
+            liveUniqueNames_.insert(it->first); // view on the map key (stable).
+        }
+    }
+
+
+    void DBusConnection::removeOwner(std::string const& name)
+    {
+        auto it = owners_.find(name);
+        if (it == owners_.end())
+        {
+            return;
+        }
+
+        liveUniqueNames_.erase(it->first);
+        owners_.erase(it);
+    }
+
+
+    bool DBusConnection::knownAbsent(std::string const& name, uint8_t flags) const
+    {
+        if ((not namesTracked_) or (name == "org.freedesktop.DBus") or hasOwner(name))
+        {
+            return false;
+        }
+
+        if ((name[0] == ':') or (flags & NO_AUTO_START))
+        {
+            return true;
+        }
+        return activatable_.find(name) == activatable_.end(); // would be started by the bus.
+    }
+
+
+    bool DBusConnection::staleSender(uint32_t id, std::string_view sender) const
+    {
+        MatchRule const* rule = matches_.rule(id);
+        if ((rule == nullptr) or rule->sender.empty())
+        {
+            return false;
+        }
+
+        if (rule->sender[0] == ':')
+        {
+            return liveUniqueNames_.find(sender) == liveUniqueNames_.end(); // already checked by the index.
+        }
+
+        auto it = owners_.find(rule->sender);
+        return (it == owners_.end()) or (it->second != sender);
+    }
+
+
+    DBusError DBusConnection::send(DBusMessage&& msg)
+    {
+        DBUS_METRICS(auto start_timestamp = steady_clock::now());
+        DBusError err = prepareSend(msg);
+        if (err)
+        {
+            return err;
+        }
+
+        err = writeMessage(msg, 100ms);
+        if (err)
+        {
+            return err;
+        }
+
+        DBUS_METRICS(sent(msg, start_timestamp));
+        if (capture_)
+        {
+            capture_->record(trace::DIRECTION::OUT,
+                             msg.headerBuffer_.data(), msg.headerBuffer_.size(),
+                             msg.body_.data(), msg.body_.size());
+        }
+        return ESUCCESS;
+    }
+
+
+    DBusError DBusConnection::writeMessage(DBusMessage const& msg, milliseconds timeout)
+    {
+#ifdef DBUS_ENABLE_IO_URING
+        if (uring_)
+        {
+            // Both buffers in one submission.
+            sendBuffers_.clear();
+            sendBuffers_.push_back({const_cast<uint8_t*>(msg.headerBuffer_.data()), msg.headerBuffer_.size()});
+            if (not msg.body_.empty())
+            {
+                sendBuffers_.push_back({const_cast<uint8_t*>(msg.body_.data()), msg.body_.size()});
+            }
+            std::size_t written = 0;
+            DBUS_METRICS(uint64_t const enters = uring_->enters());
+            DBusError err = uring_->write(sendBuffers_, written, timeout);
+            DBUS_METRICS(metrics_.writeSyscall(uring_->enters() - enters));
+            DBUS_METRICS(if (err.code() == ERROR_CODE::TIMEOUT) { metrics_.timeout(); });
+            return err;
+        }
+#endif
+
+        DBusError err = writeData(msg.headerBuffer_.data(), msg.headerBuffer_.size(), timeout);
+        if (err)
+        {
+            return err;
+        }
+        return writeData(msg.body_.data(), msg.body_.size(), timeout);
+    }
+
+
+    DBusError DBusConnection::prepareSend(DBusMessage& msg)
+    {
+        if (failFast_ and msg.isCall())
+        {
+            // Template calls have no readable fields: their destination is kept on the template.
+            std::string const* destination = nullptr;
+            if (msg.template_)
+            {
+                destination = &msg.template_->destination;
+            }
+            else if (msg.hasField(FIELD::DESTINATION))
+            {
+                destination = &msg.destination();
+            }
+
+            if ((destination != nullptr) and not destination->empty() and knownAbsent(*destination, msg.header_.flags))
+            {
+                DBUS_METRICS(metrics_.fastFail());
+                return ECODE(ERROR_CODE::REMOTE, "org.freedesktop.DBus.Error.ServiceUnknown: " + *destination);
+            }
+        }
+
+        if (not name_.empty() and not msg.template_)
+        {
+            // Add sender filed with our name if we know it (if not, probably the Hello() message).
+            if (not msg.hasField(FIELD::SENDER))
+            {
+                msg.setSender(name_);
+            }
+        }
+
+        msg.serialize();
         return ESUCCESS;
     }
 
-    DBusError DBusConnection::recv(DBusMessage& msg, milliseconds timeout)
+
+    DBusError DBusConnection::call(DBusMessage&& msg, DBusMessage& reply, milliseconds timeout)
     {
-        // Start with fixed length header part.
-        msg.body_.resize(sizeof(struct Header));
-        DBusError err = readData(msg.body_.data(), sizeof(struct Header), timeout);
+        uint32_t const serial = msg.serial();
+        DBusError err = send(std::move(msg));
         if (err)
         {
             return err;
         }
-        std::memcpy(&msg.header_, msg.body_.data(), sizeof(struct Header));
-        msg.body_pos_ = msg.body_.size();
 
-        // Next read header fields.
-        msg.body_.resize(msg.body_.size() + sizeof(uint32_t));
-        err = readData(msg.body_.data() + msg.body_pos_, sizeof(uint32_t), timeout); // read fields size
-        if (err)
+        auto deadline = steady_clock::now() + timeout;
+        while (true)
         {
-            return err;
-        }
+            milliseconds remaining = duration_cast<milliseconds>(deadline - steady_clock::now());
+            if (remaining < 0ms)
+            {
+                DBUS_METRICS(callTimedOut(serial));
+                return ECODE(ERROR_CODE::TIMEOUT, "timeout");
+            }
 
-        uint32_t fields_size = *reinterpret_cast<uint32_t*>(msg.body_.data() + msg.body_pos_);
-        msg.body_.resize(msg.body_.size() + fields_size);
-        err = readData(msg.body_.data() + msg.body_pos_ + sizeof(uint32_t), fields_size, timeout);
-        if (err)
-        {
-            err += EERROR("");
-            return err;
+            err = recv(reply, remaining);
+            if (err)
+            {
+#ifdef DBUS_ENABLE_METRICS
+                if (err.code() == ERROR_CODE::TIMEOUT)
+                {
+                    callTimedOut(serial);
+                }
+                else
+                {
+                    callFailed(serial);
+                }
+#endif
+                err += EERROR("");
+                return err;
+            }
+
+            if ((reply.isReply() or reply.isError()) and (reply.replySerial() == serial))
+            {
+                if (reply.isError())
+                {
+                    return ECODE(ERROR_CODE::REMOTE, reply.errorMessage());
+                }
+                return ESUCCESS;
+            }
         }
-/*
-        std::ofstream myfile;
-        static int y;
-        ++y;
-        myfile.open ("yolo_" + std::to_string(y), std::ios::out | std::ios::binary);
-        myfile.write(reinterpret_cast<const char*>(msg.body_.data()), msg.body_.size());
-*/
-        err = msg.extractArgument(msg.fields_);
-        if (err)
+    }
+
+
+    DBusError DBusConnection::callBatch(std::vector<DBusMessage>& calls, std::vector<BatchResult>& results,
+                                        milliseconds timeout)
+    {
+        auto deadline = steady_clock::now() + timeout;
+        DBUS_METRICS(auto start_timestamp = steady_clock::now());
+        results.clear();
+        results.resize(calls.size());
+
+        // Every frame of the batch, back to back: header and body buffers of each call.
+        std::vector<struct iovec> buffers;
+        std::vector<std::size_t> queued;     // index of the calls to write, in order.
+        std::vector<std::size_t> ends;       // per queued call: end of its buffers.
+        std::unordered_map<uint32_t, std::size_t> waiting; // call serial -> index, until answered.
+        buffers.reserve(calls.size() * 2);
+        queued.reserve(calls.size());
+        ends.reserve(calls.size());
+        waiting.reserve(calls.size());
+        for (std::size_t i = 0; i < calls.size(); ++i)
         {
-            return err;
+            DBusMessage& call = calls[i];
+            if (not call.isCall())
+            {
+                results[i].error = EERROR("Not a method call");
+                continue;
+            }
+
+            DBusError err = prepareSend(call);
+            if (err)
+            {
+                results[i].error = std::move(err); // known absent destination.
+                continue;
+            }
+
+            buffers.push_back({call.headerBuffer_.data(), call.headerBuffer_.size()});
+            if (not call.body_.empty())
+            {
+                buffers.push_back({call.body_.data(), call.body_.size()});
+            }
+            queued.push_back(i);
+            ends.push_back(buffers.size());
+            if (call.expectReply())
+            {
+                waiting.emplace(call.serial(), i);
+            }
         }
 
-        // copy signature to internal field if any.
-        auto signatureIt = msg.fields_.find(FIELD::SIGNATURE);
-        if (signatureIt == msg.fields_.end())
+        // Write and read at once: the other side may answer (and fill the socket) before the batch is written.
+        std::size_t written = 0; // buffers fully written.
+        std::size_t flushed = 0; // queued calls fully written.
+        DBusError failure;       // connection error that stopped the batch.
+        DBusMessage incoming;
+        while ((written < buffers.size()) or not waiting.empty())
         {
-            msg.signature_.clear();
+            milliseconds remaining = std::max(0ms, duration_cast<milliseconds>(deadline - steady_clock::now()));
+            short const events = (written < buffers.size()) ? (POLLIN | POLLOUT) : POLLIN;
+            struct pollfd fds[2] = {{pollFd(), events, 0}, {timerFd_, POLLIN, 0}};
+            bool const pending = buffered(); // readable without the socket telling.
+            int rc = poll(fds, timerArmed_ ? 2 : 1, pending ? 0 : remaining.count());
+            if (rc < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                failure = ESYSTEM(errno);
+                break;
+            }
+            if (pending)
+            {
+                fds[0].revents |= POLLIN;
+            }
+            else if (rc == 0)
+            {
+                DBUS_METRICS(metrics_.timeout());
+                break;
+            }
+
+            if (timerArmed_ and (fds[1].revents & POLLIN))
+            {
+                expireCalls();
+            }
+
+            if (fds[0].revents & POLLOUT)
+            {
+                remaining = std::max(0ms, duration_cast<milliseconds>(deadline - steady_clock::now()));
+                DBusError err = writeBuffers(buffers, written, remaining);
+
+                for (; (flushed < queued.size()) and (ends[flushed] <= written); ++flushed)
+                {
+                    DBusMessage const& call = calls[queued[flushed]];
+                    DBUS_METRICS(sent(call, start_timestamp));
+                    if (capture_)
+                    {
+                        capture_->record(trace::DIRECTION::OUT,
+                                         call.headerBuffer_.data(), call.headerBuffer_.size(),
+                                         call.body_.data(), call.body_.size());
+                    }
+                }
+                if (err)
+                {
+                    failure = std::move(err);
+                    break;
+                }
+            }
+
+            if (fds[0].revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                bool delivered;
+                DBusError err = recvOne(incoming, remaining, delivered);
+                if (err)
+                {
+                    failure = std::move(err);
+                    break;
+                }
+
+                if (delivered and (incoming.isReply() or incoming.isError()))
+                {
+                    auto it = waiting.find(incoming.replySerial());
+                    if (it != waiting.end())
+                    {
+                        BatchResult& result = results[it->second];
+                        waiting.erase(it);
+                        if (incoming.isError())
+                        {
+                            result.error = ECODE(ERROR_CODE::REMOTE, incoming.errorMessage());
+                        }
+                        result.reply = std::move(incoming);
+                    }
+                }
+            }
         }
-        else
+
+        if (waiting.empty() and (written == buffers.size()))
         {
-            msg.signature_ = signatureIt->second.get<Signature>();
+            return ESUCCESS;
         }
 
-        // Read header padding.
-        uint8_t header_padding[7]; // at most 7 bytes of padding.
-        uint32_t padding_size = msg.body_.size() % 8;
-        if (padding_size)
+        // Unanswered and unwritten calls: the connection error, or TIMEOUT.
+        auto error = [&failure]()
         {
-            err = readData(header_padding, 8 - padding_size, timeout);
-            if (err)
+            if (not failure)
             {
-                err += EERROR("");
-                return err;
+                return ECODE(ERROR_CODE::TIMEOUT, "timeout");
+            }
+            if (failure.code() == ERROR_CODE::SYSTEM)
+            {
+                return DBusError(failure.code(), failure.systemError(), failure.site());
             }
+            return DBusError(failure.code(), failure.message(), failure.site());
+        };
+        for (auto const& [serial, index] : waiting)
+        {
+            DBUS_METRICS(failure ? callFailed(serial) : callTimedOut(serial));
+            results[index].error = error();
         }
-
-        // Read message body.
-        msg.body_pos_ = 0;
-        msg.body_.clear();
-        msg.body_.resize(msg.header_.size);
-        return readData(msg.body_.data(), msg.body_.size(), timeout);
+        for (std::size_t i = flushed; i < queued.size(); ++i)
+        {
+            results[queued[i]].error = error(); // not even written.
+        }
+        if (failure)
+        {
+            return failure;
+        }
+        return ECODE(ERROR_CODE::TIMEOUT, "timeout");
     }
 
 
-    DBusError DBusConnection::send(DBusMessage&& msg)
+    DBusError DBusConnection::initSocket(BusAddress const& address)
     {
-        if (not name_.empty())
+        struct sockaddr_un sa;
+        socklen_t sa_size;
+        DBusError err = unixSocketAddress(address, sa, sa_size);
+        if (err)
         {
-            // Add sender filed with our name if we know it (if not, probably the Hello() message).
-            msg.fields_.emplace(FIELD::SENDER, name_);
+            return err;
         }
 
-        msg.serialize();
-
-        // Send message.
-        return writeData(msg.headerBuffer_.data(), msg.headerBuffer_.size(), 100ms);
-    }
-
-
-    DBusError DBusConnection::initSocket(BUS_TYPE bus)
-    {
-        fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+        fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
         if (fd_ < 0)
         {
-            return EERROR(strerror(errno));
+            return ESYSTEM(errno);
         }
 
-        int rc = -1;
-        switch (bus)
+        // Non blocking connect: a dead address shall not delay the next one.
+        int rc = ::connect(fd_, (struct sockaddr*)&sa, sa_size);
+        if ((rc < 0) and (errno == EINPROGRESS))
         {
-            case BUS_SYSTEM:
-            {
-                constexpr struct sockaddr_un const SYSTEM_BUS {AF_UNIX, "/var/run/dbus/system_bus_socket" };
-                rc = ::connect(fd_, (struct sockaddr*)&SYSTEM_BUS, sizeof(struct sockaddr_un));
-                break;
-            }
-
-            case BUS_SESSION:
+            struct pollfd pfd{fd_, POLLOUT, 0};
+            rc = poll(&pfd, 1, CONNECT_TIMEOUT.count());
+            if (rc == 0)
             {
-                return EERROR("Not implemented");
+                return ECODE(ERROR_CODE::TIMEOUT, "connect timeout");
             }
 
-            case BUS_USER:
-            {
-                return EERROR("Not implemented");
-            }
+            int so_error = 0;
+            socklen_t size = sizeof(int);
+            getsockopt(fd_, SOL_SOCKET, SO_ERROR, &so_error, &size);
+            errno = so_error;
+            rc = so_error ? -1 : 0;
         }
+
         if (rc < 0)
         {
-            return EERROR(strerror(errno));
+            return ESYSTEM(errno);
         }
 
+        return ESUCCESS;
+    }
+
+
+    DBusError DBusConnection::setupSocket()
+    {
         // set socket non blocking
         int flags = fcntl(fd_, F_GETFL, 0);
         if (flags < 0)
         {
-            return EERROR(strerror(errno));
-        }
-
-        rc = fcntl(fd_, F_SETFL, flags | O_NONBLOCK);
-        if (rc < 0)
-        {
-            return EERROR(strerror(errno));
+            return ESYSTEM(errno);
         }
 
-        rc = write(fd_, "\0", 1);
+        int rc = fcntl(fd_, F_SETFL, flags | O_NONBLOCK);
         if (rc < 0)
         {
-            return EERROR(strerror(errno));
+            return ESYSTEM(errno);
         }
 
         return ESUCCESS;
@@ -301,7 +1777,7 @@ namespace dbus
         int32_t rc = write(fd_, req.c_str(), req.size());
         if (rc < 0)
         {
-            return EERROR(strerror(errno));
+            return ESYSTEM(errno);
         }
 
         return ESUCCESS;
@@ -312,6 +1788,7 @@ namespace dbus
     {
         reply.clear();
         auto start = steady_clock::now();
+        steady_clock::time_point spin_end{};
 
         while (true)
         {
@@ -319,20 +1796,28 @@ namespace dbus
             milliseconds spent = duration_cast<milliseconds>(now - start);
             if ((timeout - spent) < 0ms)
             {
-                return EERROR("timeout");
+                DBUS_METRICS(metrics_.timeout());
+                return ECODE(ERROR_CODE::TIMEOUT, "timeout");
             }
 
             uint8_t buffer[4096];
             int r = read(fd_, buffer, 4096);
+            DBUS_METRICS(metrics_.readSyscall());
             if (r < 0)
             {
                 if (errno == EAGAIN)
                 {
-                    usleep(1000);
+                    DBUS_METRICS(metrics_.eagain());
+                    DBusError err = waitSocket(POLLIN, spin_end, timeout - spent);
+                    if (err)
+                    {
+                        return err;
+                    }
                     continue;
                 }
-                return EERROR(strerror(errno));
+                return ESYSTEM(errno);
             }
+            spinDone(spin_end);
 
             reply.insert(reply.end(), buffer, buffer + r);
             if (std::equal(auth::ENDLINE.rbegin(), auth::ENDLINE.rend(), reply.rbegin()))
@@ -343,9 +1828,97 @@ namespace dbus
     }
 
 
+    DBusError DBusConnection::readAuthLine(std::string& line, milliseconds timeout)
+    {
+        // Byte per byte: the peer may send messages right after BEGIN, they shall stay in the socket.
+        line.clear();
+        while (not std::equal(auth::ENDLINE.rbegin(), auth::ENDLINE.rend(), line.rbegin()) or (line.size() < auth::ENDLINE.size()))
+        {
+            char c;
+            DBusError err = readData(&c, 1, timeout);
+            if (err)
+            {
+                return err;
+            }
+            line += c;
+        }
+
+        line.resize(line.size() - auth::ENDLINE.size());
+        return ESUCCESS;
+    }
+
+
+    DBusError DBusConnection::waitSocket(short events, steady_clock::time_point& spin_end, milliseconds timeout)
+    {
+        if (spin_ > 0us)
+        {
+            auto const now = steady_clock::now();
+            if (spin_end == steady_clock::time_point{})
+            {
+                spin_end = now + spin_;
+            }
+            if (now < spin_end)
+            {
+                return ESUCCESS; // retry at once.
+            }
+        }
+
+        struct pollfd pfd{fd_, events, 0};
+        if ((poll(&pfd, 1, std::max(0ms, timeout).count()) < 0) and (errno != EINTR))
+        {
+            return ESYSTEM(errno);
+        }
+        return ESUCCESS;
+    }
+
+
+    void DBusConnection::spinDone(steady_clock::time_point& spin_end)
+    {
+        if (spin_end != steady_clock::time_point{})
+        {
+            DBUS_METRICS(metrics_.spin(steady_clock::now() < spin_end));
+            spin_end = {};
+        }
+    }
+
+
+    int DBusConnection::pollFd() const
+    {
+#ifdef DBUS_ENABLE_IO_URING
+        if (uring_)
+        {
+            return uring_->pollFd();
+        }
+#endif
+        return fd_;
+    }
+
+
+    bool DBusConnection::buffered() const
+    {
+#ifdef DBUS_ENABLE_IO_URING
+        return uring_ and uring_->buffered();
+#else
+        return false;
+#endif
+    }
+
+
     DBusError DBusConnection::readData(void* data, uint32_t data_size, milliseconds timeout)
     {
+#ifdef DBUS_ENABLE_IO_URING
+        if (uring_)
+        {
+            DBUS_METRICS(uint64_t const enters = uring_->enters());
+            DBusError err = uring_->read(data, data_size, timeout);
+            DBUS_METRICS(metrics_.readSyscall(uring_->enters() - enters));
+            DBUS_METRICS(if (err.code() == ERROR_CODE::TIMEOUT) { metrics_.timeout(); });
+            return err;
+        }
+#endif
+
         auto start_timestamp = steady_clock::now();
+        steady_clock::time_point spin_end{};
 
         uint32_t to_read = data_size;
         uint32_t position = 0;
@@ -356,19 +1929,31 @@ namespace dbus
             milliseconds spent = duration_cast<milliseconds>(now - start_timestamp);
             if ((timeout - spent) < 0ms)
             {
-                return EERROR("timeout");
+                DBUS_METRICS(metrics_.timeout());
+                return ECODE(ERROR_CODE::TIMEOUT, "timeout");
             }
 
             int r = read(fd_, buffer + position, to_read);
+            DBUS_METRICS(metrics_.readSyscall());
             if (r < 0)
             {
                 if (errno == EAGAIN)
                 {
-                    usleep(1000);
+                    DBUS_METRICS(metrics_.eagain());
+                    DBusError err = waitSocket(POLLIN, spin_end, timeout - spent);
+                    if (err)
+                    {
+                        return err;
+                    }
                     continue;
                 }
-                return EERROR(strerror(errno));
+                return ESYSTEM(errno);
+            }
+            if (r == 0)
+            {
+                return EERROR("Connection closed by peer"); // rather than spinning until the deadline.
             }
+            spinDone(spin_end);
 
             to_read -= r;
             position += r;
@@ -381,6 +1966,7 @@ namespace dbus
     DBusError DBusConnection::writeData(void const* data, uint32_t data_size, milliseconds timeout)
     {
         auto start_timestamp = steady_clock::now();
+        steady_clock::time_point spin_end{};
 
         uint32_t to_write = data_size;
         uint32_t position = 0;
@@ -391,19 +1977,27 @@ namespace dbus
             milliseconds spent = duration_cast<milliseconds>(now - start_timestamp);
             if ((timeout - spent) < 0ms)
             {
-                return EERROR("timeout");
+                DBUS_METRICS(metrics_.timeout());
+                return ECODE(ERROR_CODE::TIMEOUT, "timeout");
             }
 
             int r = write(fd_, buffer + position, to_write);
+            DBUS_METRICS(metrics_.writeSyscall());
             if (r < 0)
             {
                 if (errno == EAGAIN)
                 {
-                    usleep(1000);
+                    DBUS_METRICS(metrics_.eagain());
+                    DBusError err = waitSocket(POLLOUT, spin_end, timeout - spent);
+                    if (err)
+                    {
+                        return err;
+                    }
                     continue;
                 }
-                return EERROR(strerror(errno));
+                return ESYSTEM(errno);
             }
+            spinDone(spin_end);
 
             to_write -= r;
             position += r;
@@ -411,4 +2005,178 @@ namespace dbus
 
         return ESUCCESS;
     }
+
+
+    DBusError DBusConnection::writeBuffers(std::vector<struct iovec>& buffers, std::size_t& written,
+                                           [[maybe_unused]] milliseconds timeout) // io_uring only.
+    {
+#ifdef DBUS_ENABLE_IO_URING
+        if (uring_)
+        {
+            // The whole batch in one submission (the ring always polls writable), within the caller's deadline.
+            DBUS_METRICS(uint64_t const enters = uring_->enters());
+            DBusError err = uring_->write(buffers, written, timeout);
+            DBUS_METRICS(metrics_.writeSyscall(uring_->enters() - enters));
+            return err;
+        }
+#endif
+
+        // As much as the socket takes, IOV_MAX buffers per syscall. A partially written buffer is advanced.
+        while (written < buffers.size())
+        {
+            int const count = std::min<std::size_t>(buffers.size() - written, IOV_MAX);
+            ssize_t r = writev(fd_, &buffers[written], count);
+            DBUS_METRICS(metrics_.writeSyscall());
+            if (r < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                if (errno == EAGAIN)
+                {
+                    DBUS_METRICS(metrics_.eagain());
+                    return ESUCCESS; // full: wait for POLLOUT.
+                }
+                return ESYSTEM(errno);
+            }
+
+            std::size_t size = r;
+            while ((written < buffers.size()) and (size >= buffers[written].iov_len))
+            {
+                size -= buffers[written].iov_len;
+                ++written;
+            }
+            if (size > 0)
+            {
+                buffers[written].iov_base = static_cast<uint8_t*>(buffers[written].iov_base) + size;
+                buffers[written].iov_len -= size;
+            }
+        }
+        return ESUCCESS;
+    }
+
+
+    DBusError DBusConnection::startCapture(std::string const& path)
+    {
+        auto capture = std::make_unique<WireCapture>();
+        DBusError err = capture->open(path);
+        if (err)
+        {
+            return err;
+        }
+
+        capture_ = std::move(capture);
+        return ESUCCESS;
+    }
+
+
+    void DBusConnection::stopCapture()
+    {
+        capture_.reset();
+    }
+
+
+    DBusMetrics::Snapshot DBusConnection::metrics() const
+    {
+#ifdef DBUS_ENABLE_METRICS
+        return metrics_.snapshot();
+#else
+        return DBusMetrics::Snapshot{};
+#endif
+    }
+
+
+#ifdef DBUS_ENABLE_METRICS
+    void DBusConnection::sent(DBusMessage const& msg, steady_clock::time_point start)
+    {
+        auto now = steady_clock::now();
+        metrics_.messageOut(msg.type(), msg.headerBuffer_.size() + msg.body_.size());
+        metrics_.queueTime(duration_cast<nanoseconds>(now - start).count());
+        trackCall(msg, now);
+    }
+
+
+    void DBusConnection::trackCall(DBusMessage const& msg, steady_clock::time_point now)
+    {
+        if ((not msg.expectReply()) or (msg.serial() == 0))
+        {
+            return;
+        }
+
+        if (pendingCalls_.empty())
+        {
+            pendingCalls_.resize(PENDING_CALL_SLOTS, {0, {}});
+        }
+        PendingCall& slot = pendingCalls_[msg.serial() % PENDING_CALL_SLOTS];
+        if (slot.serial == 0)
+        {
+            pendingCount_++;
+        }
+        slot = {msg.serial(), now}; // otherwise an older call loses its sample.
+        metrics_.pendingCalls(pendingCount_);
+    }
+
+
+    void DBusConnection::untrackCall(uint32_t serial, steady_clock::time_point* sent)
+    {
+        if (pendingCalls_.empty() or (serial == 0))
+        {
+            return;
+        }
+
+        PendingCall& slot = pendingCalls_[serial % PENDING_CALL_SLOTS];
+        if (slot.serial != serial)
+        {
+            return; // not a call of ours, or its sample was dropped.
+        }
+        if (sent)
+        {
+            *sent = slot.sent;
+        }
+        slot.serial = 0;
+        pendingCount_--;
+        metrics_.pendingCalls(pendingCount_);
+    }
+
+
+    void DBusConnection::callTimedOut(uint32_t serial)
+    {
+        metrics_.callTimeout();
+        untrackCall(serial);
+    }
+
+
+    void DBusConnection::callFailed(uint32_t serial)
+    {
+        metrics_.callFailure();
+        untrackCall(serial);
+    }
+
+
+    void DBusConnection::trackReply(DBusMessage const& msg, steady_clock::time_point now)
+    {
+        if (not (msg.isReply() or msg.isError()))
+        {
+            return;
+        }
+
+        steady_clock::time_point sent = steady_clock::time_point::max();
+        untrackCall(msg.replySerial(), &sent);
+        if (sent != steady_clock::time_point::max())
+        {
+            metrics_.callLatency(duration_cast<nanoseconds>(now - sent).count());
+        }
+    }
+#endif
+
+
+    std::ostream& operator<<(std::ostream& out, DBusConnection::ConnectAttempt const& attempt)
+    {
+        auto us = [](nanoseconds ns) { return duration_cast<duration<double, std::micro>>(ns).count(); };
+
+        out << attempt.address << ": " << (attempt.failure.empty() ? "connected" : ("failed (" + attempt.failure + ")"))
+            << " - socket " << us(attempt.socket) << " us, auth " << us(attempt.auth) << " us, hello " << us(attempt.hello) << " us";
+        return out;
+    }
 }
@@ -3,8 +3,24 @@
 
 // C++
 #include <chrono>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 
+// POSIX
+#include <sys/uio.h>
+
+#include "BusAddress.h"
 #include "DBusMessage.h"
+#include "DBusMetrics.h"
+#include "MatchRule.h"
+#include "SignalCoalescer.h"
+#include "SubscriberQueue.h"
+#include "TimerWheel.h"
+#include "UringTransport.h"
+#include "WireCapture.h"
 
 namespace dbus
 {
@@ -19,22 +35,255 @@ namespace dbus
             BUS_SESSION,
             BUS_USER
         };
+
+        enum IO_BACKEND
+        {
+            BACKEND_POSIX, // read() / write() on the socket.
+            BACKEND_URING  // see UringTransport.h.
+        };
+
+        // Outcome and setup time of each address tried by the last connection.
+        struct ConnectAttempt
+        {
+            std::string address;
+            std::string failure; // failed step ("socket", "auth" or "hello"), empty on success.
+            nanoseconds socket{0};
+            nanoseconds auth{0};
+            nanoseconds hello{0};
+        };
+
+        using SignalHandler = std::function<void(DBusMessage& signal)>;
+        using ReplyHandler = std::function<void(DBusError err, DBusMessage& reply)>;
+
+        static constexpr milliseconds TIMER_TICK{1}; // resolution of asynchronous call deadlines.
+
+        DBusConnection() = default;
+        ~DBusConnection();
+
+        DBusConnection(DBusConnection const&) = delete;
+        DBusConnection& operator=(DBusConnection const&) = delete;
         
         DBusError connect(BUS_TYPE bus);
+        DBusError connect(std::string const& address); // address list, tried in turn (see BusAddress.h): "unix:abstract=/tmp/x;unix:path=/tmp/bus"
+        DBusError attach(int fd);                      // already connected stream socket (i.e. socketpair()), fd is owned by the connection.
+
+        // Peer to peer connection (no bus daemon): no Hello(), no routing, messages have no sender nor destination.
+        // One side listens then accepts the other side that connects with connectPeer().
+        // Addresses: "unix:path=/tmp/socket" or "unix:abstract=name".
+        DBusError listen(std::string const& address);
+        DBusError accept(milliseconds timeout);
+        DBusError connectPeer(std::string const& address);
+        bool isPeer() const { return peer_; }
+
+        std::vector<ConnectAttempt> const& connectReport() const { return connectReport_; }
+
+        // I/O backend, selected once connected (BACKEND_POSIX until then). BACKEND_URING fails if not compiled in
+        // (CMake option ENABLE_IO_URING) or not supported by the kernel, the connection then stays on
+        // BACKEND_POSIX. Once selected, io_uring stays until the connection closes.
+        DBusError setBackend(IO_BACKEND backend);
+        IO_BACKEND backend() const;
+
+        // Busy poll: when the socket is not ready (EAGAIN), retry at once for up to spin before blocking in poll()
+        // (0, the default: block at once). Hits and misses are counted in the metrics. cpu >= 0 also pins the
+        // calling thread, the one doing the connection I/O, on that CPU. BACKEND_POSIX only.
+        DBusError setBusyPoll(microseconds spin, int cpu = -1);
+
         DBusError send(DBusMessage&& msg);
         DBusError recv(DBusMessage& msg, milliseconds timeout);
+
+        // Next raw frame, through the same buffered reads as recv(), but neither decoded nor dispatched.
+        // frame stays valid until the next receive.
+        DBusError recvFrame(uint8_t const*& frame, uint32_t& frame_size, milliseconds timeout);
+
+        // Turn the connection into a bus monitor (org.freedesktop.DBus.Monitoring.BecomeMonitor): from then on it
+        // gets a copy of every message the bus routes (matching rules if any) and shall not send anything.
+        // Read the traffic with recvFrame() (see BusMonitor.h).
+        DBusError becomeMonitor(std::vector<MatchRule> const& rules = {}, milliseconds timeout = 1000ms);
+
+        // Send a method call and wait for its reply. Unrelated incoming messages are discarded
+        // (signals matched by a rule with a handler are dispatched meanwhile).
+        DBusError call(DBusMessage&& msg, DBusMessage& reply, milliseconds timeout);
+
+        // Send a method call without waiting: the handler gets the reply (error replies as REMOTE errors),
+        // or a TIMEOUT error with an empty message if none came before the deadline. Handlers run from
+        // recv() / call(). Deadlines live in a timer wheel, woken up by a one-shot timerfd armed at its next
+        // expiry (or cascade): no wakeup between deadlines.
+        DBusError callAsync(DBusMessage&& msg, ReplyHandler handler, milliseconds timeout);
+
+        // Pipelined method calls: the whole batch is written with as few syscalls as possible (writev), then
+        // the replies are gathered as they come, in any order, until all answered or the batch deadline.
+        // results[i] is the outcome of calls[i]: its reply, a REMOTE error for error replies (the reply is
+        // kept), a TIMEOUT error if unanswered, or the connection error that stopped the batch before it was
+        // answered (or written). Returns a TIMEOUT error if some calls are unanswered, or that connection error.
+        // Unrelated incoming messages are handled as by call().
+        struct BatchResult
+        {
+            DBusError error;
+            DBusMessage reply;
+        };
+        DBusError callBatch(std::vector<DBusMessage>& calls, std::vector<BatchResult>& results, milliseconds timeout);
+        bool cancelCall(uint32_t serial); // false if unknown (already answered or expired).
+        std::size_t pendingCalls() const { return asyncCalls_.size(); }
+
+        // Subscribe to signals (AddMatch() on the bus, local only on peer connections).
+        // Once a rule is registered, received broadcast signals are filtered on their header fields: those
+        // matching no rule are dropped without decoding their body. Signals addressed to us are never dropped.
+        // Matched signals go to the rule handler from recv() / call(), or are returned by recv() if the handler
+        // is empty.
+        DBusError addMatch(MatchRule const& rule, SignalHandler handler, uint32_t& id);
+        DBusError removeMatch(uint32_t id);
+
+        // Subscribe a consumer thread: matched signals are copied to queue (see SubscriberQueue.h) from
+        // recv() / call(), and the consumer pop()s them. Overflows are counted in the metrics; with
+        // QUEUE_DISCONNECT, the first one closes the queue and removes the match (RemoveMatch() not awaited).
+        DBusError addMatch(MatchRule const& rule, std::shared_ptr<SubscriberQueue> queue, uint32_t& id);
+
+        // Coalesce the signals of a subscription with a handler (see SignalCoalescer.h): window delays the first
+        // signal of a source, and is the minimum interval between two signals of a source given to the handler.
+        // Held signals reach the handler from recv() / call(), ticked like asynchronous call deadlines.
+        // COALESCE_NONE: back to immediate delivery. Merged and dropped signals are counted in the metrics.
+        DBusError setCoalescing(uint32_t id, SignalCoalescer::POLICY policy, milliseconds window);
+
+        std::string const& name() const { return name_; }
+
+        // Bus names owners cache (not on peer connections). trackNames() fills it with ListNames() (and
+        // ListActivatableNames()), then NameOwnerChanged keeps it current: this registers a match rule,
+        // so broadcast signals matching no rule are filtered from then on (see addMatch()).
+        DBusError trackNames();
+        DBusError nameOwner(std::string const& name, std::string& owner); // cached, GetNameOwner() otherwise.
+        bool hasOwner(std::string const& name) const;
+
+        // Once names are tracked: calls to names without owner (and not activatable) fail without
+        // a bus round trip. Default: on.
+        void setFailFast(bool enable) { failFast_ = enable; }
+
+        // Once names are tracked: drop signals matched through a well-known sender name that their sender
+        // does not own anymore (i.e. previous owner still emitting after a name transfer). Default: off.
+        void setDropStaleSignals(bool enable) { dropStale_ = enable; }
+
+        // Record every frame sent and received to a trace file (see WireCapture and dbus_replay).
+        DBusError startCapture(std::string const& path);
+        void stopCapture();
+
+        // Counters and histograms (empty snapshot if not compiled with DBUS_ENABLE_METRICS).
+        DBusMetrics::Snapshot metrics() const;
         
     private:
-        DBusError initSocket(BUS_TYPE bus);
+        DBusError connectFirst(std::string const& addresses, bool with_hello);
+        DBusError handshake(bool with_hello, ConnectAttempt& attempt);
+        DBusError initSocket(BusAddress const& address);
+        DBusError setupSocket();
+        void closeSocket();
+        DBusError authenticate();
+        DBusError acceptAuthentication(milliseconds timeout);
+        DBusError hello();
         DBusError readAuth(std::string& reply, milliseconds timeout);
+        DBusError readAuthLine(std::string& line, milliseconds timeout);
         DBusError writeAuthRequest(std::string const& request);
         
+        DBusError readFrame(uint32_t& frame_size, milliseconds timeout); // one wire frame in frame_.
+        DBusError recvOne(DBusMessage& msg, milliseconds timeout, bool& delivered); // false: filtered or dispatched.
+        DBusError prepareSend(DBusMessage& msg);                         // fast fail check, sender, serialize.
+        bool dispatchSignal(DBusMessage& msg); // true if the signal shall be returned by recv().
+        bool dispatchReply(DBusMessage& msg);  // true if consumed by an asynchronous call handler.
+
+        DBusError waitReadable(milliseconds timeout); // while deadlines are pending: expire them meanwhile.
+        void expireCalls();
+        void flushSignals(); // coalesced signals whose window closed.
+        bool forgetMatch(uint32_t id, std::string& rule); // local part of removeMatch().
+        void dropMatch(uint32_t id);                       // removeMatch() from a handler, without waiting.
+        DBusError initTimer();
+        void armTimer(steady_clock::time_point deadline); // one-shot, moved earlier only.
+        void armNext();      // after a wakeup: at the next wheel expiry or coalescer window closing.
+        void disarmTimer();  // once idle: no deadline, no coalesced signal.
+        uint64_t currentTick() const;
+        steady_clock::time_point tickTime(uint64_t tick) const;
+
+        DBusError watchNameOwners();
+        void nameOwnerChanged(DBusMessage& signal);
+        void setOwner(std::string const& name, std::string const& owner);
+        void removeOwner(std::string const& name);
+        bool knownAbsent(std::string const& name, uint8_t flags) const;
+        bool staleSender(uint32_t id, std::string_view sender) const;
+
+        // After EAGAIN: spin while the busy poll budget lasts (spin_end: end of the current spin, zero before the
+        // first EAGAIN), then wait in poll() for events until timeout. The caller retries the syscall.
+        DBusError waitSocket(short events, steady_clock::time_point& spin_end, milliseconds timeout);
+        void spinDone(steady_clock::time_point& spin_end); // the syscall succeeded: count the spin.
         DBusError readData(void* data, uint32_t data_size, milliseconds timeout);
         DBusError writeData(void const* data, uint32_t data_size, milliseconds timeout);
+        DBusError writeBuffers(std::vector<struct iovec>& buffers, std::size_t& written, // until EAGAIN (sockets),
+                               milliseconds timeout);                                   // all or timeout (io_uring).
+        DBusError writeMessage(DBusMessage const& msg, milliseconds timeout);             // header and body.
+        int pollFd() const;    // readable when a message comes in.
+        bool buffered() const; // received data already taken from the socket.
         
-        int fd_;
+        int fd_{-1};
+        int listenFd_{-1};
+        microseconds spin_{0}; // busy poll budget.
+        bool peer_{false};
         std::string name_; // our unique name on the bus.
+        std::vector<ConnectAttempt> connectReport_;
+        std::vector<uint8_t> frame_; // receive buffer (one wire frame).
+        std::shared_ptr<InternTable> strings_; // header strings of received messages, renewed when full.
+        std::unique_ptr<WireCapture> capture_;
+#ifdef DBUS_ENABLE_IO_URING
+        std::unique_ptr<UringTransport> uring_;  // BACKEND_URING.
+        std::vector<struct iovec> sendBuffers_;   // scratch: buffers of the message being sent.
+#endif
+
+        MatchIndex matches_;
+        std::unordered_map<uint32_t, SignalHandler> handlers_; // by match id.
+        std::vector<uint32_t> matched_;                        // scratch: ids matched by the last signal.
+        SignalCoalescer coalescer_;
+        std::vector<SignalCoalescer::Ready> ready_;            // scratch: coalesced signals to hand over.
+
+        std::unordered_map<std::string, std::string> owners_;  // bus name -> unique name of its owner.
+        std::unordered_set<std::string_view> liveUniqueNames_; // views on owners_ keys: lookup from header views.
+        std::unordered_set<std::string> activatable_;
+        uint32_t ownersMatch_{0};
+        bool namesTracked_{false};
+        bool failFast_{true};
+        bool dropStale_{false};
+
+        struct AsyncCall
+        {
+            ReplyHandler handler;
+            TimerWheel::TimerId timer;
+        };
+        std::unordered_map<uint32_t, AsyncCall> asyncCalls_; // by call serial.
+        TimerWheel timers_;
+        steady_clock::time_point timerEpoch_; // tick 0.
+        int timerFd_{-1};
+        bool timerArmed_{false};
+        steady_clock::time_point timerDeadline_{steady_clock::time_point::max()}; // armed expiry, max() once fired.
+        std::vector<uint32_t> expired_; // scratch: serials of the calls expired by the last tick.
+
+#ifdef DBUS_ENABLE_METRICS
+        void sent(DBusMessage const& msg, steady_clock::time_point start);
+        void trackCall(DBusMessage const& msg, steady_clock::time_point now);
+        void trackReply(DBusMessage const& msg, steady_clock::time_point now);
+        void callTimedOut(uint32_t serial);
+        void callFailed(uint32_t serial); // connection error before the reply.
+        void untrackCall(uint32_t serial, steady_clock::time_point* sent = nullptr); // sent: its send timestamp.
+
+        // Send timestamps of the calls waiting for a reply, by serial modulo the number of slots (serial 0: free
+        // slot). A call takes the slot of the one PENDING_CALL_SLOTS serials older: replies may never come, the
+        // oldest samples are dropped, in sending order whatever the serials wrap around. Allocated on first call.
+        static constexpr uint32_t PENDING_CALL_SLOTS = 8192;
+        struct PendingCall
+        {
+            uint32_t serial;
+            steady_clock::time_point sent;
+        };
+
+        DBusMetrics metrics_;
+        std::vector<PendingCall> pendingCalls_;
+        uint32_t pendingCount_{0};
+#endif
     };
+
+    std::ostream& operator<<(std::ostream& out, DBusConnection::ConnectAttempt const& attempt);
 }
 
 #endif // DBUSCONNECTION_H
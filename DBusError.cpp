@@ -1,31 +1,273 @@
 #include "DBusError.h"
 
+#include <atomic>
+#include <cstring>
 #include <iostream>
 
 namespace dbus
 {
-    DBusError::DBusError(std::string const& message, 
-                         std::string const& function, 
-                         std::string const& file, 
-                         int32_t line)
-        : isError_{true}
-        , what_{function + ": " + message + " (" + file + ":" + std::to_string(line) + ")"}
+    namespace
+    {
+        std::string format(ErrorSite const* site, std::string const& message)
+        {
+            if (site == nullptr)
+            {
+                return message;
+            }
+            return std::string(site->function) + ": " + message + " (" + site->file + ":" + std::to_string(site->line) + ")";
+        }
+
+        std::array<std::atomic<ErrorSite const*>, ErrorSite::MAX_SITES> sites{};
+        std::atomic<uint32_t> siteCount{0};
+    }
+
+
+    uint16_t ErrorSite::enroll(ErrorSite const* site)
+    {
+        uint32_t const index = siteCount.fetch_add(1, std::memory_order_relaxed);
+        if (index >= MAX_SITES)
+        {
+            return 0; // propagation through this site needs a detail block.
+        }
+        sites[index].store(site, std::memory_order_release);
+        return static_cast<uint16_t>(index + 1);
+    }
+
+
+    ErrorSite const* ErrorSite::find(uint16_t id)
+    {
+        return (id == 0) ? nullptr : sites[id - 1].load(std::memory_order_acquire);
+    }
+
+
+    std::string str(ERROR_CODE code)
+    {
+        switch (code)
+        {
+            case ERROR_CODE::SUCCESS: { return "SUCCESS"; }
+            case ERROR_CODE::FAILED:  { return "FAILED";  }
+            case ERROR_CODE::TIMEOUT: { return "TIMEOUT"; }
+            case ERROR_CODE::SYSTEM:  { return "SYSTEM";  }
+            case ERROR_CODE::REMOTE:  { return "REMOTE";  }
+            default:                  { return "UNKNOWN"; }
+        }
+    }
+
+
+    struct DBusError::Detail
+    {
+        static constexpr uint32_t MAX_FRAMES = 4;
+        struct Frame
+        {
+            ErrorSite const* site;
+            char const* message;
+        };
+
+        char const* message{nullptr}; // string literal message.
+        int32_t errnum{0};            // SYSTEM.
+        std::string text;             // message built at runtime.
+        bool hasText{false};
+        std::string context;          // propagated errors that carry a runtime message.
+        uint32_t frames{0};           // used entries of trace.
+        uint32_t lostFrames{0};       // propagation sites beyond MAX_FRAMES.
+        std::array<Frame, MAX_FRAMES> trace; // propagation sites past the inline ones, first frames entries only.
+    };
+    static_assert(sizeof(DBusError) == 3 * sizeof(void*), "DBusError: code and inline frames, site and one pointer");
+
+
+    DBusError::DBusError(ERROR_CODE code, char const* message, ErrorSite const* site)
+        : code_{code}
+        , site_{site}
+        , data_{(code == ERROR_CODE::SYSTEM) ? 0 : reinterpret_cast<uintptr_t>(message)} // SYSTEM: strerror().
     { }
-    
-    
-    void DBusError::what() const
+
+
+    DBusError::DBusError(ERROR_CODE code, std::string message, ErrorSite const* site)
+        : code_{code}
+        , site_{site}
+    {
+        Detail& detail = ownDetail();
+        detail.text = std::move(message);
+        detail.hasText = true;
+    }
+
+
+    DBusError::DBusError(ERROR_CODE code, int32_t errnum, ErrorSite const* site)
+        : code_{code}
+        , site_{site}
+        , data_{static_cast<uint32_t>(errnum)}
+    { }
+
+
+    DBusError& DBusError::operator=(DBusError&& other) noexcept
+    {
+        if (this == &other)
+        {
+            return *this;
+        }
+        if (detailed_)
+        {
+            release();
+        }
+
+        code_ = other.code_;
+        detailed_ = other.detailed_;
+        frames_ = other.frames_;
+        site_ = other.site_;
+        data_ = other.data_;
+        other.detailed_ = false;
+        other.data_ = 0;
+        return *this;
+    }
+
+
+    int32_t DBusError::systemError() const
+    {
+        if (code_ != ERROR_CODE::SYSTEM)
+        {
+            return 0;
+        }
+        return detailed_ ? detail()->errnum : static_cast<int32_t>(data_);
+    }
+
+
+    char const* DBusError::literal() const
     {
-        std::cout << what_ << std::endl;
-        for (auto b : backtrace_)
+        char const* message = nullptr;
+        if (detailed_)
+        {
+            message = detail()->message;
+        }
+        else if (code_ != ERROR_CODE::SYSTEM)
         {
-            std::cout << " from: " << b << std::endl;
+            message = reinterpret_cast<char const*>(data_);
         }
+        return (message == nullptr) ? "" : message;
     }
-    
-    
+
+
+    DBusError::Detail& DBusError::ownDetail()
+    {
+        if (not detailed_)
+        {
+            Detail* detail = new Detail;
+            if (code_ == ERROR_CODE::SYSTEM)
+            {
+                detail->errnum = static_cast<int32_t>(data_);
+            }
+            else
+            {
+                detail->message = reinterpret_cast<char const*>(data_);
+            }
+            data_ = reinterpret_cast<uintptr_t>(detail);
+            detailed_ = true;
+        }
+        return *detail();
+    }
+
+
+    void DBusError::release()
+    {
+        delete detail();
+        detailed_ = false;
+        data_ = 0;
+    }
+
+
+    std::string DBusError::message() const
+    {
+        if (code_ == ERROR_CODE::SUCCESS)
+        {
+            return "success";
+        }
+        if (detailed_ and detail()->hasText)
+        {
+            return detail()->text;
+        }
+        if (code_ == ERROR_CODE::SYSTEM)
+        {
+            return strerror(systemError());
+        }
+        return literal();
+    }
+
+
+    std::string DBusError::str() const
+    {
+        std::string out = format(site_, message());
+        for (uint16_t id : frames_)
+        {
+            if (id != 0)
+            {
+                out += "\n from: " + format(ErrorSite::find(id), "");
+            }
+        }
+        if (not detailed_)
+        {
+            return out;
+        }
+
+        Detail const& detail = *this->detail();
+        for (uint32_t i = 0; i < detail.frames; ++i)
+        {
+            out += "\n from: " + format(detail.trace[i].site, detail.trace[i].message);
+        }
+        if (detail.lostFrames)
+        {
+            out += "\n from: (" + std::to_string(detail.lostFrames) + " more)";
+        }
+        out += detail.context;
+        return out;
+    }
+
+
+    void DBusError::what() const
+    {
+        std::cout << str() << std::endl;
+    }
+
+
     DBusError& DBusError::operator+=(DBusError&& other)
     {
-        backtrace_.emplace_back(std::move(other.what_));
+        if (not other)
+        {
+            return *this;
+        }
+
+        if (not *this)
+        {
+            *this = std::move(other);
+            return *this;
+        }
+
+        bool const static_text = (other.code_ != ERROR_CODE::SYSTEM) and
+                                 (not other.detailed_ or (not other.detail()->hasText and (other.detail()->frames == 0) and
+                                                          other.detail()->context.empty()));
+        // Inline while no frame went to the detail block, to keep them in order.
+        bool const inline_frame = static_text and (other.site_ != nullptr) and (other.site_->id != 0) and
+                                  (other.literal()[0] == '\0') and (not detailed_ or (detail()->frames == 0));
+        for (uint16_t& id : frames_)
+        {
+            if (inline_frame and (id == 0))
+            {
+                id = other.site_->id;
+                return *this;
+            }
+        }
+
+        Detail& detail = ownDetail();
+        if (not static_text)
+        {
+            detail.context += "\n from: " + other.str();
+        }
+        else if (detail.frames < Detail::MAX_FRAMES)
+        {
+            detail.trace[detail.frames++] = {other.site_, other.literal()};
+        }
+        else
+        {
+            detail.lostFrames++;
+        }
         return *this;
     }
 }
@@ -1,41 +1,113 @@
 #ifndef DBUS_ERROR_H
 #define DBUS_ERROR_H
 
+#include <array>
 #include <cstdint>
+#include <memory>
 #include <string>
-#include <vector>
 
 namespace dbus
 {
+    enum class ERROR_CODE : uint8_t
+    {
+        SUCCESS = 0,
+        FAILED,     // generic failure, see message.
+        TIMEOUT,    // deadline reached.
+        SYSTEM,     // system call failure, see systemError() (errno).
+        REMOTE      // error reply or bus error name (org.freedesktop.DBus.Error.*).
+    };
+    std::string str(ERROR_CODE code);
+
+    // Where an error was raised: static data, one per call site. Sites are numbered when first used (id, 0 once
+    // MAX_SITES are taken): propagation sites are kept as numbers in the error itself.
+    struct ErrorSite
+    {
+        static constexpr uint32_t MAX_SITES = 4096;
+
+        char const* function;
+        char const* file;
+        int32_t line;
+        uint16_t id;
+
+        static uint16_t enroll(ErrorSite const* site);
+        static ErrorSite const* find(uint16_t id); // nullptr for 0.
+    };
+
+    // Static ErrorSite of the call site (one per expanded macro), function name of the enclosing function.
+    #define DBUS_ERROR_SITE                                                                                         \
+        ([](char const* function) -> dbus::ErrorSite const*                                                         \
+        {                                                                                                           \
+            static dbus::ErrorSite const site{function, __FILE__, __LINE__, dbus::ErrorSite::enroll(&site)};        \
+            return &site;                                                                                           \
+        }(__FUNCTION__))
+
     #define ESUCCESS DBusError()
-    #define EERROR(err) DBusError(err, __FUNCTION__, __FILE__, __LINE__)
-    
+    #define EERROR(err) DBusError(dbus::ERROR_CODE::FAILED, err, DBUS_ERROR_SITE)
+    #define ECODE(code, err) DBusError(code, err, DBUS_ERROR_SITE)
+    #define ESYSTEM(errnum) DBusError(dbus::ERROR_CODE::SYSTEM, static_cast<int32_t>(errnum), DBUS_ERROR_SITE)
+
+    // Three words: code and the first INLINE_FRAMES propagation sites (operator+= of an empty literal message, as
+    // err += EERROR("")), origin site, and a string literal message, an errno (SYSTEM) or a detail block.
+    // Raising errors from codes, errno and string literals and propagating them does not allocate, and moving
+    // them is copying these words. The detail block is allocated for messages built at runtime (std::string),
+    // propagation sites with a message and further ones. The text is formatted when asked for (str(), what()).
     class DBusError
     {
     public:
-        DBusError()  = default;
-        ~DBusError() = default;
-        
-        DBusError(DBusError&& other) = default;
-        DBusError& operator=(DBusError&& other) = default;
-        
+        DBusError() { }
+        ~DBusError()
+        {
+            if (detailed_)
+            {
+                release();
+            }
+        }
+
+        DBusError(DBusError&& other) noexcept
+            : code_{other.code_}
+            , detailed_{other.detailed_}
+            , frames_{other.frames_}
+            , site_{other.site_}
+            , data_{other.data_}
+        {
+            other.detailed_ = false;
+            other.data_ = 0;
+        }
+        DBusError& operator=(DBusError&& other) noexcept;
+
         DBusError(DBusError const& other) = delete;
         DBusError& operator=(DBusError const& other) = delete;
-                
-        DBusError(std::string const& message, 
-                  std::string const& function, 
-                  std::string const& file, 
-                  int32_t line);
-        
+
+        DBusError(ERROR_CODE code, char const* message, ErrorSite const* site); // message: string literal.
+        DBusError(ERROR_CODE code, std::string message, ErrorSite const* site);
+        DBusError(ERROR_CODE code, int32_t errnum, ErrorSite const* site);
+
         DBusError& operator+=(DBusError&& other);
 
-        operator bool() const { return isError_; }
+        operator bool() const { return code_ != ERROR_CODE::SUCCESS; }
+        ERROR_CODE code() const { return code_; }
+        int32_t systemError() const;
+        ErrorSite const* site() const { return site_; }
+
+        std::string message() const; // message only.
+        std::string str() const;     // message, site and propagation sites.
         void what() const;
-        
+
     private:
-        bool isError_{false};
-        std::string what_{"success"};
-        std::vector<std::string> backtrace_;
+        static constexpr uint32_t INLINE_FRAMES = 3;
+
+        struct Detail;
+
+        char const* literal() const;         // string literal message (the detail block one if any).
+        Detail* detail() const { return reinterpret_cast<Detail*>(data_); }
+        Detail& ownDetail();                 // allocated on first use.
+        void release();
+
+        ERROR_CODE code_{ERROR_CODE::SUCCESS};
+        bool detailed_{false};                        // data_ is a Detail*.
+        std::array<uint16_t, INLINE_FRAMES> frames_{}; // ids of the first propagation sites, 0 when unused.
+        ErrorSite const* site_{nullptr};
+        uintptr_t data_{0};                           // errno (SYSTEM) or string literal, unless detailed_.
     };
 }
 
@@ -1,32 +1,425 @@
 // debug
 #include <iostream>
-#include <fstream>
+#include <cstring>
 
 #include "helpers.h"
 #include "DBusMessage.h"
 #include "DBusVariant.h"
+#include "SignatureProgram.h"
 
 namespace dbus
 {
+    // Messages are queued and handed over by value: moves must not fall back to copies.
+    static_assert(std::is_nothrow_move_constructible_v<DBusMessage>);
+    static_assert(std::is_nothrow_move_assignable_v<DBusMessage>);
+
     // Init serial counter.
-    uint32_t DBusMessage::serialCounter_ = 1U;
+    std::atomic<uint32_t> DBusMessage::serialCounter_{1U};
 
     uint32_t DBusMessage::prepareCall(const std::string& name, const std::string& path, const std::string& interface, const std::string& method)
     {
-        header_ = {ENDIANNESS::LITTLE, MESSAGE_TYPE::METHOD_CALL, 0, 1, 0, serialCounter_};
-        serialCounter_++;
+        header_ = {ENDIANNESS::LITTLE, MESSAGE_TYPE::METHOD_CALL, 0, 1, 0, serialCounter_++};
+        restart();
+        setField(FIELD::PATH, path);
+        setField(FIELD::INTERFACE, interface);
+        setField(FIELD::MEMBER, method);
+        if (not name.empty()) // no destination on peer to peer connections.
+        {
+            setDestination(name);
+        }
+
+        return serial();
+    }
+
+
+    uint32_t DBusMessage::prepareReply(DBusMessage const& call)
+    {
+        header_ = {ENDIANNESS::LITTLE, MESSAGE_TYPE::METHOD_RETURN, 0, 1, 0, serialCounter_++};
+        restart();
+        replySerial_ = call.serial();
+        HeaderString const& sender = call.fields_[static_cast<uint32_t>(FIELD::SENDER)];
+        if (sender.present)
+        {
+            // The destination is the caller: its interned entry is shared, not copied.
+            HeaderString& destination = fields_[static_cast<uint32_t>(FIELD::DESTINATION)];
+            destination.present = true;
+            destination.entry = sender.entry;
+            if (sender.entry)
+            {
+                strings_ = call.strings_;
+            }
+            else
+            {
+                destination.owned = sender.owned;
+            }
+        }
+
+        return serial();
+    }
+
+
+    uint32_t DBusMessage::prepareError(DBusMessage const& call, std::string const& error_name)
+    {
+        prepareReply(call);
+        header_.type = MESSAGE_TYPE::ERROR;
+        setField(FIELD::ERROR_NAME, error_name);
+
+        return serial();
+    }
+
+
+    uint32_t DBusMessage::prepareSignal(std::string const& path, std::string const& interface, std::string const& signal)
+    {
+        header_ = {ENDIANNESS::LITTLE, MESSAGE_TYPE::SIGNAL, 0, 1, 0, serialCounter_++};
+        restart();
+        setField(FIELD::PATH, path);
+        setField(FIELD::INTERFACE, interface);
+        setField(FIELD::MEMBER, signal);
+
+        return serial();
+    }
+
+
+    bool DBusMessage::hasField(FIELD field) const
+    {
+        switch (field)
+        {
+            case FIELD::REPLY_SERIAL: { return replySerial_ != 0;     }
+            case FIELD::SIGNATURE:    { return not signature_.empty(); }
+            case FIELD::UNIX_FDS:     { return unixFds_ != 0;         }
+            default:
+            {
+                uint32_t const index = static_cast<uint32_t>(field);
+                return (index < STRING_FIELDS) and fields_[index].present;
+            }
+        }
+    }
+
+
+    DBusMessage::HeaderString const& DBusMessage::field(FIELD field) const
+    {
+        HeaderString const& header_string = fields_.at(static_cast<uint32_t>(field));
+        if (not header_string.present)
+        {
+            throw std::out_of_range("Missing header field " + str(field));
+        }
+        return header_string;
+    }
+
+
+    InternTable::Entry const* DBusMessage::interned(FIELD field) const
+    {
+        uint32_t const index = static_cast<uint32_t>(field);
+        if ((index >= STRING_FIELDS) or not fields_[index].present)
+        {
+            return nullptr;
+        }
+        return fields_[index].entry;
+    }
+
+
+    void DBusMessage::setField(FIELD field, std::string const& value)
+    {
+        HeaderString& header_string = fields_[static_cast<uint32_t>(field)];
+        header_string.entry = nullptr;
+        header_string.owned.setData(value);
+        header_string.present = true;
+    }
+
+
+    void DBusMessage::restart()
+    {
+        // Buffers keep their capacity: a reused message is built without allocation.
+        template_.reset();
+        clearFields();
+        signature_.clear();
+        body_.clear();
+        body_pos_ = 0;
+        sign_pos_ = 0;
+    }
+
+
+    void DBusMessage::clearFields()
+    {
+        for (auto& header_string : fields_)
+        {
+            header_string.entry = nullptr;
+            header_string.present = false;
+        }
+        replySerial_ = 0;
+        unixFds_ = 0;
+        strings_.reset();
+    }
+
+
+    template<typename F>
+    void DBusMessage::visitFields(F&& visitor) const
+    {
+        for (uint32_t code = static_cast<uint32_t>(FIELD::PATH); code < STRING_FIELDS; ++code)
+        {
+            FIELD const field = static_cast<FIELD>(code);
+            if (field == FIELD::REPLY_SERIAL)
+            {
+                if (replySerial_ != 0)
+                {
+                    visitor(field, DBUS_TYPE::UINT32, &replySerial_);
+                }
+            }
+            else if (fields_[code].present)
+            {
+                DBUS_TYPE const type = (field == FIELD::PATH) ? DBUS_TYPE::PATH : DBUS_TYPE::STRING;
+                visitor(field, type, &fields_[code].str());
+            }
+        }
+        if (not signature_.empty())
+        {
+            visitor(FIELD::SIGNATURE, DBUS_TYPE::SIGNATURE, static_cast<std::string const*>(&signature_));
+        }
+        if (unixFds_ != 0)
+        {
+            visitor(FIELD::UNIX_FDS, DBUS_TYPE::UINT32, &unixFds_);
+        }
+    }
+
+
+    DBusMessage::HeaderTemplate DBusMessage::callTemplate(std::string const& name, std::string const& path,
+                                                          std::string const& interface, std::string const& method,
+                                                          std::string const& signature)
+    {
+        DBusMessage msg;
+        msg.prepareCall(name, path, interface, method);
+        msg.signature_ = signature;
+        msg.serialize();
+        return std::make_shared<CallTemplate const>(CallTemplate{std::move(msg.headerBuffer_), name});
+    }
 
-        fields_ =
-        {{
-            {FIELD::DESTINATION, {name}},
-            {FIELD::PATH,        {ObjectPath{path}}},
-            {FIELD::INTERFACE,   {interface}},
-            {FIELD::MEMBER,      {method}},
-        }};
 
+    uint32_t DBusMessage::prepareFromTemplate(HeaderTemplate const& header)
+    {
+        std::memcpy(&header_, header->header.data(), sizeof(struct Header));
+        header_.serial = serialCounter_++;
+        restart();
+        template_ = header;
         return serial();
     }
 
+
+    DBusError DBusMessage::frameSize(uint8_t const* prefix, uint32_t& frame_size)
+    {
+        Header header;
+        std::memcpy(&header, prefix, sizeof(struct Header));
+        if (header.endianness != ENDIANNESS::LITTLE)
+        {
+            return EERROR("Unsupported endianness: " + str(header.endianness));
+        }
+
+        uint32_t fields_size;
+        std::memcpy(&fields_size, prefix + sizeof(struct Header), sizeof(uint32_t));
+
+        if (fields_size > MAX_ARRAY_SIZE)
+        {
+            return EERROR("Header fields too large: " + std::to_string(fields_size));
+        }
+        if (header.size > MAX_MESSAGE_SIZE)
+        {
+            return EERROR("Body too large: " + std::to_string(header.size));
+        }
+
+        // In 64 bits: sizes come from the peer.
+        uint64_t size = FRAME_PREFIX_SIZE + static_cast<uint64_t>(fields_size);
+        size = (size + 7) & ~uint64_t{7}; // body starts on a 8 bytes boundary.
+        size += header.size;
+        if ((size < FRAME_PREFIX_SIZE) or (size > MAX_MESSAGE_SIZE))
+        {
+            return EERROR("Message too large: " + std::to_string(size));
+        }
+
+        frame_size = static_cast<uint32_t>(size);
+        return ESUCCESS;
+    }
+
+
+    DBusError DBusMessage::scanHeader(uint8_t const* frame, uint32_t frame_size, HeaderView& view)
+    {
+        if (frame_size < FRAME_PREFIX_SIZE)
+        {
+            return EERROR("Truncated frame");
+        }
+
+        Header header;
+        std::memcpy(&header, frame, sizeof(struct Header));
+        view = HeaderView{};
+        view.type = header.type;
+        view.flags = header.flags;
+        view.serial = header.serial;
+
+        uint32_t fields_size;
+        std::memcpy(&fields_size, frame + sizeof(struct Header), sizeof(uint32_t));
+        uint32_t const end = FRAME_PREFIX_SIZE + fields_size;
+        if (end > frame_size)
+        {
+            return EERROR("Truncated header fields");
+        }
+
+        uint32_t position = FRAME_PREFIX_SIZE;
+        while (true)
+        {
+            align(position, 8); // dict entries are aligned on 8 bytes.
+            if ((position + 3) > end)
+            {
+                break; // code, signature size, signature.
+            }
+
+            FIELD const code = static_cast<FIELD>(frame[position]);
+            uint8_t const signature_size = frame[position + 1];
+            char const type = static_cast<char>(frame[position + 2]);
+            position += 2 + signature_size + 1;
+
+            if (type == static_cast<char>(DBUS_TYPE::UINT32))
+            {
+                align(position, 4);
+                if ((position + sizeof(uint32_t)) > end)
+                {
+                    return EERROR("Truncated header field");
+                }
+
+                uint32_t value;
+                std::memcpy(&value, frame + position, sizeof(uint32_t));
+                position += sizeof(uint32_t);
+                if (code == FIELD::REPLY_SERIAL)
+                {
+                    view.replySerial = value;
+                }
+                else if (code == FIELD::UNIX_FDS)
+                {
+                    view.unixFds = value;
+                }
+                continue;
+            }
+
+            uint32_t size;
+            if (type == static_cast<char>(DBUS_TYPE::SIGNATURE))
+            {
+                if (position >= end)
+                {
+                    return EERROR("Truncated header field");
+                }
+                size = frame[position];
+                position += 1;
+            }
+            else if ((type == static_cast<char>(DBUS_TYPE::STRING)) or (type == static_cast<char>(DBUS_TYPE::PATH)))
+            {
+                align(position, 4);
+                if ((position + sizeof(uint32_t)) > end)
+                {
+                    return EERROR("Truncated header field");
+                }
+                std::memcpy(&size, frame + position, sizeof(uint32_t));
+                position += sizeof(uint32_t);
+            }
+            else
+            {
+                return EERROR("Unexpected header field type '" + prettyStr(static_cast<DBUS_TYPE>(type)) + "'");
+            }
+
+            if ((position + size + 1) > end)
+            {
+                return EERROR("Truncated header field");
+            }
+
+            std::string_view value(reinterpret_cast<char const*>(frame + position), size);
+            position += size + 1; // trailing nul.
+
+            switch (code)
+            {
+                case FIELD::PATH:        { view.path = value;        break; }
+                case FIELD::INTERFACE:   { view.interface = value;   break; }
+                case FIELD::MEMBER:      { view.member = value;      break; }
+                case FIELD::ERROR_NAME:  { view.errorName = value;   break; }
+                case FIELD::DESTINATION: { view.destination = value; break; }
+                case FIELD::SENDER:      { view.sender = value;      break; }
+                case FIELD::SIGNATURE:   { view.signature = value;   break; }
+                default:                 {                           break; }
+            }
+        }
+
+        return ESUCCESS;
+    }
+
+
+    void DBusMessage::toWire(std::vector<uint8_t>& frame)
+    {
+        serialize();
+        frame = headerBuffer_;
+        frame.insert(frame.end(), body_.begin(), body_.end());
+    }
+
+
+    DBusError DBusMessage::deserialize(uint8_t const* frame, uint32_t frame_size)
+    {
+        return deserialize(frame, frame_size, nullptr);
+    }
+
+
+    DBusError DBusMessage::deserialize(uint8_t const* frame, uint32_t frame_size, std::shared_ptr<InternTable> const& strings)
+    {
+        HeaderView view;
+        DBusError err = scanHeader(frame, frame_size, view);
+        if (err)
+        {
+            return err;
+        }
+        std::memcpy(&header_, frame, sizeof(struct Header));
+        template_.reset();
+
+        uint32_t fields_size;
+        std::memcpy(&fields_size, frame + sizeof(struct Header), sizeof(uint32_t));
+        uint32_t body_start = FRAME_PREFIX_SIZE + fields_size;
+        align(body_start, 8);
+        if ((body_start + header_.size) != frame_size)
+        {
+            return EERROR("Inconsistent frame size");
+        }
+
+        // String fields: entries of the table when one is given (and not full), copies otherwise.
+        clearFields();
+        auto setString = [&](FIELD field, std::string_view value)
+        {
+            if (value.data() == nullptr)
+            {
+                return; // absent.
+            }
+            HeaderString& header_string = fields_[static_cast<uint32_t>(field)];
+            header_string.present = true;
+            if (strings)
+            {
+                header_string.entry = strings->intern(value);
+            }
+            if (header_string.entry == nullptr)
+            {
+                header_string.owned.setData(std::string{value});
+            }
+        };
+        setString(FIELD::PATH, view.path);
+        setString(FIELD::INTERFACE, view.interface);
+        setString(FIELD::MEMBER, view.member);
+        setString(FIELD::ERROR_NAME, view.errorName);
+        setString(FIELD::DESTINATION, view.destination);
+        setString(FIELD::SENDER, view.sender);
+        strings_ = strings;
+        replySerial_ = view.replySerial;
+        unixFds_ = view.unixFds;
+        signature_ = view.signature;
+
+        // Message body.
+        body_.assign(frame + body_start, frame + frame_size);
+        body_pos_ = 0;
+        sign_pos_ = 0;
+
+        return ESUCCESS;
+    }
+
+
     std::string DBusMessage::dump() const
     {
         std::string dump;
@@ -40,10 +433,18 @@ namespace dbus
         ss << "Size:        " << header_.size << std::endl;
         ss << "Serial:      " << header_.serial << std::endl;
 
-        for (auto& f : fields_)
+        visitFields([&](FIELD field, DBUS_TYPE type, void const* value)
         {
-            ss << str(f.first) << ": " << f.second << std::endl;
-        }
+            ss << str(field) << ": ";
+            if (type == DBUS_TYPE::UINT32)
+            {
+                ss << *reinterpret_cast<uint32_t const*>(value) << std::endl;
+            }
+            else
+            {
+                ss << *reinterpret_cast<std::string const*>(value) << std::endl;
+            }
+        });
         ss << std::endl;
 
         ss << "---- header hex (send only) ----" << std::endl;
@@ -52,82 +453,213 @@ namespace dbus
         ss << "----------- Body hex -----------" << std::endl;
         ss << hexDump(body_);
 
-/*
-        std::ofstream myfile;
-        myfile.open ("body" + std::to_string(header_.serial), std::ios::out | std::ios::binary);
-        myfile.write(reinterpret_cast<const char*>(body_.data()), body_.size());
-*/
+        SignatureProgram::Ptr program;
+        std::vector<DBusVariant> values;
+        uint32_t position = 0;
+        if (not SignatureProgram::get(signature_, program) and not program->run(body_.data(), body_.size(), position, values))
+        {
+            ss << "------------- Body -------------" << std::endl;
+            for (auto const& value : values)
+            {
+                ss << value << std::endl;
+            }
+        }
         return ss.str();
     }
 
 
-    void DBusMessage::serialize()
+    DBusError DBusMessage::extractValues(std::vector<DBusVariant>& values)
+    {
+        SignatureProgram::Ptr program;
+        DBusError err = SignatureProgram::get(std::string_view{signature_}.substr(sign_pos_), program);
+        if (err)
+        {
+            return err;
+        }
+
+        err = program->run(body_.data(), body_.size(), body_pos_, values);
+        if (err)
+        {
+            return err;
+        }
+        sign_pos_ = signature_.size();
+        return ESUCCESS;
+    }
+
+
+    DBusError DBusMessage::addArgument(ValueView const& value)
     {
-        if (not body_.empty())
+        std::size_t const size = body_.size();
+        DBusError err = value.copy(body_);
+        if (err)
         {
-            // add signature to header fields.
-            DBusVariant v{signature_};
-            fields_.emplace(FIELD::SIGNATURE, v);
+            body_.resize(size);
+            return err;
         }
+        signature_ += value.signature();
+        return ESUCCESS;
+    }
+
 
-        // prepare buffer.
-        headerBuffer_.clear();
-        headerBuffer_.reserve(sizeof(struct Header) + header_.size + 256); // 256: preallocate memory for fields even if we dont know the finale size yet.
+    DBusError DBusMessage::extractArgument(ValueView& arg)
+    {
+        if (sign_pos_ >= signature_.size())
+        {
+            return EERROR("No argument left");
+        }
 
-        // insert header
-        header_.size = body_.size();  // Update header body size.
-        uint8_t const* header_ptr = reinterpret_cast<uint8_t const*>(&header_);
-        headerBuffer_.insert(headerBuffer_.begin(), header_ptr, header_ptr+sizeof(struct Header));
+        uint32_t const sign_end = completeTypeEnd(signature_, sign_pos_);
+        arg = ValueView{body_.data(), static_cast<uint32_t>(body_.size()), body_pos_,
+                        std::string_view{signature_}.substr(sign_pos_, sign_end - sign_pos_)};
 
-        // insert fields
-        uint8_t* const fields_size = &headerBuffer_.back() + 1; // WARNING: at this point, this pointer is out of bound!
-        headerBuffer_.resize(headerBuffer_.size() + sizeof(uint32_t));
-        for (auto& i : fields_)
+        uint32_t position;
+        DBusError err = arg.end(position);
+        if (err)
         {
-            updatePadding(8, headerBuffer_);                           // dict entry aligned on 8 bytes.
-            insertValue(DBUS_TYPE::BYTE, &i.first, headerBuffer_);     // key.
-            insertValue(DBUS_TYPE::VARIANT, &i.second, headerBuffer_); // value.
+            return err;
         }
-        *reinterpret_cast<uint32_t*>(fields_size) = &headerBuffer_.back() - (fields_size + 3); // compute size
-        updatePadding(8, headerBuffer_); // header size shall be a multiple of 8.
+        body_pos_ = position;
+        sign_pos_ = sign_end;
+        return ESUCCESS;
     }
 
 
-    void DBusMessage::insertValue(DBUS_TYPE type, void const* data, std::vector<uint8_t>& buffer)
+    void DBusMessage::serialize()
     {
-        auto insertPOD = [this](void const* data, int32_t data_size, std::vector<uint8_t>& buffer)
+        if (template_)
         {
-            updatePadding(data_size, buffer);
+            // Prebuilt fields: only the fixed header part changes.
+            header_.size = body_.size();
+            headerBuffer_.assign(template_->header.begin(), template_->header.end());
+            std::memcpy(headerBuffer_.data(), &header_, sizeof(struct Header));
+            return;
+        }
+
+        // Sizing pass: fields array of (byte, variant) dict entries, then padding to 8.
+        // A field variant is its code, its one character signature (size, type, nul) and its value.
+        uint32_t fields_end = FRAME_PREFIX_SIZE;
+        visitFields([&](FIELD, DBUS_TYPE type, void const* value)
+        {
+            align(fields_end, 8);
+            fields_end = sizeOf(type, value, fields_end + 4);
+        });
+        uint32_t header_size = fields_end;
+        align(header_size, 8); // header size shall be a multiple of 8.
+        headerBuffer_.resize(header_size);
+
+        uint8_t* const buffer = headerBuffer_.data();
+        header_.size = body_.size();
+        std::memcpy(buffer, &header_, sizeof(struct Header));
+        uint32_t const fields_size = fields_end - FRAME_PREFIX_SIZE;
+        std::memcpy(buffer + sizeof(struct Header), &fields_size, sizeof(uint32_t));
+
+        uint32_t position = FRAME_PREFIX_SIZE;
+        visitFields([&](FIELD field, DBUS_TYPE type, void const* value)
+        {
+            pad(buffer, position, 8);                              // dict entry aligned on 8 bytes.
+            buffer[position++] = static_cast<uint8_t>(field);      // key.
+            buffer[position++] = 1;                                // variant signature.
+            buffer[position++] = static_cast<uint8_t>(type);
+            buffer[position++] = 0;
+            writeValue(type, value, buffer, position);             // value.
+        });
+        pad(buffer, position, 8);
+    }
+
+
+    uint32_t DBusMessage::sizeOf(DBUS_TYPE type, void const* data, uint32_t position)
+    {
+        switch (type)
+        {
+            case DBUS_TYPE::BYTE:
+            case DBUS_TYPE::INT16:
+            case DBUS_TYPE::UINT16:
+            case DBUS_TYPE::BOOLEAN:
+            case DBUS_TYPE::UINT32:
+            case DBUS_TYPE::INT32:
+            case DBUS_TYPE::INT64:
+            case DBUS_TYPE::UINT64:
+            case DBUS_TYPE::DOUBLE:
+            {
+                align(position, alignment(type));
+                return position + alignment(type); // basic types: size is the alignment.
+            }
+            case DBUS_TYPE::STRING:
+            case DBUS_TYPE::PATH:
+            {
+                std::string const* str = reinterpret_cast<std::string const*>(data);
+                align(position, 4);
+                return position + sizeof(uint32_t) + str->size() + 1; // size, string, trailing nul.
+            }
+            case DBUS_TYPE::SIGNATURE:
+            {
+                std::string const* str = reinterpret_cast<std::string const*>(data);
+                return position + 1 + str->size() + 1; // signatures have a size of one byte only.
+            }
+            case DBUS_TYPE::VARIANT:
+            {
+                // Variants hold a single complete basic type (signature of one character) or a typed array (two).
+                DBusVariant const* v = reinterpret_cast<DBusVariant const*>(data);
+                if (v->elementType() != DBUS_TYPE::UNKNOWN)
+                {
+                    return v->visitArray([&](auto const& elements) { return sizeOf(elements, position + 4); });
+                }
+                return sizeOf(v->type(), v->data(), position + 3);
+            }
+            case DBUS_TYPE::ARRAY:
+            case DBUS_TYPE::UNIX_FD:
+            case DBUS_TYPE::STRUCT_BEGIN:
+            case DBUS_TYPE::STRUCT_END:
+            case DBUS_TYPE::DICT_BEGIN:
+            case DBUS_TYPE::DICT_END:
+            case DBUS_TYPE::UNKNOWN:
+            default:
+            {
+                std::abort();
+            }
+        }
+    }
+
 
-            uint8_t const* ptr = reinterpret_cast<uint8_t const*>(data);
-            buffer.insert(buffer.end(), ptr, ptr + data_size);
+    void DBusMessage::writeValue(DBUS_TYPE type, void const* data, uint8_t* buffer, uint32_t& position)
+    {
+        auto writePOD = [&](void const* value, uint32_t size)
+        {
+            pad(buffer, position, size);
+            std::memcpy(buffer + position, value, size);
+            position += size;
         };
 
         switch (type)
         {
             case DBUS_TYPE::BYTE:
             {
-                insertPOD(data, 1, buffer);
+                buffer[position++] = *reinterpret_cast<uint8_t const*>(data);
                 break;
             }
             case DBUS_TYPE::INT16:
             case DBUS_TYPE::UINT16:
             {
-                insertPOD(data, 2, buffer);
+                writePOD(data, 2);
                 break;
             }
             case DBUS_TYPE::BOOLEAN:
+            {
+                uint32_t const value = *reinterpret_cast<bool const*>(data); // 4 bytes on the wire.
+                writePOD(&value, 4);
+                break;
+            }
             case DBUS_TYPE::UINT32:
             case DBUS_TYPE::INT32:
             {
-                insertPOD(data, 4, buffer);
+                writePOD(data, 4);
                 break;
             }
             case DBUS_TYPE::INT64:
             case DBUS_TYPE::UINT64:
             case DBUS_TYPE::DOUBLE:
             {
-                insertPOD(data, 8, buffer);
+                writePOD(data, 8);
                 break;
             }
             case DBUS_TYPE::STRING:
@@ -137,32 +669,36 @@ namespace dbus
                 std::string const* str = reinterpret_cast<std::string const*>(data);
                 if (type == DBUS_TYPE::SIGNATURE) // signature have a size of one byte only.
                 {
-                    uint8_t str_size = str->size();
-                    insertValue(DBUS_TYPE::BYTE, &str_size, buffer);
+                    buffer[position++] = static_cast<uint8_t>(str->size());
                 }
                 else
                 {
-                    uint32_t str_size = str->size();
-                    insertValue(DBUS_TYPE::UINT32, &str_size, buffer);
+                    uint32_t const str_size = str->size();
+                    writePOD(&str_size, 4);
                 }
 
-                // Insert string + trailing null
-                buffer.insert(buffer.end(), str->begin(), str->end());
-                buffer.push_back('\0');
+                // string + trailing null
+                std::memcpy(buffer + position, str->data(), str->size());
+                position += str->size();
+                buffer[position++] = '\0';
                 break;
             }
             case DBUS_TYPE::VARIANT:
             {
-                auto insertVariant = [this](DBUS_TYPE type, void const* data, std::vector<uint8_t>& buffer)
-                {
-                    Signature s{str(type)};
-                    insertValue(DBUS_TYPE::SIGNATURE, &s, buffer);
-                    insertValue(type, data, buffer);
-                };
-
-
                 DBusVariant const* v = reinterpret_cast<DBusVariant const*>(data);
-                insertVariant(v->type(), v->data(), buffer);
+                if (v->elementType() != DBUS_TYPE::UNKNOWN)
+                {
+                    buffer[position++] = 2;
+                    buffer[position++] = static_cast<uint8_t>(DBUS_TYPE::ARRAY);
+                    buffer[position++] = static_cast<uint8_t>(v->elementType());
+                    buffer[position++] = '\0';
+                    v->visitArray([&](auto const& elements) { write(elements, buffer, position); });
+                    break;
+                }
+                buffer[position++] = 1;
+                buffer[position++] = static_cast<uint8_t>(v->type());
+                buffer[position++] = '\0';
+                writeValue(v->type(), v->data(), buffer, position);
                 break;
             }
             case DBUS_TYPE::ARRAY:
@@ -172,6 +708,7 @@ namespace dbus
             case DBUS_TYPE::DICT_BEGIN:
             case DBUS_TYPE::DICT_END:
             case DBUS_TYPE::UNKNOWN:
+            default:
             {
                 std::abort();
             }
@@ -280,113 +817,7 @@ namespace dbus
             }
             case DBUS_TYPE::VARIANT:
             {
-                DBusVariant* arg = static_cast<DBusVariant*>(data);
-                Signature s;
-                extractArgument(DBUS_TYPE::SIGNATURE, &s);
-
-                DBUS_TYPE variant_type = static_cast<DBUS_TYPE>(s[0]);
-
-                DBusError err;
-                switch (variant_type)
-                {
-                    case DBUS_TYPE::BYTE:
-                    {
-                        uint8_t val;
-                        err = extractArgument(variant_type, &val);
-                        *arg = val;
-                        break;
-                    }
-                    case DBUS_TYPE::BOOLEAN:
-                    {
-                        bool val;
-                        err = extractArgument(variant_type, &val);
-                        *arg = val;
-                        break;
-                    }
-                    case DBUS_TYPE::INT16:
-                    {
-                        int16_t val;
-                        err = extractArgument(variant_type, &val);
-                        *arg = val;
-                        break;
-                    }
-                    case DBUS_TYPE::UINT16:
-                    {
-                        uint16_t val;
-                        err = extractArgument(variant_type, &val);
-                        *arg = val;
-                        break;
-                    }
-                    case DBUS_TYPE::INT32:
-                    {
-                        int32_t val;
-                        err = extractArgument(variant_type, &val);
-                        *arg = val;
-                        break;
-                    }
-                    case DBUS_TYPE::UINT32:
-                    {
-                        uint32_t val;
-                        err = extractArgument(variant_type, &val);
-                        *arg = val;
-                        break;
-                    }
-                    case DBUS_TYPE::INT64:
-                    {
-                        int64_t val;
-                        err = extractArgument(variant_type, &val);
-                        *arg = val;
-                        break;
-                    }
-                    case DBUS_TYPE::UINT64:
-                    {
-                        uint64_t val;
-                        err = extractArgument(variant_type, &val);
-                        *arg = val;
-                        break;
-                    }
-                    case DBUS_TYPE::DOUBLE:
-                    {
-                        double val;
-                        err = extractArgument(variant_type, &val);
-                        *arg = val;
-                        break;
-                    }
-                    case DBUS_TYPE::STRING:
-                    {
-                        std::string val;
-                        err = extractArgument(variant_type, &val);
-                        *arg = val;
-                        break;
-                    }
-                    case DBUS_TYPE::SIGNATURE:
-                    {
-                        Signature val;
-                        err = extractArgument(variant_type, &val);
-                        *arg = val;
-                        break;
-                    }
-                    case DBUS_TYPE::PATH:
-                    {
-                        ObjectPath val;
-                        err = extractArgument(variant_type, &val);
-                        *arg = val;
-                        break;
-                    }
-                    case DBUS_TYPE::ARRAY:
-                    {
-                        DBusVariant array(DBUS_TYPE::ARRAY);
-                        err = extractArray(s, 1, array);
-                        *arg = array;
-                        break;
-                    }
-                    default:
-                    {
-                        return EERROR("Variant: unsupported type '" + prettyStr(variant_type) + "'");
-                    }
-                }
-
-                return err;
+                return SignatureProgram::decodeVariant(body_.data(), body_.size(), body_pos_, *static_cast<DBusVariant*>(data));
             }
             default:
             {
@@ -396,67 +827,4 @@ namespace dbus
 
         return ESUCCESS;
     }
-
-
-    DBusError DBusMessage::extractArray(Signature const& s, int32_t index, DBusVariant& array)
-    {
-        std::vector<DBusVariant>& refArray = array.get<std::vector<DBusVariant>>();
-        uint32_t array_size;
-        DBusError err = extractArgument(DBUS_TYPE::UINT32, &array_size);
-        if (err)
-        {
-            return err;
-        }
-
-        uint32_t const endPos = body_pos_ + array_size;
-        DBUS_TYPE array_type = static_cast<DBUS_TYPE>(s[index]);
-
-        while (endPos > body_pos_)
-        {
-            switch (array_type)
-            {
-                case DBUS_TYPE::BYTE:
-                {
-                    uint8_t data;
-                    err = extractArgument(DBUS_TYPE::BYTE, &data);
-                    refArray.push_back(data);
-                    break;
-                }
-                case DBUS_TYPE::STRING:
-                {
-                    std::string data;
-                    err = extractArgument(DBUS_TYPE::STRING, &data);
-                    refArray.push_back(data);
-                    break;
-                }
-                case DBUS_TYPE::PATH:
-                {
-                    ObjectPath data;
-                    err = extractArgument(DBUS_TYPE::PATH, &data);
-                    refArray.push_back(data);
-                    break;
-                }
-                case DBUS_TYPE::ARRAY:
-                {
-                    DBusVariant nextArray(DBUS_TYPE::ARRAY);
-                    err = extractArray(s, index + 1, nextArray);
-                    refArray.push_back(nextArray);
-                    break;
-                }
-                default:
-                {
-                    printf("Warning: skip array of type %s at %u (unsupported)\n", str(array_type).c_str(), body_pos_);
-                    if (DBUS_TYPE::STRUCT_BEGIN == array_type)
-                    {
-                        align(body_pos_, 8);
-                    }
-
-                    body_pos_ += array_size;
-                    break;
-                }
-            }
-        }
-
-        return err;
-    }
 }
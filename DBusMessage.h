@@ -1,29 +1,67 @@
 #ifndef DBUS_MESSAGE_H
 #define DBUS_MESSAGE_H
 
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <memory>
+
 #include "Protocol.h"
 #include "DBusError.h"
+#include "FlatDict.h"
+#include "InternTable.h"
+#include "ValueView.h"
 #include "helpers.h"
 #include "DBusVariant.h"
 
 namespace dbus
 {
     class DBusConnection;
+    class LoopbackBus;
     class DBusMessage
     {
         friend class DBusConnection;
+        friend class LoopbackBus;
     public:
         DBusMessage()  = default;
         ~DBusMessage() = default;
 
-        // return call serial;
-        uint32_t prepareCall(std::string const& name, std::string const& path, std::string const& interface, std::string const& method);
+        DBusMessage(DBusMessage const&) = default;
+        DBusMessage& operator=(DBusMessage const&) = default;
+        DBusMessage(DBusMessage&&) noexcept = default;
+        DBusMessage& operator=(DBusMessage&&) noexcept = default;
 
+        // Start a new message, return its serial. A reused message drops its previous arguments but keeps its
+        // buffers: building it again does not allocate.
+        uint32_t prepareCall(std::string const& name, std::string const& path, std::string const& interface, std::string const& method);
+        uint32_t prepareReply(DBusMessage const& call);
+        uint32_t prepareError(DBusMessage const& call, std::string const& error_name);
+        uint32_t prepareSignal(std::string const& path, std::string const& interface, std::string const& signal);
+
+        // Serialized header fields shared by messages that only differ by their serial and body (generated proxies).
+        // Such messages carry no SENDER field (set by the bus) and their fields are not readable locally, except
+        // the destination which is kept aside for the connection (fail-fast on absent names).
+        struct CallTemplate
+        {
+            std::vector<uint8_t> header;
+            std::string destination;
+        };
+        using HeaderTemplate = std::shared_ptr<CallTemplate const>;
+        static HeaderTemplate callTemplate(std::string const& name, std::string const& path, std::string const& interface,
+                                           std::string const& method, std::string const& signature);
+        uint32_t prepareFromTemplate(HeaderTemplate const& header);
+
+        // Arguments: basic types, variants, std::vector, Dict and FlatDict of them, marshalled from where they are
+        // (temporaries included): the body is the only copy.
         template<typename T>
         void addArgument(T const& arg);
 
-        template<typename K, typename V>
-        void addArgument(Dict<K, V> const& arg);
+        // Copy of a value of another message, whatever its type, without decoding it (see ValueView::copy()).
+        DBusError addArgument(ValueView const& value);
+
+        // Several arguments at once: the body grows once, to the exact marshalled size of all of them.
+        template<typename... Args>
+        void addArguments(Args const&... args);
 
         template<typename T>
         DBusError extractArgument(T& arg);
@@ -31,6 +69,39 @@ namespace dbus
         template<typename K, typename V>
         DBusError extractArgument(Dict<K, V>& arg);
 
+        // Dicts decoded in wire order into contiguous storage (i.e. FlatDict<ObjectPath, FlatDict<std::string, ...>>).
+        template<typename K, typename V>
+        DBusError extractArgument(FlatDict<K, V>& arg);
+
+        template<typename T>
+        DBusError extractArgument(std::vector<T>& arg);
+
+        // Remaining arguments, whatever their signature, as DBusVariant trees (see SignatureProgram).
+        DBusError extractValues(std::vector<DBusVariant>& values);
+
+        // Next argument as a view on the body, decoded on demand (see ValueView).
+        DBusError extractArgument(ValueView& arg);
+
+        // Streaming extraction of an array or dict argument: one element (or key and value) at a time,
+        // straight from the body (see ValueView::forEach()).
+        template<typename F>
+        DBusError visitArgument(F&& visitor);
+
+        // Extraction without per argument signature check, for decoders that checked signature() once.
+        template<typename T>
+        DBusError extractTrusted(T& arg);
+
+        template<typename K, typename V>
+        DBusError extractTrusted(Dict<K, V>& arg);
+
+        template<typename K, typename V>
+        DBusError extractTrusted(FlatDict<K, V>& arg);
+
+        template<typename T>
+        DBusError extractTrusted(std::vector<T>& arg);
+
+        Signature const& signature() const { return signature_; }
+
         uint32_t serial() const { return header_.serial; }
         std::string dump() const;
 
@@ -40,30 +111,116 @@ namespace dbus
         bool isError() const      { return header_.type == MESSAGE_TYPE::ERROR;         }
         bool isSignal() const     { return header_.type == MESSAGE_TYPE::SIGNAL;        }
 
-        // Optionnal header fields accessors
-        uint32_t replySerial() const            { return fields_.at(FIELD::REPLY_SERIAL).get<uint32_t>();  }
-        std::string const& errorMessage() const { return fields_.at(FIELD::ERROR_NAME).get<std::string>(); }
-        //ObjectPath const& path() const          { return std::get<ObjectPath>(fields_.at(FIELD::PATH));       }
-        //std::string const& interface() const    { return fields_.at(FIELD::INTERFACE)).get<std::string()>();  }
-        //std::string const& member() const       { return fields_.at(FIELD::MEMBER)).get<std::string()>();     }
+        bool isCall() const       { return header_.type == MESSAGE_TYPE::METHOD_CALL;   }
+        bool expectReply() const  { return isCall() and not (header_.flags & NO_REPLY_EXPECTED); }
+
+        // Optionnal header fields accessors (string fields throw std::out_of_range if absent).
+        bool hasField(FIELD field) const;
+        uint32_t replySerial() const            { return replySerial_; } // 0 if absent.
+        std::string const& errorMessage() const { return field(FIELD::ERROR_NAME).str();  }
+        ObjectPath const& path() const          { return field(FIELD::PATH).path();       }
+        std::string const& interface() const    { return field(FIELD::INTERFACE).str();   }
+        std::string const& member() const       { return field(FIELD::MEMBER).str();      }
+        std::string const& destination() const  { return field(FIELD::DESTINATION).str(); }
+        std::string const& sender() const       { return field(FIELD::SENDER).str();      }
+
+        // Interned entry of a string field (nullptr if absent or not interned): entries of the same table,
+        // i.e. of messages received by the same connection, compare by address.
+        InternTable::Entry const* interned(FIELD field) const;
+
+        void setDestination(std::string const& destination) { setField(FIELD::DESTINATION, destination); }
+        void setSender(std::string const& sender)            { setField(FIELD::SENDER, sender);           }
+
+        // Wire framing: a frame is the fixed header, the fields array, its padding and the body.
+        static constexpr uint32_t FRAME_PREFIX_SIZE = sizeof(struct Header) + sizeof(uint32_t); // fixed header + fields size.
+        static constexpr uint32_t MAX_ARRAY_SIZE = 1U << 26;   // 64 MiB (fields array included).
+        static constexpr uint32_t MAX_MESSAGE_SIZE = 1U << 27; // 128 MiB.
+        // Fails on frames over the protocol limits: frame_size is always within [FRAME_PREFIX_SIZE, MAX_MESSAGE_SIZE].
+        static DBusError frameSize(uint8_t const* prefix, uint32_t& frame_size);
+        static DBusError scanHeader(uint8_t const* frame, uint32_t frame_size, HeaderView& view); // no allocation, no body decoding.
+        DBusError deserialize(uint8_t const* frame, uint32_t frame_size);
+        // Header strings interned in strings (shared with the message), copied once the table is full.
+        DBusError deserialize(uint8_t const* frame, uint32_t frame_size, std::shared_ptr<InternTable> const& strings);
+        void toWire(std::vector<uint8_t>& frame); // serialize the whole message in frame.
+
+        // Restart arguments extraction from the first one.
+        void rewind() { body_pos_ = 0; sign_pos_ = 0; }
 
     private:
+        // String header field: an entry of strings_ (received messages), or owned.
+        struct HeaderString
+        {
+            InternTable::Entry const* entry{nullptr};
+            ObjectPath owned;
+            bool present{false};
+
+            ObjectPath const& path() const  { return entry ? entry->value : owned; }
+            std::string const& str() const  { return path().data(); }
+        };
+        static constexpr uint32_t STRING_FIELDS = static_cast<uint32_t>(FIELD::SENDER) + 1; // indexed by FIELD code.
+
+        HeaderString const& field(FIELD field) const;
+        void setField(FIELD field, std::string const& value);
+        void clearFields();
+        void restart(); // new message: no fields, no arguments.
+
+        template<typename F>
+        void visitFields(F&& visitor) const; // (code, type, value) of the fields present, in code order.
+
         void serialize();
 
-        DBusError extractArray(Signature const& s, int32_t index, DBusVariant& array);
+        // Whole dict signature (key, value and nested containers) against the next complete type.
+        template<typename D>
+        DBusError checkDictSignature();
+
+        template<typename D>
+        DBusError extractDict(D& arg); // Dict or FlatDict, signature already checked.
+
+        template<typename T>
+        DBusError extractVector(std::vector<T>& arg); // signature already checked.
+
+        template<typename T> struct IsDict : std::false_type { };
+        template<typename K, typename V> struct IsDict<Dict<K, V>> : std::true_type { };
+        template<typename K, typename V> struct IsDict<FlatDict<K, V>> : std::true_type { };
+        template<typename T> struct IsFlatDict : std::false_type { };
+        template<typename K, typename V> struct IsFlatDict<FlatDict<K, V>> : std::true_type { };
+        template<typename T> struct IsVector : std::false_type { };
+        template<typename T> struct IsVector<std::vector<T>> : std::true_type { };
+
+        template<typename T>
+        static void appendSignature(Signature& signature);
+
+        // Marshalling in two passes: sizeOf() gives the position right after a value that starts at position
+        // (padding included), the buffer is resized once to the total, then write() fills it in place.
+        template<typename T>
+        static constexpr uint32_t fixedSize(); // wire size of fixed size types, 0 otherwise.
+
+        template<typename T>
+        static constexpr uint32_t alignmentOf();
+
+        template<typename T>
+        static uint32_t sizeOf(T const& arg, uint32_t position);
+
+        template<typename T>
+        static void write(T const& arg, uint8_t* buffer, uint32_t& position);
 
-        void insertValue(DBUS_TYPE type, void const* data, std::vector<uint8_t>& buffer);
+        static uint32_t sizeOf(DBUS_TYPE type, void const* data, uint32_t position);
+        static void writeValue(DBUS_TYPE type, void const* data, uint8_t* buffer, uint32_t& position);
         DBusError extractArgument(DBUS_TYPE type, void* data);
         DBusError checkSignature(DBUS_TYPE type);
 
-        static uint32_t serialCounter_;
+        static std::atomic<uint32_t> serialCounter_;
 
         struct Header header_;
-        HeaderFields fields_;
-        Signature signature_;       // DBus call signature.
+        std::array<HeaderString, STRING_FIELDS> fields_;
+        uint32_t replySerial_{0};
+        uint32_t unixFds_{0};
+        std::shared_ptr<InternTable const> strings_; // table of the interned fields.
+        Signature signature_;       // DBus call signature (SIGNATURE field).
 
         std::vector<uint8_t> headerBuffer_;  // DBus message header buffer.
-        std::vector<uint8_t> body_;          // DBus message body buffer.
+        Buffer body_;                        // DBus message body buffer (not zeroed when it grows).
+        HeaderTemplate template_;            // prebuilt header (fields_ unused).
 
         uint32_t sign_pos_{0};
         uint32_t body_pos_{0};
@@ -3,36 +3,182 @@ namespace dbus
     template<typename T>
     void DBusMessage::addArgument(T const& arg)
     {
-        signature_ += dbusType<T>();
-        insertValue(dbusType<T>(), &arg, body_);
+        addArguments(arg);
     }
 
 
-    template<typename K, typename V>
-    void DBusMessage::addArgument(Dict<K, V> const& arg)
+    template<typename... Args>
+    void DBusMessage::addArguments(Args const&... args)
     {
-        signature_ += DBUS_TYPE::ARRAY;
-        signature_ += DBUS_TYPE::DICT_BEGIN;
-        signature_ += dbusType<K>();
-        signature_ += dbusType<V>();
-        signature_ += DBUS_TYPE::DICT_END;
+        (appendSignature<Args>(signature_), ...);
+
+        uint32_t end = body_.size();
+        ((end = sizeOf(args, end)), ...);
+
+        uint32_t position = body_.size();
+        body_.resize(end);
+        (write(args, body_.data(), position), ...);
+    }
+
+
+    template<typename T>
+    void DBusMessage::appendSignature(Signature& signature)
+    {
+        if constexpr (IsDict<T>::value)
+        {
+            signature += DBUS_TYPE::ARRAY;
+            signature += DBUS_TYPE::DICT_BEGIN;
+            signature += dbusType<typename T::key_type>();
+            appendSignature<typename T::mapped_type>(signature);
+            signature += DBUS_TYPE::DICT_END;
+        }
+        else if constexpr (IsVector<T>::value)
+        {
+            signature += DBUS_TYPE::ARRAY;
+            appendSignature<typename T::value_type>(signature);
+        }
+        else
+        {
+            static_assert(dbusType<T>() != DBUS_TYPE::UNKNOWN, "Invalid DBus type");
+            signature += dbusType<T>();
+        }
+    }
+
+
+    template<typename T>
+    constexpr uint32_t DBusMessage::fixedSize()
+    {
+        if constexpr (IsDict<T>::value or IsVector<T>::value)
+        {
+            return 0;
+        }
+        else
+        {
+            switch (dbusType<T>())
+            {
+                case DBUS_TYPE::BYTE:    { return 1; }
+                case DBUS_TYPE::INT16:
+                case DBUS_TYPE::UINT16:  { return 2; }
+                case DBUS_TYPE::BOOLEAN:
+                case DBUS_TYPE::INT32:
+                case DBUS_TYPE::UINT32:  { return 4; }
+                case DBUS_TYPE::INT64:
+                case DBUS_TYPE::UINT64:
+                case DBUS_TYPE::DOUBLE:  { return 8; }
+                default:                 { return 0; }
+            }
+        }
+    }
 
-        // array size.
-        uint8_t* const array_size = &body_.back() + 1; // WARNING: at this point, this pointer is out of bound!
-        body_.resize(body_.size() + sizeof(uint32_t));
 
-        for (auto& i : arg.value)
+    template<typename T>
+    constexpr uint32_t DBusMessage::alignmentOf()
+    {
+        if constexpr (IsDict<T>::value or IsVector<T>::value)
+        {
+            return 4; // array size.
+        }
+        else
         {
-            updatePadding(8, body_); // dict entry aligned on 8 bytes.
+            return alignment(dbusType<T>());
+        }
+    }
 
-            // insert key
-            insertValue(dbusType<K>(), &i.first, body_);
 
-            // insert value
-            insertValue(dbusType<V>(), &i.second, body_);
+    template<typename T>
+    uint32_t DBusMessage::sizeOf(T const& arg, uint32_t position)
+    {
+        if constexpr (IsDict<T>::value)
+        {
+            // array size, then padding to the first dict entry (not accounted in the array size).
+            align(position, 4);
+            position += sizeof(uint32_t);
+            align(position, 8);
+            for (auto const& entry : arg)
+            {
+                align(position, 8); // dict entry aligned on 8 bytes.
+                position = sizeOf(entry.first, position);
+                position = sizeOf(entry.second, position);
+            }
+            return position;
+        }
+        else if constexpr (IsVector<T>::value)
+        {
+            using E = typename T::value_type;
+            align(position, 4);
+            position += sizeof(uint32_t);
+            align(position, alignmentOf<E>());
+            if constexpr (fixedSize<E>() != 0)
+            {
+                return position + arg.size() * fixedSize<E>(); // no padding between fixed size elements.
+            }
+            for (auto const& element : arg)
+            {
+                position = sizeOf(element, position);
+            }
+            return position;
+        }
+        else if constexpr (fixedSize<T>() != 0)
+        {
+            align(position, fixedSize<T>());
+            return position + fixedSize<T>();
         }
+        else
+        {
+            return sizeOf(dbusType<T>(), &arg, position);
+        }
+    }
+
+
+    template<typename T>
+    void DBusMessage::write(T const& arg, uint8_t* buffer, uint32_t& position)
+    {
+        if constexpr (IsDict<T>::value or IsVector<T>::value)
+        {
+            pad(buffer, position, 4);
+            uint32_t const size_pos = position;
+            position += sizeof(uint32_t);
+
+            if constexpr (IsDict<T>::value)
+            {
+                pad(buffer, position, 8);
+            }
+            else
+            {
+                pad(buffer, position, alignmentOf<typename T::value_type>());
+            }
+            uint32_t const start_pos = position;
+
+            if constexpr (IsDict<T>::value)
+            {
+                for (auto const& entry : arg)
+                {
+                    pad(buffer, position, 8); // dict entry aligned on 8 bytes.
+                    write(entry.first, buffer, position);
+                    write(entry.second, buffer, position);
+                }
+            }
+            else if constexpr (fixedSize<typename T::value_type>() == sizeof(typename T::value_type))
+            {
+                // Same layout in memory and on the wire (little endian).
+                std::memcpy(buffer + position, arg.data(), arg.size() * sizeof(typename T::value_type));
+                position += arg.size() * sizeof(typename T::value_type);
+            }
+            else
+            {
+                for (auto const& element : arg)
+                {
+                    write(element, buffer, position);
+                }
+            }
 
-        *reinterpret_cast<uint32_t*>(array_size) = &body_.back() - (array_size + 3); // Update size.
+            uint32_t const array_size = position - start_pos;
+            std::memcpy(buffer + size_pos, &array_size, sizeof(uint32_t));
+        }
+        else
+        {
+            writeValue(dbusType<T>(), &arg, buffer, position);
+        }
     }
 
 
@@ -49,9 +195,57 @@ namespace dbus
     }
 
 
+    template<typename D>
+    DBusError DBusMessage::checkDictSignature()
+    {
+        static Signature const expected = []()
+        {
+            Signature signature;
+            appendSignature<D>(signature);
+            return signature;
+        }();
+
+        if (signature_.compare(sign_pos_, expected.size(), expected) != 0)
+        {
+            return EERROR("Wrong signature: expected '" + expected + "', got '" + signature_.substr(sign_pos_) + "'");
+        }
+        sign_pos_ += expected.size();
+        return ESUCCESS;
+    }
+
+
     template<typename K, typename V>
     DBusError DBusMessage::extractArgument(Dict<K, V>& arg)
     {
+        DBusError err = checkDictSignature<Dict<K, V>>();
+        if (err)
+        {
+            return err;
+        }
+
+        return extractDict(arg);
+    }
+
+
+    template<typename K, typename V>
+    DBusError DBusMessage::extractArgument(FlatDict<K, V>& arg)
+    {
+        DBusError err = checkDictSignature<FlatDict<K, V>>();
+        if (err)
+        {
+            return err;
+        }
+
+        return extractDict(arg);
+    }
+
+
+    template<typename D>
+    DBusError DBusMessage::extractDict(D& arg)
+    {
+        using K = typename D::key_type;
+        using V = typename D::mapped_type;
+
         uint32_t array_size;
         DBusError err = extractArgument(DBUS_TYPE::UINT32, &array_size);
         if (err)
@@ -59,6 +253,7 @@ namespace dbus
             return err;
         }
 
+        align(body_pos_, 8); // padding to the first entry is not accounted in the array size.
         uint32_t const start_pos = body_pos_;
         while (body_pos_ < (array_size + start_pos))
         {
@@ -73,9 +268,9 @@ namespace dbus
 
             V value;
             constexpr DBUS_TYPE valueType = dbusType<V>();
-            if (valueType == DBUS_TYPE::UNKNOWN)
+            if constexpr (valueType == DBUS_TYPE::UNKNOWN)
             {
-                err = extractArgument(value); // not a basic type
+                err = extractDict(value); // not a basic type
             }
             else
             {
@@ -86,9 +281,122 @@ namespace dbus
                 return err;
             }
 
-            arg.emplace(key, value);
+            arg.emplace(std::move(key), std::move(value));
+        }
+
+        if constexpr (IsFlatDict<D>::value)
+        {
+            arg.index();
+        }
+        return err;
+    }
+
+
+    template<typename T>
+    DBusError DBusMessage::extractArgument(std::vector<T>& arg)
+    {
+        static_assert(dbusType<T>() != DBUS_TYPE::UNKNOWN, "Invalid DBus element type");
+
+        if ((signature_.size() < (sign_pos_ + 2)) or
+            (static_cast<DBUS_TYPE>(signature_[sign_pos_]) != DBUS_TYPE::ARRAY) or
+            (static_cast<DBUS_TYPE>(signature_[sign_pos_ + 1]) != dbusType<T>()))
+        {
+            return EERROR("Wrong signature: expected an array of '" + prettyStr(dbusType<T>()) + "', got '" + signature_.substr(sign_pos_) + "'");
+        }
+        sign_pos_ += 2;
+
+        return extractVector(arg);
+    }
+
+
+    template<typename T>
+    DBusError DBusMessage::extractVector(std::vector<T>& arg)
+    {
+        uint32_t array_size;
+        DBusError err = extractArgument(DBUS_TYPE::UINT32, &array_size);
+        if (err)
+        {
+            return err;
+        }
+
+        align(body_pos_, alignment(dbusType<T>()));
+        if ((body_pos_ > body_.size()) or (array_size > (body_.size() - body_pos_))) // no 32 bits wrap around.
+        {
+            return EERROR("Array out of message bounds");
+        }
+        uint32_t const end_pos = body_pos_ + array_size;
+
+        arg.clear();
+        if constexpr (std::is_arithmetic_v<T> and not std::is_same_v<T, bool>)
+        {
+            // Same layout on the wire and in memory: one copy.
+            if ((array_size % sizeof(T)) != 0)
+            {
+                return EERROR("Array size is not a multiple of its elements size");
+            }
+            arg.resize(array_size / sizeof(T));
+            std::memcpy(arg.data(), body_.data() + body_pos_, array_size);
+            body_pos_ = end_pos;
+            return err;
+        }
+
+        while (body_pos_ < end_pos)
+        {
+            T element;
+            err = extractArgument(dbusType<T>(), &element);
+            if (err)
+            {
+                return err;
+            }
+            arg.push_back(std::move(element));
         }
 
         return err;
     }
+
+
+    template<typename F>
+    DBusError DBusMessage::visitArgument(F&& visitor)
+    {
+        ValueView arg;
+        DBusError err = extractArgument(arg);
+        if (err)
+        {
+            return err;
+        }
+
+        return arg.forEach(std::forward<F>(visitor));
+    }
+
+
+    template<typename T>
+    DBusError DBusMessage::extractTrusted(T& arg)
+    {
+        sign_pos_++;
+        return extractArgument(dbusType<T>(), &arg);
+    }
+
+
+    template<typename K, typename V>
+    DBusError DBusMessage::extractTrusted(Dict<K, V>& arg)
+    {
+        sign_pos_ = completeTypeEnd(signature_, sign_pos_);
+        return extractDict(arg);
+    }
+
+
+    template<typename K, typename V>
+    DBusError DBusMessage::extractTrusted(FlatDict<K, V>& arg)
+    {
+        sign_pos_ = completeTypeEnd(signature_, sign_pos_);
+        return extractDict(arg);
+    }
+
+
+    template<typename T>
+    DBusError DBusMessage::extractTrusted(std::vector<T>& arg)
+    {
+        sign_pos_ += 2;
+        return extractVector(arg);
+    }
 }
@@ -0,0 +1,143 @@
+#include "DBusMetrics.h"
+
+namespace dbus
+{
+    uint32_t Histogram::bucketIndex(uint64_t value)
+    {
+        if (value < SUB_BUCKETS)
+        {
+            return value; // first buckets are exact.
+        }
+
+        uint32_t msb = 63 - __builtin_clzll(value);
+        uint32_t shift = msb - SUB_BUCKET_BITS;
+        return (shift + 1) * SUB_BUCKETS + ((value >> shift) - SUB_BUCKETS);
+    }
+
+
+    uint64_t Histogram::bucketValue(uint32_t index)
+    {
+        if (index < SUB_BUCKETS)
+        {
+            return index;
+        }
+
+        uint32_t shift = index / SUB_BUCKETS - 1;
+        uint64_t sub = index % SUB_BUCKETS;
+        return ((SUB_BUCKETS + sub + 1) << shift) - 1;
+    }
+
+
+    Histogram::Snapshot Histogram::snapshot() const
+    {
+        Snapshot snapshot;
+        for (uint32_t i = 0; i < BUCKETS; ++i)
+        {
+            snapshot.buckets[i] = buckets_[i].get();
+        }
+        snapshot.count = count_.get();
+        snapshot.sum   = sum_.get();
+        snapshot.max   = max_.get();
+        return snapshot;
+    }
+
+
+    uint64_t Histogram::Snapshot::percentile(double q) const
+    {
+        if (count == 0)
+        {
+            return 0;
+        }
+
+        uint64_t const rank = static_cast<uint64_t>(q * (count - 1)) + 1;
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < BUCKETS; ++i)
+        {
+            seen += buckets[i];
+            if (seen >= rank)
+            {
+                uint64_t value = bucketValue(i);
+                return (value < max) ? value : max;
+            }
+        }
+        return max;
+    }
+
+
+    DBusMetrics::Snapshot DBusMetrics::snapshot() const
+    {
+        Snapshot snapshot;
+        snapshot.enabled = true;
+
+        for (uint32_t i = 0; i < MESSAGE_TYPES; ++i)
+        {
+            snapshot.messagesIn[i]  = messagesIn_[i].get();
+            snapshot.bytesIn[i]     = bytesIn_[i].get();
+            snapshot.messagesOut[i] = messagesOut_[i].get();
+            snapshot.bytesOut[i]    = bytesOut_[i].get();
+        }
+
+        snapshot.readSyscalls    = readSyscalls_.get();
+        snapshot.writeSyscalls   = writeSyscalls_.get();
+        snapshot.eagain          = eagain_.get();
+        snapshot.timeouts        = timeouts_.get();
+        snapshot.callTimeouts    = callTimeouts_.get();
+        snapshot.callFailures    = callFailures_.get();
+        snapshot.signalsFiltered = signalsFiltered_.get();
+        snapshot.staleSignals    = staleSignals_.get();
+        snapshot.signalsMerged   = signalsMerged_.get();
+        snapshot.signalsDropped  = signalsDropped_.get();
+        snapshot.queueOverflows  = queueOverflows_.get();
+        snapshot.nameHits        = nameHits_.get();
+        snapshot.nameMisses      = nameMisses_.get();
+        snapshot.fastFails       = fastFails_.get();
+        snapshot.timerWakeups    = timerWakeups_.get();
+        snapshot.spinHits        = spinHits_.get();
+        snapshot.spinMisses      = spinMisses_.get();
+        snapshot.pendingCalls    = pendingCalls_.get();
+        snapshot.maxPendingCalls = maxPendingCalls_.get();
+
+        snapshot.callLatency = callLatency_.snapshot();
+        snapshot.queueTime   = queueTime_.snapshot();
+        return snapshot;
+    }
+
+
+    std::ostream& operator<<(std::ostream& out, DBusMetrics::Snapshot const& snapshot)
+    {
+        if (not snapshot.enabled)
+        {
+            return (out << "metrics disabled (build with ENABLE_METRICS)" << std::endl);
+        }
+
+        for (uint32_t i = 1; i < DBusMetrics::MESSAGE_TYPES; ++i)
+        {
+            out << str(static_cast<MESSAGE_TYPE>(i)) << ": "
+                << "in " << snapshot.messagesIn[i] << " (" << snapshot.bytesIn[i] << " bytes), "
+                << "out " << snapshot.messagesOut[i] << " (" << snapshot.bytesOut[i] << " bytes)" << std::endl;
+        }
+
+        out << "syscalls: read " << snapshot.readSyscalls << ", write " << snapshot.writeSyscalls
+            << ", EAGAIN " << snapshot.eagain << " (busy poll hits " << snapshot.spinHits
+            << ", misses " << snapshot.spinMisses << ")" << std::endl;
+        out << "timeouts: I/O " << snapshot.timeouts << ", calls " << snapshot.callTimeouts
+            << " (timer wakeups " << snapshot.timerWakeups << "), failed calls " << snapshot.callFailures << std::endl;
+        out << "signals filtered: " << snapshot.signalsFiltered << ", stale " << snapshot.staleSignals
+            << ", coalesced: merged " << snapshot.signalsMerged << ", dropped " << snapshot.signalsDropped
+            << ", queue overflows " << snapshot.queueOverflows << std::endl;
+        out << "name owners: hits " << snapshot.nameHits << ", misses " << snapshot.nameMisses
+            << ", fast fails " << snapshot.fastFails << std::endl;
+        out << "pending calls: " << snapshot.pendingCalls << " (max " << snapshot.maxPendingCalls << ")" << std::endl;
+
+        auto printHistogram = [&out](char const* name, Histogram::Snapshot const& h)
+        {
+            out << name << " (ns): count " << h.count << ", mean " << h.mean()
+                << ", p50 " << h.percentile(0.5) << ", p99 " << h.percentile(0.99)
+                << ", p999 " << h.percentile(0.999) << ", max " << h.max << std::endl;
+        };
+        printHistogram("call latency", snapshot.callLatency);
+        printHistogram("queue time", snapshot.queueTime);
+
+        return out;
+    }
+}
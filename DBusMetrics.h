@@ -0,0 +1,202 @@
+#ifndef DBUS_METRICS_H
+#define DBUS_METRICS_H
+
+// C++
+#include <array>
+#include <atomic>
+#include <ostream>
+
+#include "Protocol.h"
+
+// Metrics are compiled in with DBUS_ENABLE_METRICS (CMake option ENABLE_METRICS).
+#ifdef DBUS_ENABLE_METRICS
+    #define DBUS_METRICS(statement) statement
+#else
+    #define DBUS_METRICS(statement)
+#endif
+
+namespace dbus
+{
+    // Counter written by a single thread (the connection owner) and read by anyone:
+    // relaxed load + store instead of a locked read-modify-write.
+    class Counter
+    {
+    public:
+        void add(uint64_t n = 1) { value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+        void set(uint64_t n)     { value_.store(n, std::memory_order_relaxed); }
+        uint64_t get() const     { return value_.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint64_t> value_{0};
+    };
+
+
+    // Log-linear histogram (HDR style): each power of two is split in SUB_BUCKETS linear buckets,
+    // giving a constant relative precision (~6%) from 1 to 2^64 with a fixed memory footprint.
+    // Single writer, like Counter.
+    class Histogram
+    {
+    public:
+        static constexpr uint32_t SUB_BUCKET_BITS = 4;
+        static constexpr uint32_t SUB_BUCKETS = 1U << SUB_BUCKET_BITS;
+        static constexpr uint32_t BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+        struct Snapshot
+        {
+            std::array<uint64_t, BUCKETS> buckets{};
+            uint64_t count{0};
+            uint64_t sum{0};
+            uint64_t max{0};
+
+            uint64_t percentile(double q) const; // q in [0, 1]
+            uint64_t mean() const { return count ? sum / count : 0; }
+        };
+
+        void record(uint64_t value)
+        {
+            Counter& bucket = buckets_[bucketIndex(value)];
+            bucket.add();
+            count_.add();
+            sum_.add(value);
+            if (value > max_.get())
+            {
+                max_.set(value);
+            }
+        }
+
+        Snapshot snapshot() const;
+
+        static uint32_t bucketIndex(uint64_t value);
+        static uint64_t bucketValue(uint32_t index); // highest value of the bucket.
+
+    private:
+        std::array<Counter, BUCKETS> buckets_;
+        Counter count_;
+        Counter sum_;
+        Counter max_;
+    };
+
+
+    // Per connection metrics. Durations are in nanoseconds.
+    class DBusMetrics
+    {
+    public:
+        static constexpr uint32_t MESSAGE_TYPES = 5; // MESSAGE_TYPE values.
+
+        struct Snapshot
+        {
+            bool enabled{false};
+
+            std::array<uint64_t, MESSAGE_TYPES> messagesIn{};
+            std::array<uint64_t, MESSAGE_TYPES> bytesIn{};
+            std::array<uint64_t, MESSAGE_TYPES> messagesOut{};
+            std::array<uint64_t, MESSAGE_TYPES> bytesOut{};
+
+            uint64_t readSyscalls{0};
+            uint64_t writeSyscalls{0};
+            uint64_t eagain{0};
+            uint64_t timeouts{0};       // I/O timeouts.
+            uint64_t callTimeouts{0};   // calls without reply before their deadline.
+            uint64_t callFailures{0};   // calls ended by a connection error before their reply.
+            uint64_t signalsFiltered{0}; // signals dropped by the match rules on header scan.
+            uint64_t staleSignals{0};    // signals dropped because their sender lost the matched name.
+            uint64_t signalsMerged{0};   // coalesced signals merged into a held one (PropertiesChanged).
+            uint64_t signalsDropped{0};  // coalesced signals superseded by a later one of their source.
+            uint64_t queueOverflows{0};  // signals lost by full (or disconnected) subscriber queues.
+            uint64_t nameHits{0};        // name owner lookups served by the cache.
+            uint64_t nameMisses{0};
+            uint64_t fastFails{0};       // calls to absent services failed locally.
+            uint64_t timerWakeups{0};    // timerfd expiries (call deadlines, coalescing windows).
+            uint64_t spinHits{0};        // busy polls ended by the socket getting ready within the spin budget.
+            uint64_t spinMisses{0};      // busy polls that fell back to a blocking wait.
+
+            uint64_t pendingCalls{0};   // calls waiting for a reply.
+            uint64_t maxPendingCalls{0};
+
+            Histogram::Snapshot callLatency; // call sent -> reply received.
+            Histogram::Snapshot queueTime;   // send() entry -> last byte accepted by the socket.
+        };
+
+        void messageIn(MESSAGE_TYPE type, uint64_t bytes)
+        {
+            uint32_t index = typeIndex(type);
+            messagesIn_[index].add();
+            bytesIn_[index].add(bytes);
+        }
+
+        void messageOut(MESSAGE_TYPE type, uint64_t bytes)
+        {
+            uint32_t index = typeIndex(type);
+            messagesOut_[index].add();
+            bytesOut_[index].add(bytes);
+        }
+
+        void readSyscall(uint64_t n = 1)  { readSyscalls_.add(n);  }
+        void writeSyscall(uint64_t n = 1) { writeSyscalls_.add(n); }
+        void eagain()       { eagain_.add();        }
+        void timeout()      { timeouts_.add();      }
+        void callTimeout()  { callTimeouts_.add();  }
+        void callFailure()  { callFailures_.add();  }
+        void signalFiltered() { signalsFiltered_.add(); }
+        void staleSignal()    { staleSignals_.add();    }
+        void signalCoalesced(bool merged) { merged ? signalsMerged_.add() : signalsDropped_.add(); }
+        void queueOverflow()  { queueOverflows_.add();  }
+        void fastFail()       { fastFails_.add();       }
+        void timerWakeup()    { timerWakeups_.add();    }
+        void spin(bool hit)   { hit ? spinHits_.add() : spinMisses_.add(); }
+        void nameLookup(bool hit) { hit ? nameHits_.add() : nameMisses_.add(); }
+
+        void pendingCalls(uint64_t depth)
+        {
+            pendingCalls_.set(depth);
+            if (depth > maxPendingCalls_.get())
+            {
+                maxPendingCalls_.set(depth);
+            }
+        }
+
+        void callLatency(uint64_t ns) { callLatency_.record(ns); }
+        void queueTime(uint64_t ns)   { queueTime_.record(ns);   }
+
+        Snapshot snapshot() const;
+
+    private:
+        static uint32_t typeIndex(MESSAGE_TYPE type)
+        {
+            uint32_t index = static_cast<uint32_t>(type);
+            return (index < MESSAGE_TYPES) ? index : 0;
+        }
+
+        std::array<Counter, MESSAGE_TYPES> messagesIn_;
+        std::array<Counter, MESSAGE_TYPES> bytesIn_;
+        std::array<Counter, MESSAGE_TYPES> messagesOut_;
+        std::array<Counter, MESSAGE_TYPES> bytesOut_;
+
+        Counter readSyscalls_;
+        Counter writeSyscalls_;
+        Counter eagain_;
+        Counter timeouts_;
+        Counter callTimeouts_;
+        Counter callFailures_;
+        Counter signalsFiltered_;
+        Counter staleSignals_;
+        Counter signalsMerged_;
+        Counter signalsDropped_;
+        Counter queueOverflows_;
+        Counter nameHits_;
+        Counter nameMisses_;
+        Counter fastFails_;
+        Counter timerWakeups_;
+        Counter spinHits_;
+        Counter spinMisses_;
+        Counter pendingCalls_;
+        Counter maxPendingCalls_;
+
+        Histogram callLatency_;
+        Histogram queueTime_;
+    };
+
+    std::ostream& operator<<(std::ostream& out, DBusMetrics::Snapshot const& snapshot);
+}
+
+#endif
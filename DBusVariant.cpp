@@ -3,6 +3,9 @@
 
 namespace dbus
 {
+    // Containers of variants (std::vector, Dict) move their elements on growth only if this holds.
+    static_assert(std::is_nothrow_move_constructible_v<DBusVariant>);
+
     DBusVariant::DBusVariant(DBUS_TYPE type)
     {
         transform(type);
@@ -28,35 +31,68 @@ namespace dbus
     }
 
 
-    DBusVariant::DBusVariant(DBusVariant&& other)
+    DBusVariant::DBusVariant(DBusVariant&& other) noexcept
         : type_(other.type_)
+        , element_(other.element_)
         , storage_(other.storage_)
     {
         other.type_ = DBUS_TYPE::UNKNOWN;
+        other.element_ = DBUS_TYPE::UNKNOWN;
         other.storage_ = nullptr;
     }
 
 
-    DBusVariant& DBusVariant::operator=(DBusVariant&& other)
+    DBusVariant& DBusVariant::operator=(DBusVariant&& other) noexcept
     {
+        if (this == &other)
+        {
+            return *this;
+        }
+
+        cleanup(); // previous value.
         type_ = other.type_;
+        element_ = other.element_;
         storage_ = other.storage_;
 
         other.type_ = DBUS_TYPE::UNKNOWN;
+        other.element_ = DBUS_TYPE::UNKNOWN;
         other.storage_ = nullptr;
 
         return *this;
     }
 
-    void DBusVariant::transform(DBUS_TYPE type)
+    void DBusVariant::transform(DBUS_TYPE type, DBUS_TYPE element)
     {
-        if (type_ == type)
+        if ((type != DBUS_TYPE::ARRAY) or not isTypedArrayElement(element))
+        {
+            element = DBUS_TYPE::UNKNOWN;
+        }
+        if ((type_ == type) and (element_ == element))
         {
             return; // nothing to do.
         }
 
         cleanup();
         type_ = type;
+        element_ = element;
+
+        if (element_ != DBUS_TYPE::UNKNOWN)
+        {
+            switch (element_)
+            {
+                case DBUS_TYPE::BYTE:    { storage_ = new std::vector<uint8_t>();     break; }
+                case DBUS_TYPE::INT16:   { storage_ = new std::vector<int16_t>();     break; }
+                case DBUS_TYPE::UINT16:  { storage_ = new std::vector<uint16_t>();    break; }
+                case DBUS_TYPE::INT32:   { storage_ = new std::vector<int32_t>();     break; }
+                case DBUS_TYPE::INT64:   { storage_ = new std::vector<int64_t>();     break; }
+                case DBUS_TYPE::UINT64:  { storage_ = new std::vector<uint64_t>();    break; }
+                case DBUS_TYPE::DOUBLE:  { storage_ = new std::vector<double>();      break; }
+                case DBUS_TYPE::STRING:  { storage_ = new std::vector<std::string>(); break; }
+                case DBUS_TYPE::PATH:    { storage_ = new std::vector<ObjectPath>();  break; }
+                default:                 { storage_ = new std::vector<uint32_t>();    break; } // UINT32, UNIX_FD.
+            }
+            return;
+        }
 
         switch (type_)
         {
@@ -72,7 +108,11 @@ namespace dbus
             case DBUS_TYPE::STRING:    { storage_ = new std::string();              break; }
             case DBUS_TYPE::SIGNATURE: { storage_ = new Signature();                break; }
             case DBUS_TYPE::PATH:      { storage_ = new ObjectPath();               break; }
-            case DBUS_TYPE::ARRAY:     { storage_ = new std::vector<DBusVariant>(); break; }
+            case DBUS_TYPE::UNIX_FD:   { storage_ = new uint32_t(0U);               break; }
+            case DBUS_TYPE::ARRAY:
+            case DBUS_TYPE::STRUCT_BEGIN:
+            case DBUS_TYPE::DICT_BEGIN:{ storage_ = new std::vector<DBusVariant>(); break; }
+            case DBUS_TYPE::VARIANT:   { storage_ = new DBusVariant();              break; }
             default:
             {
                 break;
@@ -83,6 +123,18 @@ namespace dbus
 
     void DBusVariant::cleanup()
     {
+        if (element_ != DBUS_TYPE::UNKNOWN)
+        {
+            visitArray([](auto& elements)
+            {
+                delete &elements;
+            });
+            storage_ = nullptr;
+            type_ = DBUS_TYPE::UNKNOWN;
+            element_ = DBUS_TYPE::UNKNOWN;
+            return;
+        }
+
         switch (type_)
         {
             case DBUS_TYPE::BYTE:      { delete static_cast<uint8_t*>(storage_);                  break; }
@@ -97,7 +149,11 @@ namespace dbus
             case DBUS_TYPE::STRING:    { delete static_cast<std::string*>(storage_);              break; }
             case DBUS_TYPE::SIGNATURE: { delete static_cast<Signature*>(storage_);                break; }
             case DBUS_TYPE::PATH:      { delete static_cast<ObjectPath*>(storage_);               break; }
-            case DBUS_TYPE::ARRAY:     { delete static_cast<std::vector<DBusVariant>*>(storage_); break; }
+            case DBUS_TYPE::UNIX_FD:   { delete static_cast<uint32_t*>(storage_);                 break; }
+            case DBUS_TYPE::ARRAY:
+            case DBUS_TYPE::STRUCT_BEGIN:
+            case DBUS_TYPE::DICT_BEGIN:{ delete static_cast<std::vector<DBusVariant>*>(storage_); break; }
+            case DBUS_TYPE::VARIANT:   { delete static_cast<DBusVariant*>(storage_);              break; }
             default:
             {
                 break;
@@ -111,27 +167,45 @@ namespace dbus
 
     void DBusVariant::copy(DBusVariant const& other)
     {
-        if (other.type_ != type_)
+        if (this == &other)
         {
-            cleanup();
-            transform(other.type_);
+            return;
+        }
+        transform(other.type_, other.element_);
+
+        if (element_ != DBUS_TYPE::UNKNOWN)
+        {
+            other.visitArray([this](auto const& elements)
+            {
+                using Elements = std::decay_t<decltype(elements)>;
+                *static_cast<Elements*>(storage_) = elements;
+            });
+            return;
         }
 
         switch (type_)
         {
             case DBUS_TYPE::BYTE:    { *static_cast<uint8_t*>(storage_)     = other.get<uint8_t>();     break; }
             case DBUS_TYPE::INT16:   { *static_cast<int16_t*>(storage_)     = other.get<int16_t>();     break; }
-            case DBUS_TYPE::UINT16:  { *static_cast<uint16_t*>(storage_)    = other.get<int16_t>();     break; }
-            case DBUS_TYPE::INT32:   { *static_cast<int32_t*>(storage_)     = other.get<int16_t>();     break; }
-            case DBUS_TYPE::UINT32:  { *static_cast<uint32_t*>(storage_)    = other.get<int16_t>();     break; }
-            case DBUS_TYPE::INT64:   { *static_cast<int64_t*>(storage_)     = other.get<int16_t>();     break; }
-            case DBUS_TYPE::UINT64:  { *static_cast<uint64_t*>(storage_)    = other.get<int16_t>();     break; }
-            case DBUS_TYPE::DOUBLE:  { *static_cast<double*>(storage_)      = other.get<int16_t>();     break; }
-            case DBUS_TYPE::BOOLEAN: { *static_cast<bool*>(storage_)        = other.get<int16_t>();     break; }
+            case DBUS_TYPE::UINT16:  { *static_cast<uint16_t*>(storage_)    = other.get<uint16_t>();    break; }
+            case DBUS_TYPE::INT32:   { *static_cast<int32_t*>(storage_)     = other.get<int32_t>();     break; }
+            case DBUS_TYPE::UINT32:  { *static_cast<uint32_t*>(storage_)    = other.get<uint32_t>();    break; }
+            case DBUS_TYPE::INT64:   { *static_cast<int64_t*>(storage_)     = other.get<int64_t>();     break; }
+            case DBUS_TYPE::UINT64:  { *static_cast<uint64_t*>(storage_)    = other.get<uint64_t>();    break; }
+            case DBUS_TYPE::DOUBLE:  { *static_cast<double*>(storage_)      = other.get<double>();      break; }
+            case DBUS_TYPE::BOOLEAN: { *static_cast<bool*>(storage_)        = other.get<bool>();        break; }
             case DBUS_TYPE::STRING:  { *static_cast<std::string*>(storage_) = other.get<std::string>(); break; }
             case DBUS_TYPE::SIGNATURE: { *static_cast<Signature*>(storage_) = other.get<Signature>();   break; }
             case DBUS_TYPE::PATH:      { *static_cast<ObjectPath*>(storage_)= other.get<ObjectPath>();  break; }
-            case DBUS_TYPE::ARRAY:   { *static_cast<std::vector<DBusVariant>*>(storage_) = other.get<std::vector<DBusVariant>>(); break; }
+            case DBUS_TYPE::UNIX_FD: { *static_cast<uint32_t*>(storage_)    = other.get<uint32_t>();    break; }
+            case DBUS_TYPE::ARRAY:
+            case DBUS_TYPE::STRUCT_BEGIN:
+            case DBUS_TYPE::DICT_BEGIN:
+            {
+                *static_cast<std::vector<DBusVariant>*>(storage_) = other.get<std::vector<DBusVariant>>();
+                break;
+            }
+            case DBUS_TYPE::VARIANT: { *static_cast<DBusVariant*>(storage_) = other.get<DBusVariant>(); break; }
             default:
             {
                 break;
@@ -158,6 +232,27 @@ namespace dbus
             case DBUS_TYPE::PATH:      { out << v.get<ObjectPath>() << " ";  break; }
             case DBUS_TYPE::ARRAY:
             {
+                if (v.elementType() != DBUS_TYPE::UNKNOWN)
+                {
+                    out << "[ ";
+                    v.visitArray([&out](auto const& elements)
+                    {
+                        for (auto const& element : elements)
+                        {
+                            if constexpr (std::is_same_v<std::decay_t<decltype(element)>, uint8_t>)
+                            {
+                                out << static_cast<uint32_t>(element) << " ";
+                            }
+                            else
+                            {
+                                out << element << " ";
+                            }
+                        }
+                    });
+                    out << "]";
+                    break;
+                }
+
                 std::vector<DBusVariant> const& array = v.get<std::vector<DBusVariant>>();
                 out << "[ ";
                 for (auto const& entry : array)
@@ -167,6 +262,21 @@ namespace dbus
                 out << " ]";
                 break;
             }
+            case DBUS_TYPE::STRUCT_BEGIN:
+            case DBUS_TYPE::DICT_BEGIN:
+            {
+                bool const dict = (v.type() == DBUS_TYPE::DICT_BEGIN);
+                std::vector<DBusVariant> const& members = v.get<std::vector<DBusVariant>>();
+                out << (dict ? "{ " : "( ");
+                for (auto const& member : members)
+                {
+                    out << member << " ";
+                }
+                out << (dict ? "}" : ")");
+                break;
+            }
+            case DBUS_TYPE::VARIANT:   { out << "<" << v.get<DBusVariant>() << ">"; break; }
+            case DBUS_TYPE::UNIX_FD:   { out << "fd " << v.get<uint32_t>();        break; }
             default:
             {
                 out << "Unknown variant type";
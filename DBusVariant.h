@@ -4,18 +4,51 @@
 #include "Protocol.h"
 #include <vector>
 #include <iostream>
+#include <type_traits>
+#include <utility>
 
 namespace dbus
 {
     class DBusVariant;
+
+    // Arrays of these elements are held as typed vectors (std::vector<uint8_t>, std::vector<std::string>,
+    // std::vector<ObjectPath>, std::vector<double>...), other arrays as std::vector<DBusVariant>.
+    constexpr bool isTypedArrayElement(DBUS_TYPE element)
+    {
+        switch (element)
+        {
+            case DBUS_TYPE::BYTE:
+            case DBUS_TYPE::INT16:
+            case DBUS_TYPE::UINT16:
+            case DBUS_TYPE::INT32:
+            case DBUS_TYPE::UINT32:
+            case DBUS_TYPE::INT64:
+            case DBUS_TYPE::UINT64:
+            case DBUS_TYPE::DOUBLE:
+            case DBUS_TYPE::UNIX_FD:
+            case DBUS_TYPE::STRING:
+            case DBUS_TYPE::PATH:    { return true;  }
+            default:                 { return false; }
+        }
+    }
+
+    // Element type of T if T is a typed array, UNKNOWN otherwise.
+    template<typename T> struct TypedArray { static constexpr DBUS_TYPE element = DBUS_TYPE::UNKNOWN; };
+    template<typename E> struct TypedArray<std::vector<E>>
+    {
+        static constexpr DBUS_TYPE element = isTypedArrayElement(dbusType<E>()) ? dbusType<E>() : DBUS_TYPE::UNKNOWN;
+    };
+
     class DBusVariant
     {
     public:
         DBusVariant(DBUS_TYPE type = DBUS_TYPE::UNKNOWN);
         ~DBusVariant();
 
-        void transform(DBUS_TYPE type);
+        // element: typed array element type (see isTypedArrayElement()) when type is ARRAY.
+        void transform(DBUS_TYPE type, DBUS_TYPE element = DBUS_TYPE::UNKNOWN);
         DBUS_TYPE type() const { return type_; }
+        DBUS_TYPE elementType() const { return element_; } // UNKNOWN if not a typed array.
         void const* data() const { return storage_; }
 
         // copy
@@ -23,35 +56,62 @@ namespace dbus
         DBusVariant& operator=(DBusVariant const& other);
 
         // move
-        DBusVariant(DBusVariant&& other);
-        DBusVariant& operator=(DBusVariant&& other);
+        DBusVariant(DBusVariant&& other) noexcept;
+        DBusVariant& operator=(DBusVariant&& other) noexcept;
 
-        /// Types constructors / assignments
-        template<typename T>
-        DBusVariant(T const& value)
+        /// Types constructors / assignments: rvalues are moved in, typed arrays (std::vector<DBusVariant> for
+        /// generic ones) included.
+        template<typename T, typename = std::enable_if_t<not std::is_same_v<std::decay_t<T>, DBusVariant>>>
+        DBusVariant(T&& value)
         {
-            static_assert(dbusType<T>() != DBUS_TYPE::UNKNOWN, "Invalid DBus type");
-
-            transform(dbusType<T>());
-            get<T>() = value;
+            *this = std::forward<T>(value);
         }
 
-        template<typename T>
-        DBusVariant& operator=(T const& value)
+        template<typename T, typename = std::enable_if_t<not std::is_same_v<std::decay_t<T>, DBusVariant>>>
+        DBusVariant& operator=(T&& value)
         {
-            static_assert(dbusType<T>() != DBUS_TYPE::UNKNOWN, "Invalid DBus type");
-
-            transform(dbusType<T>());
-            get<T>() = value;
+            using V = std::decay_t<T>;
+            if constexpr (std::is_class_v<V>)
+            {
+                if ((type_ == typeOf<V>()) and (element_ == TypedArray<V>::element))
+                {
+                    get<V>() = std::forward<T>(value);
+                }
+                else
+                {
+                    emplace<V>(std::forward<T>(value));
+                }
+            }
+            else
+            {
+                static_assert(dbusType<V>() != DBUS_TYPE::UNKNOWN, "Invalid DBus type");
+                transform(dbusType<V>());
+                get<V>() = value;
+            }
             return *this;
         }
 
+        // Replace the value by a T constructed in place from args.
+        template<typename T, typename... Args>
+        T& emplace(Args&&... args)
+        {
+            static_assert(std::is_class_v<T> and (typeOf<T>() != DBUS_TYPE::UNKNOWN), "Invalid DBus type");
+
+            T* value = new T(std::forward<Args>(args)...);
+            cleanup();
+            type_ = typeOf<T>();
+            element_ = TypedArray<T>::element;
+            storage_ = value;
+            return *value;
+        }
+
         bool isValid() const { return type_ != DBUS_TYPE::UNKNOWN; }
 
         template<typename T>
         T& get()
         {
-            static_assert(dbusType<T>() != DBUS_TYPE::UNKNOWN, "Invalid DBus type");
+            static_assert((dbusType<T>() != DBUS_TYPE::UNKNOWN) or (TypedArray<T>::element != DBUS_TYPE::UNKNOWN),
+                          "Invalid DBus type");
 
             return *static_cast<T*>(storage_);
         }
@@ -59,19 +119,59 @@ namespace dbus
         template<typename T>
         T const& get() const
         {
-            static_assert(dbusType<T>() != DBUS_TYPE::UNKNOWN, "Invalid DBus type");
+            static_assert((dbusType<T>() != DBUS_TYPE::UNKNOWN) or (TypedArray<T>::element != DBUS_TYPE::UNKNOWN),
+                          "Invalid DBus type");
 
             return *static_cast<T*>(storage_);
         }
 
+        // Typed arrays: result of f(std::vector<E>&), E being the C++ type of elementType().
+        template<typename F>
+        decltype(auto) visitArray(F&& f);
+
+        template<typename F>
+        decltype(auto) visitArray(F&& f) const
+        {
+            return const_cast<DBusVariant*>(this)->visitArray([&f](auto& elements) { return f(std::as_const(elements)); });
+        }
+
     private:
+        // Variant type holding a T: ARRAY for typed arrays.
+        template<typename T>
+        static constexpr DBUS_TYPE typeOf()
+        {
+            return (TypedArray<T>::element != DBUS_TYPE::UNKNOWN) ? DBUS_TYPE::ARRAY : dbusType<T>();
+        }
+
         void cleanup();
         void copy(DBusVariant const& other);
 
         DBUS_TYPE type_{DBUS_TYPE::UNKNOWN};
+        DBUS_TYPE element_{DBUS_TYPE::UNKNOWN};
         void* storage_{nullptr};
     };
 
+
+    template<typename F>
+    decltype(auto) DBusVariant::visitArray(F&& f)
+    {
+        switch (element_)
+        {
+            case DBUS_TYPE::BYTE:    { return f(get<std::vector<uint8_t>>());     }
+            case DBUS_TYPE::INT16:   { return f(get<std::vector<int16_t>>());     }
+            case DBUS_TYPE::UINT16:  { return f(get<std::vector<uint16_t>>());    }
+            case DBUS_TYPE::INT32:   { return f(get<std::vector<int32_t>>());     }
+            case DBUS_TYPE::INT64:   { return f(get<std::vector<int64_t>>());     }
+            case DBUS_TYPE::UINT64:  { return f(get<std::vector<uint64_t>>());    }
+            case DBUS_TYPE::DOUBLE:  { return f(get<std::vector<double>>());      }
+            case DBUS_TYPE::STRING:  { return f(get<std::vector<std::string>>()); }
+            case DBUS_TYPE::PATH:    { return f(get<std::vector<ObjectPath>>());  }
+            case DBUS_TYPE::UINT32:
+            case DBUS_TYPE::UNIX_FD:
+            default:                 { return f(get<std::vector<uint32_t>>());    }
+        }
+    }
+
     std::ostream& operator<<(std::ostream& out, DBusVariant const& v);
 }
 
@@ -0,0 +1,124 @@
+#ifndef DBUS_FLAT_DICT_H
+#define DBUS_FLAT_DICT_H
+
+// C++
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace dbus
+{
+    // Dictionary with contiguous storage, an alternative to Dict (std::unordered_map) for decoded replies:
+    // entries are kept in wire order in a single vector (no node per entry) and iterated in that order.
+    // Lookups scan small dicts linearly and binary search an index of (key hash, entry) sorted by hash otherwise.
+    // The index is built by index() (done by DBusMessage extraction): entries added after it are found
+    // with a linear scan until index() is called again. Duplicated keys are kept, find() returns the first.
+    template<typename K, typename V>
+    class FlatDict
+    {
+    public:
+        using key_type = K;
+        using mapped_type = V;
+        using value_type = std::pair<K, V>;
+        using iterator = typename std::vector<value_type>::iterator;
+        using const_iterator = typename std::vector<value_type>::const_iterator;
+
+        static constexpr uint32_t LINEAR_SCAN_MAX = 16; // entries.
+
+        iterator begin()             { return entries_.begin(); }
+        iterator end()               { return entries_.end();   }
+        const_iterator begin() const { return entries_.begin(); }
+        const_iterator end() const   { return entries_.end();   }
+
+        std::size_t size() const { return entries_.size();  }
+        bool empty() const       { return entries_.empty(); }
+        void reserve(std::size_t count) { entries_.reserve(count); }
+        void clear() { entries_.clear(); sorted_.clear(); }
+
+        // Append an entry (wire order).
+        template<typename... Args>
+        value_type& emplace(Args&&... args)
+        {
+            return entries_.emplace_back(std::forward<Args>(args)...);
+        }
+
+        // Build the lookup index (the first of duplicated keys comes first).
+        void index()
+        {
+            sorted_.clear();
+            if (entries_.size() <= LINEAR_SCAN_MAX)
+            {
+                return;
+            }
+
+            sorted_.reserve(entries_.size());
+            for (uint32_t i = 0; i < entries_.size(); ++i)
+            {
+                sorted_.emplace_back(std::hash<K>{}(entries_[i].first), i);
+            }
+            std::sort(sorted_.begin(), sorted_.end());
+        }
+
+        const_iterator find(K const& key) const
+        {
+            return entries_.begin() + position(key);
+        }
+
+        iterator find(K const& key)
+        {
+            return entries_.begin() + position(key);
+        }
+
+        std::size_t count(K const& key) const { return find(key) != end(); }
+
+        V const& at(K const& key) const
+        {
+            auto it = find(key);
+            if (it == end())
+            {
+                throw std::out_of_range("FlatDict::at");
+            }
+            return it->second;
+        }
+
+        V& at(K const& key)
+        {
+            return const_cast<V&>(static_cast<FlatDict const&>(*this).at(key));
+        }
+
+    private:
+        std::size_t position(K const& key) const
+        {
+            if ((sorted_.size() == entries_.size()) and not sorted_.empty())
+            {
+                std::size_t const hash = std::hash<K>{}(key);
+                auto it = std::lower_bound(sorted_.begin(), sorted_.end(), std::make_pair(hash, uint32_t{0}));
+                for (; (it != sorted_.end()) and (it->first == hash); ++it)
+                {
+                    if (entries_[it->second].first == key)
+                    {
+                        return it->second;
+                    }
+                }
+                return entries_.size();
+            }
+
+            for (std::size_t i = 0; i < entries_.size(); ++i)
+            {
+                if (entries_[i].first == key)
+                {
+                    return i;
+                }
+            }
+            return entries_.size();
+        }
+
+        std::vector<value_type> entries_;
+        std::vector<std::pair<std::size_t, uint32_t>> sorted_; // (key hash, entry index), complete when sized as entries_.
+    };
+}
+
+#endif
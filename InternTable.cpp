@@ -0,0 +1,22 @@
+#include "InternTable.h"
+
+namespace dbus
+{
+    InternTable::Entry const* InternTable::intern(std::string_view text)
+    {
+        auto it = index_.find(text);
+        if (it != index_.end())
+        {
+            return it->second;
+        }
+        if (full())
+        {
+            return nullptr;
+        }
+
+        entries_.push_back({ObjectPath{std::string{text}}, static_cast<uint32_t>(entries_.size() + 1)});
+        Entry const* entry = &entries_.back();
+        index_.emplace(entry->str(), entry);
+        return entry;
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef DBUS_INTERN_TABLE_H
+#define DBUS_INTERN_TABLE_H
+
+// C++
+#include <cstdint>
+#include <deque>
+#include <string_view>
+#include <unordered_map>
+
+#include "Protocol.h"
+
+namespace dbus
+{
+    // Header strings (bus names, paths, interfaces, members, error names) of received messages: a small set
+    // repeated by every message. Each distinct string is stored once, at a stable address, with an id: messages
+    // decoded with the table refer to its entries instead of owning copies, and entries of a table compare by
+    // address (or id).
+    //
+    // Entries are immutable and never removed: messages keep the table alive (shared_ptr) while they refer to
+    // it, and the owner starts a new table once this one is full. Only the owner thread interns strings.
+    class InternTable
+    {
+    public:
+        static constexpr uint32_t MAX_ENTRIES = 4096;
+
+        struct Entry
+        {
+            ObjectPath value; // the string, held as an ObjectPath for path fields accessors.
+            uint32_t id;      // 1 to MAX_ENTRIES.
+
+            std::string const& str() const { return value.data(); }
+        };
+
+        // Entry of text, added if new. nullptr if the table is full.
+        Entry const* intern(std::string_view text);
+
+        std::size_t size() const { return entries_.size(); }
+        bool full() const { return entries_.size() >= MAX_ENTRIES; }
+
+    private:
+        std::deque<Entry> entries_; // stable addresses.
+        std::unordered_map<std::string_view, Entry const*> index_; // views on the entries strings.
+    };
+}
+
+#endif
@@ -0,0 +1,828 @@
+// C++
+#include <algorithm>
+#include <cstring>
+
+// POSIX
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "BusAddress.h"
+#include "LoopbackBus.h"
+
+namespace dbus
+{
+    namespace
+    {
+        std::string const BUS_NAME      {"org.freedesktop.DBus"};
+        std::string const BUS_PATH      {"/org/freedesktop/DBus"};
+        std::string const BUS_GUID      {"0123456789abcdef0123456789abcdef"};
+        std::string const ENDLINE       {"\r\n"};
+
+        // RequestName() / ReleaseName() replies.
+        constexpr uint32_t PRIMARY_OWNER = 1;
+        constexpr uint32_t EXISTS        = 3;
+        constexpr uint32_t ALREADY_OWNER = 4;
+        constexpr uint32_t RELEASED      = 1;
+        constexpr uint32_t NON_EXISTENT  = 2;
+        constexpr uint32_t NOT_OWNER     = 3;
+
+        bool setNonBlocking(int fd)
+        {
+            int flags = fcntl(fd, F_GETFL, 0);
+            if (flags < 0)
+            {
+                return false;
+            }
+            return fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+        }
+    }
+
+
+    LoopbackBus::~LoopbackBus()
+    {
+        stop();
+    }
+
+
+    DBusError LoopbackBus::listen(std::string const& address)
+    {
+        std::vector<BusAddress> parsed;
+        DBusError err = parseAddresses(address, parsed);
+        if (err)
+        {
+            return err;
+        }
+
+        struct sockaddr_un sa;
+        socklen_t sa_size;
+        err = unixSocketAddress(parsed.front(), sa, sa_size);
+        if (err)
+        {
+            return err;
+        }
+
+        listenFd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd_ < 0)
+        {
+            return ESYSTEM(errno);
+        }
+
+        if (sa.sun_path[0] != '\0')
+        {
+            path_ = sa.sun_path;
+            unlink(path_.c_str()); // remove a stale socket if any.
+        }
+
+        int rc = bind(listenFd_, (struct sockaddr*)&sa, sa_size);
+        if (rc < 0)
+        {
+            return ESYSTEM(errno);
+        }
+
+        rc = ::listen(listenFd_, SOMAXCONN);
+        if (rc < 0)
+        {
+            return ESYSTEM(errno);
+        }
+
+        address_ = parsed.front().str();
+        return ESUCCESS;
+    }
+
+
+    DBusError LoopbackBus::start()
+    {
+        epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epollFd_ < 0)
+        {
+            return ESYSTEM(errno);
+        }
+
+        wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wakeFd_ < 0)
+        {
+            return ESYSTEM(errno);
+        }
+
+        for (int fd : {wakeFd_, listenFd_})
+        {
+            if (fd < 0)
+            {
+                continue; // not listening.
+            }
+
+            struct epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event) < 0)
+            {
+                return ESYSTEM(errno);
+            }
+        }
+
+        running_ = true;
+        thread_ = std::thread(&LoopbackBus::run, this);
+        return ESUCCESS;
+    }
+
+
+    void LoopbackBus::stop()
+    {
+        if (running_.exchange(false))
+        {
+            uint64_t wake = 1;
+            (void) write(wakeFd_, &wake, sizeof(uint64_t));
+            thread_.join();
+        }
+
+        for (auto& client : clients_)
+        {
+            close(client.first);
+        }
+        clients_.clear();
+        owners_.clear();
+
+        for (int fd : pending_)
+        {
+            close(fd);
+        }
+        pending_.clear();
+
+        for (int* fd : {&listenFd_, &epollFd_, &wakeFd_})
+        {
+            if (*fd >= 0)
+            {
+                close(*fd);
+                *fd = -1;
+            }
+        }
+
+        if (not path_.empty())
+        {
+            unlink(path_.c_str());
+            path_.clear();
+        }
+        address_.clear();
+    }
+
+
+    DBusError LoopbackBus::connectPair(int& fd)
+    {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0)
+        {
+            return ESYSTEM(errno);
+        }
+
+        if (not setNonBlocking(sv[0]))
+        {
+            close(sv[0]);
+            close(sv[1]);
+            return ESYSTEM(errno);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex_);
+            pending_.push_back(sv[0]);
+        }
+
+        uint64_t wake = 1;
+        (void) write(wakeFd_, &wake, sizeof(uint64_t));
+
+        fd = sv[1];
+        return ESUCCESS;
+    }
+
+
+    void LoopbackBus::run()
+    {
+        constexpr int MAX_EVENTS = 64;
+        struct epoll_event events[MAX_EVENTS];
+
+        while (running_)
+        {
+            int n = epoll_wait(epollFd_, events, MAX_EVENTS, -1);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return;
+            }
+
+            for (int i = 0; i < n; ++i)
+            {
+                int fd = events[i].data.fd;
+                if (fd == wakeFd_)
+                {
+                    uint64_t counter;
+                    (void) read(wakeFd_, &counter, sizeof(uint64_t));
+
+                    std::lock_guard<std::mutex> lock(pendingMutex_);
+                    for (int pending : pending_)
+                    {
+                        addClient(pending);
+                    }
+                    pending_.clear();
+                    continue;
+                }
+
+                if (fd == listenFd_)
+                {
+                    int client;
+                    while ((client = accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+                    {
+                        addClient(client);
+                    }
+                    continue;
+                }
+
+                auto it = clients_.find(fd);
+                if (it == clients_.end())
+                {
+                    continue; // removed while processing a previous event.
+                }
+
+                if (events[i].events & EPOLLOUT)
+                {
+                    onWritable(it->second);
+                }
+
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                {
+                    onReadable(it->second);
+                }
+            }
+        }
+    }
+
+
+    void LoopbackBus::addClient(int fd)
+    {
+        Client client;
+        client.fd = fd;
+        clients_.emplace(fd, std::move(client));
+
+        struct epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event);
+    }
+
+
+    void LoopbackBus::removeClient(int fd)
+    {
+        auto it = clients_.find(fd);
+        if (it == clients_.end())
+        {
+            return;
+        }
+        std::string const unique_name = it->second.name;
+        if (it->second.monitor)
+        {
+            monitors_--;
+        }
+
+        epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        clients_.erase(it);
+
+        releaseNames(fd, unique_name);
+    }
+
+
+    void LoopbackBus::releaseNames(int fd, std::string const& unique_name)
+    {
+        std::vector<std::string> lost_names;
+        for (auto owner = owners_.begin(); owner != owners_.end(); )
+        {
+            if (owner->second == fd)
+            {
+                lost_names.push_back(owner->first);
+                owner = owners_.erase(owner);
+            }
+            else
+            {
+                ++owner;
+            }
+        }
+
+        for (auto const& name : lost_names)
+        {
+            nameOwnerChanged(name, unique_name, "");
+        }
+    }
+
+
+    void LoopbackBus::onReadable(Client& client)
+    {
+        uint8_t buffer[65536];
+        while (true)
+        {
+            ssize_t r = read(client.fd, buffer, sizeof(buffer));
+            if (r == 0)
+            {
+                removeClient(client.fd);
+                return;
+            }
+
+            if (r < 0)
+            {
+                if (errno == EAGAIN)
+                {
+                    break;
+                }
+                removeClient(client.fd);
+                return;
+            }
+
+            client.rx.insert(client.rx.end(), buffer, buffer + r);
+        }
+
+        if (not client.authenticated)
+        {
+            if (not processAuth(client))
+            {
+                removeClient(client.fd);
+                return;
+            }
+        }
+
+        if (not client.authenticated)
+        {
+            return; // wait for BEGIN.
+        }
+
+        uint32_t position = 0;
+        while ((client.rx.size() - position) >= DBusMessage::FRAME_PREFIX_SIZE)
+        {
+            uint32_t frame_size;
+            DBusError err = DBusMessage::frameSize(client.rx.data() + position, frame_size);
+            if (err)
+            {
+                removeClient(client.fd); // cannot resynchronize the stream.
+                return;
+            }
+
+            if ((client.rx.size() - position) < frame_size)
+            {
+                break; // incomplete frame.
+            }
+
+            processFrame(client, client.rx.data() + position, frame_size);
+            position += frame_size;
+        }
+        client.rx.erase(client.rx.begin(), client.rx.begin() + position);
+    }
+
+
+    void LoopbackBus::onWritable(Client& client)
+    {
+        ssize_t r = ::send(client.fd, client.tx.data(), client.tx.size(), MSG_NOSIGNAL);
+        if (r < 0)
+        {
+            return; // EAGAIN: wait next event. Other errors: client will be removed on read side.
+        }
+        client.tx.erase(client.tx.begin(), client.tx.begin() + r);
+
+        if (client.tx.empty())
+        {
+            struct epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = client.fd;
+            epoll_ctl(epollFd_, EPOLL_CTL_MOD, client.fd, &event);
+        }
+    }
+
+
+    bool LoopbackBus::processAuth(Client& client)
+    {
+        uint32_t position = 0;
+        if (not client.nulReceived)
+        {
+            if (client.rx.empty())
+            {
+                return true;
+            }
+
+            if (client.rx[0] != '\0')
+            {
+                return false;
+            }
+            client.nulReceived = true;
+            position = 1;
+        }
+
+        while (not client.authenticated)
+        {
+            auto begin = client.rx.begin() + position;
+            auto end = std::search(begin, client.rx.end(), ENDLINE.begin(), ENDLINE.end());
+            if (end == client.rx.end())
+            {
+                break; // incomplete line.
+            }
+
+            std::string const line(begin, end);
+            position += line.size() + ENDLINE.size();
+
+            std::string reply;
+            if (line == "AUTH")
+            {
+                reply = "REJECTED EXTERNAL";
+            }
+            else if (line.compare(0, 14, "AUTH EXTERNAL ") == 0)
+            {
+                reply = "OK " + BUS_GUID;
+            }
+            else if (line == "NEGOTIATE_UNIX_FD")
+            {
+                reply = "AGREE_UNIX_FD";
+            }
+            else if (line == "BEGIN")
+            {
+                client.authenticated = true;
+                break;
+            }
+            else
+            {
+                reply = "ERROR";
+            }
+
+            reply += ENDLINE;
+            sendTo(client, reinterpret_cast<uint8_t const*>(reply.data()), reply.size());
+        }
+
+        client.rx.erase(client.rx.begin(), client.rx.begin() + position);
+        return true;
+    }
+
+
+    void LoopbackBus::processFrame(Client& client, uint8_t const* frame, uint32_t frame_size)
+    {
+        if (not strings_ or strings_->full())
+        {
+            strings_ = std::make_shared<InternTable>();
+        }
+        DBusMessage msg;
+        DBusError err = msg.deserialize(frame, frame_size, strings_);
+        if (err)
+        {
+            return; // drop malformed message.
+        }
+
+        if (msg.hasField(FIELD::DESTINATION) and (msg.destination() == BUS_NAME))
+        {
+            processBusCall(client, msg);
+            return;
+        }
+
+        if (client.name.empty() or client.monitor)
+        {
+            return; // Hello() shall be the first message, monitors shall not send.
+        }
+
+        // Forward the frame as is unless the sender field has to be set.
+        bool const rewrite = not msg.hasField(FIELD::SENDER) or (msg.sender() != client.name);
+        if (rewrite)
+        {
+            msg.setSender(client.name);
+        }
+        if (monitors_ > 0)
+        {
+            copyToMonitors(msg, frame, frame_size, rewrite);
+        }
+
+        if (not msg.hasField(FIELD::DESTINATION))
+        {
+            if (rewrite)
+            {
+                broadcast(&client, msg);
+                return;
+            }
+
+            for (auto& peer : clients_)
+            {
+                if ((&peer.second != &client) and (not peer.second.name.empty()) and (not peer.second.monitor))
+                {
+                    sendTo(peer.second, frame, frame_size);
+                }
+            }
+            return;
+        }
+
+        auto owner = owners_.find(msg.destination());
+        if (owner == owners_.end())
+        {
+            if (msg.expectReply())
+            {
+                DBusMessage error;
+                error.prepareError(msg, "org.freedesktop.DBus.Error.ServiceUnknown");
+                error.setSender(BUS_NAME);
+                sendTo(client, error);
+            }
+            return;
+        }
+
+        Client& peer = clients_.at(owner->second);
+        if (rewrite)
+        {
+            sendTo(peer, msg);
+        }
+        else
+        {
+            sendTo(peer, frame, frame_size);
+        }
+    }
+
+
+    void LoopbackBus::processBusCall(Client& client, DBusMessage& call)
+    {
+        if (not call.hasField(FIELD::MEMBER))
+        {
+            return;
+        }
+        std::string const& member = call.member();
+
+        if (not client.name.empty())
+        {
+            call.setSender(client.name);
+        }
+        else if (member != "Hello")
+        {
+            return; // Hello() shall be the first message.
+        }
+
+        DBusMessage reply;
+        reply.prepareReply(call);
+        reply.setSender(BUS_NAME);
+
+        if (member == "Hello")
+        {
+            if (not client.name.empty())
+            {
+                reply.prepareError(call, "org.freedesktop.DBus.Error.Failed");
+                reply.setSender(BUS_NAME);
+                sendTo(client, reply);
+                return;
+            }
+
+            client.name = ":1." + std::to_string(nextId_++);
+            owners_[client.name] = client.fd;
+
+            reply.setDestination(client.name);
+            reply.addArgument(client.name);
+            sendTo(client, reply);
+
+            DBusMessage acquired;
+            acquired.prepareSignal(BUS_PATH, BUS_NAME, "NameAcquired");
+            acquired.setSender(BUS_NAME);
+            acquired.setDestination(client.name);
+            acquired.addArgument(client.name);
+            sendTo(client, acquired);
+
+            nameOwnerChanged(client.name, "", client.name);
+            return;
+        }
+
+        if (member == "RequestName")
+        {
+            std::string name;
+            if (call.extractArgument(name))
+            {
+                reply.prepareError(call, "org.freedesktop.DBus.Error.InvalidArgs");
+                reply.setSender(BUS_NAME);
+                sendTo(client, reply);
+                return;
+            }
+
+            auto owner = owners_.find(name);
+            if (owner != owners_.end())
+            {
+                reply.addArgument((owner->second == client.fd) ? ALREADY_OWNER : EXISTS);
+                sendTo(client, reply);
+                return;
+            }
+
+            owners_[name] = client.fd;
+            reply.addArgument(PRIMARY_OWNER);
+            sendTo(client, reply);
+
+            DBusMessage acquired;
+            acquired.prepareSignal(BUS_PATH, BUS_NAME, "NameAcquired");
+            acquired.setSender(BUS_NAME);
+            acquired.setDestination(client.name);
+            acquired.addArgument(name);
+            sendTo(client, acquired);
+
+            nameOwnerChanged(name, "", client.name);
+            return;
+        }
+
+        if (member == "ReleaseName")
+        {
+            std::string name;
+            if (call.extractArgument(name))
+            {
+                reply.prepareError(call, "org.freedesktop.DBus.Error.InvalidArgs");
+                reply.setSender(BUS_NAME);
+                sendTo(client, reply);
+                return;
+            }
+
+            bool released = false;
+            auto owner = owners_.find(name);
+            if (owner == owners_.end())
+            {
+                reply.addArgument(NON_EXISTENT);
+            }
+            else if (owner->second != client.fd)
+            {
+                reply.addArgument(NOT_OWNER);
+            }
+            else
+            {
+                owners_.erase(owner);
+                reply.addArgument(RELEASED);
+                released = true;
+            }
+            sendTo(client, reply);
+
+            if (released)
+            {
+                nameOwnerChanged(name, client.name, "");
+            }
+            return;
+        }
+
+        if (member == "GetNameOwner")
+        {
+            std::string name;
+            DBusError err = call.extractArgument(name);
+            auto owner = owners_.find(name);
+            if (name == BUS_NAME)
+            {
+                reply.addArgument(BUS_NAME);
+            }
+            else if (err or (owner == owners_.end()))
+            {
+                reply.prepareError(call, "org.freedesktop.DBus.Error.NameHasNoOwner");
+                reply.setSender(BUS_NAME);
+            }
+            else
+            {
+                reply.addArgument(clients_.at(owner->second).name);
+            }
+            sendTo(client, reply);
+            return;
+        }
+
+        if (member == "ListNames")
+        {
+            std::vector<std::string> names{BUS_NAME};
+            for (auto const& owner : owners_)
+            {
+                names.push_back(owner.first);
+            }
+            reply.addArgument(names);
+            sendTo(client, reply);
+            return;
+        }
+
+        if (member == "ListActivatableNames")
+        {
+            reply.addArgument(std::vector<std::string>{BUS_NAME}); // no service activation.
+            sendTo(client, reply);
+            return;
+        }
+
+        if (member == "GetId")
+        {
+            reply.addArgument(BUS_GUID);
+            sendTo(client, reply);
+            return;
+        }
+
+        if ((member == "AddMatch") or (member == "RemoveMatch"))
+        {
+            sendTo(client, reply); // accepted: every signal is broadcasted anyway.
+            return;
+        }
+
+        if ((member == "BecomeMonitor") and (call.interface() == "org.freedesktop.DBus.Monitoring"))
+        {
+            sendTo(client, reply);
+            client.monitor = true;
+            monitors_++;
+
+            releaseNames(client.fd, client.name); // a monitor leaves the bus.
+            return;
+        }
+
+        if (call.expectReply())
+        {
+            reply.prepareError(call, "org.freedesktop.DBus.Error.UnknownMethod");
+            reply.setSender(BUS_NAME);
+            sendTo(client, reply);
+        }
+    }
+
+
+    void LoopbackBus::sendTo(Client& client, uint8_t const* data, uint32_t size)
+    {
+        if (not client.tx.empty())
+        {
+            client.tx.insert(client.tx.end(), data, data + size); // keep ordering.
+            return;
+        }
+
+        uint32_t position = 0;
+        while (position < size)
+        {
+            ssize_t r = ::send(client.fd, data + position, size - position, MSG_NOSIGNAL);
+            if (r < 0)
+            {
+                if (errno == EAGAIN)
+                {
+                    break;
+                }
+                return; // client will be removed on read side.
+            }
+            position += r;
+        }
+
+        if (position < size)
+        {
+            client.tx.insert(client.tx.end(), data + position, data + size);
+
+            struct epoll_event event{};
+            event.events = EPOLLIN | EPOLLOUT;
+            event.data.fd = client.fd;
+            epoll_ctl(epollFd_, EPOLL_CTL_MOD, client.fd, &event);
+        }
+    }
+
+
+    void LoopbackBus::sendTo(Client& client, DBusMessage& msg)
+    {
+        msg.serialize();
+        sendTo(client, msg.headerBuffer_.data(), msg.headerBuffer_.size());
+        sendTo(client, msg.body_.data(), msg.body_.size());
+    }
+
+
+    void LoopbackBus::broadcast(Client const* from, DBusMessage& msg)
+    {
+        msg.serialize();
+        for (auto& peer : clients_)
+        {
+            if ((&peer.second == from) or peer.second.name.empty() or peer.second.monitor)
+            {
+                continue;
+            }
+            sendTo(peer.second, msg.headerBuffer_.data(), msg.headerBuffer_.size());
+            sendTo(peer.second, msg.body_.data(), msg.body_.size());
+        }
+    }
+
+
+    void LoopbackBus::copyToMonitors(DBusMessage& msg, uint8_t const* frame, uint32_t frame_size, bool rewritten)
+    {
+        if (rewritten)
+        {
+            msg.serialize();
+        }
+        for (auto& peer : clients_)
+        {
+            if (not peer.second.monitor)
+            {
+                continue;
+            }
+            if (rewritten)
+            {
+                sendTo(peer.second, msg.headerBuffer_.data(), msg.headerBuffer_.size());
+                sendTo(peer.second, msg.body_.data(), msg.body_.size());
+            }
+            else
+            {
+                sendTo(peer.second, frame, frame_size);
+            }
+        }
+    }
+
+
+    void LoopbackBus::nameOwnerChanged(std::string const& name, std::string const& old_owner, std::string const& new_owner)
+    {
+        DBusMessage signal;
+        signal.prepareSignal(BUS_PATH, BUS_NAME, "NameOwnerChanged");
+        signal.setSender(BUS_NAME);
+        signal.addArgument(name);
+        signal.addArgument(old_owner);
+        signal.addArgument(new_owner);
+        broadcast(nullptr, signal);
+    }
+}
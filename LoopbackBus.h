@@ -0,0 +1,88 @@
+#ifndef DBUS_LOOPBACK_BUS_H
+#define DBUS_LOOPBACK_BUS_H
+
+// C++
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "DBusMessage.h"
+
+namespace dbus
+{
+    // Minimal in-process stand-in of a bus daemon, meant to drive DBusConnection in benchmarks.
+    // It implements the EXTERNAL authentication exchange, unicast routing by unique or well-known name and
+    // broadcast of signals without destination to every peer.
+    // Bus methods answered (processBusCall()), and only those: Hello(), GetId(), RequestName(), ReleaseName(),
+    // GetNameOwner(), ListNames(), ListActivatableNames() (no service activation), AddMatch() and RemoveMatch()
+    // (accepted, rules are not evaluated).
+    // BecomeMonitor() turns a client into a monitor: it gets a copy of every message routed between peers
+    // (match rules ignored) and nothing else.
+    class LoopbackBus
+    {
+    public:
+        LoopbackBus() = default;
+        ~LoopbackBus();
+
+        LoopbackBus(LoopbackBus const&) = delete;
+        LoopbackBus& operator=(LoopbackBus const&) = delete;
+
+        DBusError listen(std::string const& address); // optional: accept clients on a Unix socket (unix:path= or unix:abstract=).
+        DBusError start();
+        void stop();
+
+        // Create a socketpair: one end is served by the bus, the other is returned (to give to DBusConnection::attach()).
+        DBusError connectPair(int& fd);
+
+        std::string const& address() const { return address_; }
+
+    private:
+        struct Client
+        {
+            int fd;
+            bool authenticated{false};
+            bool nulReceived{false};
+            std::string name;
+            bool monitor{false};
+            std::vector<uint8_t> rx;
+            std::vector<uint8_t> tx;
+        };
+
+        void run();
+        void addClient(int fd);
+        void removeClient(int fd);
+        void releaseNames(int fd, std::string const& unique_name);
+        void onReadable(Client& client);
+        void onWritable(Client& client);
+
+        bool processAuth(Client& client);
+        void processFrame(Client& client, uint8_t const* frame, uint32_t frame_size);
+        void processBusCall(Client& client, DBusMessage& call);
+
+        void sendTo(Client& client, uint8_t const* data, uint32_t size);
+        void sendTo(Client& client, DBusMessage& msg);
+        void broadcast(Client const* from, DBusMessage& msg);
+        void copyToMonitors(DBusMessage& msg, uint8_t const* frame, uint32_t frame_size, bool rewritten);
+        void nameOwnerChanged(std::string const& name, std::string const& old_owner, std::string const& new_owner);
+
+        std::string address_;
+        std::string path_; // filesystem socket to remove on stop.
+        int listenFd_{-1};
+        int epollFd_{-1};
+        int wakeFd_{-1};
+        std::atomic<bool> running_{false};
+        std::thread thread_;
+
+        std::mutex pendingMutex_;
+        std::vector<int> pending_; // socketpair ends waiting to be registered by the bus thread.
+
+        std::unordered_map<int, Client> clients_;           // by fd.
+        std::unordered_map<std::string, int> owners_;       // bus names (unique and well-known) to fd.
+        std::shared_ptr<InternTable> strings_;               // header strings of routed messages.
+        uint32_t nextId_{1};
+        uint32_t monitors_{0};
+    };
+}
+
+#endif
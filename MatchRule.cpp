@@ -0,0 +1,195 @@
+// C++
+#include <algorithm>
+#include <functional>
+
+#include "MatchRule.h"
+
+namespace dbus
+{
+    bool MatchRule::matches(HeaderView const& header) const
+    {
+        if (header.type != MESSAGE_TYPE::SIGNAL)
+        {
+            return false;
+        }
+
+        if ((not interface.empty()) and (header.interface != interface))
+        {
+            return false;
+        }
+
+        if ((not member.empty()) and (header.member != member))
+        {
+            return false;
+        }
+
+        if ((not path.empty()) and (header.path != path))
+        {
+            return false;
+        }
+
+        if ((not pathNamespace.empty()) and (pathNamespace != "/"))
+        {
+            std::string_view const prefix = pathNamespace;
+            if (header.path.compare(0, prefix.size(), prefix) != 0)
+            {
+                return false;
+            }
+
+            if ((header.path.size() > prefix.size()) and (header.path[prefix.size()] != '/'))
+            {
+                return false; // "/a/bc" is not in "/a/b" namespace.
+            }
+        }
+
+        // Well-known names are resolved by the bus: only unique names can be checked here.
+        if ((not sender.empty()) and (sender[0] == ':') and (header.sender != sender))
+        {
+            return false;
+        }
+
+        return true;
+    }
+
+
+    std::string MatchRule::str() const
+    {
+        std::string rule = "type='signal'";
+        auto append = [&rule](char const* key, std::string const& value)
+        {
+            if (not value.empty())
+            {
+                rule += std::string(",") + key + "='" + value + "'";
+            }
+        };
+
+        append("sender", sender);
+        append("path", path);
+        append("path_namespace", pathNamespace);
+        append("interface", interface);
+        append("member", member);
+        return rule;
+    }
+
+
+    uint64_t MatchIndex::key(uint64_t interface_hash, uint64_t member_hash)
+    {
+        return interface_hash ^ (member_hash + 0x9e3779b97f4a7c15ULL + (interface_hash << 6) + (interface_hash >> 2));
+    }
+
+
+    uint64_t MatchIndex::key(std::string_view interface, std::string_view member)
+    {
+        return key(std::hash<std::string_view>{}(interface), std::hash<std::string_view>{}(member));
+    }
+
+
+    uint32_t MatchIndex::add(MatchRule const& rule)
+    {
+        uint32_t const id = nextId_++;
+        auto entry = std::make_unique<Entry>(Entry{id, rule});
+        buckets_[key(rule.interface, rule.member)].push_back(entry.get());
+        rules_.emplace(id, std::move(entry));
+        return id;
+    }
+
+
+    bool MatchIndex::remove(uint32_t id)
+    {
+        auto it = rules_.find(id);
+        if (it == rules_.end())
+        {
+            return false;
+        }
+
+        uint64_t const k = key(it->second->rule.interface, it->second->rule.member);
+        auto& bucket = buckets_[k];
+        bucket.erase(std::remove(bucket.begin(), bucket.end(), it->second.get()), bucket.end());
+        if (bucket.empty())
+        {
+            buckets_.erase(k);
+        }
+
+        rules_.erase(it);
+        return true;
+    }
+
+
+    MatchRule const* MatchIndex::rule(uint32_t id) const
+    {
+        auto it = rules_.find(id);
+        if (it == rules_.end())
+        {
+            return nullptr;
+        }
+        return &it->second->rule;
+    }
+
+
+    template<typename F>
+    void MatchIndex::lookup(HeaderView const& header, F&& on_match) const
+    {
+        if ((header.type != MESSAGE_TYPE::SIGNAL) or buckets_.empty())
+        {
+            return;
+        }
+
+        // Hash each name once: the four probes only combine them.
+        static uint64_t const any_hash = std::hash<std::string_view>{}(std::string_view{});
+        std::string_view const any;
+        std::string_view const interfaces[] = { header.interface, any };
+        std::string_view const members[]    = { header.member,    any };
+        uint64_t const interface_hashes[]   = { std::hash<std::string_view>{}(header.interface), any_hash };
+        uint64_t const member_hashes[]      = { std::hash<std::string_view>{}(header.member),    any_hash };
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            if ((i == 1) and interfaces[0].empty())
+            {
+                break; // wildcard bucket already probed.
+            }
+
+            for (uint32_t m = 0; m < 2; ++m)
+            {
+                if ((m == 1) and members[0].empty())
+                {
+                    break;
+                }
+
+                std::string_view const interface = interfaces[i];
+                std::string_view const member = members[m];
+                auto it = buckets_.find(key(interface_hashes[i], member_hashes[m]));
+                if (it == buckets_.end())
+                {
+                    continue;
+                }
+
+                for (Entry const* entry : it->second)
+                {
+                    // Also filter hash collisions: rule from another (interface, member) bucket fails here.
+                    if (entry->rule.matches(header) and (entry->rule.interface == interface) and (entry->rule.member == member))
+                    {
+                        if (not on_match(entry->id))
+                        {
+                            return;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+
+    void MatchIndex::match(HeaderView const& header, std::vector<uint32_t>& ids) const
+    {
+        ids.clear();
+        lookup(header, [&ids](uint32_t id) { ids.push_back(id); return true; });
+    }
+
+
+    bool MatchIndex::matchAny(HeaderView const& header) const
+    {
+        bool found = false;
+        lookup(header, [&found](uint32_t) { found = true; return false; });
+        return found;
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef DBUS_MATCH_RULE_H
+#define DBUS_MATCH_RULE_H
+
+// C++
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Protocol.h"
+
+namespace dbus
+{
+    // Signal match rule. Empty keys are wildcards.
+    struct MatchRule
+    {
+        std::string sender;         // unique name, or well-known name (resolved by the bus, not checked locally).
+        std::string path;           // exact object path.
+        std::string pathNamespace;  // object path and its children.
+        std::string interface;
+        std::string member;
+
+        bool matches(HeaderView const& header) const;
+        std::string str() const;    // AddMatch() / RemoveMatch() syntax.
+    };
+
+
+    // Client side index of signal match rules, evaluated on the raw header fields (see DBusMessage::scanHeader()).
+    // Rules are bucketed by (interface, member): a lookup is at most four hash probes, one per combination of
+    // wildcards, and a full check of the few rules found in each bucket (path, path namespace and sender).
+    class MatchIndex
+    {
+    public:
+        uint32_t add(MatchRule const& rule); // return the rule id.
+        bool remove(uint32_t id);
+        MatchRule const* rule(uint32_t id) const;
+
+        // Ids of the rules matching header (ids is cleared first). Does not allocate once ids capacity is reached.
+        void match(HeaderView const& header, std::vector<uint32_t>& ids) const;
+        bool matchAny(HeaderView const& header) const;
+
+        bool empty() const       { return rules_.empty(); }
+        std::size_t size() const { return rules_.size();  }
+
+    private:
+        struct Entry
+        {
+            uint32_t id;
+            MatchRule rule;
+        };
+
+        static uint64_t key(uint64_t interface_hash, uint64_t member_hash);
+        static uint64_t key(std::string_view interface, std::string_view member);
+
+        template<typename F>
+        void lookup(HeaderView const& header, F&& on_match) const;
+
+        std::unordered_map<uint32_t, std::unique_ptr<Entry>> rules_;        // by id.
+        std::unordered_map<uint64_t, std::vector<Entry const*>> buckets_;   // by (interface, member) hash.
+        uint32_t nextId_{1};
+    };
+}
+
+#endif
@@ -0,0 +1,210 @@
+#include "ObjectManagerReplica.h"
+
+namespace dbus
+{
+    ObjectManagerReplica::ObjectManagerReplica(DBusConnection& connection, std::string const& destination, ObjectPath const& root)
+        : connection_(connection)
+        , destination_(destination)
+        , root_(root)
+        , tree_(std::make_shared<Objects>())
+    { }
+
+
+    ObjectManagerReplica::~ObjectManagerReplica()
+    {
+        stop();
+    }
+
+
+    DBusError ObjectManagerReplica::start(milliseconds timeout)
+    {
+        stop();
+
+        // Subscribe first: changes that happen while GetManagedObjects() is processed are part of its reply.
+        MatchRule rule;
+        rule.sender = destination_;
+        rule.pathNamespace = root_.data();
+        rule.interface = INTERFACE;
+
+        uint32_t id;
+        rule.member = "InterfacesAdded";
+        DBusError err = connection_.addMatch(rule, [this](DBusMessage& signal) { interfacesAdded(signal); }, id);
+        if (err)
+        {
+            return err;
+        }
+        matches_.push_back(id);
+
+        rule.member = "InterfacesRemoved";
+        err = connection_.addMatch(rule, [this](DBusMessage& signal) { interfacesRemoved(signal); }, id);
+        if (err)
+        {
+            stop();
+            return err;
+        }
+        matches_.push_back(id);
+
+        DBusMessage call;
+        call.prepareCall(destination_, root_.data(), INTERFACE, "GetManagedObjects");
+
+        DBusMessage reply;
+        loading_ = true; // signals received before the reply are already accounted in it.
+        err = connection_.call(std::move(call), reply, timeout);
+        loading_ = false;
+        if (err)
+        {
+            stop();
+            err += EERROR("GetManagedObjects");
+            return err;
+        }
+
+        Dict<ObjectPath, Interfaces> managed;
+        err = reply.extractArgument(managed);
+        if (err)
+        {
+            stop();
+            return err;
+        }
+
+        auto tree = std::make_shared<Objects>();
+        for (auto& object : managed)
+        {
+            notifyAdded(object.first, object.second);
+            mergeInterfaces(*tree, object.first, std::move(object.second));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tree_ = std::move(tree);
+        }
+        return ESUCCESS;
+    }
+
+
+    void ObjectManagerReplica::stop()
+    {
+        for (uint32_t id : matches_)
+        {
+            (void) connection_.removeMatch(id); // best effort: the connection may be closed.
+        }
+        matches_.clear();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        tree_ = std::make_shared<Objects>();
+    }
+
+
+    std::shared_ptr<ObjectManagerReplica::Objects const> ObjectManagerReplica::snapshot() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return tree_;
+    }
+
+
+    std::shared_ptr<ObjectManagerReplica::Interfaces const> ObjectManagerReplica::object(ObjectPath const& path) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = tree_->find(path);
+        if (it == tree_->end())
+        {
+            return nullptr;
+        }
+        return it->second;
+    }
+
+
+    ObjectManagerReplica::Objects& ObjectManagerReplica::writableTree()
+    {
+        if (tree_.use_count() > 1)
+        {
+            // A snapshot is held: copy the tree (object pointers only).
+            tree_ = std::make_shared<Objects>(*tree_);
+        }
+        return *tree_;
+    }
+
+
+    void ObjectManagerReplica::notifyAdded(ObjectPath const& path, Interfaces const& added)
+    {
+        for (auto const& callback : added_)
+        {
+            callback(path, added);
+        }
+    }
+
+
+    void ObjectManagerReplica::mergeInterfaces(Objects& objects, ObjectPath const& path, Interfaces&& added)
+    {
+        auto it = objects.find(path);
+        if (it == objects.end())
+        {
+            objects.emplace(path, std::make_shared<Interfaces const>(std::move(added)));
+            return;
+        }
+
+        // Objects are immutable (shared with snapshots): replace it.
+        auto object = std::make_shared<Interfaces>(*it->second);
+        for (auto& interface : added)
+        {
+            (*object)[interface.first] = std::move(interface.second);
+        }
+        it->second = std::move(object);
+    }
+
+
+    void ObjectManagerReplica::interfacesAdded(DBusMessage& signal)
+    {
+        // InterfacesAdded(o path, a{sa{sv}} interfaces_and_properties)
+        ObjectPath path;
+        Interfaces added;
+        if (loading_ or signal.extractArgument(path) or signal.extractArgument(added))
+        {
+            return;
+        }
+
+        updates_.add();
+        notifyAdded(path, added);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        mergeInterfaces(writableTree(), path, std::move(added));
+    }
+
+
+    void ObjectManagerReplica::interfacesRemoved(DBusMessage& signal)
+    {
+        // InterfacesRemoved(o path, as interfaces)
+        ObjectPath path;
+        std::vector<std::string> removed;
+        if (loading_ or signal.extractArgument(path) or signal.extractArgument(removed))
+        {
+            return;
+        }
+
+        updates_.add();
+        for (auto const& callback : removed_)
+        {
+            callback(path, removed);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        Objects& objects = writableTree();
+        auto it = objects.find(path);
+        if (it == objects.end())
+        {
+            return;
+        }
+
+        auto object = std::make_shared<Interfaces>(*it->second);
+        for (auto const& interface : removed)
+        {
+            object->erase(interface);
+        }
+
+        if (object->empty())
+        {
+            objects.erase(it);
+            return;
+        }
+        it->second = std::move(object);
+    }
+}
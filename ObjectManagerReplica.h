@@ -0,0 +1,74 @@
+#ifndef DBUS_OBJECT_MANAGER_REPLICA_H
+#define DBUS_OBJECT_MANAGER_REPLICA_H
+
+// C++
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "DBusConnection.h"
+
+namespace dbus
+{
+    // Local copy of the objects exported through org.freedesktop.DBus.ObjectManager by a service.
+    // start() loads the whole tree with one GetManagedObjects() call, then InterfacesAdded and
+    // InterfacesRemoved signals are applied incrementally (no further call).
+    //
+    // Snapshots are immutable and cheap: the tree is copied on write only while a snapshot is held, and
+    // the copy shares the unchanged objects. Updates and callbacks run from the connection thread
+    // (recv() / call()); snapshots may be read from any thread.
+    class ObjectManagerReplica
+    {
+    public:
+        static constexpr char const* INTERFACE = "org.freedesktop.DBus.ObjectManager";
+
+        using Properties = Dict<std::string, DBusVariant>;
+        using Interfaces = Dict<std::string, Properties>;
+        using Objects    = std::map<ObjectPath, std::shared_ptr<Interfaces const>>; // sorted by path.
+
+        using AddedCallback   = std::function<void(ObjectPath const& path, Interfaces const& added)>;
+        using RemovedCallback = std::function<void(ObjectPath const& path, std::vector<std::string> const& removed)>;
+
+        // root: path of the object implementing ObjectManager.
+        ObjectManagerReplica(DBusConnection& connection, std::string const& destination, ObjectPath const& root = ObjectPath{"/"});
+        ~ObjectManagerReplica();
+
+        ObjectManagerReplica(ObjectManagerReplica const&) = delete;
+        ObjectManagerReplica& operator=(ObjectManagerReplica const&) = delete;
+
+        DBusError start(milliseconds timeout = 1000ms);
+        void stop();
+
+        // Callbacks are called for the initial objects too (at start()).
+        void onInterfacesAdded(AddedCallback callback)     { added_.push_back(std::move(callback));   }
+        void onInterfacesRemoved(RemovedCallback callback) { removed_.push_back(std::move(callback)); }
+
+        std::shared_ptr<Objects const> snapshot() const;
+        std::shared_ptr<Interfaces const> object(ObjectPath const& path) const; // nullptr if unknown.
+
+        uint64_t updates() const { return updates_.get(); } // signals applied.
+
+    private:
+        void interfacesAdded(DBusMessage& signal);
+        void interfacesRemoved(DBusMessage& signal);
+        void notifyAdded(ObjectPath const& path, Interfaces const& added);
+        static void mergeInterfaces(Objects& objects, ObjectPath const& path, Interfaces&& added);
+        Objects& writableTree(); // mutex_ shall be held.
+
+        DBusConnection& connection_;
+        std::string destination_;
+        ObjectPath root_;
+        std::vector<uint32_t> matches_;
+        bool loading_{false};
+
+        mutable std::mutex mutex_; // guards tree_ updates against snapshot().
+        std::shared_ptr<Objects> tree_;
+
+        std::vector<AddedCallback> added_;
+        std::vector<RemovedCallback> removed_;
+        Counter updates_;
+    };
+}
+
+#endif
@@ -0,0 +1,440 @@
+#include "PropertyCache.h"
+
+namespace dbus
+{
+    namespace
+    {
+        // Replies and signals come from any peer: decoded through bounds checked value views.
+        DBusError extractText(DBusMessage& msg, std::string& value)
+        {
+            ValueView view;
+            DBusError err = msg.extractArgument(view);
+            if (err)
+            {
+                return err;
+            }
+            return view.get(value);
+        }
+
+
+        DBusError extractProperties(DBusMessage& msg, std::unordered_map<std::string, DBusVariant>& values) // a{sv}
+        {
+            ValueView dict;
+            DBusError err = msg.extractArgument(dict);
+            if (err)
+            {
+                return err;
+            }
+
+            std::string name;
+            DBusError value_err;
+            err = dict.forEach([&name, &values, &value_err](ValueView const& key, ValueView const& value)
+            {
+                value_err = key.get(name);
+                if (not value_err)
+                {
+                    value_err = value.get(values[name]);
+                }
+                return not value_err;
+            });
+            if (err)
+            {
+                return err;
+            }
+            return value_err;
+        }
+
+
+        DBusError extractNames(DBusMessage& msg, std::vector<std::string>& names) // as
+        {
+            ValueView array;
+            DBusError err = msg.extractArgument(array);
+            if (err)
+            {
+                return err;
+            }
+
+            DBusError value_err;
+            err = array.forEach([&names, &value_err](ValueView const& element)
+            {
+                names.emplace_back();
+                value_err = element.get(names.back());
+                return not value_err;
+            });
+            if (err)
+            {
+                return err;
+            }
+            return value_err;
+        }
+    }
+
+
+    PropertyCache::PropertyCache(DBusConnection& connection, milliseconds timeout)
+        : connection_(connection)
+        , timeout_(timeout)
+    { }
+
+
+    PropertyCache::~PropertyCache()
+    {
+        clear();
+    }
+
+
+    DBusError PropertyCache::get(std::string const& destination, ObjectPath const& path,
+                                 std::string const& interface, std::string const& property, DBusVariant& value)
+    {
+        DBusVariant const* cached;
+        DBusError err = lookup(destination, path, interface, property, cached);
+        if (err)
+        {
+            return err;
+        }
+
+        value = *cached;
+        return ESUCCESS;
+    }
+
+
+    DBusError PropertyCache::lookup(std::string const& destination, ObjectPath const& path,
+                                    std::string const& interface, std::string const& property, DBusVariant const*& value)
+    {
+        // Hit path: lookups only.
+        auto destination_it = destinations_.find(destination);
+        if (destination_it != destinations_.end())
+        {
+            auto object_it = destination_it->second.find(path);
+            if (object_it != destination_it->second.end())
+            {
+                auto interface_it = object_it->second.find(interface);
+                if ((interface_it != object_it->second.end()) and interface_it->second.filled)
+                {
+                    auto value_it = interface_it->second.values.find(property);
+                    if (value_it != interface_it->second.values.end())
+                    {
+                        hits_.add();
+                        value = &value_it->second;
+                        return ESUCCESS;
+                    }
+                }
+            }
+        }
+
+        misses_.add();
+        Entry& cached = entry(destination, path, interface);
+        DBusError err;
+        if (not cached.filled)
+        {
+            err = fill(destination, path, interface, cached);
+        }
+        else if (cached.invalidated.count(property))
+        {
+            err = fetch(destination, path, interface, property, cached);
+        }
+        if (err)
+        {
+            return err;
+        }
+
+        auto value_it = cached.values.find(property);
+        if (value_it == cached.values.end())
+        {
+            return EERROR("Unknown property " + interface + "." + property + " on " + path.data());
+        }
+
+        value = &value_it->second;
+        return ESUCCESS;
+    }
+
+
+    PropertyCache::Entry& PropertyCache::entry(std::string const& destination, ObjectPath const& path, std::string const& interface)
+    {
+        return destinations_[destination][path][interface];
+    }
+
+
+    DBusError PropertyCache::refresh(std::string const& destination, ObjectPath const& path, std::string const& interface)
+    {
+        return fill(destination, path, interface, entry(destination, path, interface));
+    }
+
+
+    void PropertyCache::invalidate(std::string const& destination, ObjectPath const& path, std::string const& interface)
+    {
+        entry(destination, path, interface).filled = false;
+    }
+
+
+    void PropertyCache::clear()
+    {
+        for (auto const& match : matches_)
+        {
+            (void) connection_.removeMatch(match.second); // best effort: the connection may be closed.
+        }
+
+        if (ownersMatch_ != 0)
+        {
+            (void) connection_.removeMatch(ownersMatch_);
+            ownersMatch_ = 0;
+        }
+
+        matches_.clear();
+        destinations_.clear();
+        owners_.clear();
+    }
+
+
+    PropertyCache::Stats PropertyCache::stats() const
+    {
+        Stats stats;
+        stats.hits          = hits_.get();
+        stats.misses        = misses_.get();
+        stats.fills         = fills_.get();
+        stats.fetches       = fetches_.get();
+        stats.updates       = updates_.get();
+        stats.invalidations = invalidations_.get();
+        stats.ownerChanges  = ownerChanges_.get();
+        return stats;
+    }
+
+
+    DBusError PropertyCache::fill(std::string const& destination, ObjectPath const& path, std::string const& interface, Entry& entry)
+    {
+        // Subscribe first: changes that happen while GetAll() is processed are not lost.
+        DBusError err = watchOwners();
+        if (not err)
+        {
+            err = subscribe(destination, path);
+        }
+        if (err)
+        {
+            return err;
+        }
+
+        DBusMessage call;
+        call.prepareCall(destination, path.data(), INTERFACE, "GetAll");
+        call.addArgument(interface);
+
+        DBusMessage reply;
+        err = connection_.call(std::move(call), reply, timeout_);
+        if (err)
+        {
+            err += EERROR("GetAll " + interface + " on " + path.data());
+            return err;
+        }
+
+        std::unordered_map<std::string, DBusVariant> values;
+        err = extractProperties(reply, values);
+        if (err)
+        {
+            return err;
+        }
+
+        fills_.add();
+        entry.values = std::move(values);
+        entry.invalidated.clear();
+        entry.owner = reply.hasField(FIELD::SENDER) ? reply.sender() : "";
+        entry.filled = true;
+        owners_[entry.owner].insert(destination);
+        return ESUCCESS;
+    }
+
+
+    DBusError PropertyCache::fetch(std::string const& destination, ObjectPath const& path, std::string const& interface,
+                                   std::string const& property, Entry& entry)
+    {
+        DBusMessage call;
+        call.prepareCall(destination, path.data(), INTERFACE, "Get");
+        call.addArgument(interface);
+        call.addArgument(property);
+
+        DBusMessage reply;
+        DBusError err = connection_.call(std::move(call), reply, timeout_);
+        if (err)
+        {
+            err += EERROR("Get " + interface + "." + property + " on " + path.data());
+            return err;
+        }
+
+        ValueView view;
+        DBusVariant value;
+        err = reply.extractArgument(view);
+        if (not err)
+        {
+            err = view.get(value);
+        }
+        if (err)
+        {
+            return err;
+        }
+
+        fetches_.add();
+        entry.values[property] = value;
+        entry.invalidated.erase(property);
+        return ESUCCESS;
+    }
+
+
+    DBusError PropertyCache::subscribe(std::string const& destination, ObjectPath const& path)
+    {
+        std::string const key = destination + " " + path.data();
+        if (matches_.count(key))
+        {
+            return ESUCCESS;
+        }
+
+        MatchRule rule;
+        rule.sender = destination;
+        rule.path = path.data();
+        rule.interface = INTERFACE;
+        rule.member = "PropertiesChanged";
+
+        uint32_t id;
+        DBusError err = connection_.addMatch(rule, [this](DBusMessage& signal) { onPropertiesChanged(signal); }, id);
+        if (err)
+        {
+            return err;
+        }
+
+        matches_.emplace(key, id);
+        return ESUCCESS;
+    }
+
+
+    DBusError PropertyCache::watchOwners()
+    {
+        if ((ownersMatch_ != 0) or connection_.name().empty())
+        {
+            return ESUCCESS; // watching already, or peer connection (no bus, no owner changes).
+        }
+
+        MatchRule rule;
+        rule.sender = "org.freedesktop.DBus";
+        rule.path = "/org/freedesktop/DBus";
+        rule.interface = "org.freedesktop.DBus";
+        rule.member = "NameOwnerChanged";
+        return connection_.addMatch(rule, [this](DBusMessage& signal) { onNameOwnerChanged(signal); }, ownersMatch_);
+    }
+
+
+    void PropertyCache::onNameOwnerChanged(DBusMessage& signal)
+    {
+        // NameOwnerChanged(s name, s old_owner, s new_owner)
+        std::string name;
+        std::string old_owner;
+        std::string new_owner;
+        if (extractText(signal, name) or extractText(signal, old_owner) or extractText(signal, new_owner))
+        {
+            return; // malformed: ignored.
+        }
+        if (old_owner.empty())
+        {
+            return; // new name: nothing cached from a previous owner.
+        }
+
+        // The destination itself (a well-known name changing hands, or a unique name leaving the bus), and every
+        // destination served by a unique name that left the bus.
+        std::unordered_set<std::string> destinations;
+        if (destinations_.count(name))
+        {
+            destinations.insert(name);
+        }
+        auto owner_it = owners_.find(old_owner);
+        if ((name == old_owner) and (owner_it != owners_.end()))
+        {
+            destinations.insert(owner_it->second.begin(), owner_it->second.end());
+        }
+
+        for (auto const& destination : destinations)
+        {
+            dropDestination(destination, old_owner);
+        }
+    }
+
+
+    void PropertyCache::dropDestination(std::string const& destination, std::string const& owner)
+    {
+        auto destination_it = destinations_.find(destination);
+        if (destination_it != destinations_.end())
+        {
+            for (auto& object : destination_it->second)
+            {
+                for (auto& interface : object.second)
+                {
+                    interface.second.filled = false;
+                    interface.second.values.clear();
+                    interface.second.invalidated.clear();
+                }
+            }
+            ownerChanges_.add();
+        }
+
+        auto owner_it = owners_.find(owner);
+        if (owner_it != owners_.end())
+        {
+            owner_it->second.erase(destination);
+            if (owner_it->second.empty())
+            {
+                owners_.erase(owner_it);
+            }
+        }
+    }
+
+
+    void PropertyCache::onPropertiesChanged(DBusMessage& signal)
+    {
+        // PropertiesChanged(s interface, a{sv} changed, as invalidated)
+        std::string interface;
+        std::unordered_map<std::string, DBusVariant> changed;
+        std::vector<std::string> invalidated;
+        if (extractText(signal, interface) or extractProperties(signal, changed) or extractNames(signal, invalidated))
+        {
+            return; // malformed: ignored.
+        }
+
+        std::string const owner = signal.hasField(FIELD::SENDER) ? signal.sender() : "";
+        auto owner_it = owners_.find(owner);
+        if (owner_it == owners_.end())
+        {
+            return;
+        }
+
+        for (auto const& destination : owner_it->second)
+        {
+            auto destination_it = destinations_.find(destination);
+            if (destination_it == destinations_.end())
+            {
+                continue;
+            }
+
+            auto object_it = destination_it->second.find(signal.path());
+            if (object_it == destination_it->second.end())
+            {
+                continue;
+            }
+
+            auto interface_it = object_it->second.find(interface);
+            if ((interface_it == object_it->second.end()) or not interface_it->second.filled
+                or (interface_it->second.owner != owner))
+            {
+                continue;
+            }
+
+            Entry& entry = interface_it->second;
+            for (auto const& property : changed)
+            {
+                entry.values[property.first] = property.second;
+                entry.invalidated.erase(property.first);
+                updates_.add();
+            }
+
+            for (auto const& property : invalidated)
+            {
+                entry.values.erase(property);
+                entry.invalidated.insert(property);
+                invalidations_.add();
+            }
+        }
+    }
+}
@@ -0,0 +1,120 @@
+#ifndef DBUS_PROPERTY_CACHE_H
+#define DBUS_PROPERTY_CACHE_H
+
+// C++
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "DBusConnection.h"
+
+namespace dbus
+{
+    // Local mirror of remote objects properties (org.freedesktop.DBus.Properties).
+    // An interface is filled at once with GetAll() on its first read, then kept up to date with the
+    // PropertiesChanged signals of its owner. Invalidated properties (changed without their value) are
+    // fetched with Get() on their next read. Hits are served from memory without any message.
+    // On bus connections, NameOwnerChanged is watched too: when a destination changes owner (or its owner
+    // leaves the bus), its interfaces are filled again on their next read.
+    //
+    // The cache uses the connection from the connection thread only (signals are applied from recv() / call()).
+    class PropertyCache
+    {
+    public:
+        static constexpr char const* INTERFACE = "org.freedesktop.DBus.Properties";
+
+        struct Stats
+        {
+            uint64_t hits{0};
+            uint64_t misses{0};
+            uint64_t fills{0};          // GetAll() calls.
+            uint64_t fetches{0};        // Get() calls (invalidated properties).
+            uint64_t updates{0};        // properties updated from PropertiesChanged.
+            uint64_t invalidations{0};  // properties invalidated by PropertiesChanged.
+            uint64_t ownerChanges{0};   // destinations dropped on NameOwnerChanged.
+        };
+
+        explicit PropertyCache(DBusConnection& connection, milliseconds timeout = 1000ms);
+        ~PropertyCache();
+
+        PropertyCache(PropertyCache const&) = delete;
+        PropertyCache& operator=(PropertyCache const&) = delete;
+
+        DBusError get(std::string const& destination, ObjectPath const& path,
+                      std::string const& interface, std::string const& property, DBusVariant& value);
+
+        template<typename T>
+        DBusError get(std::string const& destination, ObjectPath const& path,
+                      std::string const& interface, std::string const& property, T& value);
+
+        DBusError refresh(std::string const& destination, ObjectPath const& path, std::string const& interface); // GetAll() now.
+        void invalidate(std::string const& destination, ObjectPath const& path, std::string const& interface); // GetAll() on next read.
+        void clear(); // drop everything (and the signal subscriptions).
+
+        Stats stats() const;
+
+    private:
+        struct Entry
+        {
+            bool filled{false};
+            std::string owner; // unique name of the object owner (sender of GetAll() reply, empty on peer connections).
+            std::unordered_map<std::string, DBusVariant> values;
+            std::unordered_set<std::string> invalidated;
+        };
+
+        using Interfaces = std::unordered_map<std::string, Entry>;   // by interface.
+        using Objects    = std::unordered_map<ObjectPath, Interfaces>; // by path.
+
+        // Cached value (filled or fetched first if needed). No allocation nor message on hit.
+        DBusError lookup(std::string const& destination, ObjectPath const& path,
+                         std::string const& interface, std::string const& property, DBusVariant const*& value);
+        Entry& entry(std::string const& destination, ObjectPath const& path, std::string const& interface);
+        DBusError fill(std::string const& destination, ObjectPath const& path, std::string const& interface, Entry& entry);
+        DBusError fetch(std::string const& destination, ObjectPath const& path, std::string const& interface,
+                        std::string const& property, Entry& entry);
+        DBusError subscribe(std::string const& destination, ObjectPath const& path);
+        DBusError watchOwners();
+        void onPropertiesChanged(DBusMessage& signal);
+        void onNameOwnerChanged(DBusMessage& signal);
+        void dropDestination(std::string const& destination, std::string const& owner); // filled again on next read.
+
+        DBusConnection& connection_;
+        milliseconds timeout_;
+
+        std::unordered_map<std::string, Objects> destinations_;                   // by destination (as given by the user).
+        std::unordered_map<std::string, std::unordered_set<std::string>> owners_; // unique name -> destinations.
+        std::unordered_map<std::string, uint32_t> matches_;                       // "destination path" -> match id.
+        uint32_t ownersMatch_{0};                                                 // NameOwnerChanged match id (0: none).
+
+        Counter hits_;
+        Counter misses_;
+        Counter fills_;
+        Counter fetches_;
+        Counter updates_;
+        Counter invalidations_;
+        Counter ownerChanges_;
+    };
+
+
+    template<typename T>
+    DBusError PropertyCache::get(std::string const& destination, ObjectPath const& path,
+                                 std::string const& interface, std::string const& property, T& value)
+    {
+        DBusVariant const* variant;
+        DBusError err = lookup(destination, path, interface, property, variant);
+        if (err)
+        {
+            return err;
+        }
+
+        if (variant->type() != dbusType<T>())
+        {
+            return EERROR("Property " + property + ": expected '" + prettyStr(dbusType<T>()) + "', got '" + prettyStr(variant->type()) + "'");
+        }
+        value = variant->get<T>();
+        return ESUCCESS;
+    }
+}
+
+#endif
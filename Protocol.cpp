@@ -38,6 +38,45 @@ namespace dbus
     }
 
 
+    uint32_t completeTypeEnd(std::string_view signature, uint32_t position)
+    {
+        while ((position < signature.size()) and (signature[position] == static_cast<char>(DBUS_TYPE::ARRAY)))
+        {
+            position++; // array of the next complete type.
+        }
+
+        if (position >= signature.size())
+        {
+            return signature.size();
+        }
+
+        char const c = signature[position];
+        if ((c != static_cast<char>(DBUS_TYPE::STRUCT_BEGIN)) and (c != static_cast<char>(DBUS_TYPE::DICT_BEGIN)))
+        {
+            return position + 1;
+        }
+
+        uint32_t depth = 0;
+        for (; position < signature.size(); ++position)
+        {
+            char const t = signature[position];
+            if ((t == static_cast<char>(DBUS_TYPE::STRUCT_BEGIN)) or (t == static_cast<char>(DBUS_TYPE::DICT_BEGIN)))
+            {
+                depth++;
+            }
+            else if ((t == static_cast<char>(DBUS_TYPE::STRUCT_END)) or (t == static_cast<char>(DBUS_TYPE::DICT_END)))
+            {
+                depth--;
+                if (depth == 0)
+                {
+                    return position + 1;
+                }
+            }
+        }
+        return signature.size(); // unbalanced.
+    }
+
+
     std::string str(FIELD type)
     {
         switch (type)
@@ -3,6 +3,7 @@
 
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 #include <unordered_map>
@@ -35,6 +36,28 @@ namespace dbus
     };
     std::string str(DBUS_TYPE type);
     std::string prettyStr(DBUS_TYPE type);
+    // Wire alignment of a value of this type.
+    constexpr uint32_t alignment(DBUS_TYPE type)
+    {
+        switch (type)
+        {
+            case DBUS_TYPE::INT16:
+            case DBUS_TYPE::UINT16:        { return 2; }
+            case DBUS_TYPE::BOOLEAN:
+            case DBUS_TYPE::INT32:
+            case DBUS_TYPE::UINT32:
+            case DBUS_TYPE::UNIX_FD:
+            case DBUS_TYPE::STRING:
+            case DBUS_TYPE::PATH:
+            case DBUS_TYPE::ARRAY:         { return 4; }
+            case DBUS_TYPE::INT64:
+            case DBUS_TYPE::UINT64:
+            case DBUS_TYPE::DOUBLE:
+            case DBUS_TYPE::STRUCT_BEGIN:
+            case DBUS_TYPE::DICT_BEGIN:    { return 8; }
+            default:                       { return 1; } // byte, signature, variant.
+        }
+    }
 
 
     enum class MESSAGE_TYPE : uint8_t
@@ -48,6 +71,14 @@ namespace dbus
     std::string str(MESSAGE_TYPE endianness);
 
 
+    enum FLAGS : uint8_t
+    {
+        NO_REPLY_EXPECTED               = 0x1,
+        NO_AUTO_START                   = 0x2,
+        ALLOW_INTERACTIVE_AUTHORIZATION = 0x4
+    };
+
+
     enum class ENDIANNESS : uint8_t
     {
         LITTLE ='l',
@@ -95,16 +126,21 @@ namespace dbus
     {
         Signature() = default;
         Signature(Signature const&) = default;
+        Signature(Signature&&) = default;
 
         using std::string::operator=;
         using std::string::operator+=;
 
         Signature& operator=(Signature const&) = default;
+        Signature& operator=(Signature&&) = default;
         Signature& operator+=(DBUS_TYPE type);
         bool operator==(DBUS_TYPE type);
         bool operator!=(DBUS_TYPE type);
     };
 
+    // Position right after the single complete type that starts at position in signature (i.e. "a{sv}" in "a{sv}as").
+    uint32_t completeTypeEnd(std::string_view signature, uint32_t position);
+
 
     template<typename K, typename V>
     using Dict = std::unordered_map<K, V>;
@@ -147,7 +183,23 @@ namespace dbus
         uint32_t size;
         uint32_t serial{1};
     } __attribute__ ((packed));
-    using HeaderFields = Dict<FIELD, DBusVariant>;
+
+    // Header fields read in place from a wire frame (views are valid as long as the frame buffer is).
+    struct HeaderView
+    {
+        MESSAGE_TYPE type{MESSAGE_TYPE::INVALID};
+        uint8_t flags{0};
+        uint32_t serial{0};
+        uint32_t replySerial{0};
+        uint32_t unixFds{0};
+        std::string_view path;
+        std::string_view interface;
+        std::string_view member;
+        std::string_view errorName;
+        std::string_view destination;
+        std::string_view sender;
+        std::string_view signature;
+    };
 }
 
 // Hash specializations
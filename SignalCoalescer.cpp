@@ -0,0 +1,269 @@
+// C++
+#include <algorithm>
+#include <cstring>
+
+#include "SignalCoalescer.h"
+
+using namespace std::chrono;
+
+
+namespace dbus
+{
+    namespace
+    {
+        std::string const PROPERTIES_INTERFACE {"org.freedesktop.DBus.Properties"};
+        std::string const PROPERTIES_CHANGED   {"PropertiesChanged"};
+
+        std::string_view fieldOf(DBusMessage const& signal, FIELD field)
+        {
+            if (not signal.hasField(field))
+            {
+                return {};
+            }
+            switch (field)
+            {
+                case FIELD::SENDER:    { return signal.sender();      }
+                case FIELD::PATH:      { return signal.path().data(); }
+                case FIELD::INTERFACE: { return signal.interface();   }
+                default:               { return signal.member();      }
+            }
+        }
+    }
+
+
+    void SignalCoalescer::setPolicy(uint32_t id, POLICY policy, milliseconds window)
+    {
+        if (policy == COALESCE_NONE)
+        {
+            policies_.erase(id);
+            return;
+        }
+        policies_[id] = {policy, window};
+    }
+
+
+    void SignalCoalescer::remove(uint32_t id)
+    {
+        policies_.erase(id);
+        nextDue_ = steady_clock::time_point::max();
+        for (auto it = pending_.begin(); it != pending_.end(); )
+        {
+            if (it->second.id != id)
+            {
+                nextDue_ = std::min(nextDue_, it->second.deadline);
+                ++it;
+                continue;
+            }
+            windows_.erase(it->second.source);
+            it = pending_.erase(it);
+        }
+    }
+
+
+    SignalCoalescer::RESULT SignalCoalescer::add(uint32_t id, DBusMessage& signal, steady_clock::time_point now)
+    {
+        auto policy = policies_.find(id);
+        if (policy == policies_.end())
+        {
+            return PASSED;
+        }
+
+        if (policy->second.policy == COALESCE_LATEST)
+        {
+            key(id, signal, {});
+            Pending* pending = find();
+            RESULT const result = pending ? DROPPED : HELD;
+            if (not pending)
+            {
+                pending = &open(id, now + policy->second.window);
+            }
+            pending->signal = signal;
+            return result;
+        }
+
+        // PropertiesChanged(s interface, a{sv} changed, as invalidated)
+        if ((signal.member() != PROPERTIES_CHANGED) or (signal.interface() != PROPERTIES_INTERFACE) or
+            (signal.signature() != "sa{sv}as"))
+        {
+            return PASSED;
+        }
+
+        // Values are copied as they are on the wire (re-aligned to the start of their own buffer), all of them
+        // before merging anything: a malformed signal is left to the handler.
+        std::string interface;
+        ValueView changed;
+        std::vector<std::string> invalidated;
+        DBusError err = signal.extractArgument(interface);
+        if (not err)
+        {
+            err = signal.extractArgument(changed);
+        }
+        if (not err)
+        {
+            err = signal.extractArgument(invalidated);
+        }
+        std::size_t count = 0;
+        DBusError value_err;
+        if (not err)
+        {
+            err = changed.forEach([this, &count, &value_err](ValueView const& key, ValueView const& value)
+            {
+                if (changed_.size() <= count)
+                {
+                    changed_.emplace_back();
+                }
+                auto& property = changed_[count++];
+                property.second.clear();
+
+                std::string_view name;
+                value_err = key.get(name);
+                if (not value_err)
+                {
+                    property.first.assign(name);
+                    value_err = value.copy(property.second);
+                }
+                return not value_err;
+            });
+        }
+        if (err or value_err)
+        {
+            return PASSED;
+        }
+
+        key(id, signal, interface);
+        Pending* pending = find();
+        RESULT const result = pending ? MERGED : HELD;
+        if (not pending)
+        {
+            pending = &open(id, now + policy->second.window);
+            pending->properties = true;
+            pending->sender = fieldOf(signal, FIELD::SENDER);
+            pending->path = signal.path().data();
+            pending->interface = std::move(interface);
+        }
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            auto& property = changed_[i];
+            auto invalid = std::find(pending->invalidated.begin(), pending->invalidated.end(), property.first);
+            if (invalid != pending->invalidated.end())
+            {
+                pending->invalidated.erase(invalid);
+            }
+            pending->changed[property.first].swap(property.second); // the scratch buffer gets the old value.
+        }
+        for (auto& property : invalidated)
+        {
+            pending->changed.erase(property);
+            if (std::find(pending->invalidated.begin(), pending->invalidated.end(), property) == pending->invalidated.end())
+            {
+                pending->invalidated.push_back(std::move(property));
+            }
+        }
+        return result;
+    }
+
+
+    void SignalCoalescer::due(steady_clock::time_point now, std::vector<Ready>& ready, bool flush_all)
+    {
+        nextDue_ = steady_clock::time_point::max();
+        for (auto it = pending_.begin(); it != pending_.end(); )
+        {
+            Pending& pending = it->second;
+            if (not flush_all and (pending.deadline > now))
+            {
+                nextDue_ = std::min(nextDue_, pending.deadline);
+                ++it;
+                continue;
+            }
+
+            ready.push_back({pending.id, {}});
+            if (pending.properties)
+            {
+                if (build(pending, ready.back().signal))
+                {
+                    ready.pop_back(); // values are checked when merged: not expected.
+                }
+            }
+            else
+            {
+                ready.back().signal = std::move(pending.signal);
+            }
+            windows_.erase(pending.source);
+            it = pending_.erase(it);
+        }
+    }
+
+
+    SignalCoalescer::Pending* SignalCoalescer::find()
+    {
+        auto it = windows_.find(key_);
+        return (it == windows_.end()) ? nullptr : &pending_[it->second];
+    }
+
+
+    SignalCoalescer::Pending& SignalCoalescer::open(uint32_t id, steady_clock::time_point deadline)
+    {
+        uint64_t const window = next_++;
+        windows_.emplace(key_, window);
+        Pending& pending = pending_[window];
+        pending.id = id;
+        pending.source = key_;
+        pending.deadline = deadline;
+        nextDue_ = std::min(nextDue_, deadline);
+        return pending;
+    }
+
+
+    void SignalCoalescer::key(uint32_t id, DBusMessage const& signal, std::string_view extra)
+    {
+        key_.assign(reinterpret_cast<char const*>(&id), sizeof(id));
+        for (FIELD field : {FIELD::SENDER, FIELD::PATH, FIELD::INTERFACE, FIELD::MEMBER})
+        {
+            key_ += fieldOf(signal, field);
+            key_ += '\0';
+        }
+        key_ += extra;
+    }
+
+
+    DBusError SignalCoalescer::build(Pending const& pending, DBusMessage& signal)
+    {
+        signal.prepareSignal(pending.path, PROPERTIES_INTERFACE, PROPERTIES_CHANGED);
+        if (not pending.sender.empty())
+        {
+            signal.setSender(pending.sender);
+        }
+        signal.addArgument(pending.interface);
+
+        // a{sv} body of its own (array size, padding to the first entry, entries), then copied into the signal
+        // where it re-aligns the values.
+        dict_.assign(8, 0);
+        for (auto const& property : pending.changed)
+        {
+            dict_.resize((dict_.size() + 7) & ~std::size_t{7}, 0); // dict entries are aligned on 8 bytes.
+            uint32_t const name_size = property.first.size();
+            uint8_t const* size_bytes = reinterpret_cast<uint8_t const*>(&name_size);
+            dict_.insert(dict_.end(), size_bytes, size_bytes + sizeof(uint32_t));
+            dict_.insert(dict_.end(), property.first.begin(), property.first.end());
+            dict_.push_back(0);
+
+            ValueView const value{property.second.data(), static_cast<uint32_t>(property.second.size()), 0, "v"};
+            DBusError err = value.copy(dict_);
+            if (err)
+            {
+                return err;
+            }
+        }
+        uint32_t const dict_size = dict_.size() - 8;
+        std::memcpy(dict_.data(), &dict_size, sizeof(uint32_t));
+
+        DBusError err = signal.addArgument(ValueView{dict_.data(), static_cast<uint32_t>(dict_.size()), 0, "a{sv}"});
+        if (err)
+        {
+            return err;
+        }
+        signal.addArgument(pending.invalidated);
+        return ESUCCESS;
+    }
+}
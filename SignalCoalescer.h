@@ -0,0 +1,103 @@
+#ifndef DBUS_SIGNAL_COALESCER_H
+#define DBUS_SIGNAL_COALESCER_H
+
+// C++
+#include <chrono>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "DBusMessage.h"
+
+namespace dbus
+{
+    // Coalescing stage between the receive path and the signal handlers, per subscription (match id).
+    // A signal opens a window: signals of the same source coming in meanwhile are folded into it, and one
+    // signal is handed over when the window closes (at most one per window and source: a rate limit).
+    //
+    // Policies:
+    // - COALESCE_LATEST: source is (sender, path, interface, member), only the latest signal is kept, the
+    //   previous ones are dropped.
+    // - COALESCE_PROPERTIES: PropertiesChanged signals, source is (sender, path, properties interface). They are
+    //   merged into one PropertiesChanged with the latest value of each property changed during the window
+    //   (and the properties invalidated since their last value). Values are kept as they came on the wire, not
+    //   decoded: any type is merged. Other signals are not held.
+    //
+    // Not thread safe: used by the connection owner only.
+    class SignalCoalescer
+    {
+    public:
+        enum POLICY
+        {
+            COALESCE_NONE,
+            COALESCE_LATEST,
+            COALESCE_PROPERTIES
+        };
+
+        enum RESULT
+        {
+            PASSED,     // not held: deliver now.
+            HELD,       // opened a window.
+            DROPPED,    // replaced the signal held for its source.
+            MERGED      // merged into the signal held for its source.
+        };
+
+        struct Ready
+        {
+            uint32_t id; // match id.
+            DBusMessage signal;
+        };
+
+        // COALESCE_NONE: signals held so far are still handed over when their window closes.
+        void setPolicy(uint32_t id, POLICY policy, std::chrono::milliseconds window);
+        void remove(uint32_t id); // subscription gone: its held signals are dropped.
+
+        // signal is read (rewind it before reuse).
+        RESULT add(uint32_t id, DBusMessage& signal, std::chrono::steady_clock::time_point now);
+
+        // Append the signals whose window closed by now (all if flush_all) to ready, in window opening order.
+        void due(std::chrono::steady_clock::time_point now, std::vector<Ready>& ready, bool flush_all = false);
+
+        bool holds(uint32_t id) const { return policies_.count(id) > 0; }
+        bool empty() const { return pending_.empty(); }
+        std::chrono::steady_clock::time_point nextDue() const { return nextDue_; } // max() if none held.
+
+    private:
+        struct Policy
+        {
+            POLICY policy;
+            std::chrono::milliseconds window;
+        };
+
+        struct Pending
+        {
+            uint32_t id;
+            std::string source;
+            std::chrono::steady_clock::time_point deadline;
+            DBusMessage signal;                     // COALESCE_LATEST: latest signal.
+            bool properties{false};                 // COALESCE_PROPERTIES: merged PropertiesChanged.
+            std::string sender;
+            std::string path;
+            std::string interface;
+            Dict<std::string, Buffer> changed; // wire variant of each property, as a body of its own.
+            std::vector<std::string> invalidated;
+        };
+
+        void key(uint32_t id, DBusMessage const& signal, std::string_view extra);
+        Pending* find();                                                  // window of key_, if open.
+        Pending& open(uint32_t id, std::chrono::steady_clock::time_point deadline); // new window for key_.
+        DBusError build(Pending const& pending, DBusMessage& signal);
+
+        std::unordered_map<uint32_t, Policy> policies_;
+        std::map<uint64_t, Pending> pending_;              // by window opening order.
+        std::unordered_map<std::string, uint64_t> windows_; // source -> window.
+        std::string key_;                                   // scratch: source of the last signal.
+        std::vector<std::pair<std::string, Buffer>> changed_; // scratch: properties of the last signal.
+        Buffer dict_;                                         // scratch: changed properties of a merged signal.
+        uint64_t next_{0};                                  // next window.
+        std::chrono::steady_clock::time_point nextDue_{std::chrono::steady_clock::time_point::max()};
+    };
+}
+
+#endif
@@ -0,0 +1,953 @@
+// C++
+#include <cstring>
+#include <unordered_map>
+
+#include "SignatureProgram.h"
+#include "helpers.h"
+
+namespace dbus
+{
+    namespace
+    {
+        constexpr uint32_t MAX_ARRAY = 1U << 26; // 64 MiB.
+
+        // Wire size of fixed size basic types, 0 otherwise.
+        constexpr uint8_t fixedSize(DBUS_TYPE type)
+        {
+            switch (type)
+            {
+                case DBUS_TYPE::BYTE:    { return 1; }
+                case DBUS_TYPE::INT16:
+                case DBUS_TYPE::UINT16:  { return 2; }
+                case DBUS_TYPE::BOOLEAN:
+                case DBUS_TYPE::INT32:
+                case DBUS_TYPE::UINT32:
+                case DBUS_TYPE::UNIX_FD: { return 4; }
+                case DBUS_TYPE::INT64:
+                case DBUS_TYPE::UINT64:
+                case DBUS_TYPE::DOUBLE:  { return 8; }
+                default:                 { return 0; }
+            }
+        }
+
+        constexpr bool isString(DBUS_TYPE type)
+        {
+            return (type == DBUS_TYPE::STRING) or (type == DBUS_TYPE::PATH) or (type == DBUS_TYPE::SIGNATURE);
+        }
+
+        // position + size bytes are in the body (position may be past the end after padding).
+        bool fits(uint32_t size, uint32_t position, uint32_t bytes)
+        {
+            return (position <= size) and (bytes <= (size - position));
+        }
+
+        template<typename T>
+        void load(DBusVariant& value, uint8_t const* data)
+        {
+            std::memcpy(&value.get<T>(), data, sizeof(T));
+        }
+
+        // Fixed size value of type at data (bounds already checked).
+        void decodeFixed(DBUS_TYPE type, uint8_t const* data, DBusVariant& value)
+        {
+            value.transform(type);
+            switch (type)
+            {
+                case DBUS_TYPE::BYTE:    { load<uint8_t>(value, data);  break; }
+                case DBUS_TYPE::INT16:   { load<int16_t>(value, data);  break; }
+                case DBUS_TYPE::UINT16:  { load<uint16_t>(value, data); break; }
+                case DBUS_TYPE::INT32:   { load<int32_t>(value, data);  break; }
+                case DBUS_TYPE::UINT32:
+                case DBUS_TYPE::UNIX_FD: { load<uint32_t>(value, data); break; }
+                case DBUS_TYPE::INT64:   { load<int64_t>(value, data);  break; }
+                case DBUS_TYPE::UINT64:  { load<uint64_t>(value, data); break; }
+                case DBUS_TYPE::DOUBLE:  { load<double>(value, data);   break; }
+                case DBUS_TYPE::BOOLEAN:
+                {
+                    uint32_t boolean;
+                    std::memcpy(&boolean, data, sizeof(uint32_t));
+                    value.get<bool>() = (boolean != 0);
+                    break;
+                }
+                default:
+                {
+                    break;
+                }
+            }
+        }
+
+        DBusError decodeFixed(DBUS_TYPE type, uint8_t const* body, uint32_t size, uint32_t& position, DBusVariant& value)
+        {
+            uint8_t const bytes = fixedSize(type);
+            align(position, bytes);
+            if (not fits(size, position, bytes))
+            {
+                return EERROR("Truncated " + prettyStr(type));
+            }
+            decodeFixed(type, body + position, value);
+            position += bytes;
+            return ESUCCESS;
+        }
+
+        // String, object path or signature.
+        DBusError decodeString(DBUS_TYPE type, uint8_t const* body, uint32_t size, uint32_t& position, DBusVariant& value)
+        {
+            std::string_view text;
+            DBusError err = SignatureProgram::text(type, body, size, position, text);
+            if (err)
+            {
+                return err;
+            }
+
+            value.transform(type);
+            if (type == DBUS_TYPE::PATH)
+            {
+                value.get<ObjectPath>().setData(std::string(text));
+            }
+            else
+            {
+                value.get<std::string>().assign(text.data(), text.size());
+            }
+            return ESUCCESS;
+        }
+
+        // Variant signature at position, in place.
+        DBusError variantSignature(uint8_t const* body, uint32_t size, uint32_t& position, std::string_view& signature)
+        {
+            if (not fits(size, position, 1))
+            {
+                return EERROR("Truncated variant signature");
+            }
+            uint32_t const length = body[position];
+            if ((not fits(size, position + 1, length)) or (not fits(size, position + 1 + length, 1)) or
+                (body[position + 1 + length] != 0))
+            {
+                return EERROR("Truncated or unterminated variant signature");
+            }
+            signature = std::string_view{reinterpret_cast<char const*>(body + position + 1), length};
+            position += length + 2;
+            return ESUCCESS;
+        }
+    }
+
+
+    DBusError SignatureProgram::text(DBUS_TYPE type, uint8_t const* body, uint32_t size, uint32_t& position,
+                                     std::string_view& value)
+    {
+        uint32_t length;
+        if (type == DBUS_TYPE::SIGNATURE)
+        {
+            if (not fits(size, position, 1))
+            {
+                return EERROR("Truncated signature");
+            }
+            length = body[position++];
+        }
+        else
+        {
+            align(position, 4);
+            if (not fits(size, position, sizeof(uint32_t)))
+            {
+                return EERROR("Truncated " + prettyStr(type));
+            }
+            std::memcpy(&length, body + position, sizeof(uint32_t));
+            position += sizeof(uint32_t);
+        }
+
+        if ((not fits(size, position, length)) or (not fits(size, position + length, 1)) or (body[position + length] != 0))
+        {
+            return EERROR("Truncated or unterminated " + prettyStr(type));
+        }
+
+        value = std::string_view{reinterpret_cast<char const*>(body + position), length};
+        position += length + 1;
+        return ESUCCESS;
+    }
+
+
+    DBusError SignatureProgram::fixed(DBUS_TYPE type, uint8_t const* body, uint32_t size, uint32_t& position, void* value)
+    {
+        uint8_t const bytes = fixedSize(type);
+        align(position, bytes);
+        if ((bytes == 0) or not fits(size, position, bytes))
+        {
+            return EERROR("Truncated " + prettyStr(type));
+        }
+
+        if (type == DBUS_TYPE::BOOLEAN)
+        {
+            uint32_t boolean;
+            std::memcpy(&boolean, body + position, sizeof(uint32_t));
+            *static_cast<bool*>(value) = (boolean != 0);
+        }
+        else
+        {
+            std::memcpy(value, body + position, bytes);
+        }
+        position += bytes;
+        return ESUCCESS;
+    }
+
+
+    DBusError SignatureProgram::get(std::string_view signature, Ptr& program)
+    {
+        // Keys are views on the cached programs signature.
+        thread_local std::unordered_map<std::string_view, Ptr> cache;
+
+        auto it = cache.find(signature);
+        if (it != cache.end())
+        {
+            program = it->second;
+            return ESUCCESS;
+        }
+
+        auto compiled = std::make_shared<SignatureProgram>();
+        DBusError err = compile(signature, *compiled);
+        if (err)
+        {
+            return err;
+        }
+
+        if (cache.size() >= CACHE_SIZE)
+        {
+            cache.clear(); // programs in use stay alive with their users.
+        }
+        program = compiled;
+        cache.emplace(program->signature(), program);
+        return ESUCCESS;
+    }
+
+
+    DBusError SignatureProgram::compile(std::string_view signature, SignatureProgram& program)
+    {
+        if (signature.size() > MAX_SIGNATURE)
+        {
+            return EERROR("Signature too long");
+        }
+
+        program.signature_ = signature;
+        program.completeTypes_ = 0;
+        program.code_.clear();
+        program.runs_.clear();
+
+        uint32_t position = 0;
+        while (position < signature.size())
+        {
+            DBusError err = program.compileType(signature, position, 0, 0);
+            if (err)
+            {
+                err += EERROR("Invalid signature '" + program.signature_ + "'");
+                return err;
+            }
+            program.completeTypes_++;
+        }
+        return ESUCCESS;
+    }
+
+
+    DBusError SignatureProgram::compileType(std::string_view signature, uint32_t& position, uint32_t arrays, uint32_t structs)
+    {
+        if (position >= signature.size())
+        {
+            return EERROR("Incomplete type");
+        }
+
+        DBUS_TYPE const type = static_cast<DBUS_TYPE>(signature[position++]);
+        uint8_t const size = fixedSize(type);
+        if (size != 0)
+        {
+            code_.push_back({OP::FIXED, type, size, size});
+            return ESUCCESS;
+        }
+        if (isString(type))
+        {
+            code_.push_back({OP::STRING, type, static_cast<uint8_t>(alignment(type)), 0});
+            return ESUCCESS;
+        }
+
+        switch (type)
+        {
+            case DBUS_TYPE::VARIANT:
+            {
+                code_.push_back({OP::VARIANT, type, 1, 0});
+                return ESUCCESS;
+            }
+            case DBUS_TYPE::STRUCT_BEGIN:
+            {
+                return compileStruct(signature, position, type, arrays, structs + 1);
+            }
+            case DBUS_TYPE::ARRAY:
+            {
+                if (arrays >= MAX_NESTING)
+                {
+                    return EERROR("Too many nested arrays");
+                }
+                if (position >= signature.size())
+                {
+                    return EERROR("Array without element type");
+                }
+
+                DBUS_TYPE const element = static_cast<DBUS_TYPE>(signature[position]);
+                uint8_t const element_size = fixedSize(element);
+                if (element_size != 0)
+                {
+                    position++;
+                    code_.push_back({OP::FIXED_ARRAY, element, element_size, element_size});
+                    return ESUCCESS;
+                }
+                if ((element == DBUS_TYPE::STRING) or (element == DBUS_TYPE::PATH))
+                {
+                    position++;
+                    code_.push_back({OP::STRING_ARRAY, element, 4, 0});
+                    return ESUCCESS;
+                }
+
+                uint32_t const begin = code_.size();
+                code_.push_back({OP::ARRAY, element, static_cast<uint8_t>(alignment(element)), 0});
+                DBusError err;
+                if (element == DBUS_TYPE::DICT_BEGIN)
+                {
+                    position++;
+                    err = compileStruct(signature, position, element, arrays + 1, structs + 1);
+                }
+                else
+                {
+                    err = compileType(signature, position, arrays + 1, structs);
+                }
+                if (err)
+                {
+                    return err;
+                }
+
+                code_[begin].operand = code_.size();
+                code_.push_back({OP::ARRAY_END, element, 0, 0, begin + 1});
+                return ESUCCESS;
+            }
+            case DBUS_TYPE::DICT_BEGIN:
+            {
+                return EERROR("Dict entry outside of an array");
+            }
+            default:
+            {
+                return EERROR("Unexpected '" + std::string(1, static_cast<char>(type)) + "'");
+            }
+        }
+    }
+
+
+    DBusError SignatureProgram::compileStruct(std::string_view signature, uint32_t& position, DBUS_TYPE type,
+                                              uint32_t arrays, uint32_t structs)
+    {
+        if (structs > MAX_NESTING)
+        {
+            return EERROR("Too many nested structs");
+        }
+
+        bool const dict = (type == DBUS_TYPE::DICT_BEGIN);
+        char const end = static_cast<char>(dict ? DBUS_TYPE::DICT_END : DBUS_TYPE::STRUCT_END);
+        uint32_t const begin = code_.size();
+        code_.push_back({OP::STRUCT, type, 8, 0});
+
+        // Fixed size members up to the first variable size one have static offsets from the struct start.
+        uint32_t const run_start = runs_.size();
+        uint32_t offset = 0;
+        bool in_run = true;
+        auto flushRun = [&]()
+        {
+            if (in_run and (runs_.size() > run_start))
+            {
+                code_.push_back({OP::RUN, type, 8, 0, run_start, static_cast<uint32_t>(runs_.size() - run_start)});
+            }
+            in_run = false;
+        };
+
+        uint32_t members = 0;
+        while ((position < signature.size()) and (signature[position] != end))
+        {
+            DBUS_TYPE const member = static_cast<DBUS_TYPE>(signature[position]);
+            if (dict and (members == 0) and (fixedSize(member) == 0) and not isString(member))
+            {
+                return EERROR("Dict entry key is not a basic type");
+            }
+
+            uint8_t const size = fixedSize(member);
+            if (in_run and (size != 0))
+            {
+                align(offset, size);
+                runs_.push_back({member, offset});
+                offset += size;
+                position++;
+            }
+            else
+            {
+                flushRun();
+                DBusError err = compileType(signature, position, arrays, structs);
+                if (err)
+                {
+                    return err;
+                }
+            }
+            members++;
+        }
+        flushRun();
+
+        if (position >= signature.size())
+        {
+            return EERROR("Unterminated struct or dict entry");
+        }
+        position++;
+
+        if ((members == 0) or (dict and (members != 2)))
+        {
+            return EERROR(dict ? "Dict entry without exactly a key and a value" : "Empty struct");
+        }
+        code_[begin].count = members;
+        code_.push_back({OP::STRUCT_END, type, 0, 0});
+        return ESUCCESS;
+    }
+
+
+    DBusError SignatureProgram::run(uint8_t const* body, uint32_t size, uint32_t& position, std::vector<DBusVariant>& values) const
+    {
+        return run(body, size, position, values, 0);
+    }
+
+
+    DBusError SignatureProgram::run(uint8_t const* body, uint32_t size, uint32_t& position, std::vector<DBusVariant>& values,
+                                    uint32_t depth) const
+    {
+        // Enclosing containers: values of the parent and end of the enclosing array.
+        struct Frame
+        {
+            std::vector<DBusVariant>* values;
+            uint32_t end;
+        };
+        Frame stack[2 * MAX_NESTING]; // compile limits: the stack cannot overflow.
+        uint32_t top = 0;
+
+        std::vector<DBusVariant>* target = &values;
+        uint32_t end = 0;
+
+        auto readArraySize = [&](uint32_t element_alignment, uint32_t& length) -> DBusError
+        {
+            align(position, 4);
+            if (not fits(size, position, sizeof(uint32_t)))
+            {
+                return EERROR("Truncated array size");
+            }
+            std::memcpy(&length, body + position, sizeof(uint32_t));
+            position += sizeof(uint32_t);
+            align(position, element_alignment); // padding to the first element, even when empty.
+
+            if ((length > MAX_ARRAY) or not fits(size, position, length))
+            {
+                return EERROR("Array out of message bounds");
+            }
+            return ESUCCESS;
+        };
+
+        for (uint32_t pc = 0; pc < code_.size(); ++pc)
+        {
+            Instruction const& i = code_[pc];
+            switch (i.op)
+            {
+                case OP::FIXED:
+                {
+                    DBusError err = decodeFixed(i.type, body, size, position, target->emplace_back());
+                    if (err)
+                    {
+                        return err;
+                    }
+                    break;
+                }
+                case OP::RUN:
+                {
+                    Member const* members = runs_.data() + i.operand;
+                    Member const& last = members[i.count - 1];
+                    uint32_t const run_size = last.offset + fixedSize(last.type);
+                    if (not fits(size, position, run_size))
+                    {
+                        return EERROR("Truncated struct");
+                    }
+                    for (uint32_t m = 0; m < i.count; ++m)
+                    {
+                        decodeFixed(members[m].type, body + position + members[m].offset, target->emplace_back());
+                    }
+                    position += run_size;
+                    break;
+                }
+                case OP::STRING:
+                {
+                    DBusError err = decodeString(i.type, body, size, position, target->emplace_back());
+                    if (err)
+                    {
+                        return err;
+                    }
+                    break;
+                }
+                case OP::VARIANT:
+                {
+                    DBusError err = decodeVariant(body, size, position, target->emplace_back(), depth + 1);
+                    if (err)
+                    {
+                        return err;
+                    }
+                    break;
+                }
+                case OP::FIXED_ARRAY:
+                {
+                    uint32_t length = 0;
+                    DBusError err = readArraySize(i.alignment, length);
+                    if (err)
+                    {
+                        return err;
+                    }
+                    if ((length % i.size) != 0)
+                    {
+                        return EERROR("Array size is not a multiple of its elements size");
+                    }
+
+                    DBusVariant& array = target->emplace_back();
+                    uint32_t const count = length / i.size;
+                    if (i.type == DBUS_TYPE::BOOLEAN)
+                    {
+                        array.transform(DBUS_TYPE::ARRAY);
+                        std::vector<DBusVariant>& elements = array.get<std::vector<DBusVariant>>();
+                        elements.resize(count);
+                        for (auto& element : elements)
+                        {
+                            decodeFixed(i.type, body + position, element);
+                            position += i.size;
+                        }
+                        break;
+                    }
+
+                    // Same layout on the wire and in memory: one copy.
+                    array.transform(DBUS_TYPE::ARRAY, i.type);
+                    array.visitArray([&](auto& elements)
+                    {
+                        if constexpr (std::is_arithmetic_v<typename std::decay_t<decltype(elements)>::value_type>)
+                        {
+                            elements.resize(count);
+                            std::memcpy(elements.data(), body + position, length);
+                        }
+                    });
+                    position += length;
+                    break;
+                }
+                case OP::STRING_ARRAY:
+                {
+                    uint32_t length = 0;
+                    DBusError err = readArraySize(i.alignment, length);
+                    if (err)
+                    {
+                        return err;
+                    }
+
+                    DBusVariant& array = target->emplace_back();
+                    array.transform(DBUS_TYPE::ARRAY, i.type);
+                    uint32_t const array_end = position + length;
+                    std::string_view value;
+                    if (i.type == DBUS_TYPE::PATH)
+                    {
+                        std::vector<ObjectPath>& paths = array.get<std::vector<ObjectPath>>();
+                        while (position < array_end)
+                        {
+                            err = text(i.type, body, array_end, position, value);
+                            if (err)
+                            {
+                                return err;
+                            }
+                            paths.emplace_back(std::string(value));
+                        }
+                    }
+                    else
+                    {
+                        std::vector<std::string>& strings = array.get<std::vector<std::string>>();
+                        while (position < array_end)
+                        {
+                            err = text(i.type, body, array_end, position, value);
+                            if (err)
+                            {
+                                return err;
+                            }
+                            strings.emplace_back(value);
+                        }
+                    }
+                    break;
+                }
+                case OP::ARRAY:
+                {
+                    uint32_t length = 0;
+                    DBusError err = readArraySize(i.alignment, length);
+                    if (err)
+                    {
+                        return err;
+                    }
+
+                    DBusVariant& array = target->emplace_back(DBUS_TYPE::ARRAY);
+                    stack[top++] = {target, end};
+                    target = &array.get<std::vector<DBusVariant>>();
+                    end = position + length;
+                    if (length == 0)
+                    {
+                        pc = i.operand - 1; // to ARRAY_END.
+                    }
+                    break;
+                }
+                case OP::ARRAY_END:
+                {
+                    if (position < end)
+                    {
+                        pc = i.operand - 1; // next element.
+                        break;
+                    }
+                    if (position > end)
+                    {
+                        return EERROR("Array element crosses the array end");
+                    }
+                    top--;
+                    target = stack[top].values;
+                    end = stack[top].end;
+                    break;
+                }
+                case OP::STRUCT:
+                {
+                    align(position, 8);
+                    if (position > size)
+                    {
+                        return EERROR("Truncated struct");
+                    }
+                    DBusVariant& container = target->emplace_back(i.type);
+                    stack[top++] = {target, end};
+                    target = &container.get<std::vector<DBusVariant>>();
+                    target->reserve(i.count);
+                    break;
+                }
+                case OP::STRUCT_END:
+                {
+                    top--;
+                    target = stack[top].values;
+                    end = stack[top].end;
+                    break;
+                }
+            }
+        }
+
+        return ESUCCESS;
+    }
+
+
+    DBusError SignatureProgram::decodeVariant(uint8_t const* body, uint32_t size, uint32_t& position, DBusVariant& value,
+                                              uint32_t depth)
+    {
+        if (depth >= MAX_VARIANT_DEPTH)
+        {
+            return EERROR("Too many nested variants");
+        }
+
+        std::string_view signature;
+        DBusError err = variantSignature(body, size, position, signature);
+        if (err)
+        {
+            return err;
+        }
+
+        if (signature == "v")
+        {
+            value.transform(DBUS_TYPE::VARIANT); // variant of variant: the nesting is kept.
+            return decodeVariant(body, size, position, value.get<DBusVariant>(), depth + 1);
+        }
+        return decodeValue(signature, body, size, position, value, depth);
+    }
+
+
+    DBusError SignatureProgram::decodeValue(std::string_view signature, uint8_t const* body, uint32_t size,
+                                            uint32_t& position, DBusVariant& value, uint32_t depth)
+    {
+        if (signature.size() == 1)
+        {
+            DBUS_TYPE const type = static_cast<DBUS_TYPE>(signature[0]);
+            if (fixedSize(type) != 0)
+            {
+                return decodeFixed(type, body, size, position, value);
+            }
+            if (isString(type))
+            {
+                return decodeString(type, body, size, position, value);
+            }
+            if (type == DBUS_TYPE::VARIANT)
+            {
+                return decodeVariant(body, size, position, value, depth);
+            }
+        }
+
+        Ptr program;
+        DBusError err = get(signature, program);
+        if (err)
+        {
+            return err;
+        }
+        if (program->completeTypes() != 1)
+        {
+            return EERROR("Signature '" + std::string(signature) + "' is not a single complete type");
+        }
+
+        std::vector<DBusVariant> content;
+        content.reserve(1);
+        err = program->run(body, size, position, content, depth);
+        if (err)
+        {
+            return err;
+        }
+        value = std::move(content.front());
+        return ESUCCESS;
+    }
+
+
+    DBusError SignatureProgram::skip(std::string_view signature, uint8_t const* body, uint32_t size, uint32_t& position,
+                                     uint32_t depth)
+    {
+        if (depth >= (MAX_NESTING + MAX_VARIANT_DEPTH))
+        {
+            return EERROR("Too many nested types");
+        }
+        if (signature.empty())
+        {
+            return EERROR("Empty signature");
+        }
+
+        DBUS_TYPE const type = static_cast<DBUS_TYPE>(signature[0]);
+        uint8_t const bytes = fixedSize(type);
+        if (bytes != 0)
+        {
+            align(position, bytes);
+            if (not fits(size, position, bytes))
+            {
+                return EERROR("Truncated " + prettyStr(type));
+            }
+            position += bytes;
+            return ESUCCESS;
+        }
+
+        switch (type)
+        {
+            case DBUS_TYPE::STRING:
+            case DBUS_TYPE::PATH:
+            case DBUS_TYPE::SIGNATURE:
+            {
+                std::string_view value;
+                return text(type, body, size, position, value);
+            }
+            case DBUS_TYPE::VARIANT:
+            {
+                std::string_view content;
+                DBusError err = variantSignature(body, size, position, content);
+                if (err)
+                {
+                    return err;
+                }
+                if (completeTypeEnd(content, 0) != content.size())
+                {
+                    return EERROR("Variant signature '" + std::string(content) + "' is not a single complete type");
+                }
+                return skip(content, body, size, position, depth + 1);
+            }
+            case DBUS_TYPE::ARRAY:
+            {
+                align(position, 4);
+                if ((signature.size() < 2) or not fits(size, position, sizeof(uint32_t)))
+                {
+                    return EERROR("Truncated array");
+                }
+                uint32_t length;
+                std::memcpy(&length, body + position, sizeof(uint32_t));
+                position += sizeof(uint32_t);
+
+                align(position, alignment(static_cast<DBUS_TYPE>(signature[1])));
+                if ((length > MAX_ARRAY) or not fits(size, position, length))
+                {
+                    return EERROR("Array out of message bounds");
+                }
+                position += length;
+                return ESUCCESS;
+            }
+            case DBUS_TYPE::STRUCT_BEGIN:
+            case DBUS_TYPE::DICT_BEGIN:
+            {
+                align(position, 8);
+                char const end = static_cast<char>((type == DBUS_TYPE::DICT_BEGIN) ? DBUS_TYPE::DICT_END : DBUS_TYPE::STRUCT_END);
+                uint32_t member = 1;
+                while ((member < signature.size()) and (signature[member] != end))
+                {
+                    uint32_t const member_end = completeTypeEnd(signature, member);
+                    DBusError err = skip(signature.substr(member, member_end - member), body, size, position, depth + 1);
+                    if (err)
+                    {
+                        return err;
+                    }
+                    member = member_end;
+                }
+                if (member >= signature.size())
+                {
+                    return EERROR("Unbalanced signature '" + std::string(signature) + "'");
+                }
+                return ESUCCESS;
+            }
+            default:
+            {
+                return EERROR("Unexpected '" + std::string(1, static_cast<char>(type)) + "'");
+            }
+        }
+    }
+
+
+    DBusError SignatureProgram::copy(std::string_view signature, uint8_t const* body, uint32_t size, uint32_t& position,
+                                     Buffer& out, uint32_t depth)
+    {
+        if (depth >= (MAX_NESTING + MAX_VARIANT_DEPTH))
+        {
+            return EERROR("Too many nested types");
+        }
+        if (signature.empty())
+        {
+            return EERROR("Empty signature");
+        }
+
+        auto padOut = [&out](uint32_t alignment)
+        {
+            out.resize((out.size() + alignment - 1) & ~static_cast<std::size_t>(alignment - 1), 0);
+        };
+
+        DBUS_TYPE const type = static_cast<DBUS_TYPE>(signature[0]);
+        uint8_t const bytes = fixedSize(type);
+        if (bytes != 0)
+        {
+            align(position, bytes);
+            if (not fits(size, position, bytes))
+            {
+                return EERROR("Truncated " + prettyStr(type));
+            }
+            padOut(bytes);
+            out.insert(out.end(), body + position, body + position + bytes);
+            position += bytes;
+            return ESUCCESS;
+        }
+
+        switch (type)
+        {
+            case DBUS_TYPE::STRING:
+            case DBUS_TYPE::PATH:
+            case DBUS_TYPE::SIGNATURE:
+            {
+                uint32_t const value_alignment = (type == DBUS_TYPE::SIGNATURE) ? 1 : 4;
+                align(position, value_alignment);
+                uint32_t const start = position;
+                std::string_view value;
+                DBusError err = text(type, body, size, position, value);
+                if (err)
+                {
+                    return err;
+                }
+                padOut(value_alignment);
+                out.insert(out.end(), body + start, body + position); // size, text and nul.
+                return ESUCCESS;
+            }
+            case DBUS_TYPE::VARIANT:
+            {
+                uint32_t const start = position;
+                std::string_view content;
+                DBusError err = variantSignature(body, size, position, content);
+                if (err)
+                {
+                    return err;
+                }
+                if (completeTypeEnd(content, 0) != content.size())
+                {
+                    return EERROR("Variant signature '" + std::string(content) + "' is not a single complete type");
+                }
+                out.insert(out.end(), body + start, body + position);
+                return copy(content, body, size, position, out, depth + 1);
+            }
+            case DBUS_TYPE::ARRAY:
+            {
+                align(position, 4);
+                if ((signature.size() < 2) or not fits(size, position, sizeof(uint32_t)))
+                {
+                    return EERROR("Truncated array");
+                }
+                uint32_t length;
+                std::memcpy(&length, body + position, sizeof(uint32_t));
+                position += sizeof(uint32_t);
+
+                std::string_view const element = signature.substr(1, completeTypeEnd(signature, 1) - 1);
+                uint32_t const element_alignment = alignment(static_cast<DBUS_TYPE>(element[0]));
+                align(position, element_alignment);
+                if ((length > MAX_ARRAY) or not fits(size, position, length))
+                {
+                    return EERROR("Array out of message bounds");
+                }
+                uint32_t const end = position + length;
+
+                padOut(4);
+                std::size_t const length_offset = out.size();
+                out.resize(out.size() + sizeof(uint32_t));
+                padOut(element_alignment);
+                std::size_t const start = out.size();
+
+                if (fixedSize(static_cast<DBUS_TYPE>(element[0])) != 0)
+                {
+                    out.insert(out.end(), body + position, body + end); // no padding between elements.
+                    position = end;
+                }
+                while (position < end)
+                {
+                    DBusError err = copy(element, body, end, position, out, depth + 1);
+                    if (err)
+                    {
+                        return err;
+                    }
+                }
+                if (position != end)
+                {
+                    return EERROR("Array elements overflow the array length");
+                }
+
+                uint32_t const out_length = static_cast<uint32_t>(out.size() - start);
+                if (out_length > MAX_ARRAY)
+                {
+                    return EERROR("Array out of message bounds");
+                }
+                std::memcpy(out.data() + length_offset, &out_length, sizeof(uint32_t));
+                return ESUCCESS;
+            }
+            case DBUS_TYPE::STRUCT_BEGIN:
+            case DBUS_TYPE::DICT_BEGIN:
+            {
+                align(position, 8);
+                padOut(8);
+                char const end = static_cast<char>((type == DBUS_TYPE::DICT_BEGIN) ? DBUS_TYPE::DICT_END : DBUS_TYPE::STRUCT_END);
+                uint32_t member = 1;
+                while ((member < signature.size()) and (signature[member] != end))
+                {
+                    uint32_t const member_end = completeTypeEnd(signature, member);
+                    DBusError err = copy(signature.substr(member, member_end - member), body, size, position, out, depth + 1);
+                    if (err)
+                    {
+                        return err;
+                    }
+                    member = member_end;
+                }
+                if (member >= signature.size())
+                {
+                    return EERROR("Unbalanced signature '" + std::string(signature) + "'");
+                }
+                return ESUCCESS;
+            }
+            default:
+            {
+                return EERROR("Unexpected '" + std::string(1, static_cast<char>(type)) + "'");
+            }
+        }
+    }
+}
@@ -0,0 +1,120 @@
+#ifndef DBUS_SIGNATURE_PROGRAM_H
+#define DBUS_SIGNATURE_PROGRAM_H
+
+// C++
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "DBusError.h"
+#include "DBusVariant.h"
+#include "helpers.h"
+
+namespace dbus
+{
+    // Decoder of a signature compiled once into a flat instruction program: alignments, fixed sizes, array
+    // element layouts and container boundaries are resolved at compile time, decoding is a loop over the
+    // instructions with an explicit container stack (no recursion, except for variants).
+    //
+    // Values are decoded as DBusVariant trees, one per complete type of the signature:
+    // - basic types hold their value,
+    // - arrays (ARRAY) of basic types but booleans and signatures are typed arrays (see DBusVariant::elementType()),
+    //   other arrays hold their elements as variants, dict entries included,
+    // - structs (STRUCT_BEGIN) hold their members, dict entries (DICT_BEGIN) their key and value,
+    // - variants hold their content (a VARIANT only when the content is a variant itself).
+    //
+    // Programs are immutable: get() shares them through a per thread cache keyed by signature.
+    class SignatureProgram
+    {
+    public:
+        using Ptr = std::shared_ptr<SignatureProgram const>;
+
+        static constexpr uint32_t MAX_SIGNATURE = 255;
+        static constexpr uint32_t MAX_NESTING = 32;      // arrays, and structs, per signature.
+        static constexpr uint32_t MAX_VARIANT_DEPTH = 64;
+        static constexpr uint32_t CACHE_SIZE = 256;      // programs per thread, the cache is flushed when full.
+
+        // Cached program of signature, compiled on first use.
+        static DBusError get(std::string_view signature, Ptr& program);
+
+        static DBusError compile(std::string_view signature, SignatureProgram& program);
+
+        // Decode the complete types of the signature from body at position, moved after them.
+        DBusError run(uint8_t const* body, uint32_t size, uint32_t& position, std::vector<DBusVariant>& values) const;
+
+        // Decode a variant (its signature, then its value) in value. Basic types are decoded without program.
+        static DBusError decodeVariant(uint8_t const* body, uint32_t size, uint32_t& position, DBusVariant& value,
+                                       uint32_t depth = 0);
+
+        // Decode one value of a single complete type signature (variants: their content).
+        static DBusError decodeValue(std::string_view signature, uint8_t const* body, uint32_t size, uint32_t& position,
+                                     DBusVariant& value, uint32_t depth = 0);
+
+        // Move position right after one value of a single complete type signature, without decoding it:
+        // arrays are jumped over from their size, structs and variants are walked.
+        static DBusError skip(std::string_view signature, uint8_t const* body, uint32_t size, uint32_t& position,
+                              uint32_t depth = 0);
+
+        // Append one value of a single complete type signature, read at position (moved after it), to out as if out
+        // were a body: padding follows the value offsets in out, array lengths are recomputed. Wire values are
+        // copied as is, whatever they contain (nested variants, structs, dicts...), and checked as skip() does.
+        static DBusError copy(std::string_view signature, uint8_t const* body, uint32_t size, uint32_t& position,
+                              Buffer& out, uint32_t depth = 0);
+
+        // Text of a string, object path or signature at position, in place.
+        static DBusError text(DBUS_TYPE type, uint8_t const* body, uint32_t size, uint32_t& position,
+                              std::string_view& value);
+
+        // Fixed size basic value at position, stored as its C++ type (bool for BOOLEAN) in value.
+        static DBusError fixed(DBUS_TYPE type, uint8_t const* body, uint32_t size, uint32_t& position, void* value);
+
+        std::string const& signature() const { return signature_; }
+        uint32_t completeTypes() const { return completeTypes_; }
+        uint32_t instructions() const { return code_.size(); }
+
+    private:
+        enum class OP : uint8_t
+        {
+            FIXED,          // basic fixed size value.
+            RUN,            // fixed size struct members at static offsets from the struct start.
+            STRING,         // string, object path or signature.
+            VARIANT,
+            ARRAY,          // array of a non fixed size type: operand is the matching ARRAY_END.
+            ARRAY_END,      // loop to operand (first element instruction) until the array end.
+            FIXED_ARRAY,    // array of a fixed size basic type, decoded in one instruction.
+            STRING_ARRAY,   // array of strings or object paths, decoded in one instruction.
+            STRUCT,         // struct or dict entry (type) begin.
+            STRUCT_END,
+        };
+
+        struct Instruction
+        {
+            OP op;
+            DBUS_TYPE type;         // value type (element type for FIXED_ARRAY).
+            uint8_t alignment;      // value alignment (element alignment for arrays).
+            uint8_t size;           // wire size of fixed types.
+            uint32_t operand{0};    // jump target (ARRAY, ARRAY_END), first runs_ entry (RUN).
+            uint32_t count{0};      // members (RUN, STRUCT).
+        };
+
+        struct Member
+        {
+            DBUS_TYPE type;
+            uint32_t offset; // from the struct start (8 bytes aligned).
+        };
+
+        DBusError compileType(std::string_view signature, uint32_t& position, uint32_t arrays, uint32_t structs);
+        DBusError compileStruct(std::string_view signature, uint32_t& position, DBUS_TYPE type, uint32_t arrays,
+                                uint32_t structs);
+        DBusError run(uint8_t const* body, uint32_t size, uint32_t& position, std::vector<DBusVariant>& values,
+                      uint32_t depth) const;
+
+        std::string signature_;
+        uint32_t completeTypes_{0};
+        std::vector<Instruction> code_;
+        std::vector<Member> runs_;
+    };
+}
+
+#endif
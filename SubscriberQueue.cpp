@@ -0,0 +1,150 @@
+// C++
+#include <algorithm>
+
+#include "SubscriberQueue.h"
+
+using namespace std::chrono;
+
+
+namespace dbus
+{
+    SubscriberQueue::SubscriberQueue(uint32_t capacity, POLICY policy, milliseconds block_timeout)
+        : policy_(policy)
+        , blockTimeout_(block_timeout)
+        , slots_(std::max<uint32_t>(1, capacity))
+    {
+    }
+
+
+    SubscriberQueue::RESULT SubscriberQueue::push(DBusMessage const& signal)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (closed_)
+        {
+            overflows_.add();
+            return DISCONNECTED;
+        }
+
+        RESULT result = QUEUED;
+        if (count_ == slots_.size())
+        {
+            switch (policy_)
+            {
+                case QUEUE_BLOCK:
+                {
+                    blocked_.add();
+                    if (notFull_.wait_for(lock, blockTimeout_, [this]() { return closed_ or (count_ < slots_.size()); }))
+                    {
+                        if (closed_)
+                        {
+                            overflows_.add();
+                            return DISCONNECTED;
+                        }
+                        break;
+                    }
+                    overflows_.add();
+                    return OVERFLOWED;
+                }
+                case QUEUE_DROP_OLDEST:
+                {
+                    head_ = (head_ + 1) % slots_.size();
+                    count_--;
+                    overflows_.add();
+                    result = OVERFLOWED;
+                    break;
+                }
+                case QUEUE_DROP_NEWEST:
+                {
+                    overflows_.add();
+                    return OVERFLOWED;
+                }
+                case QUEUE_DISCONNECT:
+                {
+                    closed_ = true;
+                    overflows_.add();
+                    lock.unlock();
+                    notEmpty_.notify_all();
+                    return DISCONNECTED;
+                }
+            }
+        }
+
+        store(signal);
+        lock.unlock();
+        notEmpty_.notify_one();
+        return result;
+    }
+
+
+    void SubscriberQueue::store(DBusMessage const& signal)
+    {
+        slots_[(head_ + count_) % slots_.size()] = signal; // copy assignment: the slot buffers are reused.
+        count_++;
+        pushed_.add();
+        if (count_ > maxDepth_.get())
+        {
+            maxDepth_.set(count_);
+        }
+    }
+
+
+    DBusError SubscriberQueue::pop(DBusMessage& signal, milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (not notEmpty_.wait_for(lock, timeout, [this]() { return closed_ or (count_ > 0); }))
+        {
+            return ECODE(ERROR_CODE::TIMEOUT, "timeout");
+        }
+        if (count_ == 0)
+        {
+            return EERROR("Subscription disconnected");
+        }
+
+        std::swap(signal, slots_[head_]);
+        head_ = (head_ + 1) % slots_.size();
+        count_--;
+        popped_.add();
+        lock.unlock();
+
+        notFull_.notify_one();
+        signal.rewind();
+        return ESUCCESS;
+    }
+
+
+    void SubscriberQueue::close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        notEmpty_.notify_all();
+        notFull_.notify_all();
+    }
+
+
+    bool SubscriberQueue::closed() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return closed_;
+    }
+
+
+    std::size_t SubscriberQueue::size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return count_;
+    }
+
+
+    SubscriberQueue::Stats SubscriberQueue::stats() const
+    {
+        Stats stats;
+        stats.pushed    = pushed_.get();
+        stats.popped    = popped_.get();
+        stats.overflows = overflows_.get();
+        stats.blocked   = blocked_.get();
+        stats.maxDepth  = maxDepth_.get();
+        return stats;
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef DBUS_SUBSCRIBER_QUEUE_H
+#define DBUS_SUBSCRIBER_QUEUE_H
+
+// C++
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "DBusError.h"
+#include "DBusMessage.h"
+#include "DBusMetrics.h"
+
+namespace dbus
+{
+    // Bounded ring of signals between the connection thread and one consumer thread (see
+    // DBusConnection::addMatch()). The connection copies matched signals in and moves on: a consumer
+    // falling behind fills its own ring, not the socket, and the policy decides what gives when it is full.
+    //
+    // Slots keep their buffers: pop() swaps the message out and the consumer's previous message takes its
+    // place, so a steady stream does not allocate.
+    //
+    // push() is called by the connection thread, pop() by the consumer thread.
+    class SubscriberQueue
+    {
+    public:
+        enum POLICY
+        {
+            QUEUE_BLOCK,        // wait for room (up to block_timeout, then drop the new signal): holds the
+                                // connection and every other subscription meanwhile.
+            QUEUE_DROP_OLDEST,  // overwrite the oldest signal queued.
+            QUEUE_DROP_NEWEST,  // drop the new signal.
+            QUEUE_DISCONNECT    // close the queue: the subscription is removed.
+        };
+
+        enum RESULT
+        {
+            QUEUED,
+            OVERFLOWED,         // queued at the cost of the oldest signal, or dropped.
+            DISCONNECTED        // closed (now or before), not queued.
+        };
+
+        struct Stats
+        {
+            uint64_t pushed{0};
+            uint64_t popped{0};
+            uint64_t overflows{0}; // signals lost (dropped, overwritten, or refused once disconnected).
+            uint64_t blocked{0};   // QUEUE_BLOCK: pushes which waited for room.
+            uint64_t maxDepth{0};
+        };
+
+        SubscriberQueue(uint32_t capacity, POLICY policy,
+                        std::chrono::milliseconds block_timeout = std::chrono::milliseconds(1000));
+
+        SubscriberQueue(SubscriberQueue const&) = delete;
+        SubscriberQueue& operator=(SubscriberQueue const&) = delete;
+
+        RESULT push(DBusMessage const& signal);
+
+        // Wait for the next signal (rewound). Once disconnected, the signals queued are still returned, then
+        // an error.
+        DBusError pop(DBusMessage& signal, std::chrono::milliseconds timeout);
+
+        void close(); // wakes up pop() and a blocked push().
+        bool closed() const;
+
+        std::size_t size() const;
+        uint32_t capacity() const { return static_cast<uint32_t>(slots_.size()); }
+        POLICY policy() const { return policy_; }
+        Stats stats() const;
+
+    private:
+        void store(DBusMessage const& signal); // lock held, room available.
+
+        POLICY const policy_;
+        std::chrono::milliseconds const blockTimeout_;
+
+        mutable std::mutex mutex_;
+        std::condition_variable notEmpty_;
+        std::condition_variable notFull_;
+        std::vector<DBusMessage> slots_;
+        std::size_t head_{0};
+        std::size_t count_{0};
+        bool closed_{false};
+
+        Counter pushed_;
+        Counter popped_;
+        Counter overflows_;
+        Counter blocked_;
+        Counter maxDepth_;
+    };
+}
+
+#endif
@@ -0,0 +1,181 @@
+// C++
+#include <algorithm>
+
+#include "TimerWheel.h"
+
+namespace dbus
+{
+    TimerWheel::TimerId TimerWheel::add(uint64_t expiry, uint32_t value)
+    {
+        uint32_t index = free_;
+        if (index != NIL)
+        {
+            free_ = nodes_[index].next;
+        }
+        else
+        {
+            index = nodes_.size();
+            nodes_.push_back({0, 0, 0, NIL, NIL, NIL});
+        }
+
+        Node& node = nodes_[index];
+        node.expiry = expiry;
+        node.value = value;
+        place(index, current_ + 1); // current tick is already processed.
+        size_++;
+
+        return (static_cast<uint64_t>(node.generation) << 32) | (index + 1);
+    }
+
+
+    bool TimerWheel::cancel(TimerId id)
+    {
+        uint32_t const index = static_cast<uint32_t>(id) - 1;
+        if ((index >= nodes_.size()) or (nodes_[index].slot == NIL) or (nodes_[index].generation != (id >> 32)))
+        {
+            return false;
+        }
+
+        unlink(index);
+        release(index);
+        return true;
+    }
+
+
+    void TimerWheel::advance(uint64_t now, std::vector<uint32_t>& expired)
+    {
+        while ((current_ < now) and (size_ > 0))
+        {
+            current_++;
+
+            // Higher level slots reaching their turn are spread on lower levels, highest first.
+            uint32_t level = 0;
+            while (((level + 1) < LEVELS) and ((current_ & ((uint64_t{1} << (SLOT_BITS * (level + 1))) - 1)) == 0))
+            {
+                level++;
+            }
+            for (; level > 0; --level)
+            {
+                cascade(level);
+            }
+
+            uint32_t& slot = slots_[current_ & (SLOTS - 1)];
+            uint32_t index = slot;
+            slot = NIL;
+            while (index != NIL)
+            {
+                uint32_t const next = nodes_[index].next;
+                expired.push_back(nodes_[index].value);
+                release(index);
+                index = next;
+            }
+        }
+
+        current_ = std::max(current_, now); // nothing left to expire: jump.
+    }
+
+
+    uint64_t TimerWheel::nextExpiry() const
+    {
+        uint64_t next = UINT64_MAX;
+        if (size_ == 0)
+        {
+            return next;
+        }
+
+        // Level l slot i is reached (expired or cascaded) at the next tick whose level l index is i.
+        for (uint32_t level = 0; level < LEVELS; ++level)
+        {
+            uint32_t const shift = SLOT_BITS * level;
+            uint64_t const position = current_ >> shift;
+            for (uint64_t i = 1; i <= SLOTS; ++i)
+            {
+                if (slots_[level * SLOTS + ((position + i) & (SLOTS - 1))] != NIL)
+                {
+                    next = std::min(next, (position + i) << shift);
+                    break;
+                }
+            }
+        }
+        return next;
+    }
+
+
+    void TimerWheel::place(uint32_t index, uint64_t earliest)
+    {
+        uint64_t at = std::max(nodes_[index].expiry, earliest);
+        uint64_t const delta = at - current_;
+
+        uint32_t level = 0;
+        while ((level < LEVELS) and ((delta >> (SLOT_BITS * (level + 1))) != 0))
+        {
+            level++;
+        }
+        if (level == LEVELS)
+        {
+            // Beyond the wheel range: wait in the last level, placed again when cascaded.
+            level = LEVELS - 1;
+            at = current_ + (uint64_t{1} << (SLOT_BITS * LEVELS)) - 1;
+        }
+
+        link(index, level * SLOTS + ((at >> (SLOT_BITS * level)) & (SLOTS - 1)));
+    }
+
+
+    void TimerWheel::link(uint32_t index, uint32_t slot)
+    {
+        Node& node = nodes_[index];
+        node.slot = slot;
+        node.prev = NIL;
+        node.next = slots_[slot];
+        if (node.next != NIL)
+        {
+            nodes_[node.next].prev = index;
+        }
+        slots_[slot] = index;
+    }
+
+
+    void TimerWheel::unlink(uint32_t index)
+    {
+        Node const& node = nodes_[index];
+        if (node.prev != NIL)
+        {
+            nodes_[node.prev].next = node.next;
+        }
+        else
+        {
+            slots_[node.slot] = node.next;
+        }
+
+        if (node.next != NIL)
+        {
+            nodes_[node.next].prev = node.prev;
+        }
+    }
+
+
+    void TimerWheel::release(uint32_t index)
+    {
+        Node& node = nodes_[index];
+        node.slot = NIL;
+        node.generation++; // outstanding ids of this node become invalid.
+        node.next = free_;
+        free_ = index;
+        size_--;
+    }
+
+
+    void TimerWheel::cascade(uint32_t level)
+    {
+        uint32_t& slot = slots_[level * SLOTS + ((current_ >> (SLOT_BITS * level)) & (SLOTS - 1))];
+        uint32_t index = slot;
+        slot = NIL;
+        while (index != NIL)
+        {
+            uint32_t const next = nodes_[index].next;
+            place(index, current_); // due now: level 0 slot of the current tick, expired right after.
+            index = next;
+        }
+    }
+}
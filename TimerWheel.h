@@ -0,0 +1,77 @@
+#ifndef DBUS_TIMER_WHEEL_H
+#define DBUS_TIMER_WHEEL_H
+
+// C++
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace dbus
+{
+    // Hierarchical timer wheel: LEVELS wheels of SLOTS slots, level l slots span SLOTS^l ticks.
+    // Timers are nodes of intrusive lists (indices in a slab): add() and cancel() are O(1), advance()
+    // is O(1) per elapsed tick plus the cascade of one higher level slot every SLOTS ticks.
+    // Deadlines further than SLOTS^LEVELS ticks wait in the last level and are placed again on cascade.
+    // Time is in ticks, given by the owner (e.g. milliseconds since an epoch). Not thread safe.
+    class TimerWheel
+    {
+    public:
+        using TimerId = uint64_t; // 0 is never a valid id.
+
+        static constexpr uint32_t SLOT_BITS = 6;
+        static constexpr uint32_t SLOTS = 1U << SLOT_BITS;
+        static constexpr uint32_t LEVELS = 4;
+
+        explicit TimerWheel(uint64_t now = 0) : current_(now) { }
+
+        // Timer expiring once the wheel reaches the expiry tick (next tick if already past).
+        // value is given back by advance().
+        TimerId add(uint64_t expiry, uint32_t value);
+        bool cancel(TimerId id); // false if already expired or cancelled.
+
+        // Move to tick now, appending values of expired timers (by expiry tick) to expired.
+        void advance(uint64_t now, std::vector<uint32_t>& expired);
+
+        // Earliest tick advance() has work at: a timer expiry or the cascade of a higher level slot holding
+        // timers (UINT64_MAX if empty). Scans at most LEVELS * SLOTS slots.
+        uint64_t nextExpiry() const;
+
+        uint64_t now() const { return current_; }
+        uint32_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+
+    private:
+        static constexpr uint32_t NIL = UINT32_MAX;
+
+        struct Node
+        {
+            uint64_t expiry;
+            uint32_t value;
+            uint32_t generation;
+            uint32_t slot;  // NIL when free.
+            uint32_t prev;
+            uint32_t next;
+        };
+
+        void place(uint32_t index, uint64_t earliest);
+        void link(uint32_t index, uint32_t slot);
+        void unlink(uint32_t index);
+        void release(uint32_t index);
+        void cascade(uint32_t level);
+
+        std::vector<Node> nodes_;
+        uint32_t free_{NIL};
+        std::array<uint32_t, LEVELS * SLOTS> slots_ = make();
+        uint64_t current_;
+        uint32_t size_{0};
+
+        static std::array<uint32_t, LEVELS * SLOTS> make()
+        {
+            std::array<uint32_t, LEVELS * SLOTS> slots;
+            slots.fill(NIL);
+            return slots;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,421 @@
+// C++
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+// POSIX
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "UringTransport.h"
+
+using namespace std::chrono;
+
+
+namespace dbus
+{
+    namespace
+    {
+        constexpr uint16_t BUFFER_GROUP = 0;
+        constexpr uint32_t MAX_SENDS = UringTransport::RING_ENTRIES - 2; // room left for the receive and a cancel.
+
+        template<typename T>
+        T* at(void* base, uint32_t offset)
+        {
+            return reinterpret_cast<T*>(static_cast<uint8_t*>(base) + offset);
+        }
+    }
+
+
+    UringTransport::~UringTransport()
+    {
+        close();
+    }
+
+
+    DBusError UringTransport::open(int fd)
+    {
+        close();
+        fd_ = fd;
+
+        struct io_uring_params params{};
+        ringFd_ = syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+        if (ringFd_ < 0)
+        {
+            return ESYSTEM(errno);
+        }
+        if (not (params.features & IORING_FEAT_SINGLE_MMAP) or not (params.features & IORING_FEAT_EXT_ARG))
+        {
+            close();
+            return EERROR("io_uring: kernel too old");
+        }
+
+        // Submission and completion rings share one mapping, the submission entries have their own.
+        ringSize_ = std::max(params.sq_off.array + params.sq_entries * sizeof(uint32_t),
+                             params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe));
+        ring_ = mmap(nullptr, ringSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+        if (ring_ == MAP_FAILED)
+        {
+            int const errnum = errno;
+            ring_ = nullptr;
+            close();
+            return ESYSTEM(errnum);
+        }
+        sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+        void* sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+        {
+            int const errnum = errno;
+            close();
+            return ESYSTEM(errnum);
+        }
+        sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+        sqHead_  = at<uint32_t>(ring_, params.sq_off.head);
+        sqTail_  = at<uint32_t>(ring_, params.sq_off.tail);
+        sqArray_ = at<uint32_t>(ring_, params.sq_off.array);
+        sqMask_  = *at<uint32_t>(ring_, params.sq_off.ring_mask);
+        cqHead_  = at<uint32_t>(ring_, params.cq_off.head);
+        cqTail_  = at<uint32_t>(ring_, params.cq_off.tail);
+        cqes_    = at<struct io_uring_cqe>(ring_, params.cq_off.cqes);
+        cqMask_  = *at<uint32_t>(ring_, params.cq_off.ring_mask);
+
+        // Provided buffers: the ring (page aligned) and the buffers it points to.
+        void* memory = mmap(nullptr, BUFFERS * (sizeof(struct io_uring_buf) + BUFFER_SIZE), PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if (memory == MAP_FAILED)
+        {
+            int const errnum = errno;
+            close();
+            return ESYSTEM(errnum);
+        }
+        bufferRing_ = static_cast<struct io_uring_buf_ring*>(memory);
+        buffers_ = static_cast<uint8_t*>(memory) + BUFFERS * sizeof(struct io_uring_buf);
+
+        struct io_uring_buf_reg reg{};
+        reg.ring_addr = reinterpret_cast<uint64_t>(bufferRing_);
+        reg.ring_entries = BUFFERS;
+        reg.bgid = BUFFER_GROUP;
+        if (syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+        {
+            int const errnum = errno;
+            close();
+            return ESYSTEM(errnum);
+        }
+        for (uint16_t buffer = 0; buffer < BUFFERS; ++buffer)
+        {
+            giveBack(buffer);
+        }
+
+        postRecv();
+        return enter(toSubmit_, 0, 0ms);
+    }
+
+
+    void UringTransport::close()
+    {
+        if (ringFd_ >= 0)
+        {
+            // The kernel writes into the buffers until the receive is gone: cancel it before unmapping them.
+            if (recvPosted_ and (sqes_ != nullptr))
+            {
+                struct io_uring_sqe* sqe = nextSqe();
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->addr = RECV;
+                sqe->user_data = CANCEL;
+                for (int attempt = 0; recvPosted_ and (attempt < 10); ++attempt)
+                {
+                    enter(toSubmit_, 1, 10ms);
+                    reap();
+                }
+            }
+            ::close(ringFd_);
+            ringFd_ = -1;
+        }
+
+        if (sqes_ != nullptr)
+        {
+            munmap(sqes_, sqesSize_);
+            sqes_ = nullptr;
+        }
+        if (ring_ != nullptr)
+        {
+            munmap(ring_, ringSize_);
+            ring_ = nullptr;
+        }
+        if (bufferRing_ != nullptr)
+        {
+            munmap(bufferRing_, BUFFERS * (sizeof(struct io_uring_buf) + BUFFER_SIZE));
+            bufferRing_ = nullptr;
+            buffers_ = nullptr;
+        }
+
+        fd_ = -1;
+        toSubmit_ = 0;
+        bufferTail_ = 0;
+        recvPosted_ = false;
+        closed_ = false;
+        recvError_ = 0;
+        chunkHead_ = 0;
+        chunkCount_ = 0;
+    }
+
+
+    DBusError UringTransport::read(void* data, uint32_t size, milliseconds timeout)
+    {
+        auto const deadline = steady_clock::now() + timeout;
+        uint8_t* buffer = static_cast<uint8_t*>(data);
+        while (size > 0)
+        {
+            reap();
+            if (chunkCount_ == 0)
+            {
+                if (recvError_ != 0)
+                {
+                    return ESYSTEM(recvError_);
+                }
+                if (closed_)
+                {
+                    return EERROR("Connection closed by peer");
+                }
+                if (not recvPosted_)
+                {
+                    postRecv(); // stopped when out of buffers: all are back now.
+                }
+
+                milliseconds remaining = duration_cast<milliseconds>(deadline - steady_clock::now());
+                if (remaining < 0ms)
+                {
+                    return ECODE(ERROR_CODE::TIMEOUT, "timeout");
+                }
+                DBusError err = enter(toSubmit_, 1, remaining);
+                if (err)
+                {
+                    return err;
+                }
+                continue;
+            }
+
+            Chunk& chunk = chunks_[chunkHead_];
+            uint32_t const n = std::min(size, chunk.size);
+            std::memcpy(buffer, buffers_ + chunk.buffer * BUFFER_SIZE + chunk.offset, n);
+            buffer += n;
+            size -= n;
+            chunk.offset += n;
+            chunk.size -= n;
+            if (chunk.size == 0)
+            {
+                giveBack(chunk.buffer);
+                chunkHead_ = (chunkHead_ + 1) % BUFFERS;
+                --chunkCount_;
+            }
+        }
+        return ESUCCESS;
+    }
+
+
+    DBusError UringTransport::write(std::vector<struct iovec>& buffers, std::size_t& written, milliseconds timeout)
+    {
+        auto const deadline = steady_clock::now() + timeout;
+        while (written < buffers.size())
+        {
+            // The rest as linked sends: the kernel runs them in order, a short send breaks the link
+            // (the next ones complete with ECANCELED) and the remainder is queued again.
+            headers_.clear();
+            for (std::size_t i = written; (i < buffers.size()) and (headers_.size() < MAX_SENDS); i += IOV_MAX)
+            {
+                struct msghdr header{};
+                header.msg_iov = &buffers[i];
+                header.msg_iovlen = std::min<std::size_t>(buffers.size() - i, IOV_MAX);
+                headers_.push_back(header);
+            }
+            for (std::size_t i = 0; i < headers_.size(); ++i)
+            {
+                struct io_uring_sqe* sqe = nextSqe();
+                sqe->opcode = IORING_OP_SENDMSG;
+                sqe->fd = fd_;
+                sqe->addr = reinterpret_cast<uint64_t>(&headers_[i]);
+                sqe->len = 1;
+                sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+                sqe->flags = (i + 1 < headers_.size()) ? IOSQE_IO_LINK : 0;
+                sqe->user_data = SEND;
+            }
+            sendsPending_ = headers_.size();
+            sent_ = 0;
+            sendError_ = 0;
+
+            DBusError err;
+            while (sendsPending_ > 0)
+            {
+                milliseconds remaining = std::max(0ms, duration_cast<milliseconds>(deadline - steady_clock::now()));
+                err = enter(toSubmit_, sendsPending_, remaining);
+                reap();
+                if (err)
+                {
+                    break;
+                }
+            }
+            if (err)
+            {
+                // Headers and buffers are the caller's: wait for the cancelled sends before giving them back.
+                struct io_uring_sqe* sqe = nextSqe();
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->addr = SEND;
+                sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL;
+                sqe->user_data = CANCEL;
+                while (sendsPending_ > 0)
+                {
+                    enter(toSubmit_, sendsPending_, 100ms);
+                    reap();
+                }
+                return err;
+            }
+            if ((sendError_ != 0) and (sendError_ != ECANCELED))
+            {
+                return ESYSTEM(sendError_);
+            }
+
+            std::size_t size = sent_;
+            while ((written < buffers.size()) and (size >= buffers[written].iov_len))
+            {
+                size -= buffers[written].iov_len;
+                ++written;
+            }
+            if (size > 0)
+            {
+                buffers[written].iov_base = static_cast<uint8_t*>(buffers[written].iov_base) + size;
+                buffers[written].iov_len -= size;
+            }
+        }
+        return ESUCCESS;
+    }
+
+
+    struct io_uring_sqe* UringTransport::nextSqe()
+    {
+        // Entries are consumed by io_uring_enter() (no submission thread): the queue only fills up with
+        // entries not submitted yet, kept below RING_ENTRIES by the callers.
+        uint32_t const tail = *sqTail_;
+        uint32_t const index = tail & sqMask_;
+        struct io_uring_sqe* sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqArray_[index] = index;
+        __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+        ++toSubmit_;
+        return sqe;
+    }
+
+
+    DBusError UringTransport::enter(uint32_t submit, uint32_t wait, milliseconds timeout)
+    {
+        struct __kernel_timespec ts{};
+        ts.tv_sec = timeout.count() / 1000;
+        ts.tv_nsec = (timeout.count() % 1000) * 1000000;
+        struct io_uring_getevents_arg arg{};
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+
+        uint32_t const flags = IORING_ENTER_EXT_ARG | ((wait > 0) ? IORING_ENTER_GETEVENTS : 0);
+        long rc = syscall(__NR_io_uring_enter, ringFd_, submit, wait, flags, &arg, sizeof(arg));
+        ++enters_;
+        if (rc >= 0)
+        {
+            toSubmit_ -= std::min<uint32_t>(rc, toSubmit_);
+            return ESUCCESS;
+        }
+
+        switch (errno)
+        {
+            case ETIME: { return ECODE(ERROR_CODE::TIMEOUT, "timeout"); }
+            case EINTR:
+            case EBUSY: { return ESUCCESS; } // completions to reap first.
+            default:    { return ESYSTEM(errno); }
+        }
+    }
+
+
+    void UringTransport::postRecv()
+    {
+        struct io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = fd_;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUFFER_GROUP;
+        sqe->user_data = RECV;
+        recvPosted_ = true;
+    }
+
+
+    void UringTransport::reap()
+    {
+        uint32_t head = *cqHead_;
+        uint32_t const tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head)
+        {
+            struct io_uring_cqe const& cqe = cqes_[head & cqMask_];
+            switch (cqe.user_data)
+            {
+                case RECV:
+                {
+                    if (not (cqe.flags & IORING_CQE_F_MORE))
+                    {
+                        recvPosted_ = false;
+                    }
+
+                    uint16_t const buffer = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+                    if (cqe.res > 0)
+                    {
+                        chunks_[(chunkHead_ + chunkCount_) % BUFFERS] = {buffer, 0, static_cast<uint32_t>(cqe.res)};
+                        ++chunkCount_;
+                        break;
+                    }
+                    if (cqe.flags & IORING_CQE_F_BUFFER)
+                    {
+                        giveBack(buffer);
+                    }
+                    if (cqe.res == 0)
+                    {
+                        closed_ = true;
+                    }
+                    else if ((cqe.res != -ENOBUFS) and (cqe.res != -ECANCELED))
+                    {
+                        recvError_ = -cqe.res;
+                    }
+                    break;
+                }
+                case SEND:
+                {
+                    --sendsPending_;
+                    if (cqe.res >= 0)
+                    {
+                        sent_ += cqe.res;
+                    }
+                    else if (sendError_ == 0)
+                    {
+                        sendError_ = -cqe.res;
+                    }
+                    break;
+                }
+                default:
+                {
+                    break; // cancel requests.
+                }
+            }
+        }
+        __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+    }
+
+
+    void UringTransport::giveBack(uint16_t buffer)
+    {
+        struct io_uring_buf& entry = reinterpret_cast<struct io_uring_buf*>(bufferRing_)[bufferTail_ & (BUFFERS - 1)];
+        entry.addr = reinterpret_cast<uint64_t>(buffers_ + buffer * BUFFER_SIZE);
+        entry.len = BUFFER_SIZE;
+        entry.bid = buffer;
+        ++bufferTail_;
+        __atomic_store_n(&bufferRing_->tail, bufferTail_, __ATOMIC_RELEASE);
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef DBUS_URING_TRANSPORT_H
+#define DBUS_URING_TRANSPORT_H
+
+// C++
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// POSIX
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "DBusError.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf_ring;
+
+namespace dbus
+{
+    // io_uring I/O on a connected stream socket (raw syscalls, no liburing), compiled with DBUS_ENABLE_IO_URING
+    // (CMake option ENABLE_IO_URING).
+    //
+    // Receive: one multishot recv stays posted, the kernel fills buffers of a registered provided buffer ring as
+    // data comes and posts a completion per chunk. read() copies from these chunks and gives the buffers back:
+    // while completions are queued, reading takes no syscall at all.
+    // Send: write() submits the buffers as linked sendmsg() (MSG_WAITALL, IOV_MAX buffers each) and waits for
+    // them with a single io_uring_enter().
+    //
+    // Not thread safe: used by the connection owner only.
+    class UringTransport
+    {
+    public:
+        static constexpr uint32_t RING_ENTRIES = 64;       // submission queue (completion queue: twice).
+        static constexpr uint32_t BUFFERS = 64;            // provided buffers, power of two.
+        static constexpr uint32_t BUFFER_SIZE = 16 * 1024;
+
+        UringTransport() = default;
+        ~UringTransport();
+
+        UringTransport(UringTransport const&) = delete;
+        UringTransport& operator=(UringTransport const&) = delete;
+
+        // Set up the rings on fd (not owned) and post the receive. Fails on kernels without io_uring,
+        // provided buffer rings or extended enter arguments (before 5.19).
+        DBusError open(int fd);
+        void close();
+        bool isOpen() const { return ringFd_ >= 0; }
+
+        // Readable (POLLIN) while completions are queued: poll it instead of the socket, which the
+        // posted receive keeps empty. Check buffered() first: data already taken from the completions
+        // does not wake it up.
+        int pollFd() const { return ringFd_; }
+        bool buffered() const { return chunkCount_ > 0; }
+
+        DBusError read(void* data, uint32_t size, std::chrono::milliseconds timeout);
+
+        // Write the buffers from written (buffers fully written, updated) on. A partially written buffer is advanced.
+        DBusError write(std::vector<struct iovec>& buffers, std::size_t& written, std::chrono::milliseconds timeout);
+
+        uint64_t enters() const { return enters_; } // io_uring_enter() calls.
+
+    private:
+        enum TAG : uint64_t
+        {
+            RECV = 1,
+            SEND,
+            CANCEL,
+        };
+
+        struct Chunk
+        {
+            uint16_t buffer;
+            uint32_t offset;
+            uint32_t size;
+        };
+
+        io_uring_sqe* nextSqe();
+        DBusError enter(uint32_t submit, uint32_t wait, std::chrono::milliseconds timeout);
+        void postRecv();
+        void reap(); // process the queued completions.
+        void giveBack(uint16_t buffer);
+
+        int fd_{-1};
+        int ringFd_{-1};
+        uint64_t enters_{0};
+
+        // Rings (shared with the kernel).
+        void* ring_{nullptr};
+        std::size_t ringSize_{0};
+        io_uring_sqe* sqes_{nullptr};
+        std::size_t sqesSize_{0};
+        uint32_t* sqHead_{nullptr};
+        uint32_t* sqTail_{nullptr};
+        uint32_t* sqArray_{nullptr};
+        uint32_t sqMask_{0};
+        uint32_t toSubmit_{0};
+        uint32_t* cqHead_{nullptr};
+        uint32_t* cqTail_{nullptr};
+        io_uring_cqe* cqes_{nullptr};
+        uint32_t cqMask_{0};
+
+        // Provided buffers.
+        io_uring_buf_ring* bufferRing_{nullptr};
+        uint8_t* buffers_{nullptr}; // BUFFERS * BUFFER_SIZE.
+        uint16_t bufferTail_{0};
+        bool recvPosted_{false};
+        bool closed_{false};        // end of stream.
+        int recvError_{0};          // errno of a failed receive.
+
+        // Received chunks, in order, not consumed yet.
+        std::array<Chunk, BUFFERS> chunks_;
+        uint32_t chunkHead_{0};
+        uint32_t chunkCount_{0};
+
+        // Sends in flight.
+        std::vector<struct msghdr> headers_;
+        uint32_t sendsPending_{0};
+        std::size_t sent_{0};       // bytes.
+        int sendError_{0};          // first send failure (ECANCELED: link broken by a short send).
+    };
+}
+
+#endif
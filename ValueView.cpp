@@ -0,0 +1,83 @@
+#include "ValueView.h"
+#include "SignatureProgram.h"
+
+namespace dbus
+{
+    DBUS_TYPE ValueView::type() const
+    {
+        if (signature_.empty())
+        {
+            return DBUS_TYPE::UNKNOWN;
+        }
+        return static_cast<DBUS_TYPE>(signature_[0]);
+    }
+
+
+    bool ValueView::isDict() const
+    {
+        return (signature_.size() > 2) and (type() == DBUS_TYPE::ARRAY) and
+               (static_cast<DBUS_TYPE>(signature_[1]) == DBUS_TYPE::DICT_BEGIN);
+    }
+
+
+    DBusError ValueView::get(std::string_view& value) const
+    {
+        DBUS_TYPE const value_type = type();
+        if ((value_type != DBUS_TYPE::STRING) and (value_type != DBUS_TYPE::PATH) and (value_type != DBUS_TYPE::SIGNATURE))
+        {
+            return EERROR("Wrong signature: expected a string, got '" + std::string(signature_) + "'");
+        }
+
+        uint32_t position = position_;
+        return SignatureProgram::text(value_type, body_, size_, position, value);
+    }
+
+
+    DBusError ValueView::decode(DBusVariant& value) const
+    {
+        uint32_t position = position_;
+        return SignatureProgram::decodeValue(signature_, body_, size_, position, value);
+    }
+
+
+    DBusError ValueView::copy(Buffer& out) const
+    {
+        uint32_t position = position_;
+        return SignatureProgram::copy(signature_, body_, size_, position, out);
+    }
+
+
+    DBusError ValueView::end(uint32_t& position) const
+    {
+        position = position_;
+        return SignatureProgram::skip(signature_, body_, size_, position);
+    }
+
+
+    DBusError ValueView::elements(uint32_t& position, uint32_t& limit) const
+    {
+        if ((type() != DBUS_TYPE::ARRAY) or (signature_.size() < 2))
+        {
+            return EERROR("Wrong signature: expected an array, got '" + std::string(signature_) + "'");
+        }
+
+        DBusError err = end(limit); // checks the array bounds.
+        if (err)
+        {
+            return err;
+        }
+
+        position = position_;
+        align(position, 4);
+        position += sizeof(uint32_t);
+        align(position, alignment(static_cast<DBUS_TYPE>(signature_[1])));
+        return ESUCCESS;
+    }
+
+
+    DBusError ValueView::fixed(void* value) const
+    {
+        uint32_t position = position_;
+        return SignatureProgram::fixed(type(), body_, size_, position, value);
+    }
+}
@@ -0,0 +1,175 @@
+#ifndef DBUS_VALUE_VIEW_H
+#define DBUS_VALUE_VIEW_H
+
+// C++
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "DBusError.h"
+#include "DBusVariant.h"
+#include "helpers.h"
+
+namespace dbus
+{
+    // One value of a message body, read in place and decoded only on demand. Arrays and dicts are walked one
+    // element at a time with forEach(), in constant memory: huge replies (i.e. GetManagedObjects) can be
+    // filtered and aggregated in one pass, decoding only the values that are looked at.
+    //
+    // A view is valid as long as the message it comes from is alive and its body unchanged.
+    class ValueView
+    {
+    public:
+        ValueView() = default;
+        ValueView(uint8_t const* body, uint32_t size, uint32_t position, std::string_view signature)
+            : body_(body)
+            , size_(size)
+            , position_(position)
+            , signature_(signature)
+        { }
+
+        std::string_view signature() const { return signature_; } // a single complete type.
+        DBUS_TYPE type() const;
+        bool isDict() const;
+
+        // Basic types, and DBusVariant for variants (their content).
+        template<typename T>
+        DBusError get(T& value) const;
+
+        // Strings, object paths and signatures without copy.
+        DBusError get(std::string_view& value) const;
+
+        // Any type, as a DBusVariant tree (see SignatureProgram).
+        DBusError decode(DBusVariant& value) const;
+
+        // Arrays: visitor(ValueView const& element), dicts: visitor(ValueView const& key, ValueView const& value)
+        // (a one argument visitor walks a dict as an array of dict entries). The visitor returns false to stop early.
+        template<typename F>
+        DBusError forEach(F&& visitor) const;
+
+        // Append the value to out, a body being built, re-aligned to its offset there (see SignatureProgram::copy()).
+        DBusError copy(Buffer& out) const;
+
+        // Position in the body right after the value (nothing is decoded).
+        DBusError end(uint32_t& position) const;
+
+    private:
+        DBusError elements(uint32_t& position, uint32_t& limit) const; // first element and end of an array.
+        DBusError fixed(void* value) const;
+
+        uint8_t const* body_{nullptr};
+        uint32_t size_{0};     // readable bytes of body_ (the enclosing array end for elements).
+        uint32_t position_{0}; // unaligned: the value starts at the next multiple of its alignment.
+        std::string_view signature_;
+    };
+
+
+    template<typename T>
+    DBusError ValueView::get(T& value) const
+    {
+        constexpr DBUS_TYPE expected = dbusType<T>();
+        static_assert((expected != DBUS_TYPE::UNKNOWN) and (expected != DBUS_TYPE::ARRAY), "Invalid DBus basic type");
+
+        if (type() != expected)
+        {
+            return EERROR("Wrong signature: expected '" + prettyStr(expected) + "', got '" + std::string(signature_) + "'");
+        }
+
+        if constexpr (std::is_arithmetic_v<T>)
+        {
+            return fixed(&value);
+        }
+        else if constexpr (std::is_same_v<T, DBusVariant>)
+        {
+            return decode(value);
+        }
+        else
+        {
+            std::string_view text;
+            DBusError err = get(text);
+            if (err)
+            {
+                return err;
+            }
+
+            if constexpr (std::is_same_v<T, ObjectPath>)
+            {
+                value.setData(std::string(text));
+            }
+            else
+            {
+                value.assign(text.data(), text.size());
+            }
+            return ESUCCESS;
+        }
+    }
+
+
+    template<typename F>
+    DBusError ValueView::forEach(F&& visitor) const
+    {
+        uint32_t position;
+        uint32_t limit;
+        DBusError err = elements(position, limit);
+        if (err)
+        {
+            return err;
+        }
+
+        std::string_view const element = signature_.substr(1);
+        if constexpr (std::is_invocable_v<F&, ValueView const&, ValueView const&>)
+        {
+            if (not isDict())
+            {
+                return EERROR("Wrong signature: expected a dict, got '" + std::string(signature_) + "'");
+            }
+
+            std::string_view const key = element.substr(1, 1);
+            std::string_view const value = element.substr(2, element.size() - 3);
+            while (position < limit)
+            {
+                align(position, 8); // dict entries are aligned on 8 bytes.
+                ValueView const key_view{body_, limit, position, key};
+                err = key_view.end(position);
+                if (err)
+                {
+                    return err;
+                }
+
+                ValueView const value_view{body_, limit, position, value};
+                err = value_view.end(position);
+                if (err)
+                {
+                    return err;
+                }
+
+                if (not visitor(key_view, value_view))
+                {
+                    break;
+                }
+            }
+        }
+        else
+        {
+            uint32_t const element_alignment = alignment(static_cast<DBUS_TYPE>(element[0]));
+            while (position < limit)
+            {
+                align(position, element_alignment);
+                ValueView const element_view{body_, limit, position, element};
+                err = element_view.end(position);
+                if (err)
+                {
+                    return err;
+                }
+
+                if (not visitor(element_view))
+                {
+                    break;
+                }
+            }
+        }
+        return ESUCCESS;
+    }
+}
+
+#endif
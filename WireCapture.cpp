@@ -0,0 +1,283 @@
+// C++
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+// POSIX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "WireCapture.h"
+
+namespace dbus
+{
+    using namespace std::chrono;
+
+    namespace
+    {
+        constexpr uint64_t RECORD_ALIGNMENT = 8;
+        constexpr uint64_t MIN_FILE_SIZE = 1024 * 1024;
+
+        uint64_t aligned(uint64_t size)
+        {
+            return (size + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+        }
+    }
+
+
+    WireCapture::~WireCapture()
+    {
+        close();
+    }
+
+
+    DBusError WireCapture::open(std::string const& path, uint32_t ring_size)
+    {
+        if ((ring_size == 0) or (ring_size & (ring_size - 1)))
+        {
+            return EERROR("Ring size shall be a power of two");
+        }
+
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd_ < 0)
+        {
+            return ESYSTEM(errno);
+        }
+
+        if (not reserveFile(std::max<uint64_t>(MIN_FILE_SIZE, ring_size)))
+        {
+            DBusError err = ESYSTEM(errno);
+            close();
+            return err;
+        }
+
+        trace::FileHeader header{};
+        std::memcpy(header.magic, trace::MAGIC, sizeof(header.magic));
+        header.version = trace::VERSION;
+        header.start = duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+        std::memcpy(map_, &header, sizeof(trace::FileHeader));
+        fileSize_ = sizeof(trace::FileHeader);
+
+        ring_.resize(ring_size);
+        mask_ = ring_size - 1;
+        head_ = 0;
+        tail_ = 0;
+        start_ = duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+
+        running_ = true;
+        flusher_ = std::thread(&WireCapture::flushLoop, this);
+        return ESUCCESS;
+    }
+
+
+    void WireCapture::close()
+    {
+        if (running_.exchange(false))
+        {
+            flusher_.join();
+        }
+
+        if (map_ != nullptr)
+        {
+            flush(); // last records.
+            munmap(map_, mapSize_);
+            map_ = nullptr;
+            mapSize_ = 0;
+        }
+
+        if (fd_ >= 0)
+        {
+            (void) ftruncate(fd_, fileSize_); // drop preallocated space.
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+
+    void WireCapture::record(trace::DIRECTION direction,
+                             uint8_t const* data, uint32_t size,
+                             uint8_t const* extra, uint32_t extra_size)
+    {
+        uint64_t const total = aligned(sizeof(trace::RecordHeader) + size + extra_size);
+        uint64_t const head = head_.load(std::memory_order_relaxed);
+        uint64_t const tail = tail_.load(std::memory_order_acquire);
+        if (total > (ring_.size() - (head - tail)))
+        {
+            dropped_.add();
+            return;
+        }
+
+        trace::RecordHeader header{};
+        header.timestamp = duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count() - start_;
+        header.size = size + extra_size;
+        header.direction = direction;
+
+        put(head, &header, sizeof(trace::RecordHeader));
+        put(head + sizeof(trace::RecordHeader), data, size);
+        if (extra_size)
+        {
+            put(head + sizeof(trace::RecordHeader) + size, extra, extra_size);
+        }
+
+        head_.store(head + total, std::memory_order_release);
+        captured_.add();
+    }
+
+
+    void WireCapture::put(uint64_t position, void const* data, uint32_t size)
+    {
+        uint8_t const* src = reinterpret_cast<uint8_t const*>(data);
+        uint64_t const offset = position & mask_;
+        uint64_t const first = std::min<uint64_t>(size, ring_.size() - offset);
+
+        std::memcpy(ring_.data() + offset, src, first);
+        std::memcpy(ring_.data(), src + first, size - first); // wrap around.
+    }
+
+
+    void WireCapture::flushLoop()
+    {
+        while (running_)
+        {
+            flush();
+            std::this_thread::sleep_for(1ms);
+        }
+    }
+
+
+    void WireCapture::flush()
+    {
+        uint64_t const head = head_.load(std::memory_order_acquire);
+        uint64_t const tail = tail_.load(std::memory_order_relaxed);
+        uint64_t const size = head - tail;
+        if (size == 0)
+        {
+            return;
+        }
+
+        if (not reserveFile(fileSize_ + size))
+        {
+            tail_.store(head, std::memory_order_release); // cannot write: drop.
+            return;
+        }
+
+        uint64_t const offset = tail & mask_;
+        uint64_t const first = std::min<uint64_t>(size, ring_.size() - offset);
+        std::memcpy(map_ + fileSize_, ring_.data() + offset, first);
+        std::memcpy(map_ + fileSize_ + first, ring_.data(), size - first);
+        fileSize_ += size;
+
+        tail_.store(head, std::memory_order_release);
+    }
+
+
+    bool WireCapture::reserveFile(uint64_t size)
+    {
+        if (size <= mapSize_)
+        {
+            return true;
+        }
+
+        uint64_t const new_size = std::max(size, mapSize_ * 2);
+        if (ftruncate(fd_, new_size) < 0)
+        {
+            return false;
+        }
+
+        void* map;
+        if (map_ == nullptr)
+        {
+            map = mmap(nullptr, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        }
+        else
+        {
+            map = mremap(map_, mapSize_, new_size, MREMAP_MAYMOVE);
+        }
+
+        if (map == MAP_FAILED)
+        {
+            return false;
+        }
+
+        map_ = reinterpret_cast<uint8_t*>(map);
+        mapSize_ = new_size;
+        return true;
+    }
+
+
+    TraceReader::~TraceReader()
+    {
+        if (map_ != nullptr)
+        {
+            munmap(const_cast<uint8_t*>(map_), size_);
+        }
+    }
+
+
+    DBusError TraceReader::open(std::string const& path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return ESYSTEM(errno);
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) < 0)
+        {
+            DBusError err = ESYSTEM(errno);
+            ::close(fd);
+            return err;
+        }
+
+        if (static_cast<uint64_t>(info.st_size) < sizeof(trace::FileHeader))
+        {
+            ::close(fd);
+            return EERROR("Not a trace file: " + path);
+        }
+
+        void* map = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED)
+        {
+            return ESYSTEM(errno);
+        }
+        madvise(map, info.st_size, MADV_SEQUENTIAL);
+
+        map_ = reinterpret_cast<uint8_t const*>(map);
+        size_ = info.st_size;
+        if ((std::memcmp(header().magic, trace::MAGIC, sizeof(trace::MAGIC)) != 0) or (header().version != trace::VERSION))
+        {
+            return EERROR("Not a trace file (or unsupported version): " + path);
+        }
+
+        rewind();
+        return ESUCCESS;
+    }
+
+
+    bool TraceReader::next(Record& record)
+    {
+        if ((position_ + sizeof(trace::RecordHeader)) > size_)
+        {
+            return false;
+        }
+
+        trace::RecordHeader header;
+        std::memcpy(&header, map_ + position_, sizeof(trace::RecordHeader));
+        if ((position_ + sizeof(trace::RecordHeader) + header.size) > size_)
+        {
+            return false; // truncated record.
+        }
+
+        record.timestamp = header.timestamp;
+        record.direction = header.direction;
+        record.data = map_ + position_ + sizeof(trace::RecordHeader);
+        record.size = header.size;
+
+        position_ += aligned(sizeof(trace::RecordHeader) + header.size);
+        return true;
+    }
+}
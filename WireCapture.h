@@ -0,0 +1,125 @@
+#ifndef DBUS_WIRE_CAPTURE_H
+#define DBUS_WIRE_CAPTURE_H
+
+// C++
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "DBusError.h"
+#include "DBusMetrics.h"
+
+namespace dbus
+{
+    // Trace file layout: a FileHeader followed by records. Each record is a RecordHeader followed by
+    // the raw wire frame, padded to 8 bytes.
+    namespace trace
+    {
+        enum class DIRECTION : uint8_t
+        {
+            IN  = 0,
+            OUT = 1
+        };
+
+        struct FileHeader
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t reserved;
+            uint64_t start;     // capture start, ns since epoch (system clock). Records are relative to it.
+        };
+
+        struct RecordHeader
+        {
+            uint64_t timestamp; // ns since capture start.
+            uint32_t size;      // frame size (without padding).
+            DIRECTION direction;
+            uint8_t reserved[3];
+        };
+
+        constexpr char const MAGIC[8] = {'T', 'D', 'B', 'U', 'S', 'C', 'A', 'P'};
+        constexpr uint32_t VERSION = 1;
+    }
+
+
+    // Capture sent and received frames to a trace file.
+    // The I/O path (single producer) only copies frames into a lock-free ring; a background thread
+    // drains the ring into the mmap'd trace file. When the ring is full frames are dropped (and counted):
+    // capture never blocks the connection.
+    class WireCapture
+    {
+    public:
+        WireCapture() = default;
+        ~WireCapture();
+
+        WireCapture(WireCapture const&) = delete;
+        WireCapture& operator=(WireCapture const&) = delete;
+
+        DBusError open(std::string const& path, uint32_t ring_size = 4 * 1024 * 1024); // ring_size: power of two.
+        void close();
+
+        // A frame may be given in two parts (i.e. header and body buffers).
+        void record(trace::DIRECTION direction,
+                    uint8_t const* data, uint32_t size,
+                    uint8_t const* extra = nullptr, uint32_t extra_size = 0);
+
+        uint64_t captured() const { return captured_.get(); }
+        uint64_t dropped() const  { return dropped_.get();  }
+
+    private:
+        void put(uint64_t position, void const* data, uint32_t size);
+        void flushLoop();
+        void flush();
+        bool reserveFile(uint64_t size);
+
+        std::vector<uint8_t> ring_;
+        uint64_t mask_{0};
+        alignas(64) std::atomic<uint64_t> head_{0}; // written by producer.
+        alignas(64) std::atomic<uint64_t> tail_{0}; // written by flusher.
+
+        int64_t start_{0}; // steady clock ns.
+        int fd_{-1};
+        uint8_t* map_{nullptr};
+        uint64_t mapSize_{0};
+        uint64_t fileSize_{0};
+
+        std::atomic<bool> running_{false};
+        std::thread flusher_;
+
+        Counter captured_;
+        Counter dropped_;
+    };
+
+
+    // Sequential reader of a trace file (mmap'd, zero copy).
+    class TraceReader
+    {
+    public:
+        struct Record
+        {
+            uint64_t timestamp;
+            trace::DIRECTION direction;
+            uint8_t const* data;
+            uint32_t size;
+        };
+
+        TraceReader() = default;
+        ~TraceReader();
+
+        TraceReader(TraceReader const&) = delete;
+        TraceReader& operator=(TraceReader const&) = delete;
+
+        DBusError open(std::string const& path);
+        bool next(Record& record);
+        void rewind() { position_ = sizeof(trace::FileHeader); }
+
+        trace::FileHeader const& header() const { return *reinterpret_cast<trace::FileHeader const*>(map_); }
+
+    private:
+        uint8_t const* map_{nullptr};
+        uint64_t size_{0};
+        uint64_t position_{0};
+    };
+}
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef DBUS_BENCH_ALLOC_H
+#define DBUS_BENCH_ALLOC_H
+
+// C++
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Global operator new / delete replacement for the benchmarks counting heap allocations: included by the one
+// translation unit of the benchmark, which defines the hooks below.
+//
+// Every replaceable form goes through malloc() / free(), and none is inlined: callers only see operator new
+// paired with operator delete (inlining one side alone raises -Wmismatched-new-delete in optimized builds).
+namespace bench
+{
+    void onAllocate(void* ptr, std::size_t size); // successful allocations, size as asked for.
+    void onRelease(void* ptr);                    // before free(), never null.
+}
+
+
+namespace
+{
+    __attribute__((noinline)) void* allocate(std::size_t size, std::size_t alignment)
+    {
+        size = std::max<std::size_t>(size, 1);
+        void* ptr = (alignment <= alignof(std::max_align_t))
+            ? std::malloc(size)
+            : std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+        if (ptr != nullptr)
+        {
+            bench::onAllocate(ptr, size);
+        }
+        return ptr;
+    }
+
+    __attribute__((noinline)) void* allocateOrThrow(std::size_t size, std::size_t alignment)
+    {
+        void* ptr = allocate(size, alignment);
+        if (ptr == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        return ptr;
+    }
+
+    __attribute__((noinline)) void release(void* ptr)
+    {
+        if (ptr != nullptr)
+        {
+            bench::onRelease(ptr);
+            std::free(ptr);
+        }
+    }
+}
+
+
+__attribute__((noinline)) void* operator new(std::size_t size)
+{
+    return allocateOrThrow(size, alignof(std::max_align_t));
+}
+
+__attribute__((noinline)) void* operator new[](std::size_t size)
+{
+    return allocateOrThrow(size, alignof(std::max_align_t));
+}
+
+__attribute__((noinline)) void* operator new(std::size_t size, std::nothrow_t const&) noexcept
+{
+    return allocate(size, alignof(std::max_align_t));
+}
+
+__attribute__((noinline)) void* operator new[](std::size_t size, std::nothrow_t const&) noexcept
+{
+    return allocate(size, alignof(std::max_align_t));
+}
+
+__attribute__((noinline)) void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    return allocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+__attribute__((noinline)) void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return allocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+__attribute__((noinline)) void* operator new(std::size_t size, std::align_val_t alignment, std::nothrow_t const&) noexcept
+{
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+__attribute__((noinline)) void* operator new[](std::size_t size, std::align_val_t alignment, std::nothrow_t const&) noexcept
+{
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+
+__attribute__((noinline)) void operator delete(void* ptr) noexcept                          { release(ptr); }
+__attribute__((noinline)) void operator delete[](void* ptr) noexcept                        { release(ptr); }
+__attribute__((noinline)) void operator delete(void* ptr, std::size_t) noexcept             { release(ptr); }
+__attribute__((noinline)) void operator delete[](void* ptr, std::size_t) noexcept           { release(ptr); }
+__attribute__((noinline)) void operator delete(void* ptr, std::nothrow_t const&) noexcept   { release(ptr); }
+__attribute__((noinline)) void operator delete[](void* ptr, std::nothrow_t const&) noexcept { release(ptr); }
+__attribute__((noinline)) void operator delete(void* ptr, std::align_val_t) noexcept        { release(ptr); }
+__attribute__((noinline)) void operator delete[](void* ptr, std::align_val_t) noexcept      { release(ptr); }
+__attribute__((noinline)) void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept   { release(ptr); }
+__attribute__((noinline)) void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { release(ptr); }
+__attribute__((noinline)) void operator delete(void* ptr, std::align_val_t, std::nothrow_t const&) noexcept   { release(ptr); }
+__attribute__((noinline)) void operator delete[](void* ptr, std::align_val_t, std::nothrow_t const&) noexcept { release(ptr); }
+
+#endif
@@ -0,0 +1,140 @@
+// Pipelined calls benchmark: GetAll() on every object of two services (i.e. block devices), as sequential
+// round trips then as one callBatch(). Calls alternate between the services, so replies come back
+// interleaved and are gathered out of order. Each reply is checked against its call.
+//
+// usage: bench_batch [--objects N] [--rounds N]
+
+// C++
+#include <atomic>
+#include <thread>
+
+#include "bench.h"
+
+using namespace dbus;
+
+namespace
+{
+    std::string const INTERFACE = "bench.Block";
+    std::string const PROPERTIES = "org.freedesktop.DBus.Properties";
+
+    // GetAll() of /bench/block/<index>: Index (u), Device (s), Size (t).
+    void blockService(DBusConnection& service, std::atomic<bool>& running)
+    {
+        while (running)
+        {
+            DBusMessage call;
+            if (service.recv(call, 100ms) or not call.isCall())
+            {
+                continue;
+            }
+
+            std::string const& path = call.path().data();
+            uint32_t const index = std::stoul(path.substr(path.rfind('/') + 1));
+            std::unordered_map<std::string, DBusVariant> properties;
+            properties["Index"] = index;
+            properties["Device"] = "/dev/bench" + std::to_string(index);
+            properties["Size"] = uint64_t{index} << 20;
+
+            DBusMessage reply;
+            reply.prepareReply(call);
+            reply.addArgument(properties);
+            service.send(std::move(reply));
+        }
+    }
+
+    DBusMessage getAll(std::string const& service, uint32_t index)
+    {
+        DBusMessage call;
+        call.prepareCall(service, "/bench/block/" + std::to_string(index), PROPERTIES, "GetAll");
+        call.addArgument(INTERFACE);
+        return call;
+    }
+
+    bool check(DBusMessage& reply, uint32_t index)
+    {
+        std::unordered_map<std::string, DBusVariant> properties;
+        return not reply.extractArgument(properties) and (properties["Index"].get<uint32_t>() == index);
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    bench::Options options(argc, argv);
+    uint32_t const objects = options.get("objects", 500);
+    uint64_t const rounds  = options.get("rounds", 10);
+
+    LoopbackBus bus;
+    DBusError err = bus.start();
+    DBusConnection services[2];
+    DBusConnection client;
+    for (auto& service : services)
+    {
+        if (not err)
+        {
+            err = bench::connectLoopback(bus, service, "pair");
+        }
+    }
+    if (not err)
+    {
+        err = bench::connectLoopback(bus, client, "pair");
+    }
+    if (err)
+    {
+        err.what();
+        return 1;
+    }
+
+    std::atomic<bool> running{true};
+    std::thread threads[2] = {std::thread([&]() { blockService(services[0], running); }),
+                              std::thread([&]() { blockService(services[1], running); })};
+
+    //-------- sequential round trips --------//
+    uint64_t failures = 0;
+    auto start = steady_clock::now();
+    for (uint64_t round = 0; round < rounds; ++round)
+    {
+        for (uint32_t i = 0; i < objects; ++i)
+        {
+            DBusMessage reply;
+            failures += client.call(getAll(services[i % 2].name(), i), reply, 1000ms) or not check(reply, i);
+        }
+    }
+    nanoseconds const sequential = steady_clock::now() - start;
+
+    //-------- batches --------//
+    std::vector<DBusMessage> calls;
+    std::vector<DBusConnection::BatchResult> results;
+    start = steady_clock::now();
+    for (uint64_t round = 0; round < rounds; ++round)
+    {
+        calls.clear();
+        for (uint32_t i = 0; i < objects; ++i)
+        {
+            calls.push_back(getAll(services[i % 2].name(), i));
+        }
+
+        err = client.callBatch(calls, results, 5000ms);
+        if (err)
+        {
+            err.what();
+        }
+        for (uint32_t i = 0; i < objects; ++i)
+        {
+            failures += results[i].error or not check(results[i].reply, i);
+        }
+    }
+    nanoseconds const batched = steady_clock::now() - start;
+
+    running = false;
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    std::cout << std::fixed << std::setprecision(1)
+              << objects << " GetAll() per round, " << rounds << " rounds, failures: " << failures << std::endl
+              << "sequential: " << duration_cast<microseconds>(sequential).count() / double(rounds) / 1000.0 << " ms/round" << std::endl
+              << "batch:      " << duration_cast<microseconds>(batched).count() / double(rounds) / 1000.0 << " ms/round" << std::endl;
+    return 0;
+}
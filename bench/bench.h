@@ -0,0 +1,145 @@
+#ifndef DBUS_BENCH_H
+#define DBUS_BENCH_H
+
+// C++
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "DBusConnection.h"
+#include "LoopbackBus.h"
+
+// Small helpers shared by the benchmarks.
+namespace bench
+{
+    using namespace std::chrono;
+
+    // Parse "--key value" pairs.
+    class Options
+    {
+    public:
+        Options(int argc, char** argv)
+        {
+            for (int i = 1; (i + 1) < argc; i += 2)
+            {
+                std::string key{argv[i]};
+                if (key.compare(0, 2, "--") == 0)
+                {
+                    values_[key.substr(2)] = argv[i + 1];
+                }
+            }
+        }
+
+        uint64_t get(std::string const& key, uint64_t defaultValue) const
+        {
+            auto it = values_.find(key);
+            return (it == values_.end()) ? defaultValue : std::strtoull(it->second.c_str(), nullptr, 10);
+        }
+
+        std::string get(std::string const& key, std::string const& defaultValue) const
+        {
+            auto it = values_.find(key);
+            return (it == values_.end()) ? defaultValue : it->second;
+        }
+
+    private:
+        std::unordered_map<std::string, std::string> values_;
+    };
+
+
+    // Latency samples in nanoseconds.
+    class Latencies
+    {
+    public:
+        void reserve(std::size_t count)      { samples_.reserve(count); }
+        void add(nanoseconds latency)        { samples_.push_back(latency.count()); }
+        void merge(Latencies const& other)   { samples_.insert(samples_.end(), other.samples_.begin(), other.samples_.end()); }
+        std::size_t size() const             { return samples_.size(); }
+
+        // q in [0, 1]
+        double percentileUs(double q)
+        {
+            if (samples_.empty())
+            {
+                return 0.0;
+            }
+            std::size_t rank = static_cast<std::size_t>(q * (samples_.size() - 1));
+            std::nth_element(samples_.begin(), samples_.begin() + rank, samples_.end());
+            return samples_[rank] / 1000.0;
+        }
+
+        void print(std::string const& label)
+        {
+            std::cout << std::fixed << std::setprecision(1)
+                      << label << " latency (us)"
+                      << "  p50: "  << percentileUs(0.50)
+                      << "  p99: "  << percentileUs(0.99)
+                      << "  p999: " << percentileUs(0.999)
+                      << "  max: "  << percentileUs(1.0)
+                      << std::endl;
+        }
+
+    private:
+        std::vector<int64_t> samples_;
+    };
+
+
+    // Connect to the loopback bus either through a socketpair ("pair") or the socket it listens on.
+    inline dbus::DBusError connectLoopback(dbus::LoopbackBus& bus, dbus::DBusConnection& connection, std::string const& transport)
+    {
+        if (transport != "pair")
+        {
+            return connection.connect(bus.address());
+        }
+
+        int fd;
+        dbus::DBusError err = bus.connectPair(fd);
+        if (err)
+        {
+            return err;
+        }
+        return connection.attach(fd);
+    }
+
+
+    // Reply to every method call with its arguments (string payload), until running is false.
+    inline void echoService(dbus::DBusConnection& service, std::atomic<bool>& running)
+    {
+        while (running)
+        {
+            dbus::DBusMessage call;
+            dbus::DBusError err = service.recv(call, 100ms);
+            if (err or not call.isCall())
+            {
+                continue; // timeout or signal.
+            }
+
+            std::string payload;
+            dbus::DBusMessage reply;
+            reply.prepareReply(call);
+            if (not call.extractArgument(payload))
+            {
+                reply.addArgument(payload);
+            }
+            service.send(std::move(reply));
+        }
+    }
+
+
+    inline void printThroughput(std::string const& label, uint64_t count, nanoseconds elapsed)
+    {
+        double seconds = duration_cast<duration<double>>(elapsed).count();
+        std::cout << std::fixed << std::setprecision(0)
+                  << label << ": " << (count / seconds) << " msg/s"
+                  << " (" << count << " in " << std::setprecision(3) << seconds << " s)" << std::endl;
+    }
+}
+
+#endif
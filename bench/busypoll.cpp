@@ -0,0 +1,127 @@
+// Busy poll benchmark: round trips to an echo service over a peer connection with the client spinning on its
+// non-blocking reads for increasing budgets before it blocks in poll(). Reports latencies and how many spins
+// ended with data (hits) or fell back to the blocking wait (misses).
+//
+// usage: bench_busypoll [--calls N] [--payload BYTES] [--budgets US,US,...] [--cpu N] [--address unix:abstract=NAME]
+
+// C++
+#include <atomic>
+#include <sstream>
+#include <thread>
+
+// POSIX
+#include <unistd.h>
+
+#include "bench.h"
+
+using namespace dbus;
+
+
+namespace
+{
+    DBusError run(DBusConnection& client, uint64_t calls, uint64_t payload_size, microseconds spin, int cpu)
+    {
+        DBusError err = client.setBusyPoll(spin, cpu);
+        if (err)
+        {
+            return err;
+        }
+
+        std::string const payload(payload_size, 'x');
+        auto roundtrip = [&]()
+        {
+            DBusMessage call;
+            call.prepareCall("", "/bench/Echo", "bench.Echo", "Echo");
+            call.addArgument(payload);
+
+            DBusMessage reply;
+            return client.call(std::move(call), reply, 1000ms);
+        };
+
+        for (int i = 0; i < 100; ++i) // warm up.
+        {
+            err = roundtrip();
+            if (err)
+            {
+                return err;
+            }
+        }
+
+        DBusMetrics::Snapshot const before = client.metrics();
+        bench::Latencies latencies;
+        latencies.reserve(calls);
+        auto start = steady_clock::now();
+        for (uint64_t i = 0; i < calls; ++i)
+        {
+            auto call_start = steady_clock::now();
+            err = roundtrip();
+            if (err)
+            {
+                return err;
+            }
+            latencies.add(steady_clock::now() - call_start);
+        }
+        auto elapsed = steady_clock::now() - start;
+        DBusMetrics::Snapshot const after = client.metrics();
+
+        std::string const label = "spin " + std::to_string(spin.count()) + " us";
+        std::cout << std::endl;
+        bench::printThroughput(label, latencies.size(), elapsed);
+        latencies.print(label);
+        std::cout << label << " hits: " << (after.spinHits - before.spinHits)
+                  << ", misses: " << (after.spinMisses - before.spinMisses)
+                  << ", read syscalls/call: " << std::setprecision(1)
+                  << (static_cast<double>(after.readSyscalls - before.readSyscalls) / calls) << std::endl;
+        return ESUCCESS;
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    bench::Options options(argc, argv);
+    uint64_t const calls        = options.get("calls", 5000);
+    uint64_t const payload_size = options.get("payload", 64);
+    std::string const budgets   = options.get("budgets", "0,10,50,200");
+    int const cpu               = static_cast<int>(options.get("cpu", static_cast<uint64_t>(-1)));
+    std::string const address   = options.get("address", "unix:abstract=toydbus_bench_busypoll_" + std::to_string(getpid()));
+
+    DBusConnection service;
+    DBusError err = service.listen(address);
+    if (err)
+    {
+        err.what();
+        return 1;
+    }
+
+    std::atomic<bool> running{true};
+    std::thread service_thread([&]()
+    {
+        DBusError err = service.accept(5000ms);
+        if (err)
+        {
+            err.what();
+            return;
+        }
+        bench::echoService(service, running);
+    });
+
+    DBusConnection client;
+    err = client.connectPeer(address);
+
+    std::stringstream list(budgets);
+    std::string budget;
+    while ((not err) and std::getline(list, budget, ','))
+    {
+        err = run(client, calls, payload_size, microseconds(std::strtoull(budget.c_str(), nullptr, 10)), cpu);
+    }
+
+    running = false;
+    service_thread.join();
+    if (err)
+    {
+        err.what();
+        return 1;
+    }
+    return 0;
+}
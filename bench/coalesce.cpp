@@ -0,0 +1,328 @@
+// Signal coalescing benchmark: an emitter floods PropertiesChanged through the loopback bus (Counter updated by
+// even signals, Level by odd ones) to a subscriber with a slow handler, delivered as is, then coalesced with
+// COALESCE_LATEST and COALESCE_PROPERTIES. Reports the time to catch up with the emitter, the handler calls,
+// the merged / dropped signals and whether the last values of both properties reached the handler.
+// First checks that container values ((ii), ab, a{sv} with nested 8 bytes values) go through a merge unchanged.
+//
+// usage: bench_coalesce [--signals N] [--work US] [--window MS]
+
+// C++
+#include <cstring>
+#include <map>
+#include <thread>
+#include <unordered_map>
+
+#include "bench.h"
+
+using namespace dbus;
+
+
+namespace
+{
+    std::string const OBJECT     = "/bench/Sensor";
+    std::string const INTERFACE  = "bench.Sensor";
+    std::string const PROPERTIES = "org.freedesktop.DBus.Properties";
+
+    // Minimal body writer, for values DBusMessage::addArgument() has no C++ type for (structs in variants...).
+    struct Body
+    {
+        std::vector<uint8_t> data;
+
+        void pad(uint32_t alignment) { data.resize((data.size() + alignment - 1) / alignment * alignment, 0); }
+        void put(void const* value, uint32_t size, uint32_t alignment)
+        {
+            pad(alignment);
+            data.insert(data.end(), static_cast<uint8_t const*>(value), static_cast<uint8_t const*>(value) + size);
+        }
+        void u32(uint32_t value) { put(&value, 4, 4); }
+        void i64(int64_t value)  { put(&value, 8, 8); }
+        void str(std::string const& value)
+        {
+            u32(value.size());
+            data.insert(data.end(), value.begin(), value.end());
+            data.push_back(0);
+        }
+        void sig(std::string const& value)
+        {
+            data.push_back(value.size());
+            data.insert(data.end(), value.begin(), value.end());
+            data.push_back(0);
+        }
+
+        // Array: size, padding to its elements, elements.
+        std::pair<std::size_t, std::size_t> beginArray(uint32_t alignment)
+        {
+            u32(0);
+            std::size_t const size_position = data.size() - 4;
+            pad(alignment);
+            return {size_position, data.size()};
+        }
+        void endArray(std::pair<std::size_t, std::size_t> array)
+        {
+            uint32_t const size = data.size() - array.second;
+            std::memcpy(data.data() + array.first, &size, 4);
+        }
+    };
+
+
+    // PropertiesChanged(INTERFACE, {"Pair": <(ii)>, "Flags": <ab>, "Nested": <a{sv}>, extra...}, [])
+    DBusMessage containerSignal(int32_t first, std::string const& extra)
+    {
+        Body body;
+        auto dict = body.beginArray(8);
+
+        body.pad(8);
+        body.str("Pair");
+        body.sig("(ii)");
+        body.pad(8);
+        body.u32(first);
+        body.u32(first + 1);
+
+        body.pad(8);
+        body.str("Flags");
+        body.sig("ab");
+        auto flags = body.beginArray(4);
+        body.u32(1);
+        body.u32(0);
+        body.endArray(flags);
+
+        body.pad(8);
+        body.str("Nested");
+        body.sig("a{sv}");
+        auto nested = body.beginArray(8);
+        body.pad(8);
+        body.str("x");
+        body.sig("x");
+        body.i64(int64_t{first} << 40);
+        body.endArray(nested);
+
+        if (not extra.empty())
+        {
+            body.pad(8);
+            body.str(extra);
+            body.sig("s");
+            body.str(extra);
+        }
+        body.endArray(dict);
+
+        DBusMessage signal;
+        signal.prepareSignal(OBJECT, PROPERTIES, "PropertiesChanged");
+        signal.addArgument(INTERFACE);
+        signal.addArgument(ValueView{body.data.data(), static_cast<uint32_t>(body.data.size()), 0, "a{sv}"});
+        signal.addArgument(std::vector<std::string>{});
+        return signal;
+    }
+
+
+    // Properties of a PropertiesChanged, each as a wire variant in a buffer of its own.
+    DBusError wireValues(DBusMessage& signal, std::map<std::string, Buffer>& values)
+    {
+        signal.rewind();
+        std::string interface;
+        ValueView changed;
+        DBusError err = signal.extractArgument(interface);
+        if (not err)
+        {
+            err = signal.extractArgument(changed);
+        }
+        if (err)
+        {
+            return err;
+        }
+
+        DBusError value_err;
+        err = changed.forEach([&](ValueView const& key, ValueView const& value)
+        {
+            std::string_view name;
+            value_err = key.get(name);
+            if (not value_err)
+            {
+                value_err = value.copy(values[std::string(name)]);
+            }
+            return not value_err;
+        });
+        if (value_err)
+        {
+            return value_err;
+        }
+        return err;
+    }
+
+
+    // Merge two PropertiesChanged with container values: the result shall carry the latest values, byte for
+    // byte, and decode.
+    bool checkContainers()
+    {
+        SignalCoalescer coalescer;
+        coalescer.setPolicy(1, SignalCoalescer::COALESCE_PROPERTIES, 5ms);
+        auto const now = steady_clock::now();
+
+        DBusMessage first = containerSignal(1, "");
+        DBusMessage second = containerSignal(3, "Extra");
+        if ((coalescer.add(1, first, now) != SignalCoalescer::HELD) or
+            (coalescer.add(1, second, now) != SignalCoalescer::MERGED))
+        {
+            return false;
+        }
+
+        std::vector<SignalCoalescer::Ready> ready;
+        coalescer.due(now, ready, true);
+        if (ready.size() != 1)
+        {
+            return false;
+        }
+
+        std::map<std::string, Buffer> expected;
+        std::map<std::string, Buffer> merged;
+        if (wireValues(second, expected) or wireValues(ready.front().signal, merged) or (expected != merged))
+        {
+            return false;
+        }
+
+        DBusMessage& signal = ready.front().signal;
+        signal.rewind();
+        std::string interface;
+        Dict<std::string, DBusVariant> changed;
+        if (signal.extractArgument(interface) or signal.extractArgument(changed))
+        {
+            return false;
+        }
+        std::vector<DBusVariant> const& pair = changed["Pair"].get<std::vector<DBusVariant>>();
+        return (changed["Pair"].type() == DBUS_TYPE::STRUCT_BEGIN) and (pair.size() == 2) and
+               (pair[0].get<int32_t>() == 3) and (pair[1].get<int32_t>() == 4) and
+               (changed["Extra"].get<std::string>() == "Extra");
+    }
+
+
+    DBusError run(SignalCoalescer::POLICY policy, std::string const& label, uint64_t signal_count,
+                  microseconds work, milliseconds window)
+    {
+        LoopbackBus bus;
+        DBusError err = bus.start();
+        DBusConnection emitter;
+        DBusConnection subscriber;
+        if (not err)
+        {
+            err = bench::connectLoopback(bus, emitter, "pair");
+        }
+        if (not err)
+        {
+            err = bench::connectLoopback(bus, subscriber, "pair");
+        }
+
+        uint64_t calls = 0;
+        std::unordered_map<std::string, uint32_t> values;
+        auto handler = [&](DBusMessage& signal)
+        {
+            std::string interface;
+            Dict<std::string, DBusVariant> changed;
+            std::vector<std::string> invalidated;
+            if (signal.extractArgument(interface) or signal.extractArgument(changed) or signal.extractArgument(invalidated))
+            {
+                return;
+            }
+            for (auto& property : changed)
+            {
+                values[property.first] = property.second.get<uint32_t>();
+            }
+
+            ++calls;
+            auto busy_end = steady_clock::now() + work; // slow consumer.
+            while (steady_clock::now() < busy_end)
+            {
+            }
+        };
+
+        uint32_t id;
+        MatchRule rule;
+        rule.interface = PROPERTIES;
+        rule.member = "PropertiesChanged";
+        if (not err)
+        {
+            err = subscriber.addMatch(rule, handler, id);
+        }
+        if (not err)
+        {
+            err = subscriber.setCoalescing(id, policy, window);
+        }
+        if (err)
+        {
+            return err;
+        }
+
+        uint32_t const last = static_cast<uint32_t>(signal_count - 1);
+        uint32_t const last_counter = (last % 2) ? last - 1 : last;
+        uint32_t const last_level = (last % 2) ? last : last - 1;
+        std::string const last_property = (last % 2) ? "Level" : "Counter";
+
+        auto start = steady_clock::now();
+        std::thread emitter_thread([&]()
+        {
+            std::vector<std::string> const invalidated;
+            for (uint32_t i = 0; i <= last; ++i)
+            {
+                std::unordered_map<std::string, DBusVariant> changed;
+                changed[(i % 2) ? "Level" : "Counter"] = i;
+
+                DBusMessage signal;
+                signal.prepareSignal(OBJECT, PROPERTIES, "PropertiesChanged");
+                signal.addArguments(INTERFACE, changed, invalidated);
+                emitter.send(std::move(signal));
+            }
+        });
+
+        // Caught up once the last signal reached the handler.
+        while (values[last_property] != last)
+        {
+            DBusMessage msg;
+            if (subscriber.recv(msg, 100ms) and (steady_clock::now() - start) > 30s)
+            {
+                break; // lost signals.
+            }
+        }
+        auto elapsed = steady_clock::now() - start;
+        emitter_thread.join();
+
+        DBusMetrics::Snapshot const snapshot = subscriber.metrics();
+        bool const complete = (values["Counter"] == last_counter) and (values["Level"] == last_level);
+        std::cout << std::endl << std::fixed << std::setprecision(1)
+                  << label << ": " << (duration_cast<microseconds>(elapsed).count() / 1000.0) << " ms, "
+                  << calls << " handler calls for " << signal_count << " signals" << std::endl;
+        std::cout << label << " merged: " << snapshot.signalsMerged << ", dropped: " << snapshot.signalsDropped
+                  << ", last values " << (complete ? "delivered" : "lost") << std::endl;
+        bus.stop();
+        return ESUCCESS;
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    bench::Options options(argc, argv);
+    uint64_t const signal_count = std::max<uint64_t>(2, options.get("signals", 20000));
+    microseconds const work(options.get("work", 50));
+    milliseconds const window(options.get("window", 5));
+
+    bool const containers = checkContainers();
+    std::cout << "container values merge: " << (containers ? "ok" : "FAILED") << std::endl;
+    if (not containers)
+    {
+        return 1;
+    }
+
+    std::pair<SignalCoalescer::POLICY, char const*> const policies[] = {
+        {SignalCoalescer::COALESCE_NONE,       "none"},
+        {SignalCoalescer::COALESCE_LATEST,     "latest"},
+        {SignalCoalescer::COALESCE_PROPERTIES, "properties"},
+    };
+    for (auto& policy : policies)
+    {
+        DBusError err = run(policy.first, policy.second, signal_count, work, window);
+        if (err)
+        {
+            err.what();
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,248 @@
+// Generated bindings benchmark (bench/calculator.xml through dbus_codegen):
+//  - encode: prepareCall() + serialization of the header fields against a prebuilt header template,
+//  - decode: per argument signature checks against one check of the whole reply signature,
+//  - round trips through the generated proxy and skeleton on the loopback bus.
+//
+// usage: bench_codegen [--messages N] [--calls N]
+
+// C++
+#include <atomic>
+#include <thread>
+
+#include "bench.h"
+#include "Calculator.h"
+
+using namespace dbus;
+
+namespace
+{
+    std::string const OBJECT = "/bench/Calculator";
+
+    class Calculator : public bench::CalculatorSkeleton
+    {
+    protected:
+        DBusError Add(int32_t lhs, int32_t rhs, int32_t& sum) override
+        {
+            sum = lhs + rhs;
+            return ESUCCESS;
+        }
+
+        DBusError Describe(uint32_t value, std::string const& label, std::string& text, uint32_t& length, double& ratio) override
+        {
+            text = label + std::to_string(value);
+            length = text.size();
+            ratio = value / 2.0;
+            return ESUCCESS;
+        }
+
+        DBusError Stats(Dict<std::string, uint32_t>& counters, std::vector<int32_t>& history) override
+        {
+            counters["calls"] = calls_;
+            history = {1, 2, 3};
+            return ESUCCESS;
+        }
+
+        DBusError Reset() override
+        {
+            calls_ = 0;
+            return ESUCCESS;
+        }
+
+        DBusError getPrecision(uint32_t& value) override
+        {
+            value = precision_;
+            return ESUCCESS;
+        }
+
+        DBusError setPrecision(uint32_t value) override
+        {
+            precision_ = value;
+            return ESUCCESS;
+        }
+
+        DBusError getModel(std::string& value) override
+        {
+            value = "toy";
+            return ESUCCESS;
+        }
+
+    private:
+        uint32_t calls_{0};
+        uint32_t precision_{2};
+    };
+
+
+    void calculatorService(DBusConnection& service, std::atomic<bool>& running)
+    {
+        Calculator calculator;
+        while (running)
+        {
+            DBusMessage call;
+            if (service.recv(call, 100ms) or not call.isCall())
+            {
+                continue;
+            }
+            calculator.dispatch(service, call);
+        }
+    }
+
+
+    void printPerMessage(std::string const& label, uint64_t count, nanoseconds elapsed)
+    {
+        std::cout << std::fixed << std::setprecision(1)
+                  << label << ": " << (static_cast<double>(elapsed.count()) / count) << " ns/msg" << std::endl;
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    bench::Options options(argc, argv);
+    uint64_t const messages = options.get("messages", 200000);
+    uint64_t const calls    = options.get("calls", 1000);
+
+    //-------- encode --------//
+    std::vector<uint8_t> frame;
+    auto start = steady_clock::now();
+    for (uint64_t i = 0; i < messages; ++i)
+    {
+        DBusMessage call;
+        call.prepareCall(":1.1", OBJECT, bench::CalculatorProxy::INTERFACE, "Add");
+        call.addArgument(int32_t{1});
+        call.addArgument(int32_t{2});
+        call.toWire(frame);
+    }
+    printPerMessage("encode (prepareCall)", messages, steady_clock::now() - start);
+
+    auto const header = DBusMessage::callTemplate(":1.1", OBJECT, bench::CalculatorProxy::INTERFACE, "Add", "ii");
+    start = steady_clock::now();
+    for (uint64_t i = 0; i < messages; ++i)
+    {
+        DBusMessage call;
+        call.prepareFromTemplate(header);
+        call.addArgument(int32_t{1});
+        call.addArgument(int32_t{2});
+        call.toWire(frame);
+    }
+    printPerMessage("encode (template)", messages, steady_clock::now() - start);
+
+    //-------- decode --------//
+    DBusMessage request;
+    request.prepareCall(":1.1", OBJECT, bench::CalculatorProxy::INTERFACE, "Describe");
+    DBusMessage reply;
+    reply.prepareReply(request);
+    reply.addArgument(std::string{"value-42"});
+    reply.addArgument(uint32_t{8});
+    reply.addArgument(21.0);
+    reply.toWire(frame);
+
+    DBusMessage received;
+    DBusError err = received.deserialize(frame.data(), frame.size());
+    if (err)
+    {
+        err.what();
+        return 1;
+    }
+
+    std::string text;
+    uint32_t length = 0;
+    double ratio = 0;
+    start = steady_clock::now();
+    for (uint64_t i = 0; i < messages; ++i)
+    {
+        received.rewind();
+        err = received.extractArgument(text);
+        err += received.extractArgument(length);
+        err += received.extractArgument(ratio);
+    }
+    printPerMessage("decode (checked arguments)", messages, steady_clock::now() - start);
+
+    start = steady_clock::now();
+    for (uint64_t i = 0; i < messages; ++i)
+    {
+        received.rewind();
+        err = bench::CalculatorProxy::decodeDescribe(received, text, length, ratio);
+    }
+    printPerMessage("decode (generated)", messages, steady_clock::now() - start);
+    if (err or (text != "value-42") or (length != 8) or (ratio != 21.0))
+    {
+        std::cout << "decode mismatch" << std::endl;
+        return 1;
+    }
+
+    //-------- round trips --------//
+    LoopbackBus bus;
+    err = bus.start();
+    DBusConnection service;
+    DBusConnection client;
+    if (not err)
+    {
+        err = bench::connectLoopback(bus, service, "pair");
+    }
+    if (not err)
+    {
+        err = bench::connectLoopback(bus, client, "pair");
+    }
+    if (err)
+    {
+        err.what();
+        return 1;
+    }
+
+    std::atomic<bool> running{true};
+    std::thread service_thread([&]() { calculatorService(service, running); });
+
+    bench::CalculatorProxy proxy(client, service.name(), ObjectPath{OBJECT});
+    bench::Latencies latencies;
+    latencies.reserve(calls);
+    start = steady_clock::now();
+    for (uint64_t i = 0; (i < calls) and not err; ++i)
+    {
+        auto const call_start = steady_clock::now();
+        int32_t sum = 0;
+        err = proxy.Add(static_cast<int32_t>(i), 1, sum);
+        if (not err and (sum != static_cast<int32_t>(i + 1)))
+        {
+            err = EERROR("wrong sum");
+        }
+        latencies.add(steady_clock::now() - call_start);
+    }
+    if (not err)
+    {
+        bench::printThroughput("Add()", calls, steady_clock::now() - start);
+        latencies.print("Add()");
+
+        Dict<std::string, uint32_t> counters;
+        std::vector<int32_t> history;
+        err = proxy.Stats(counters, history);
+        std::cout << "Stats(): " << counters.size() << " counters, " << history.size() << " history entries" << std::endl;
+    }
+
+    uint32_t precision = 0;
+    std::string model;
+    if (not err)
+    {
+        err = proxy.setPrecision(6);
+    }
+    if (not err)
+    {
+        err = proxy.getPrecision(precision);
+    }
+    if (not err)
+    {
+        err = proxy.getModel(model);
+    }
+    if (not err)
+    {
+        std::cout << "properties: Precision=" << precision << " Model=" << model << std::endl;
+    }
+
+    running = false;
+    service_thread.join();
+    if (err)
+    {
+        err.what();
+        return 1;
+    }
+    return 0;
+}
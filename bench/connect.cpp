@@ -0,0 +1,88 @@
+// Connection setup benchmark: socket / authentication / Hello() time per transport on the loopback bus,
+// and cost of failing over a dead address.
+//
+// usage: bench_connect [--connections N]
+
+// C++
+#include <functional>
+
+// POSIX
+#include <unistd.h>
+
+#include "bench.h"
+
+using namespace dbus;
+
+
+namespace
+{
+    void run(std::string const& label, std::string const& address, uint64_t connections)
+    {
+        bench::Latencies socket, auth, hello, total;
+        std::string used;
+        uint64_t failures = 0;
+
+        for (uint64_t i = 0; i < connections; ++i)
+        {
+            DBusConnection connection;
+            auto start = steady_clock::now();
+            DBusError err = connection.connect(address);
+            auto elapsed = steady_clock::now() - start;
+            if (err)
+            {
+                failures++;
+                continue;
+            }
+
+            DBusConnection::ConnectAttempt const& attempt = connection.connectReport().back();
+            socket.add(attempt.socket);
+            auth.add(attempt.auth);
+            hello.add(attempt.hello);
+            total.add(elapsed);
+            used = attempt.address;
+        }
+
+        std::cout << std::endl << label << ": " << address << " -> " << used << " (failures: " << failures << ")" << std::endl;
+        socket.print("  socket");
+        auth.print("  auth  ");
+        hello.print("  hello ");
+        total.print("  total ");
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    bench::Options options(argc, argv);
+    uint64_t const connections = options.get("connections", 200);
+
+    std::string const name = "toydbus_bench_connect_" + std::to_string(getpid());
+
+    LoopbackBus path_bus;
+    LoopbackBus abstract_bus;
+    DBusError err = path_bus.listen("unix:path=/tmp/" + name);
+    if (not err)
+    {
+        err = abstract_bus.listen("unix:abstract=" + name);
+    }
+    if (not err)
+    {
+        err = path_bus.start();
+    }
+    if (not err)
+    {
+        err = abstract_bus.start();
+    }
+    if (err)
+    {
+        err.what();
+        return 1;
+    }
+
+    run("path",     path_bus.address(), connections);
+    run("abstract", abstract_bus.address(), connections);
+    run("preferred abstract", path_bus.address() + ";" + abstract_bus.address(), connections);
+    run("failover", "unix:path=/tmp/" + name + "_dead;" + path_bus.address(), connections);
+
+    return 0;
+}
@@ -0,0 +1,159 @@
+// Signature programs benchmark: compile cost against cached lookups, then generic decoding of bodies
+// into DBusVariant trees (extractValues, typed arrays for basic elements) against typed extraction of
+// the same bodies.
+//
+// usage: bench_decode [--elements N] [--iterations N]
+
+// C++
+#include <cstdlib>
+#include <cstring>
+
+#include "bench.h"
+#include "SignatureProgram.h"
+
+using namespace dbus;
+
+namespace
+{
+    template<typename... Args>
+    DBusMessage received(Args const&... args)
+    {
+        DBusMessage msg;
+        msg.prepareSignal("/bench", "bench.Decode", "Values");
+        msg.addArguments(args...);
+        std::vector<uint8_t> frame;
+        msg.toWire(frame);
+
+        DBusMessage decoded;
+        DBusError err = decoded.deserialize(frame.data(), frame.size());
+        if (err)
+        {
+            err.what();
+            std::exit(1);
+        }
+        return decoded;
+    }
+
+    // Received au with its array length replaced: oversized (wrapping around 32 bits) or past the body end.
+    bool checkBounds()
+    {
+        std::vector<uint32_t> const integers{1, 2, 3, 4};
+        for (uint32_t length : {0xFFFFFFFCU, 64U})
+        {
+            DBusMessage msg;
+            msg.prepareSignal("/bench", "bench.Decode", "Values");
+            msg.addArgument(integers);
+            std::vector<uint8_t> frame;
+            msg.toWire(frame);
+
+            uint32_t body_size;
+            std::memcpy(&body_size, frame.data() + 4, sizeof(uint32_t));
+            std::memcpy(frame.data() + frame.size() - body_size, &length, sizeof(uint32_t));
+
+            DBusMessage decoded;
+            std::vector<uint32_t> typed;
+            std::vector<DBusVariant> values;
+            if (decoded.deserialize(frame.data(), frame.size()) or not decoded.extractArgument(typed))
+            {
+                return false;
+            }
+            decoded.rewind();
+            if (not decoded.extractValues(values))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template<typename F>
+    void measure(std::string const& label, uint64_t iterations, F&& f)
+    {
+        auto start = steady_clock::now();
+        for (uint64_t i = 0; i < iterations; ++i)
+        {
+            DBusError err = f();
+            if (err)
+            {
+                std::cout << label << ": FAILED" << std::endl;
+                err.what();
+                std::exit(1);
+            }
+        }
+        nanoseconds const elapsed = steady_clock::now() - start;
+        std::cout << std::fixed << std::setprecision(1)
+                  << label << ": " << (static_cast<double>(elapsed.count()) / iterations) << " ns" << std::endl;
+    }
+
+    // Generic against typed decoding of msg (typed: one argument of type T).
+    template<typename T>
+    void compare(std::string const& label, DBusMessage& msg, uint64_t iterations)
+    {
+        std::vector<DBusVariant> values;
+        measure(label + " values", iterations, [&]()
+        {
+            values.clear();
+            msg.rewind();
+            return msg.extractValues(values);
+        });
+        measure(label + " typed ", iterations, [&]()
+        {
+            T typed;
+            msg.rewind();
+            return msg.extractArgument(typed);
+        });
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    bench::Options options(argc, argv);
+    uint32_t const elements = options.get("elements", 1000);
+    uint64_t const iterations = options.get("iterations", 1000);
+
+    bool const bounds = checkBounds();
+    std::cout << "array bounds: " << (bounds ? "ok" : "FAILED") << std::endl;
+    if (not bounds)
+    {
+        return 1;
+    }
+
+    //-------- compilation --------//
+    std::vector<std::string> const signatures{"s", "a{sv}", "a{oa{sa{sv}}}", "a(ia(sv)a{s(iiu)})", "(yyyyuua(yv))"};
+    for (auto const& signature : signatures)
+    {
+        SignatureProgram program;
+        measure("compile " + signature, iterations * 10, [&]() { return SignatureProgram::compile(signature, program); });
+        SignatureProgram::Ptr cached;
+        measure("cached  " + signature, iterations * 100, [&]() { return SignatureProgram::get(signature, cached); });
+        std::cout << "  " << program.instructions() << " instructions" << std::endl;
+    }
+
+    //-------- decoding --------//
+    std::vector<uint32_t> integers(elements);
+    std::vector<uint8_t> bytes(elements * 64);
+    std::vector<std::string> names(elements);
+    Dict<int32_t, int32_t> pairs;
+    Dict<std::string, DBusVariant> properties;
+    for (uint32_t i = 0; i < elements; ++i)
+    {
+        integers[i] = i;
+        names[i] = "org.example.Name" + std::to_string(i);
+        pairs[i] = -i;
+        properties["Property" + std::to_string(i)] = (i % 2) ? DBusVariant{i} : DBusVariant{std::string{"value"}};
+    }
+
+    std::cout << std::endl << elements << " elements:" << std::endl;
+    DBusMessage au = received(integers);
+    compare<std::vector<uint32_t>>("au   ", au, iterations);
+    DBusMessage ay = received(bytes);
+    compare<std::vector<uint8_t>>("ay   ", ay, iterations);
+    DBusMessage as = received(names);
+    compare<std::vector<std::string>>("as   ", as, iterations);
+    DBusMessage aii = received(pairs);
+    compare<Dict<int32_t, int32_t>>("a{ii}", aii, iterations);
+    DBusMessage asv = received(properties);
+    compare<Dict<std::string, DBusVariant>>("a{sv}", asv, iterations);
+    return 0;
+}
@@ -0,0 +1,140 @@
+// Dict decoding benchmark: a GetManagedObjects() reply (a{oa{sa{sv}}}) decoded into nested Dict
+// (std::unordered_map) against nested FlatDict (contiguous, wire order): decoding cost, heap allocations
+// and bytes, iteration over all properties and lookups by object path.
+//
+// usage: bench_dicts [--objects N] [--iterations N]
+
+// C++
+#include <cstdlib>
+#include <random>
+
+#include "alloc.h"
+#include "bench.h"
+
+using namespace dbus;
+
+namespace
+{
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> allocated{0};
+
+    using Objects = Dict<ObjectPath, Dict<std::string, Dict<std::string, DBusVariant>>>;
+    using FlatObjects = FlatDict<ObjectPath, FlatDict<std::string, FlatDict<std::string, DBusVariant>>>;
+
+    ObjectPath objectPath(uint32_t index)
+    {
+        return ObjectPath{"/bench/objects/" + std::to_string(index)};
+    }
+
+    std::vector<uint8_t> managedObjects(uint32_t count)
+    {
+        Objects objects;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            auto& interfaces = objects[objectPath(i)];
+            interfaces["bench.Item"]["Index"] = i;
+            interfaces["bench.Item"]["Name"] = "item-" + std::to_string(i);
+            interfaces["bench.Extra"]["Value"] = i * 0.5;
+        }
+
+        DBusMessage reply;
+        reply.prepareSignal("/bench", "bench.Objects", "Snapshot");
+        reply.addArgument(objects);
+        std::vector<uint8_t> frame;
+        reply.toWire(frame);
+        return frame;
+    }
+
+    template<typename D>
+    void run(std::string const& label, std::vector<uint8_t> const& frame, uint32_t count, uint64_t iterations)
+    {
+        DBusMessage msg;
+        D objects;
+        uint64_t const before = allocations.load();
+        uint64_t const before_bytes = allocated.load();
+        auto start = steady_clock::now();
+        for (uint64_t i = 0; i < iterations; ++i)
+        {
+            objects = D{};
+            DBusError err = msg.deserialize(frame.data(), frame.size());
+            if (not err)
+            {
+                err = msg.extractArgument(objects);
+            }
+            if (err or (objects.size() != count))
+            {
+                std::cout << label << ": DECODING FAILED" << std::endl;
+                err.what();
+                std::exit(1);
+            }
+        }
+        nanoseconds const decode = (steady_clock::now() - start) / iterations;
+        double const allocs = static_cast<double>(allocations.load() - before) / iterations;
+        double const bytes = static_cast<double>(allocated.load() - before_bytes) / iterations;
+
+        uint64_t sum = 0;
+        start = steady_clock::now();
+        for (uint64_t i = 0; i < iterations; ++i)
+        {
+            for (auto const& object : objects)
+            {
+                for (auto const& interface : object.second)
+                {
+                    for (auto const& property : interface.second)
+                    {
+                        sum += static_cast<uint64_t>(property.second.type());
+                    }
+                }
+            }
+        }
+        nanoseconds const iterate = (steady_clock::now() - start) / iterations;
+
+        std::mt19937 random{42};
+        std::uniform_int_distribution<uint32_t> pick{0, count - 1};
+        std::vector<ObjectPath> paths;
+        for (uint32_t i = 0; i < 10000; ++i)
+        {
+            paths.push_back(objectPath(pick(random)));
+        }
+        uint64_t found = 0;
+        start = steady_clock::now();
+        for (auto const& path : paths)
+        {
+            auto it = objects.find(path);
+            found += (it != objects.end()) and (it->second.find("bench.Item") != it->second.end());
+        }
+        nanoseconds const lookup = (steady_clock::now() - start) / paths.size();
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << label << ": decode " << duration_cast<microseconds>(decode).count() << " us, "
+                  << allocs << " allocations (" << (bytes / 1024) << " KiB), iterate "
+                  << (static_cast<double>(iterate.count()) / 1000) << " us, lookup " << lookup.count() << " ns"
+                  << " (" << found << " found, " << sum << ")" << std::endl;
+    }
+}
+
+
+namespace bench
+{
+    void onAllocate(void*, std::size_t size)
+    {
+        allocations++;
+        allocated += size;
+    }
+
+    void onRelease(void*) { }
+}
+
+int main(int argc, char** argv)
+{
+    bench::Options options(argc, argv);
+    uint32_t const count = options.get("objects", 1000);
+    uint64_t const iterations = options.get("iterations", 100);
+
+    std::vector<uint8_t> const frame = managedObjects(count);
+    std::cout << count << " objects, " << frame.size() << " bytes" << std::endl;
+
+    run<Objects>("Dict    ", frame, count, iterations);
+    run<FlatObjects>("FlatDict", frame, count, iterations);
+    return 0;
+}
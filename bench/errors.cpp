@@ -0,0 +1,137 @@
+// DBusError benchmark: cost and heap allocations of success, static errors (code and string literal),
+// errno errors, propagation (err += EERROR("")) and runtime messages, then method calls on the loopback bus
+// timing out (to a service that never answers), against building and sending the same calls.
+//
+// usage: bench_errors [--iterations N] [--calls N]
+
+// C++
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+
+#include "alloc.h"
+#include "bench.h"
+
+using namespace dbus;
+
+namespace
+{
+    std::atomic<uint64_t> allocations{0};
+
+    __attribute__((noinline)) DBusError succeed()
+    {
+        return ESUCCESS;
+    }
+
+    __attribute__((noinline)) DBusError timeout()
+    {
+        return ECODE(ERROR_CODE::TIMEOUT, "timeout");
+    }
+
+    __attribute__((noinline)) DBusError wouldBlock()
+    {
+        return ESYSTEM(EAGAIN);
+    }
+
+    __attribute__((noinline)) DBusError propagate()
+    {
+        DBusError err = timeout();
+        if (err)
+        {
+            err += EERROR("");
+            err += EERROR("");
+        }
+        return err;
+    }
+
+    __attribute__((noinline)) DBusError runtimeMessage(std::string const& name)
+    {
+        return EERROR("Unknown name " + name);
+    }
+
+    template<typename F>
+    void measure(std::string const& label, uint64_t iterations, F&& f)
+    {
+        uint64_t const before = allocations.load();
+        auto start = steady_clock::now();
+        uint64_t errors = 0;
+        for (uint64_t i = 0; i < iterations; ++i)
+        {
+            DBusError err = f();
+            errors += static_cast<bool>(err);
+        }
+        nanoseconds const elapsed = steady_clock::now() - start;
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << label << ": " << (static_cast<double>(elapsed.count()) / iterations) << " ns, "
+                  << (static_cast<double>(allocations.load() - before) / iterations) << " allocations"
+                  << " (" << errors << " errors)" << std::endl;
+    }
+}
+
+
+namespace bench
+{
+    void onAllocate(void*, std::size_t) { allocations++; }
+    void onRelease(void*) { }
+}
+
+
+int main(int argc, char** argv)
+{
+    bench::Options options(argc, argv);
+    uint64_t const iterations = options.get("iterations", 10000000);
+    uint64_t const calls      = options.get("calls", 1000);
+    std::string const name{"org.example.Missing"};
+
+    measure("success         ", iterations, succeed);
+    measure("timeout (code)  ", iterations, timeout);
+    measure("EAGAIN (errno)  ", iterations, wouldBlock);
+    measure("propagation (x2)", iterations, propagate);
+    measure("runtime message ", iterations / 10, [&]() { return runtimeMessage(name); });
+
+    // The service never reads: calls time out at once, the difference is the error path.
+    LoopbackBus bus;
+    DBusError err = bus.start();
+    DBusConnection client;
+    DBusConnection service;
+    if (not err)
+    {
+        err = bench::connectLoopback(bus, client, "pair");
+    }
+    if (not err)
+    {
+        err = bench::connectLoopback(bus, service, "pair");
+    }
+    if (err)
+    {
+        err.what();
+        return 1;
+    }
+    auto prepare = [&](DBusMessage& call)
+    {
+        call.prepareCall(service.name(), "/bench", "bench.Silent", "Ignore");
+        call.addArgument(name);
+    };
+    measure("call sent       ", calls, [&]()
+    {
+        DBusMessage call;
+        prepare(call);
+        return client.send(std::move(call));
+    });
+    measure("call timed out  ", calls, [&]()
+    {
+        DBusMessage call;
+        DBusMessage reply;
+        prepare(call);
+        return client.call(std::move(call), reply, 0ms);
+    });
+    bus.stop();
+
+    err = propagate();
+    std::cout << "\nformatted on demand:" << std::endl;
+    err.what();
+    wouldBlock().what();
+    return 0;
+}
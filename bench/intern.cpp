@@ -0,0 +1,80 @@
+// Header strings interning benchmark: cost and heap allocations of decoding received messages with header
+// strings copied per message, or shared through an InternTable, and of replying to them.
+//
+// usage: bench_intern [--iterations N]
+
+// C++
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+
+#include "alloc.h"
+#include "bench.h"
+
+using namespace dbus;
+
+namespace
+{
+    std::atomic<uint64_t> allocations{0};
+
+    template<typename F>
+    void measure(std::string const& label, uint64_t iterations, F&& f)
+    {
+        uint64_t const before = allocations.load();
+        auto start = steady_clock::now();
+        for (uint64_t i = 0; i < iterations; ++i)
+        {
+            DBusError err = f();
+            if (err)
+            {
+                std::cout << label << ": FAILED" << std::endl;
+                err.what();
+                std::exit(1);
+            }
+        }
+        nanoseconds const elapsed = steady_clock::now() - start;
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << label << ": " << (static_cast<double>(elapsed.count()) / iterations) << " ns/msg, "
+                  << (static_cast<double>(allocations.load() - before) / iterations) << " allocations/msg" << std::endl;
+    }
+}
+
+
+namespace bench
+{
+    void onAllocate(void*, std::size_t) { allocations++; }
+    void onRelease(void*) { }
+}
+
+
+int main(int argc, char** argv)
+{
+    bench::Options options(argc, argv);
+    uint64_t const iterations = options.get("iterations", 1000000);
+
+    // A call as received from the bus: long names, sender set, small body.
+    DBusMessage call;
+    call.prepareCall("org.example.LongServiceName", "/org/example/long/object/path", "org.example.LongInterfaceName",
+                     "LongMethodName");
+    call.setSender(":1.4242");
+    call.addArgument(uint32_t{42});
+    std::vector<uint8_t> frame;
+    call.toWire(frame);
+
+    DBusMessage msg; // reused, as the connection receive buffer.
+    measure("decode, copied  ", iterations, [&]() { return msg.deserialize(frame.data(), frame.size()); });
+
+    auto strings = std::make_shared<InternTable>();
+    measure("decode, interned", iterations, [&]() { return msg.deserialize(frame.data(), frame.size(), strings); });
+    std::cout << "  " << strings->size() << " interned strings" << std::endl;
+
+    DBusMessage reply;
+    measure("reply,  interned", iterations, [&]()
+    {
+        reply.prepareReply(msg);
+        return (reply.interned(FIELD::DESTINATION) == msg.interned(FIELD::SENDER)) ? ESUCCESS
+                                                                                 : EERROR("Sender not shared");
+    });
+    return 0;
+}
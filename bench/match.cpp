@@ -0,0 +1,166 @@
+// Signal match benchmark: evaluation rate of the match index on raw header bytes, compared to decoding
+// every frame then checking each rule in turn. Then end to end filtering on the loopback bus.
+//
+// usage: bench_match [--rules N] [--frames N] [--loops N] [--matched PERCENT] [--signals N]
+
+// C++
+#include <atomic>
+#include <thread>
+
+#include "bench.h"
+
+using namespace dbus;
+
+
+int main(int argc, char** argv)
+{
+    bench::Options options(argc, argv);
+    uint64_t const rule_count = options.get("rules", 200);
+    uint64_t const frame_count = options.get("frames", 1000);
+    uint64_t const loops = options.get("loops", 1000);
+    uint64_t const matched_percent = options.get("matched", 10);
+    uint64_t const signal_count = options.get("signals", 2000);
+
+    //-------- rules and frames --------//
+    MatchIndex index;
+    std::vector<MatchRule> rules;
+    for (uint64_t i = 0; i < rule_count; ++i)
+    {
+        MatchRule rule;
+        rule.interface = "bench.Interface" + std::to_string(i % 50);
+        rule.member = "Signal" + std::to_string(i);
+        if (i % 3 == 0)
+        {
+            rule.pathNamespace = "/bench/" + std::to_string(i % 7);
+        }
+        index.add(rule);
+        rules.push_back(rule);
+    }
+
+    std::vector<std::vector<uint8_t>> frames(frame_count);
+    std::string const payload(64, 'x');
+    for (uint64_t i = 0; i < frame_count; ++i)
+    {
+        DBusMessage signal;
+        uint64_t const rule = i % rule_count;
+        if ((i % 100) < matched_percent)
+        {
+            signal.prepareSignal("/bench/" + std::to_string(rule % 7) + "/object",
+                                 "bench.Interface" + std::to_string(rule % 50), "Signal" + std::to_string(rule));
+        }
+        else
+        {
+            signal.prepareSignal("/other/object", "other.Interface" + std::to_string(i % 50), "Changed");
+        }
+        signal.addArgument(payload);
+        signal.addArgument(static_cast<uint32_t>(i));
+        signal.toWire(frames[i]);
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+
+    //-------- header scan + index --------//
+    uint64_t hits = 0;
+    auto start = steady_clock::now();
+    for (uint64_t loop = 0; loop < loops; ++loop)
+    {
+        for (auto const& frame : frames)
+        {
+            HeaderView header;
+            DBusMessage::scanHeader(frame.data(), frame.size(), header);
+            hits += index.matchAny(header);
+        }
+    }
+    double const index_ns = duration_cast<nanoseconds>(steady_clock::now() - start).count() / double(loops * frame_count);
+    std::cout << "header scan + index:   " << index_ns << " ns/frame, " << (1000.0 / index_ns) << " M frames/s"
+              << " (" << hits / loops << " of " << frame_count << " matched)" << std::endl;
+
+    //-------- decode + linear scan (what a filter on DBusMessage costs) --------//
+    uint64_t const decode_loops = std::max<uint64_t>(1, loops / 10);
+    hits = 0;
+    start = steady_clock::now();
+    for (uint64_t loop = 0; loop < decode_loops; ++loop)
+    {
+        for (auto const& frame : frames)
+        {
+            DBusMessage msg;
+            msg.deserialize(frame.data(), frame.size());
+
+            HeaderView header;
+            header.type = msg.type();
+            header.path = msg.path().data();
+            header.interface = msg.interface();
+            header.member = msg.member();
+            for (auto const& rule : rules)
+            {
+                if (rule.matches(header))
+                {
+                    ++hits;
+                    break;
+                }
+            }
+        }
+    }
+    double const decode_ns = duration_cast<nanoseconds>(steady_clock::now() - start).count() / double(decode_loops * frame_count);
+    std::cout << "decode + linear scan:  " << decode_ns << " ns/frame, " << (1000.0 / decode_ns) << " M frames/s"
+              << " (" << hits / decode_loops << " of " << frame_count << " matched)" << std::endl;
+
+    //-------- end to end on the loopback bus --------//
+    LoopbackBus bus;
+    DBusError err = bus.start();
+    DBusConnection emitter;
+    DBusConnection subscriber;
+    if (not err)
+    {
+        err = bench::connectLoopback(bus, emitter, "pair");
+    }
+    if (not err)
+    {
+        err = bench::connectLoopback(bus, subscriber, "pair");
+    }
+
+    uint64_t received = 0;
+    uint32_t id;
+    MatchRule rule;
+    rule.interface = "bench.Wanted";
+    if (not err)
+    {
+        err = subscriber.addMatch(rule, [&received](DBusMessage&) { ++received; }, id);
+    }
+    if (err)
+    {
+        err.what();
+        return 1;
+    }
+
+    uint64_t const wanted = std::max<uint64_t>(1, signal_count * matched_percent / 100);
+    std::thread emitter_thread([&]()
+    {
+        for (uint64_t i = 0; i < signal_count; ++i)
+        {
+            DBusMessage signal;
+            bool const is_wanted = (i % 100) < matched_percent;
+            signal.prepareSignal("/bench", is_wanted ? "bench.Wanted" : "bench.Noise", "Tick");
+            signal.addArgument(payload);
+            emitter.send(std::move(signal));
+        }
+    });
+
+    start = steady_clock::now();
+    while (received < wanted)
+    {
+        DBusMessage msg;
+        if (subscriber.recv(msg, 100ms) and (steady_clock::now() - start) > 10s)
+        {
+            break; // lost signals.
+        }
+    }
+    auto elapsed = steady_clock::now() - start;
+    emitter_thread.join();
+
+    std::cout << std::endl;
+    bench::printThroughput("loopback signals", signal_count, elapsed);
+    std::cout << "delivered to handler: " << received << " of " << wanted << std::endl;
+    std::cout << std::endl << "subscriber snapshot:" << std::endl << subscriber.metrics() << std::endl;
+    return 0;
+}
@@ -0,0 +1,113 @@
+// Metrics overhead benchmark: cost of the accounting done for one call round trip,
+// compared to an actual round trip on the loopback bus. Also prints the connection snapshot.
+//
+// usage: bench_metrics [--iterations N] [--calls N]
+
+// C++
+#include <atomic>
+#include <thread>
+
+#include "bench.h"
+
+using namespace dbus;
+
+
+int main(int argc, char** argv)
+{
+    bench::Options options(argc, argv);
+    uint64_t const iterations = options.get("iterations", 10000000);
+    uint64_t const calls      = options.get("calls", 2000);
+
+    //-------- accounting cost (same recording steps as DBusConnection for one call) --------//
+    DBusMetrics metrics;
+    std::unordered_map<uint32_t, steady_clock::time_point> pending;
+    pending.reserve(16);
+
+    auto start = steady_clock::now();
+    for (uint64_t i = 0; i < iterations; ++i)
+    {
+        auto now = steady_clock::now();
+
+        // send(): header + body writes.
+        metrics.writeSyscall();
+        metrics.writeSyscall();
+        metrics.messageOut(MESSAGE_TYPE::METHOD_CALL, 128);
+        metrics.queueTime(i & 0xFFF);
+        pending.emplace(static_cast<uint32_t>(i), now);
+        metrics.pendingCalls(pending.size());
+
+        // recv(): prefix + rest of the frame reads.
+        metrics.readSyscall();
+        metrics.readSyscall();
+        metrics.messageIn(MESSAGE_TYPE::METHOD_RETURN, 128);
+        auto it = pending.find(static_cast<uint32_t>(i));
+        metrics.callLatency(duration_cast<nanoseconds>(now - it->second).count() + (i & 0xFFFF));
+        pending.erase(it);
+        metrics.pendingCalls(pending.size());
+    }
+    double const accounting_ns = duration_cast<nanoseconds>(steady_clock::now() - start).count() / double(iterations);
+    // steady_clock::now() is also taken by the connection: it is part of the cost.
+
+    DBusMetrics::Snapshot check = metrics.snapshot();
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "accounting per round trip: " << accounting_ns << " ns"
+              << " (" << check.callLatency.count << " samples)" << std::endl;
+
+    //-------- actual round trip --------//
+    LoopbackBus bus;
+    DBusError err = bus.start();
+    if (err)
+    {
+        err.what();
+        return 1;
+    }
+
+    DBusConnection service;
+    DBusConnection client;
+    err = bench::connectLoopback(bus, service, "pair");
+    if (not err)
+    {
+        err = bench::connectLoopback(bus, client, "pair");
+    }
+    if (err)
+    {
+        err.what();
+        return 1;
+    }
+
+    std::atomic<bool> running{true};
+    std::thread service_thread([&]()
+    {
+        while (running)
+        {
+            DBusMessage call;
+            if (service.recv(call, 100ms) or not call.isCall())
+            {
+                continue;
+            }
+
+            DBusMessage reply;
+            reply.prepareReply(call);
+            service.send(std::move(reply));
+        }
+    });
+
+    start = steady_clock::now();
+    for (uint64_t i = 0; i < calls; ++i)
+    {
+        DBusMessage call;
+        call.prepareCall(service.name(), "/bench", "bench.Metrics", "Ping");
+        DBusMessage reply;
+        client.call(std::move(call), reply, 1000ms);
+    }
+    double const roundtrip_ns = duration_cast<nanoseconds>(steady_clock::now() - start).count() / double(calls);
+
+    running = false;
+    service_thread.join();
+
+    std::cout << std::endl << "round trip: " << roundtrip_ns << " ns, metrics overhead: "
+              << std::setprecision(3) << (100.0 * accounting_ns / roundtrip_ns) << " %" << std::endl << std::endl;
+    std::cout << "client snapshot:" << std::endl << client.metrics() << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,174 @@
+// Bus monitor benchmark: traffic on the loopback bus (signals flood from an emitter, pipelined calls to an echo
+// service) is copied to a monitor connection (BecomeMonitor). Once the traffic is over, the monitor drains its
+// backlog: decoding and dumping each message (DBusMessage::dump()), then through BusMonitor: per interface /
+// member stats, binary log, both. Reports the frames the monitor took in per second and what the log missed.
+//
+// usage: bench_monitor [--signals N] [--calls N] [--payload BYTES] [--log PATH]
+
+// C++
+#include <atomic>
+#include <thread>
+
+// POSIX
+#include <unistd.h>
+
+#include "bench.h"
+#include "BusMonitor.h"
+
+using namespace dbus;
+
+
+namespace
+{
+    enum class SINK
+    {
+        DUMP,
+        STATS,
+        LOG,
+        STATS_LOG
+    };
+
+
+    DBusError run(SINK sink, std::string const& label, uint64_t signal_count, uint64_t calls,
+                  uint64_t payload_size, std::string const& log_path)
+    {
+        LoopbackBus bus;
+        DBusError err = bus.start();
+        DBusConnection monitor_connection;
+        DBusConnection emitter;
+        DBusConnection service;
+        DBusConnection client;
+        for (DBusConnection* connection : {&monitor_connection, &emitter, &service, &client})
+        {
+            if (not err)
+            {
+                err = bench::connectLoopback(bus, *connection, "pair");
+            }
+        }
+
+        BusMonitor monitor(monitor_connection);
+        if (not err)
+        {
+            err = monitor.start();
+        }
+        if ((not err) and ((sink == SINK::LOG) or (sink == SINK::STATS_LOG)))
+        {
+            err = monitor.startLog(log_path);
+        }
+        if (err)
+        {
+            return err;
+        }
+        monitor.collectStats((sink == SINK::STATS) or (sink == SINK::STATS_LOG));
+
+        std::string const payload(payload_size, 'x');
+        std::atomic<bool> running{true};
+        std::thread service_thread(bench::echoService, std::ref(service), std::ref(running));
+        std::thread emitter_thread([&]()
+        {
+            char const* const members[] = {"Tick", "Changed", "Progress", "Status"};
+            for (uint64_t i = 0; i < signal_count; ++i)
+            {
+                DBusMessage signal;
+                signal.prepareSignal("/bench", (i % 3) ? "bench.Feed" : "bench.Events", members[i % 4]);
+                signal.addArgument(payload);
+                emitter.send(std::move(signal));
+            }
+        });
+        std::thread client_thread([&]()
+        {
+            std::vector<DBusMessage> batch(64);
+            std::vector<DBusConnection::BatchResult> results;
+            for (uint64_t i = 0; i < calls; i += batch.size())
+            {
+                for (auto& call : batch)
+                {
+                    call.prepareCall(service.name(), "/bench/Echo", "bench.Echo", "Echo");
+                    call.addArgument(payload);
+                }
+                client.callBatch(batch, results, 5000ms);
+            }
+        });
+
+        // The bus queues the monitor copies meanwhile: the drain below runs at the monitor pace, as on a bus
+        // saturated with traffic.
+        emitter_thread.join();
+        client_thread.join();
+
+        // Until no frame came for a while.
+        uint64_t frames = 0;
+        std::string dump;
+        DBusMessage msg;
+        auto start = steady_clock::now();
+        auto last = start;
+        while (true)
+        {
+            if (sink == SINK::DUMP)
+            {
+                uint8_t const* frame;
+                uint32_t frame_size;
+                err = monitor_connection.recvFrame(frame, frame_size, 200ms);
+                if (not err and not msg.deserialize(frame, frame_size))
+                {
+                    dump = msg.dump();
+                }
+            }
+            else
+            {
+                err = monitor.poll(200ms);
+            }
+            if (err)
+            {
+                break;
+            }
+            frames++;
+            last = steady_clock::now();
+        }
+        running = false;
+        service_thread.join();
+
+        std::cout << std::endl;
+        bench::printThroughput(label, frames, last - start);
+        std::cout << label << " frames: " << frames << " (signals " << signal_count << ", calls " << calls << ")";
+        if ((sink == SINK::LOG) or (sink == SINK::STATS_LOG))
+        {
+            std::cout << ", logged " << monitor.logged() << ", log drops " << monitor.dropped();
+        }
+        std::cout << std::endl;
+        if (sink == SINK::STATS)
+        {
+            std::cout << monitor.stats();
+        }
+        monitor.stopLog();
+        bus.stop();
+        return ESUCCESS;
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    bench::Options options(argc, argv);
+    uint64_t const signal_count = options.get("signals", 100000);
+    uint64_t const calls        = options.get("calls", 20000);
+    uint64_t const payload_size = options.get("payload", 64);
+    std::string const log_path  = options.get("log", "/tmp/toydbus_bench_monitor_" + std::to_string(getpid()) + ".trace");
+
+    std::pair<SINK, char const*> const sinks[] = {
+        {SINK::DUMP,      "dump"},
+        {SINK::STATS,     "stats"},
+        {SINK::LOG,       "log"},
+        {SINK::STATS_LOG, "stats+log"},
+    };
+    for (auto& sink : sinks)
+    {
+        DBusError err = run(sink.first, sink.second, signal_count, calls, payload_size, log_path);
+        if (err)
+        {
+            err.what();
+            return 1;
+        }
+    }
+    unlink(log_path.c_str());
+    return 0;
+}
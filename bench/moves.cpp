@@ -0,0 +1,171 @@
+// Copies benchmark: heap allocations and bytes allocated by the calling thread while building messages and
+// variants from copied against moved values, then while sending a large payload over a peer connection with a
+// fresh message per send against one message reused (prepare*() keeps its buffers).
+//
+// usage: bench_moves [--payload BYTES] [--iterations N] [--address unix:abstract=NAME|unix:path=PATH]
+
+// C++
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <malloc.h>
+#include <thread>
+
+// POSIX
+#include <unistd.h>
+
+#include "alloc.h"
+#include "bench.h"
+
+using namespace dbus;
+
+namespace
+{
+    // Counted per thread: the receiving side of the peer connection does not pollute the sender figures.
+    thread_local uint64_t allocations{0};
+    thread_local uint64_t allocated{0};
+
+    template<typename F>
+    void measure(std::string const& label, uint64_t iterations, F&& f)
+    {
+        uint64_t const before = allocations;
+        uint64_t const bytes_before = allocated;
+        auto start = steady_clock::now();
+        for (uint64_t i = 0; i < iterations; ++i)
+        {
+            DBusError err = f();
+            if (err)
+            {
+                std::cout << label << ": FAILED" << std::endl;
+                err.what();
+                std::exit(1);
+            }
+        }
+        nanoseconds const elapsed = steady_clock::now() - start;
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << label << ": " << (static_cast<double>(elapsed.count()) / iterations / 1000.0) << " us, "
+                  << (static_cast<double>(allocations - before) / iterations) << " allocations, "
+                  << ((allocated - bytes_before) / iterations) << " bytes" << std::endl;
+    }
+}
+
+
+namespace bench
+{
+    void onAllocate(void* ptr, std::size_t)
+    {
+        allocations++;
+        allocated += malloc_usable_size(ptr);
+    }
+
+    void onRelease(void*) { }
+}
+
+
+int main(int argc, char** argv)
+{
+    bench::Options options(argc, argv);
+    uint64_t const payload_size = options.get("payload", 65536);
+    uint64_t const iterations   = options.get("iterations", 1000);
+    std::string const address   = options.get("address", "unix:abstract=toydbus_bench_moves_" + std::to_string(getpid()));
+
+    std::vector<uint8_t> const bytes(payload_size, 0x42);
+    std::string const text(payload_size, 'x');
+
+    //-------- variants --------//
+    std::cout << payload_size << " bytes payload:" << std::endl;
+    measure("variant copied string ", iterations, [&]()
+    {
+        DBusVariant value{text};
+        return ESUCCESS;
+    });
+    std::vector<std::string> texts(iterations, text); // moved in by the next pass.
+    uint64_t next = 0;
+    measure("variant moved string  ", iterations, [&]()
+    {
+        DBusVariant value{std::move(texts[next++])};
+        return ESUCCESS;
+    });
+    measure("variant emplaced bytes", iterations, [&]()
+    {
+        DBusVariant value;
+        value.emplace<std::vector<uint8_t>>(bytes.begin(), bytes.end());
+        return ESUCCESS;
+    });
+
+    //-------- messages --------//
+    measure("fresh message         ", iterations, [&]()
+    {
+        DBusMessage msg;
+        msg.prepareSignal("/bench/Moves", "bench.Moves", "Payload");
+        msg.addArgument(bytes);
+        std::vector<uint8_t> frame;
+        msg.toWire(frame);
+        return ESUCCESS;
+    });
+    DBusMessage reused;
+    std::vector<uint8_t> frame;
+    measure("reused message        ", iterations, [&]()
+    {
+        reused.prepareSignal("/bench/Moves", "bench.Moves", "Payload");
+        reused.addArgument(bytes);
+        reused.toWire(frame);
+        return ESUCCESS;
+    });
+
+    //-------- peer connection --------//
+    DBusConnection receiver;
+    DBusError err = receiver.listen(address);
+    if (err)
+    {
+        err.what();
+        return 1;
+    }
+
+    std::atomic<bool> running{true};
+    std::thread receiver_thread([&]()
+    {
+        DBusError err = receiver.accept(5000ms);
+        if (err)
+        {
+            err.what();
+            return;
+        }
+        DBusMessage msg;
+        while (running)
+        {
+            receiver.recv(msg, 10ms);
+        }
+    });
+
+    DBusConnection sender;
+    err = sender.connectPeer(address);
+    if (err)
+    {
+        err.what();
+        running = false;
+        receiver_thread.join();
+        return 1;
+    }
+
+    measure("send fresh message    ", iterations, [&]()
+    {
+        DBusMessage msg;
+        msg.prepareSignal("/bench/Moves", "bench.Moves", "Payload");
+        msg.addArgument(bytes);
+        return sender.send(std::move(msg));
+    });
+    measure("send reused message   ", iterations, [&]()
+    {
+        // send() serializes the message in place: it stays usable for the next one.
+        reused.prepareSignal("/bench/Moves", "bench.Moves", "Payload");
+        reused.addArgument(bytes);
+        return sender.send(std::move(reused));
+    });
+
+    running = false;
+    receiver_thread.join();
+    return 0;
+}
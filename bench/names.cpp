@@ -0,0 +1,198 @@
+// Name owner cache benchmark: cached owner lookups against GetNameOwner() round trips, local fast
+// failure of calls to absent services against the bus error reply, and stale owner signal filtering
+// across a well-known name transfer.
+//
+// usage: bench_names [--lookups N] [--calls N] [--ticks N]
+
+// C++
+#include <atomic>
+#include <thread>
+
+#include "bench.h"
+
+using namespace dbus;
+
+namespace
+{
+    std::string const NAME = "bench.Names";
+
+    DBusError busCall(DBusConnection& connection, char const* method, std::string const& name)
+    {
+        DBusMessage call;
+        call.prepareCall("org.freedesktop.DBus", "/org/freedesktop/DBus", "org.freedesktop.DBus", method);
+        call.addArgument(name);
+        if (std::string(method) == "RequestName")
+        {
+            call.addArgument(uint32_t{0});
+        }
+
+        DBusMessage reply;
+        return connection.call(std::move(call), reply, 1000ms);
+    }
+
+    void tick(DBusConnection& connection, std::string const& who, uint32_t phase)
+    {
+        DBusMessage signal;
+        signal.prepareSignal("/bench", NAME, "Tick");
+        signal.addArgument(who);
+        signal.addArgument(phase);
+        connection.send(std::move(signal));
+    }
+
+    struct Ticks
+    {
+        uint64_t before{0};      // from the first owner, while it owns the name.
+        uint64_t stale{0};       // from the first owner, after the transfer.
+        uint64_t newOwner{0};
+    };
+}
+
+
+int main(int argc, char** argv)
+{
+    bench::Options options(argc, argv);
+    uint64_t const lookups = options.get("lookups", 1000000);
+    uint64_t const calls   = options.get("calls", 500);
+    uint32_t const ticks   = options.get("ticks", 20);
+
+    LoopbackBus bus;
+    DBusError err = bus.start();
+    DBusConnection first;
+    DBusConnection second;
+    DBusConnection client;
+    DBusConnection filtered;
+    for (DBusConnection* connection : {&first, &second, &client, &filtered})
+    {
+        if (not err)
+        {
+            err = bench::connectLoopback(bus, *connection, "pair");
+        }
+    }
+    if (not err)
+    {
+        err = busCall(first, "RequestName", NAME);
+    }
+    if (err)
+    {
+        err.what();
+        return 1;
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+
+    //-------- fill --------//
+    auto start = steady_clock::now();
+    err = client.trackNames();
+    if (not err)
+    {
+        err = filtered.trackNames();
+    }
+    if (err)
+    {
+        err.what();
+        return 1;
+    }
+    std::cout << "trackNames():        " << duration_cast<nanoseconds>(steady_clock::now() - start).count() / 2000.0 << " us" << std::endl;
+
+    //-------- lookups --------//
+    std::string owner;
+    start = steady_clock::now();
+    for (uint64_t i = 0; i < lookups; ++i)
+    {
+        client.nameOwner(NAME, owner);
+    }
+    double const cached_ns = duration_cast<nanoseconds>(steady_clock::now() - start).count() / double(lookups);
+    std::cout << "cached owner lookup: " << cached_ns << " ns (" << NAME << " -> " << owner << ")" << std::endl;
+
+    start = steady_clock::now();
+    for (uint64_t i = 0; i < calls; ++i)
+    {
+        busCall(client, "GetNameOwner", NAME);
+    }
+    std::cout << "GetNameOwner():      " << duration_cast<nanoseconds>(steady_clock::now() - start).count() / (1000.0 * calls) << " us" << std::endl;
+
+    //-------- absent service --------//
+    auto callAbsent = [&client, calls]()
+    {
+        auto begin = steady_clock::now();
+        uint64_t failures = 0;
+        for (uint64_t i = 0; i < calls; ++i)
+        {
+            DBusMessage call;
+            call.prepareCall("bench.Absent", "/bench", "bench.Absent", "Ping");
+            DBusMessage reply;
+            failures += static_cast<bool>(client.call(std::move(call), reply, 1000ms));
+        }
+        std::cout << duration_cast<nanoseconds>(steady_clock::now() - begin).count() / (1000.0 * calls) << " us ("
+                  << failures << " failures)" << std::endl;
+    };
+    std::cout << "absent, fast fail:   ";
+    callAbsent();
+    client.setFailFast(false);
+    std::cout << "absent, bus error:   ";
+    callAbsent();
+
+    //-------- name transfer --------//
+    Ticks received[2];
+    filtered.setDropStaleSignals(true);
+    DBusConnection* subscribers[2] = {&client, &filtered};
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        MatchRule rule;
+        rule.sender = NAME;
+        rule.interface = NAME;
+        rule.member = "Tick";
+
+        uint32_t id;
+        Ticks& count = received[i];
+        subscribers[i]->addMatch(rule, [&count](DBusMessage& signal)
+        {
+            std::string who;
+            uint32_t phase = 0;
+            signal.extractArgument(who);
+            signal.extractArgument(phase);
+            if (who == "second")
+            {
+                count.newOwner++;
+            }
+            else if (phase == 0)
+            {
+                count.before++;
+            }
+            else
+            {
+                count.stale++;
+            }
+        }, id);
+    }
+
+    for (uint32_t i = 0; i < ticks; ++i)
+    {
+        tick(first, "first", 0);
+    }
+    busCall(first, "ReleaseName", NAME);
+    busCall(second, "RequestName", NAME);
+    for (uint32_t i = 0; i < ticks; ++i)
+    {
+        tick(first, "first", 1);
+        tick(second, "second", 1);
+    }
+
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        DBusMessage msg;
+        while (not subscribers[i]->recv(msg, 200ms))
+        {
+        }
+    }
+
+    char const* labels[2] = {"no filter", "drop stale"};
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        std::cout << "transfer, " << labels[i] << ": first owner " << received[i].before
+                  << ", stale " << received[i].stale << ", new owner " << received[i].newOwner << std::endl;
+    }
+
+    std::cout << std::endl << "filtered snapshot:" << std::endl << filtered.metrics() << std::endl;
+    return 0;
+}
@@ -0,0 +1,185 @@
+// ObjectManager replica benchmark: initial GetManagedObjects() load, snapshot and iteration costs,
+// then incremental InterfacesAdded / InterfacesRemoved against full reloads.
+//
+// usage: bench_objects [--objects N] [--churn N] [--iterations N]
+
+// C++
+#include <atomic>
+#include <thread>
+
+#include "bench.h"
+#include "ObjectManagerReplica.h"
+
+using namespace dbus;
+
+namespace
+{
+    using Interfaces = ObjectManagerReplica::Interfaces;
+
+    std::string const ROOT = "/bench";
+
+    Interfaces makeObject(uint32_t index)
+    {
+        Interfaces interfaces;
+        interfaces["bench.Item"]["Index"] = index;
+        interfaces["bench.Item"]["Name"] = "item-" + std::to_string(index);
+        interfaces["bench.Extra"]["Value"] = index * 0.5;
+        return interfaces;
+    }
+
+    ObjectPath objectPath(uint32_t index)
+    {
+        return ObjectPath{ROOT + "/objects/" + std::to_string(index)};
+    }
+
+    // Exports objects [first, first + count). Churn(u n): add n objects, remove the n oldest ones.
+    void objectService(DBusConnection& service, uint32_t count, std::atomic<bool>& running)
+    {
+        Dict<ObjectPath, Interfaces> objects;
+        uint32_t first = 0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            objects[objectPath(i)] = makeObject(i);
+        }
+
+        while (running)
+        {
+            DBusMessage call;
+            if (service.recv(call, 100ms) or not call.isCall())
+            {
+                continue;
+            }
+
+            DBusMessage reply;
+            reply.prepareReply(call);
+            if (call.member() == "GetManagedObjects")
+            {
+                reply.addArgument(objects);
+            }
+            else if (call.member() == "Churn")
+            {
+                uint32_t churn = 0;
+                call.extractArgument(churn);
+                for (uint32_t i = 0; i < churn; ++i)
+                {
+                    uint32_t const index = first + count;
+                    objects[objectPath(index)] = makeObject(index);
+
+                    DBusMessage added;
+                    added.prepareSignal(ROOT, ObjectManagerReplica::INTERFACE, "InterfacesAdded");
+                    added.addArgument(objectPath(index));
+                    added.addArgument(objects[objectPath(index)]);
+                    service.send(std::move(added));
+
+                    objects.erase(objectPath(first));
+                    DBusMessage removed;
+                    removed.prepareSignal(ROOT, ObjectManagerReplica::INTERFACE, "InterfacesRemoved");
+                    removed.addArgument(objectPath(first));
+                    removed.addArgument(std::vector<std::string>{"bench.Item", "bench.Extra"});
+                    service.send(std::move(removed));
+                    first++;
+                }
+            }
+            service.send(std::move(reply));
+        }
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    bench::Options options(argc, argv);
+    uint32_t const object_count = options.get("objects", 1000);
+    uint32_t const churn        = options.get("churn", 100);
+    uint64_t const iterations   = options.get("iterations", 1000);
+
+    LoopbackBus bus;
+    DBusError err = bus.start();
+    DBusConnection service;
+    DBusConnection client;
+    if (not err)
+    {
+        err = bench::connectLoopback(bus, service, "pair");
+    }
+    if (not err)
+    {
+        err = bench::connectLoopback(bus, client, "pair");
+    }
+    if (err)
+    {
+        err.what();
+        return 1;
+    }
+
+    std::atomic<bool> running{true};
+    std::thread service_thread([&]() { objectService(service, object_count, running); });
+
+    uint64_t added = 0;
+    uint64_t removed = 0;
+    ObjectManagerReplica replica(client, service.name(), ObjectPath{ROOT});
+    replica.onInterfacesAdded([&added](ObjectPath const&, Interfaces const&) { ++added; });
+    replica.onInterfacesRemoved([&removed](ObjectPath const&, std::vector<std::string> const&) { ++removed; });
+
+    std::cout << std::fixed << std::setprecision(1);
+
+    //-------- initial load --------//
+    auto start = steady_clock::now();
+    err = replica.start(5000ms);
+    double const load_us = duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1000.0;
+    if (err)
+    {
+        err.what();
+        running = false;
+        service_thread.join();
+        return 1;
+    }
+    std::cout << "GetManagedObjects load: " << load_us << " us (" << replica.snapshot()->size() << " objects)" << std::endl;
+
+    //-------- snapshot and iteration --------//
+    start = steady_clock::now();
+    uint64_t properties = 0;
+    for (uint64_t i = 0; i < iterations; ++i)
+    {
+        auto snapshot = replica.snapshot();
+        for (auto const& object : *snapshot)
+        {
+            for (auto const& interface : *object.second)
+            {
+                properties += interface.second.size();
+            }
+        }
+    }
+    double const iteration_ns = duration_cast<nanoseconds>(steady_clock::now() - start).count() / double(iterations);
+    std::cout << "snapshot + iteration:   " << iteration_ns / 1000.0 << " us ("
+              << iteration_ns / object_count << " ns/object, " << properties / iterations << " properties)" << std::endl;
+
+    //-------- incremental updates --------//
+    auto held = replica.snapshot(); // keep a snapshot: updates copy on write.
+    start = steady_clock::now();
+    DBusMessage call;
+    call.prepareCall(service.name(), ROOT, "bench.Objects", "Churn");
+    call.addArgument(churn);
+    DBusMessage reply;
+    err = client.call(std::move(call), reply, 5000ms); // signals are applied while waiting for the reply.
+    double const churn_us = duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1000.0;
+    if (err)
+    {
+        err.what();
+    }
+
+    auto current = replica.snapshot();
+    bool const consistent = (current->size() == object_count) and (current->count(objectPath(churn)) == 1)
+                            and (current->count(objectPath(0)) == (churn ? 0 : 1)) and (held->count(objectPath(0)) == 1);
+    std::cout << "churn " << churn << " (add + remove): " << churn_us << " us, "
+              << replica.updates() << " signals applied, replica " << (consistent ? "consistent" : "INCONSISTENT") << std::endl;
+
+    //-------- full reload for comparison --------//
+    start = steady_clock::now();
+    replica.start(5000ms);
+    std::cout << "full reload:            " << duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1000.0 << " us" << std::endl;
+    std::cout << "callbacks: added " << added << ", removed " << removed << std::endl;
+
+    running = false;
+    service_thread.join();
+    return 0;
+}
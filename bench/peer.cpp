@@ -0,0 +1,145 @@
+// Peer to peer benchmark: round trips to an echo service through the loopback bus versus a direct
+// peer connection (no daemon hop).
+//
+// usage: bench_peer [--calls N] [--payload BYTES] [--address unix:abstract=NAME|unix:path=PATH]
+
+// C++
+#include <atomic>
+#include <thread>
+
+// POSIX
+#include <unistd.h>
+
+#include "bench.h"
+
+using namespace dbus;
+
+
+namespace
+{
+    DBusError run(DBusConnection& client, std::string const& destination, uint64_t calls, uint64_t payload_size, std::string const& label)
+    {
+        std::string const payload(payload_size, 'x');
+        auto roundtrip = [&]()
+        {
+            DBusMessage call;
+            call.prepareCall(destination, "/bench/Echo", "bench.Echo", "Echo");
+            call.addArgument(payload);
+
+            DBusMessage reply;
+            return client.call(std::move(call), reply, 1000ms);
+        };
+
+        for (int i = 0; i < 100; ++i) // warm up.
+        {
+            DBusError err = roundtrip();
+            if (err)
+            {
+                return err;
+            }
+        }
+
+        bench::Latencies latencies;
+        latencies.reserve(calls);
+        auto start = steady_clock::now();
+        for (uint64_t i = 0; i < calls; ++i)
+        {
+            auto call_start = steady_clock::now();
+            DBusError err = roundtrip();
+            if (err)
+            {
+                return err;
+            }
+            latencies.add(steady_clock::now() - call_start);
+        }
+        auto elapsed = steady_clock::now() - start;
+
+        std::cout << std::endl;
+        bench::printThroughput(label, latencies.size(), elapsed);
+        latencies.print(label);
+        return ESUCCESS;
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    bench::Options options(argc, argv);
+    uint64_t const calls        = options.get("calls", 2000);
+    uint64_t const payload_size = options.get("payload", 64);
+    std::string const address   = options.get("address", "unix:abstract=toydbus_bench_peer_" + std::to_string(getpid()));
+
+    //-------- through the bus --------//
+    {
+        LoopbackBus bus;
+        DBusError err = bus.start();
+        if (err)
+        {
+            err.what();
+            return 1;
+        }
+
+        DBusConnection service;
+        DBusConnection client;
+        err = bench::connectLoopback(bus, service, "pair");
+        if (not err)
+        {
+            err = bench::connectLoopback(bus, client, "pair");
+        }
+        if (err)
+        {
+            err.what();
+            return 1;
+        }
+
+        std::atomic<bool> running{true};
+        std::thread service_thread(bench::echoService, std::ref(service), std::ref(running));
+        err = run(client, service.name(), calls, payload_size, "bus");
+        running = false;
+        service_thread.join();
+        if (err)
+        {
+            err.what();
+            return 1;
+        }
+    }
+
+    //-------- peer to peer --------//
+    {
+        DBusConnection service;
+        DBusError err = service.listen(address);
+        if (err)
+        {
+            err.what();
+            return 1;
+        }
+
+        std::atomic<bool> running{true};
+        std::thread service_thread([&]()
+        {
+            DBusError err = service.accept(5000ms);
+            if (err)
+            {
+                err.what();
+                return;
+            }
+            bench::echoService(service, running);
+        });
+
+        DBusConnection client;
+        err = client.connectPeer(address);
+        if (not err)
+        {
+            err = run(client, "", calls, payload_size, "peer");
+        }
+        running = false;
+        service_thread.join();
+        if (err)
+        {
+            err.what();
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,166 @@
+// Property cache benchmark: cached reads against Get() round trips on the loopback bus, then
+// propagation of PropertiesChanged (updated and invalidated properties) to the cache.
+//
+// usage: bench_properties [--reads N] [--calls N] [--changes N]
+
+// C++
+#include <atomic>
+#include <thread>
+
+#include "bench.h"
+#include "PropertyCache.h"
+
+using namespace dbus;
+
+namespace
+{
+    std::string const OBJECT    = "/bench/Device";
+    std::string const INTERFACE = "bench.Device";
+
+    // Service exposing bench.Device properties: Counter (u), Name (s), Temperature (d).
+    // Bump() increments Counter, emits PropertiesChanged (Counter updated, Name invalidated) then replies.
+    void propertyService(DBusConnection& service, std::atomic<bool>& running)
+    {
+        std::unordered_map<std::string, DBusVariant> properties;
+        properties["Counter"] = uint32_t{0};
+        properties["Name"] = std::string{"device-0"};
+        properties["Temperature"] = 21.5;
+
+        while (running)
+        {
+            DBusMessage call;
+            if (service.recv(call, 100ms) or not call.isCall())
+            {
+                continue;
+            }
+
+            DBusMessage reply;
+            reply.prepareReply(call);
+            if (call.member() == "GetAll")
+            {
+                reply.addArgument(properties);
+            }
+            else if (call.member() == "Get")
+            {
+                std::string interface;
+                std::string property;
+                call.extractArgument(interface);
+                call.extractArgument(property);
+                reply.addArgument(properties[property]);
+            }
+            else if (call.member() == "Bump")
+            {
+                uint32_t& counter = properties["Counter"].get<uint32_t>();
+                counter++;
+                properties["Name"] = "device-" + std::to_string(counter);
+
+                std::unordered_map<std::string, DBusVariant> changed;
+                changed["Counter"] = counter;
+                std::vector<std::string> invalidated{"Name"};
+
+                DBusMessage signal;
+                signal.prepareSignal(OBJECT, PropertyCache::INTERFACE, "PropertiesChanged");
+                signal.addArgument(INTERFACE);
+                signal.addArgument(changed);
+                signal.addArgument(invalidated);
+                service.send(std::move(signal));
+            }
+            service.send(std::move(reply));
+        }
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    bench::Options options(argc, argv);
+    uint64_t const reads   = options.get("reads", 1000000);
+    uint64_t const calls   = options.get("calls", 1000);
+    uint64_t const changes = options.get("changes", 100);
+
+    LoopbackBus bus;
+    DBusError err = bus.start();
+    DBusConnection service;
+    DBusConnection client;
+    if (not err)
+    {
+        err = bench::connectLoopback(bus, service, "pair");
+    }
+    if (not err)
+    {
+        err = bench::connectLoopback(bus, client, "pair");
+    }
+    if (err)
+    {
+        err.what();
+        return 1;
+    }
+
+    std::atomic<bool> running{true};
+    std::thread service_thread([&]() { propertyService(service, running); });
+
+    PropertyCache cache(client);
+    ObjectPath const path{OBJECT};
+    std::cout << std::fixed << std::setprecision(1);
+
+    //-------- first read: GetAll() --------//
+    auto start = steady_clock::now();
+    uint32_t counter = 0;
+    err = cache.get(service.name(), path, INTERFACE, "Counter", counter);
+    if (err)
+    {
+        err.what();
+        running = false;
+        service_thread.join();
+        return 1;
+    }
+    std::cout << "cold read (GetAll): " << duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1000.0 << " us" << std::endl;
+
+    //-------- cached reads --------//
+    double temperature = 0;
+    start = steady_clock::now();
+    for (uint64_t i = 0; i < reads; ++i)
+    {
+        cache.get(service.name(), path, INTERFACE, "Temperature", temperature);
+    }
+    double const cached_ns = duration_cast<nanoseconds>(steady_clock::now() - start).count() / double(reads);
+    std::cout << "cached read:        " << cached_ns << " ns" << std::endl;
+
+    //-------- Get() round trips --------//
+    start = steady_clock::now();
+    for (uint64_t i = 0; i < calls; ++i)
+    {
+        DBusMessage call;
+        call.prepareCall(service.name(), OBJECT, PropertyCache::INTERFACE, "Get");
+        call.addArgument(INTERFACE);
+        call.addArgument(std::string{"Temperature"});
+        DBusMessage reply;
+        client.call(std::move(call), reply, 1000ms);
+    }
+    double const remote_ns = duration_cast<nanoseconds>(steady_clock::now() - start).count() / double(calls);
+    std::cout << "remote Get():       " << remote_ns / 1000.0 << " us (x" << std::setprecision(0) << (remote_ns / cached_ns) << ")" << std::endl;
+
+    //-------- changes --------//
+    uint64_t stale = 0;
+    for (uint64_t i = 0; i < changes; ++i)
+    {
+        DBusMessage call;
+        call.prepareCall(service.name(), OBJECT, INTERFACE, "Bump");
+        DBusMessage reply;
+        client.call(std::move(call), reply, 1000ms); // PropertiesChanged is applied while waiting for the reply.
+
+        cache.get(service.name(), path, INTERFACE, "Counter", counter);
+        std::string name;
+        cache.get(service.name(), path, INTERFACE, "Name", name); // invalidated: Get().
+        stale += (counter != (i + 1)) or (name != "device-" + std::to_string(i + 1));
+    }
+
+    running = false;
+    service_thread.join();
+
+    PropertyCache::Stats stats = cache.stats();
+    std::cout << std::endl << "changes: " << changes << ", stale reads: " << stale << std::endl;
+    std::cout << "hits " << stats.hits << ", misses " << stats.misses << ", GetAll " << stats.fills
+              << ", Get " << stats.fetches << ", updated " << stats.updates << ", invalidated " << stats.invalidations << std::endl;
+    return 0;
+}
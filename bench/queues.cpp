@@ -0,0 +1,195 @@
+// Subscriber queues benchmark: an emitter publishes timestamped signals at a fixed rate through the loopback bus
+// to one connection with two subscriptions, a fast consumer and a slow one (sleeping per signal). Both handlers
+// inline first (the slow one holds the connection), then each consumer on its own thread behind a bounded
+// queue, for every overflow policy. Reports the fast consumer latencies, what the slow one got and the overflows.
+//
+// usage: bench_queues [--signals N] [--rate PER_SECOND] [--work US] [--capacity N]
+
+// C++
+#include <atomic>
+#include <thread>
+
+#include "bench.h"
+
+using namespace dbus;
+
+
+namespace
+{
+    struct Mode
+    {
+        char const* label;
+        bool queued;
+        SubscriberQueue::POLICY policy;
+    };
+
+
+    int64_t now_ns()
+    {
+        return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+
+    DBusError run(Mode const& mode, uint64_t signal_count, uint64_t rate, microseconds work, uint32_t capacity)
+    {
+        LoopbackBus bus;
+        DBusError err = bus.start();
+        DBusConnection emitter;
+        DBusConnection subscriber;
+        if (not err)
+        {
+            err = bench::connectLoopback(bus, emitter, "pair");
+        }
+        if (not err)
+        {
+            err = bench::connectLoopback(bus, subscriber, "pair");
+        }
+        if (err)
+        {
+            return err;
+        }
+
+        bench::Latencies latencies;
+        latencies.reserve(signal_count);
+        std::atomic<uint64_t> fast_count{0};
+        std::atomic<uint64_t> slow_count{0};
+        auto fast = [&](DBusMessage& signal)
+        {
+            int64_t sent = 0;
+            signal.extractArgument(sent);
+            latencies.add(nanoseconds(now_ns() - sent));
+            ++fast_count;
+        };
+        auto slow = [&](DBusMessage&)
+        {
+            std::this_thread::sleep_for(work); // stalled consumer.
+            ++slow_count;
+        };
+
+        MatchRule rule;
+        rule.interface = "bench.Feed";
+        uint32_t fast_id;
+        uint32_t slow_id;
+        std::shared_ptr<SubscriberQueue> fast_queue;
+        std::shared_ptr<SubscriberQueue> slow_queue;
+        if (mode.queued)
+        {
+            fast_queue = std::make_shared<SubscriberQueue>(capacity, mode.policy);
+            slow_queue = std::make_shared<SubscriberQueue>(capacity, mode.policy);
+            err = subscriber.addMatch(rule, fast_queue, fast_id);
+            if (not err)
+            {
+                err = subscriber.addMatch(rule, slow_queue, slow_id);
+            }
+        }
+        else
+        {
+            err = subscriber.addMatch(rule, fast, fast_id);
+            if (not err)
+            {
+                err = subscriber.addMatch(rule, slow, slow_id);
+            }
+        }
+        if (err)
+        {
+            return err;
+        }
+
+        std::atomic<bool> running{true};
+        std::vector<std::thread> consumers;
+        if (mode.queued)
+        {
+            auto consume = [&running](SubscriberQueue& queue, std::function<void(DBusMessage&)> handler)
+            {
+                DBusMessage signal;
+                while (running)
+                {
+                    DBusError err = queue.pop(signal, 100ms);
+                    if (err.code() == ERROR_CODE::TIMEOUT)
+                    {
+                        continue;
+                    }
+                    if (err)
+                    {
+                        return; // disconnected.
+                    }
+                    handler(signal);
+                }
+            };
+            consumers.emplace_back(consume, std::ref(*fast_queue), fast);
+            consumers.emplace_back(consume, std::ref(*slow_queue), slow);
+        }
+
+        std::thread emitter_thread([&]()
+        {
+            auto const period = nanoseconds(1000000000 / std::max<uint64_t>(1, rate));
+            auto next = steady_clock::now();
+            for (uint64_t i = 0; i < signal_count; ++i)
+            {
+                std::this_thread::sleep_until(next);
+                next += period;
+
+                DBusMessage signal;
+                signal.prepareSignal("/bench", "bench.Feed", "Tick");
+                signal.addArgument(now_ns());
+                emitter.send(std::move(signal));
+            }
+        });
+
+        auto start = steady_clock::now();
+        while ((fast_count < signal_count) and ((steady_clock::now() - start) < 60s))
+        {
+            DBusMessage msg;
+            subscriber.recv(msg, 10ms);
+        }
+        auto elapsed = steady_clock::now() - start;
+        emitter_thread.join();
+        running = false;
+        for (auto& consumer : consumers)
+        {
+            consumer.join();
+        }
+
+        std::cout << std::endl;
+        bench::printThroughput(std::string(mode.label) + " fast consumer", fast_count, elapsed);
+        latencies.print(std::string(mode.label) + " fast consumer");
+        std::cout << mode.label << " slow consumer: " << slow_count.load() << " of " << signal_count;
+        if (mode.queued)
+        {
+            SubscriberQueue::Stats const stats = slow_queue->stats();
+            std::cout << ", overflows " << stats.overflows << ", max depth " << stats.maxDepth
+                      << ", blocked pushes " << stats.blocked << (slow_queue->closed() ? ", disconnected" : "");
+        }
+        std::cout << std::endl;
+        bus.stop();
+        return ESUCCESS;
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    bench::Options options(argc, argv);
+    uint64_t const signal_count = options.get("signals", 20000);
+    uint64_t const rate         = options.get("rate", 20000);
+    microseconds const work(options.get("work", 200));
+    uint32_t const capacity     = static_cast<uint32_t>(options.get("capacity", 256));
+
+    Mode const modes[] = {
+        {"inline",      false, SubscriberQueue::QUEUE_BLOCK},
+        {"block",       true,  SubscriberQueue::QUEUE_BLOCK},
+        {"drop-oldest", true,  SubscriberQueue::QUEUE_DROP_OLDEST},
+        {"drop-newest", true,  SubscriberQueue::QUEUE_DROP_NEWEST},
+        {"disconnect",  true,  SubscriberQueue::QUEUE_DISCONNECT},
+    };
+    for (auto& mode : modes)
+    {
+        DBusError err = run(mode, signal_count, rate, work, capacity);
+        if (err)
+        {
+            err.what();
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,159 @@
+// Round trip benchmark: N clients call an echo service through the loopback bus.
+//
+// usage: bench_roundtrip [--clients N] [--calls N] [--payload BYTES] [--transport pair|socket|abstract] [--capture FILE]
+
+// C++
+#include <atomic>
+#include <thread>
+
+// POSIX
+#include <unistd.h>
+
+#include "bench.h"
+
+using namespace dbus;
+
+
+namespace
+{
+    std::string const ECHO_PATH      {"/bench/Echo"};
+    std::string const ECHO_INTERFACE {"bench.Echo"};
+}
+
+
+int main(int argc, char** argv)
+{
+    bench::Options options(argc, argv);
+    uint64_t const clients       = options.get("clients", 4);
+    uint64_t const calls         = options.get("calls", 2000);
+    uint64_t const payload_size  = options.get("payload", 64);
+    std::string const transport  = options.get("transport", "pair");
+    std::string const capture    = options.get("capture", "");  // wire capture of the first client.
+
+    LoopbackBus bus;
+    if (transport != "pair")
+    {
+        std::string const address = (transport == "abstract") ? "unix:abstract=" : "unix:path=/tmp/";
+        DBusError err = bus.listen(address + "toydbus_bench_" + std::to_string(getpid()));
+        if (err)
+        {
+            err.what();
+            return 1;
+        }
+    }
+
+    DBusError err = bus.start();
+    if (err)
+    {
+        err.what();
+        return 1;
+    }
+
+    DBusConnection service;
+    err = bench::connectLoopback(bus, service, transport);
+    if (err)
+    {
+        err.what();
+        return 1;
+    }
+    std::string const service_name = service.name();
+
+    std::atomic<bool> running{true};
+    std::thread service_thread(bench::echoService, std::ref(service), std::ref(running));
+
+    std::atomic<uint64_t> ready{0};
+    std::atomic<bool> go{false};
+    std::atomic<uint64_t> failures{0};
+    std::vector<bench::Latencies> latencies(clients);
+    std::vector<std::thread> threads;
+
+    for (uint64_t i = 0; i < clients; ++i)
+    {
+        threads.emplace_back([&, i]()
+        {
+            DBusConnection client;
+            DBusError err = bench::connectLoopback(bus, client, transport);
+            if (err)
+            {
+                err.what();
+                failures++;
+                ready++;
+                return;
+            }
+
+            if ((i == 0) and (not capture.empty()))
+            {
+                err = client.startCapture(capture);
+                if (err)
+                {
+                    err.what();
+                }
+            }
+
+            std::string const payload(payload_size, 'x');
+            auto roundtrip = [&]()
+            {
+                DBusMessage call;
+                call.prepareCall(service_name, ECHO_PATH, ECHO_INTERFACE, "Echo");
+                call.addArgument(payload);
+
+                DBusMessage reply;
+                return client.call(std::move(call), reply, 1000ms);
+            };
+
+            for (int w = 0; w < 100; ++w) // warm up.
+            {
+                roundtrip();
+            }
+
+            ready++;
+            while (not go)
+            {
+                std::this_thread::yield();
+            }
+
+            latencies[i].reserve(calls);
+            for (uint64_t c = 0; c < calls; ++c)
+            {
+                auto start = steady_clock::now();
+                if (roundtrip())
+                {
+                    failures++;
+                    continue;
+                }
+                latencies[i].add(steady_clock::now() - start);
+            }
+        });
+    }
+
+    while (ready < clients)
+    {
+        std::this_thread::sleep_for(1ms);
+    }
+
+    auto start = steady_clock::now();
+    go = true;
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    auto elapsed = steady_clock::now() - start;
+
+    running = false;
+    service_thread.join();
+    bus.stop();
+
+    bench::Latencies all;
+    for (auto const& l : latencies)
+    {
+        all.merge(l);
+    }
+
+    std::cout << std::endl << "transport: " << transport << ", clients: " << clients
+              << ", calls/client: " << calls << ", payload: " << payload_size << " bytes"
+              << ", failures: " << failures.load() << std::endl;
+    bench::printThroughput("round trips", all.size(), elapsed);
+    all.print("round trip");
+
+    return 0;
+}
@@ -0,0 +1,133 @@
+// Message encoding benchmark: cost and heap allocations of building and serializing messages
+// (body and header), with arguments added one by one or with a single addArguments() call.
+// Each encoded message is decoded back once to check it.
+//
+// usage: bench_serialize [--iterations N] [--elements N]
+
+// C++
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+
+#include "alloc.h"
+#include "bench.h"
+
+using namespace dbus;
+
+namespace
+{
+    std::atomic<uint64_t> allocations{0};
+
+    template<typename F>
+    void measure(std::string const& label, uint64_t iterations, F&& encode)
+    {
+        std::vector<uint8_t> frame;
+        uint64_t const before = allocations.load();
+        auto start = steady_clock::now();
+        for (uint64_t i = 0; i < iterations; ++i)
+        {
+            DBusMessage msg;
+            msg.prepareCall("org.example.Service", "/org/example/Object", "org.example.Interface", "Method");
+            encode(msg);
+            msg.toWire(frame);
+        }
+        nanoseconds const elapsed = steady_clock::now() - start;
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << label << ": " << (static_cast<double>(elapsed.count()) / iterations) << " ns/msg, "
+                  << (static_cast<double>(allocations.load() - before) / iterations) << " allocations/msg, "
+                  << frame.size() << " bytes" << std::endl;
+    }
+
+    template<typename T>
+    bool same(T const& lhs, T const& rhs)
+    {
+        return lhs == rhs;
+    }
+
+    bool same(Dict<std::string, DBusVariant> const& lhs, Dict<std::string, DBusVariant> const& rhs)
+    {
+        // DBusVariant has no comparison: the bench properties are all UINT32.
+        return (lhs.size() == rhs.size()) and std::all_of(lhs.begin(), lhs.end(), [&](auto const& entry)
+        {
+            auto it = rhs.find(entry.first);
+            return (it != rhs.end()) and (it->second.type() == DBUS_TYPE::UINT32) and
+                   (it->second.template get<uint32_t>() == entry.second.template get<uint32_t>());
+        });
+    }
+
+    template<typename T>
+    void check(std::string const& label, T const& expected)
+    {
+        DBusMessage msg;
+        msg.prepareCall("org.example.Service", "/org/example/Object", "org.example.Interface", "Method");
+        msg.addArgument(expected);
+        std::vector<uint8_t> frame;
+        msg.toWire(frame);
+
+        DBusMessage decoded;
+        T value;
+        DBusError err = decoded.deserialize(frame.data(), frame.size());
+        if (not err)
+        {
+            err = decoded.extractArgument(value);
+        }
+        if (err or not same(value, expected))
+        {
+            std::cout << label << ": DECODING MISMATCH" << std::endl;
+            err.what();
+            std::exit(1);
+        }
+    }
+}
+
+
+namespace bench
+{
+    void onAllocate(void*, std::size_t) { allocations++; }
+    void onRelease(void*) { }
+}
+
+
+int main(int argc, char** argv)
+{
+    bench::Options options(argc, argv);
+    uint64_t const iterations = options.get("iterations", 100000);
+    uint64_t const elements = options.get("elements", 10000);
+
+    std::string const text{"some string argument"};
+    std::vector<uint32_t> integers(elements);
+    std::vector<std::string> strings(elements / 10, text);
+    Dict<std::string, DBusVariant> properties;
+    for (uint32_t i = 0; i < (elements / 100); ++i)
+    {
+        properties.emplace("Property" + std::to_string(i), DBusVariant{i});
+    }
+    for (uint32_t i = 0; i < integers.size(); ++i)
+    {
+        integers[i] = i;
+    }
+
+    check("au", integers);
+    check("as", strings);
+    check("a{sv}", properties);
+
+    measure("no argument           ", iterations, [](DBusMessage&) { });
+    measure("6 arguments, one by one", iterations, [&](DBusMessage& msg)
+    {
+        msg.addArgument(uint32_t{42});
+        msg.addArgument(text);
+        msg.addArgument(true);
+        msg.addArgument(3.14);
+        msg.addArgument(text);
+        msg.addArgument(int64_t{-1});
+    });
+    measure("6 arguments, at once  ", iterations, [&](DBusMessage& msg)
+    {
+        msg.addArguments(uint32_t{42}, text, true, 3.14, text, int64_t{-1});
+    });
+    measure("au                    ", iterations / 10, [&](DBusMessage& msg) { msg.addArgument(integers); });
+    measure("as                    ", iterations / 10, [&](DBusMessage& msg) { msg.addArgument(strings); });
+    measure("a{sv}                 ", iterations / 10, [&](DBusMessage& msg) { msg.addArgument(properties); });
+    return 0;
+}
@@ -0,0 +1,179 @@
+// Streaming extraction benchmark: a GetManagedObjects() like reply (a{oa{sa{sv}}}) decoded into nested Dicts
+// then walked with visitArgument(), both computing the same aggregate (total Size of the objects whose
+// Device starts with "/dev/sd"). Reports time, heap allocations and peak heap growth per pass.
+//
+// usage: bench_stream [--objects N] [--iterations N]
+
+// C++
+#include <cstdlib>
+#include <malloc.h>
+
+#include "alloc.h"
+#include "bench.h"
+
+using namespace dbus;
+
+namespace
+{
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<int64_t> live{0};
+    std::atomic<int64_t> peak{0};
+
+    using Properties = Dict<std::string, DBusVariant>;
+    using Interfaces = Dict<std::string, Properties>;
+    using Objects = Dict<ObjectPath, Interfaces>;
+
+    std::string const BLOCK = "bench.Block";
+
+    template<typename F>
+    void measure(std::string const& label, uint64_t iterations, F&& f)
+    {
+        uint64_t const before = allocations.load();
+        int64_t const base = live.load();
+        peak = base;
+        uint64_t total = 0;
+        auto start = steady_clock::now();
+        for (uint64_t i = 0; i < iterations; ++i)
+        {
+            DBusError err = f(total);
+            if (err)
+            {
+                std::cout << label << ": FAILED" << std::endl;
+                err.what();
+                std::exit(1);
+            }
+        }
+        nanoseconds const elapsed = steady_clock::now() - start;
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << label << ": " << (static_cast<double>(elapsed.count()) / iterations / 1000.0) << " us, "
+                  << (static_cast<double>(allocations.load() - before) / iterations) << " allocations, "
+                  << "peak +" << ((peak.load() - base) / 1024) << " KiB (total size " << (total / iterations) << ")"
+                  << std::endl;
+    }
+}
+
+
+namespace bench
+{
+    void onAllocate(void* ptr, std::size_t)
+    {
+        allocations++;
+        int64_t const now = live += malloc_usable_size(ptr);
+        int64_t previous = peak.load();
+        while ((now > previous) and not peak.compare_exchange_weak(previous, now))
+        {
+        }
+    }
+
+    void onRelease(void* ptr)
+    {
+        live -= malloc_usable_size(ptr);
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    bench::Options options(argc, argv);
+    uint32_t const objects = options.get("objects", 10000);
+    uint64_t const iterations = options.get("iterations", 20);
+
+    DBusMessage msg;
+    {
+        Objects managed;
+        for (uint32_t i = 0; i < objects; ++i)
+        {
+            Interfaces& interfaces = managed[ObjectPath{"/bench/block/" + std::to_string(i)}];
+            Properties& block = interfaces[BLOCK];
+            block["Device"] = std::string((i % 2) ? "/dev/sd" : "/dev/nvme") + std::to_string(i);
+            block["Size"] = uint64_t{i} << 20;
+            block["ReadOnly"] = (i % 3) == 0;
+            interfaces["org.freedesktop.DBus.Properties"];
+            interfaces["org.freedesktop.DBus.Introspectable"];
+        }
+
+        DBusMessage reply;
+        reply.prepareSignal("/bench", "bench.Stream", "ManagedObjects");
+        reply.addArgument(managed);
+        std::vector<uint8_t> frame;
+        reply.toWire(frame);
+        DBusError err = msg.deserialize(frame.data(), frame.size());
+        if (err)
+        {
+            err.what();
+            return 1;
+        }
+        std::cout << objects << " objects, " << frame.size() / 1024 << " KiB reply" << std::endl;
+    }
+
+    measure("nested Dicts ", iterations, [&](uint64_t& total)
+    {
+        msg.rewind();
+        Objects managed;
+        DBusError err = msg.extractArgument(managed);
+        for (auto const& [path, interfaces] : managed)
+        {
+            auto block = interfaces.find(BLOCK);
+            if (block == interfaces.end())
+            {
+                continue;
+            }
+            auto device = block->second.find("Device");
+            auto size = block->second.find("Size");
+            if ((device != block->second.end()) and (size != block->second.end()) and
+                (device->second.get<std::string>().compare(0, 7, "/dev/sd") == 0))
+            {
+                total += size->second.get<uint64_t>();
+            }
+        }
+        return err;
+    });
+
+    measure("visitArgument", iterations, [&](uint64_t& total)
+    {
+        msg.rewind();
+        DBusError err;
+        DBusError visit = msg.visitArgument([&](ValueView const&, ValueView const& interfaces)
+        {
+            err = interfaces.forEach([&](ValueView const& name, ValueView const& properties)
+            {
+                std::string_view interface;
+                name.get(interface);
+                if (interface != BLOCK)
+                {
+                    return true;
+                }
+
+                bool disk = false;
+                uint64_t size = 0;
+                err = properties.forEach([&](ValueView const& key, ValueView const& value)
+                {
+                    std::string_view property;
+                    key.get(property);
+                    DBusVariant content;
+                    if (property == "Device")
+                    {
+                        value.get(content);
+                        disk = (content.get<std::string>().compare(0, 7, "/dev/sd") == 0);
+                    }
+                    else if (property == "Size")
+                    {
+                        value.get(content);
+                        size = content.get<uint64_t>();
+                    }
+                    return true;
+                });
+                total += disk ? size : 0;
+                return false; // one interface of interest per object.
+            });
+            return not err;
+        });
+        if (visit)
+        {
+            return visit;
+        }
+        return err;
+    });
+    return 0;
+}
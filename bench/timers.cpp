@@ -0,0 +1,189 @@
+// Call deadlines benchmark:
+//  - timer wheel add / cancel / expiry cost with many armed timers, against an ordered multimap,
+//  - asynchronous calls on the loopback bus to a service that leaves some of them unanswered: replies and
+//    synthesized timeouts are delivered to the handlers, the timerfd waking up at the next deadline only.
+//
+// usage: bench_timers [--timers N] [--calls N] [--timeout ms] [--drop N (1 call in N unanswered)]
+
+// C++
+#include <map>
+#include <random>
+#include <thread>
+
+#include "bench.h"
+#include "TimerWheel.h"
+
+using namespace dbus;
+
+namespace
+{
+    // Reply to every call, except to payloads starting with "drop".
+    void lossyService(DBusConnection& service, std::atomic<bool>& running)
+    {
+        while (running)
+        {
+            DBusMessage call;
+            if (service.recv(call, 100ms) or not call.isCall())
+            {
+                continue;
+            }
+
+            std::string payload;
+            call.extractArgument(payload);
+            if (payload.compare(0, 4, "drop") == 0)
+            {
+                continue;
+            }
+
+            DBusMessage reply;
+            reply.prepareReply(call);
+            reply.addArgument(payload);
+            service.send(std::move(reply));
+        }
+    }
+
+    void printPerOperation(std::string const& label, uint64_t count, nanoseconds elapsed)
+    {
+        std::cout << std::fixed << std::setprecision(1)
+                  << label << ": " << (static_cast<double>(elapsed.count()) / count) << " ns/op" << std::endl;
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    bench::Options options(argc, argv);
+    uint64_t const timers = options.get("timers", 200000);
+    uint64_t const calls  = options.get("calls", 2000);
+    milliseconds const timeout{options.get("timeout", 200)};
+    uint64_t const drop   = options.get("drop", 10);
+
+    //-------- timer wheel against multimap --------//
+    std::mt19937 random{42};
+    std::uniform_int_distribution<uint64_t> delay{1, 30000};
+    std::vector<uint64_t> expiries(timers);
+    for (auto& expiry : expiries)
+    {
+        expiry = delay(random);
+    }
+
+    TimerWheel wheel;
+    std::vector<TimerWheel::TimerId> ids(timers);
+    auto start = steady_clock::now();
+    for (uint64_t i = 0; i < timers; ++i)
+    {
+        ids[i] = wheel.add(expiries[i], i);
+    }
+    printPerOperation("wheel add     ", timers, steady_clock::now() - start);
+
+    start = steady_clock::now();
+    for (uint64_t i = 0; i < timers; i += 2)
+    {
+        wheel.cancel(ids[i]);
+    }
+    printPerOperation("wheel cancel  ", timers / 2, steady_clock::now() - start);
+
+    std::vector<uint32_t> expired;
+    start = steady_clock::now();
+    wheel.advance(30000, expired);
+    printPerOperation("wheel expiry  ", expired.size(), steady_clock::now() - start);
+    bool ordered = std::is_sorted(expired.begin(), expired.end(), [&](uint32_t lhs, uint32_t rhs)
+    {
+        return expiries[lhs] < expiries[rhs];
+    });
+    std::cout << "expired " << expired.size() << " of " << (timers - timers / 2)
+              << (ordered ? " in deadline order" : " OUT OF ORDER") << std::endl;
+
+    std::multimap<uint64_t, uint32_t> tree;
+    std::vector<std::multimap<uint64_t, uint32_t>::iterator> iterators(timers);
+    start = steady_clock::now();
+    for (uint64_t i = 0; i < timers; ++i)
+    {
+        iterators[i] = tree.emplace(expiries[i], i);
+    }
+    printPerOperation("multimap add  ", timers, steady_clock::now() - start);
+
+    start = steady_clock::now();
+    for (uint64_t i = 0; i < timers; i += 2)
+    {
+        tree.erase(iterators[i]);
+    }
+    printPerOperation("multimap erase", timers / 2, steady_clock::now() - start);
+
+    //-------- asynchronous calls with deadlines --------//
+    LoopbackBus bus;
+    DBusError err = bus.start();
+    DBusConnection service;
+    DBusConnection client;
+    if (not err)
+    {
+        err = bench::connectLoopback(bus, service, "pair");
+    }
+    if (not err)
+    {
+        err = bench::connectLoopback(bus, client, "pair");
+    }
+    if (err)
+    {
+        err.what();
+        return 1;
+    }
+
+    std::atomic<bool> running{true};
+    std::thread service_thread([&]() { lossyService(service, running); });
+
+    uint64_t replies = 0;
+    uint64_t timeouts = 0;
+    uint64_t failures = 0;
+    start = steady_clock::now();
+    for (uint64_t i = 0; i < calls; ++i)
+    {
+        DBusMessage call;
+        call.prepareCall(service.name(), "/bench", "bench.Lossy", "Echo");
+        call.addArgument(std::string{((i % drop) == 0) ? "drop" : "echo"});
+        err = client.callAsync(std::move(call), [&](DBusError reply_err, DBusMessage&)
+        {
+            if (not reply_err)
+            {
+                replies++;
+            }
+            else if (reply_err.code() == ERROR_CODE::TIMEOUT)
+            {
+                timeouts++;
+            }
+            else
+            {
+                failures++;
+            }
+        }, timeout);
+        if (err)
+        {
+            break;
+        }
+    }
+    std::cout << "\n" << calls << " calls sent, pending " << client.pendingCalls() << std::endl;
+
+    while (not err and (client.pendingCalls() > 0))
+    {
+        // Handlers run from recv(), which returns on timeout once nothing else is received.
+        DBusMessage unexpected;
+        err = client.recv(unexpected, 10ms);
+        if (err and (err.code() == ERROR_CODE::TIMEOUT))
+        {
+            err = ESUCCESS;
+        }
+    }
+    nanoseconds const elapsed = steady_clock::now() - start;
+    running = false;
+    service_thread.join();
+    if (err)
+    {
+        err.what();
+        return 1;
+    }
+
+    std::cout << "replies " << replies << ", timeouts " << timeouts << ", errors " << failures
+              << " in " << duration_cast<milliseconds>(elapsed).count() << " ms (deadline " << timeout.count() << " ms)" << std::endl;
+    std::cout << client.metrics();
+    return 0;
+}
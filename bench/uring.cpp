@@ -0,0 +1,161 @@
+// I/O backends benchmark: round trips and pipelined batches to an echo service through the loopback bus,
+// client and service on the POSIX backend, then both on io_uring. Reports throughput, latencies and the
+// client syscalls (read / write, or io_uring_enter) per call.
+//
+// usage: bench_uring [--calls N] [--payload BYTES] [--batch N]
+
+// C++
+#include <atomic>
+#include <thread>
+
+#include "bench.h"
+
+using namespace dbus;
+
+
+namespace
+{
+    uint64_t syscalls(DBusConnection const& connection)
+    {
+        DBusMetrics::Snapshot const snapshot = connection.metrics();
+        return snapshot.readSyscalls + snapshot.writeSyscalls;
+    }
+
+
+    void printSyscalls(std::string const& label, uint64_t count, uint64_t calls)
+    {
+        std::cout << std::fixed << std::setprecision(2)
+                  << label << " syscalls/call: " << (static_cast<double>(count) / calls) << std::endl;
+    }
+
+
+    DBusError run(DBusConnection& client, std::string const& destination, uint64_t calls, uint64_t payload_size,
+                  uint64_t batch_size, std::string const& label)
+    {
+        std::string const payload(payload_size, 'x');
+        auto prepare = [&](DBusMessage& call)
+        {
+            call.prepareCall(destination, "/bench/Echo", "bench.Echo", "Echo");
+            call.addArgument(payload);
+        };
+
+        for (int i = 0; i < 100; ++i) // warm up.
+        {
+            DBusMessage call;
+            prepare(call);
+            DBusMessage reply;
+            DBusError err = client.call(std::move(call), reply, 1000ms);
+            if (err)
+            {
+                return err;
+            }
+        }
+
+        //-------- round trips --------//
+        bench::Latencies latencies;
+        latencies.reserve(calls);
+        uint64_t const before = syscalls(client);
+        auto start = steady_clock::now();
+        for (uint64_t i = 0; i < calls; ++i)
+        {
+            auto call_start = steady_clock::now();
+            DBusMessage call;
+            prepare(call);
+            DBusMessage reply;
+            DBusError err = client.call(std::move(call), reply, 1000ms);
+            if (err)
+            {
+                return err;
+            }
+            latencies.add(steady_clock::now() - call_start);
+        }
+        auto elapsed = steady_clock::now() - start;
+
+        std::cout << std::endl;
+        bench::printThroughput(label + " round trips", latencies.size(), elapsed);
+        latencies.print(label);
+        printSyscalls(label, syscalls(client) - before, calls);
+
+        //-------- batches --------//
+        std::vector<DBusMessage> batch(batch_size);
+        std::vector<DBusConnection::BatchResult> results;
+        uint64_t const batches = std::max<uint64_t>(1, calls / batch_size);
+        uint64_t const batch_before = syscalls(client);
+        start = steady_clock::now();
+        for (uint64_t i = 0; i < batches; ++i)
+        {
+            for (auto& call : batch)
+            {
+                prepare(call);
+            }
+            DBusError err = client.callBatch(batch, results, 1000ms);
+            if (err)
+            {
+                return err;
+            }
+        }
+        elapsed = steady_clock::now() - start;
+
+        bench::printThroughput(label + " batches of " + std::to_string(batch_size), batches * batch_size, elapsed);
+        printSyscalls(label + " batch", syscalls(client) - batch_before, batches * batch_size);
+        return ESUCCESS;
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    bench::Options options(argc, argv);
+    uint64_t const calls        = options.get("calls", 5000);
+    uint64_t const payload_size = options.get("payload", 64);
+    uint64_t const batch_size   = options.get("batch", 64);
+
+    for (auto backend : {DBusConnection::BACKEND_POSIX, DBusConnection::BACKEND_URING})
+    {
+        std::string const label = (backend == DBusConnection::BACKEND_URING) ? "io_uring" : "posix";
+
+        LoopbackBus bus;
+        DBusError err = bus.start();
+        if (err)
+        {
+            err.what();
+            return 1;
+        }
+
+        DBusConnection service;
+        DBusConnection client;
+        err = bench::connectLoopback(bus, service, "pair");
+        if (not err)
+        {
+            err = bench::connectLoopback(bus, client, "pair");
+        }
+        if (not err)
+        {
+            err = service.setBackend(backend);
+        }
+        if (not err)
+        {
+            err = client.setBackend(backend);
+        }
+        if (err)
+        {
+            std::cout << std::endl << label << ": unavailable" << std::endl;
+            err.what();
+            continue;
+        }
+
+        std::atomic<bool> running{true};
+        std::thread service_thread(bench::echoService, std::ref(service), std::ref(running));
+        err = run(client, service.name(), calls, payload_size, batch_size, label);
+        running = false;
+        service_thread.join();
+        bus.stop();
+        if (err)
+        {
+            err.what();
+            return 1;
+        }
+    }
+
+    return 0;
+}
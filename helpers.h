@@ -1,7 +1,10 @@
 #ifndef DBUS_HELPERS_H
 #define DBUS_HELPERS_H
 
+#include <memory>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include <sstream>
 #include <iomanip>
@@ -9,8 +12,37 @@
 
 namespace dbus
 {
+    // Allocator that default initializes elements: resize() leaves bytes uninitialized, for buffers that are
+    // written right after (marshalling, which writes its padding).
     template<typename T>
-    std::string hexDump(std::vector<T> const& buffer)
+    struct DefaultInitAllocator : std::allocator<T>
+    {
+        template<typename U>
+        struct rebind
+        {
+            using other = DefaultInitAllocator<U>;
+        };
+
+        using std::allocator<T>::allocator;
+
+        template<typename U>
+        void construct(U* ptr) noexcept(std::is_nothrow_default_constructible<U>::value)
+        {
+            ::new(static_cast<void*>(ptr)) U;
+        }
+
+        template<typename U, typename... Args>
+        void construct(U* ptr, Args&&... args)
+        {
+            ::new(static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+        }
+    };
+
+    using Buffer = std::vector<uint8_t, DefaultInitAllocator<uint8_t>>;
+
+
+    template<typename T, typename A>
+    std::string hexDump(std::vector<T, A> const& buffer)
     {
         std::stringstream ss;
         uint8_t const* raw_buffer = buffer.data();
@@ -48,8 +80,20 @@ namespace dbus
 
     std::ostream& operator<< (std::ostream& out, std::vector<uint8_t> const& array);
 
-    void updatePadding(int32_t padding_size, std::vector<uint8_t>& buffer);
-    void align (uint32_t& position, uint32_t alignement);
+    // D-Bus alignments are powers of two: no division on the (de)serialization hot path.
+    inline void align(uint32_t& position, uint32_t alignment)
+    {
+        position = (position + alignment - 1) & ~(alignment - 1);
+    }
+
+    // Zero the padding up to the next alignment boundary of buffer.
+    inline void pad(uint8_t* buffer, uint32_t& position, uint32_t alignment)
+    {
+        while (position & (alignment - 1))
+        {
+            buffer[position++] = 0;
+        }
+    }
 }
 
 #endif
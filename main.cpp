@@ -39,11 +39,16 @@ int main(int argc, char **argv)
 
     DBusConnection bus;
     DBusError err = bus.connect(DBusConnection::BUS_SYSTEM);
+    for (auto const& attempt : bus.connectReport())
+    {
+        std::cout << attempt << std::endl;
+    }
     if (err)
     {
         err.what();
         return 1;
     }
+    std::cout << "My name is " << bus.name() << std::endl;
 
     DBusMessage msg;
     uint32_t serial = msg.prepareCall("org.freedesktop.UDisks2", "/org/freedesktop/UDisks2", "org.freedesktop.DBus.ObjectManager", "GetManagedObjects");
@@ -0,0 +1,1008 @@
+// Generate C++ proxies and skeletons from D-Bus introspection XML.
+//
+// usage: dbus_codegen <introspection.xml> <output.h> [--namespace name]
+//
+// For each interface of the document, the output header holds:
+//  - <Name>Proxy: typed method calls (header fields prebuilt once per proxy, reply signature checked once
+//    then arguments decoded without further checks), signal subscriptions and property accessors.
+//  - <Name>Skeleton: dispatch() of incoming calls (and Properties Get/GetAll/Set) to pure virtual methods,
+//    and typed signal emitters.
+// Supported types: basic types, variants, arrays of basic types and dicts of them (structs are not):
+// members using other types are skipped with a comment in the output.
+
+// C++
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    //-------- Minimal XML reader (introspection documents: elements and attributes only) --------//
+    struct Element
+    {
+        std::string name;
+        std::map<std::string, std::string> attributes;
+        std::vector<std::unique_ptr<Element>> children;
+
+        std::string attribute(std::string const& key, std::string const& defaultValue = "") const
+        {
+            auto it = attributes.find(key);
+            return (it == attributes.end()) ? defaultValue : it->second;
+        }
+    };
+
+    std::string unescapeXml(std::string const& value)
+    {
+        static std::pair<char const*, char> const ENTITIES[] =
+        {
+            {"&lt;", '<'}, {"&gt;", '>'}, {"&amp;", '&'}, {"&quot;", '"'}, {"&apos;", '\''}
+        };
+
+        std::string out;
+        for (std::size_t i = 0; i < value.size(); ++i)
+        {
+            bool replaced = false;
+            if (value[i] == '&')
+            {
+                for (auto const& entity : ENTITIES)
+                {
+                    std::string const name{entity.first};
+                    if (value.compare(i, name.size(), name) == 0)
+                    {
+                        out += entity.second;
+                        i += name.size() - 1;
+                        replaced = true;
+                        break;
+                    }
+                }
+            }
+            if (not replaced)
+            {
+                out += value[i];
+            }
+        }
+        return out;
+    }
+
+    bool parseXml(std::string const& text, Element& root, std::string& error)
+    {
+        std::vector<Element*> stack{&root};
+        std::size_t position = 0;
+        while ((position = text.find('<', position)) != std::string::npos)
+        {
+            if (text.compare(position, 4, "<!--") == 0)
+            {
+                position = text.find("-->", position);
+                if (position == std::string::npos)
+                {
+                    error = "unterminated comment";
+                    return false;
+                }
+                continue;
+            }
+
+            std::size_t const end = text.find('>', position);
+            if (end == std::string::npos)
+            {
+                error = "unterminated tag";
+                return false;
+            }
+
+            std::string tag = text.substr(position + 1, end - position - 1);
+            position = end + 1;
+            if (tag.empty() or (tag[0] == '?') or (tag[0] == '!'))
+            {
+                continue; // declaration, DOCTYPE.
+            }
+
+            if (tag[0] == '/')
+            {
+                if ((stack.size() < 2) or (stack.back()->name != tag.substr(1)))
+                {
+                    error = "unexpected closing tag </" + tag.substr(1) + ">";
+                    return false;
+                }
+                stack.pop_back();
+                continue;
+            }
+
+            bool const self_closing = (tag.back() == '/');
+            if (self_closing)
+            {
+                tag.pop_back();
+            }
+
+            auto element = std::make_unique<Element>();
+            std::size_t i = 0;
+            while ((i < tag.size()) and not std::isspace(static_cast<unsigned char>(tag[i])))
+            {
+                element->name += tag[i++];
+            }
+
+            while (true)
+            {
+                while ((i < tag.size()) and std::isspace(static_cast<unsigned char>(tag[i])))
+                {
+                    i++;
+                }
+                if (i >= tag.size())
+                {
+                    break;
+                }
+
+                std::size_t const equal = tag.find('=', i);
+                if ((equal == std::string::npos) or ((equal + 1) >= tag.size()))
+                {
+                    error = "malformed attribute in <" + element->name + ">";
+                    return false;
+                }
+
+                std::string key = tag.substr(i, equal - i);
+                while (not key.empty() and std::isspace(static_cast<unsigned char>(key.back())))
+                {
+                    key.pop_back();
+                }
+
+                std::size_t quote = equal + 1;
+                while ((quote < tag.size()) and std::isspace(static_cast<unsigned char>(tag[quote])))
+                {
+                    quote++;
+                }
+                std::size_t const close = tag.find(tag[quote], quote + 1);
+                if (((tag[quote] != '"') and (tag[quote] != '\'')) or (close == std::string::npos))
+                {
+                    error = "unquoted attribute " + key + " in <" + element->name + ">";
+                    return false;
+                }
+
+                element->attributes[key] = unescapeXml(tag.substr(quote + 1, close - quote - 1));
+                i = close + 1;
+            }
+
+            Element* raw = element.get();
+            stack.back()->children.push_back(std::move(element));
+            if (not self_closing)
+            {
+                stack.push_back(raw);
+            }
+        }
+
+        if (stack.size() != 1)
+        {
+            error = "unclosed element <" + stack.back()->name + ">";
+            return false;
+        }
+        return true;
+    }
+
+
+    //-------- D-Bus signature to C++ types --------//
+    struct CppType
+    {
+        std::string name;
+        bool basic;      // passed by value.
+        bool variant;    // may be held by a DBusVariant (properties).
+    };
+
+    bool basicType(char c, CppType& type)
+    {
+        static std::map<char, char const*> const BASIC =
+        {
+            {'y', "uint8_t"}, {'b', "bool"},    {'n', "int16_t"}, {'q', "uint16_t"},
+            {'i', "int32_t"}, {'u', "uint32_t"}, {'x', "int64_t"}, {'t', "uint64_t"}, {'d', "double"}
+        };
+        static std::map<char, char const*> const STRINGS =
+        {
+            {'s', "std::string"}, {'o', "dbus::ObjectPath"}, {'g', "dbus::Signature"}
+        };
+
+        auto basic = BASIC.find(c);
+        if (basic != BASIC.end())
+        {
+            type = {basic->second, true, true};
+            return true;
+        }
+
+        auto str = STRINGS.find(c);
+        if (str != STRINGS.end())
+        {
+            type = {str->second, false, true};
+            return true;
+        }
+        return false;
+    }
+
+    // One complete type from signature[position]; false if unsupported.
+    bool cppType(std::string const& signature, std::size_t& position, CppType& type)
+    {
+        if (position >= signature.size())
+        {
+            return false;
+        }
+
+        char const c = signature[position++];
+        if (basicType(c, type))
+        {
+            return true;
+        }
+
+        if (c == 'v')
+        {
+            type = {"dbus::DBusVariant", false, false};
+            return true;
+        }
+
+        if ((c != 'a') or (position >= signature.size()))
+        {
+            return false; // structs, unix fds.
+        }
+
+        if (signature[position] == '{')
+        {
+            position++;
+            CppType key;
+            CppType value;
+            if ((position >= signature.size()) or not basicType(signature[position++], key) or
+                not cppType(signature, position, value) or (position >= signature.size()) or (signature[position++] != '}') or
+                (value.name.compare(0, 12, "std::vector<") == 0))
+            {
+                return false; // dict values: basic types, variants or dicts.
+            }
+            type = {"dbus::Dict<" + key.name + ", " + value.name + ">", false, false};
+            return true;
+        }
+
+        CppType element;
+        if (not basicType(signature[position++], element) and (signature[position - 1] != 'v'))
+        {
+            return false; // arrays of containers are not supported.
+        }
+        if (signature[position - 1] == 'v')
+        {
+            element = {"dbus::DBusVariant", false, false};
+        }
+        type = {"std::vector<" + element.name + ">", false, false};
+        return true;
+    }
+
+    bool singleType(std::string const& signature, CppType& type)
+    {
+        std::size_t position = 0;
+        return cppType(signature, position, type) and (position == signature.size());
+    }
+
+
+    //-------- Introspection model --------//
+    struct Arg
+    {
+        std::string name;
+        std::string signature;
+        CppType type;
+    };
+
+    struct Member
+    {
+        std::string name;
+        std::vector<Arg> in;
+        std::vector<Arg> out;
+        std::string skipped; // reason, if not generated.
+    };
+
+    struct Property
+    {
+        std::string name;
+        std::string signature;
+        CppType type;
+        bool readable;
+        bool writable;
+        std::string skipped;
+    };
+
+    struct Interface
+    {
+        std::string name;
+        std::string className;
+        std::vector<Member> methods;
+        std::vector<Member> signals;
+        std::vector<Property> properties;
+    };
+
+    std::string identifier(std::string const& name, std::string const& fallback)
+    {
+        static std::set<std::string> const KEYWORDS =
+        {
+            "auto", "bool", "break", "case", "char", "class", "const", "default", "delete", "do", "double", "else",
+            "enum", "explicit", "float", "for", "friend", "if", "int", "long", "namespace", "new", "operator",
+            "private", "protected", "public", "register", "return", "short", "signed", "sizeof", "static",
+            "struct", "switch", "template", "this", "throw", "try", "typedef", "union", "unsigned", "using",
+            "virtual", "void", "volatile", "while", "err", "call", "reply", "signal", "timeout", "handler", "id",
+            "connection", "value", "rule", "name", "interface", "property"
+        };
+
+        std::string out;
+        for (char c : name)
+        {
+            out += (std::isalnum(static_cast<unsigned char>(c)) ? c : '_');
+        }
+        if (out.empty() or std::isdigit(static_cast<unsigned char>(out[0])))
+        {
+            out = fallback;
+        }
+        if (KEYWORDS.count(out))
+        {
+            out += '_';
+        }
+        return out;
+    }
+
+    std::string joinSignature(std::vector<Arg> const& args)
+    {
+        std::string signature;
+        for (auto const& arg : args)
+        {
+            signature += arg.signature;
+        }
+        return signature;
+    }
+
+    bool readArgs(Element const& element, bool is_signal, Member& member)
+    {
+        uint32_t index = 0;
+        for (auto const& child : element.children)
+        {
+            if (child->name != "arg")
+            {
+                continue;
+            }
+
+            Arg arg;
+            arg.signature = child->attribute("type");
+            arg.name = identifier(child->attribute("name"), "arg" + std::to_string(index));
+            index++;
+            if (not singleType(arg.signature, arg.type))
+            {
+                member.skipped = "unsupported type '" + arg.signature + "'";
+                return false;
+            }
+
+            bool const out = is_signal or (child->attribute("direction", "in") == "out");
+            (out ? member.out : member.in).push_back(arg);
+        }
+        return true;
+    }
+
+    void readInterface(Element const& element, Interface& interface)
+    {
+        interface.name = element.attribute("name");
+        std::string const last = interface.name.substr(interface.name.rfind('.') + 1);
+        interface.className = identifier(last, "Interface");
+        interface.className[0] = std::toupper(static_cast<unsigned char>(interface.className[0]));
+
+        for (auto const& child : element.children)
+        {
+            if ((child->name == "method") or (child->name == "signal"))
+            {
+                Member member;
+                member.name = child->attribute("name");
+                readArgs(*child, child->name == "signal", member);
+                (child->name == "method" ? interface.methods : interface.signals).push_back(member);
+            }
+            else if (child->name == "property")
+            {
+                Property property;
+                property.name = child->attribute("name");
+                property.signature = child->attribute("type");
+                std::string const access = child->attribute("access", "read");
+                property.readable = (access.find("read") != std::string::npos);
+                property.writable = (access.find("write") != std::string::npos);
+                if (not singleType(property.signature, property.type) or not property.type.variant)
+                {
+                    property.skipped = "type '" + property.signature + "' cannot be held by DBusVariant";
+                }
+                interface.properties.push_back(property);
+            }
+        }
+    }
+
+
+    //-------- Code generation --------//
+    std::string inParameter(Arg const& arg)
+    {
+        return arg.type.basic ? (arg.type.name + " " + arg.name) : (arg.type.name + " const& " + arg.name);
+    }
+
+    std::string parameters(Member const& member, bool with_outputs)
+    {
+        std::string out;
+        for (auto const& arg : member.in)
+        {
+            out += (out.empty() ? "" : ", ") + inParameter(arg);
+        }
+        if (with_outputs)
+        {
+            for (auto const& arg : member.out)
+            {
+                out += (out.empty() ? "" : ", ") + arg.type.name + "& " + arg.name;
+            }
+        }
+        return out;
+    }
+
+    // Decode args from message "msg" (signature checked once, then trusted extraction).
+    void decode(std::ostream& out, std::string const& indent, std::string const& what,
+                std::string const& msg, std::vector<Arg> const& args)
+    {
+        std::string const signature = joinSignature(args);
+        out << indent << "if (" << msg << ".signature().compare(\"" << signature << "\") != 0)\n"
+            << indent << "{\n"
+            << indent << "    return EERROR(\"" << what << ": unexpected signature '\" + " << msg << ".signature() + \"', expected '"
+            << signature << "'\");\n"
+            << indent << "}\n\n"
+            << indent << "DBusError err;\n";
+        for (std::size_t i = 0; i < args.size(); ++i)
+        {
+            if (i == 0)
+            {
+                out << indent << "err = " << msg << ".extractTrusted(" << args[i].name << ");\n";
+                continue;
+            }
+            out << indent << "if (not err)\n"
+                << indent << "{\n"
+                << indent << "    err = " << msg << ".extractTrusted(" << args[i].name << ");\n"
+                << indent << "}\n";
+        }
+        out << indent << "return err;\n";
+    }
+
+    void generateProxy(std::ostream& out, Interface const& interface)
+    {
+        std::string const name = interface.className + "Proxy";
+        out << "    // Client side of " << interface.name << ".\n"
+            << "    class " << name << "\n"
+            << "    {\n"
+            << "    public:\n"
+            << "        static constexpr char const* INTERFACE = \"" << interface.name << "\";\n\n"
+            << "        " << name << "(DBusConnection& connection, std::string const& destination, ObjectPath const& path)\n"
+            << "            : connection_(connection)\n"
+            << "            , destination_(destination)\n"
+            << "            , path_(path)\n";
+        for (auto const& method : interface.methods)
+        {
+            if (method.skipped.empty())
+            {
+                out << "            , " << identifier(method.name, "method") << "Template_(DBusMessage::callTemplate(destination, path.data(), INTERFACE, \""
+                    << method.name << "\", \"" << joinSignature(method.in) << "\"))\n";
+            }
+        }
+        out << "        { }\n\n";
+
+        for (auto const& method : interface.methods)
+        {
+            std::string const id = identifier(method.name, "method");
+            if (not method.skipped.empty())
+            {
+                out << "        // " << method.name << "(): skipped, " << method.skipped << ".\n\n";
+                continue;
+            }
+
+            std::string params = parameters(method, true);
+            out << "        DBusError " << id << "(" << params << (params.empty() ? "" : ", ") << "milliseconds timeout = 1000ms)\n"
+                << "        {\n"
+                << "            DBusMessage call;\n"
+                << "            call.prepareFromTemplate(" << id << "Template_);\n";
+            for (auto const& arg : method.in)
+            {
+                out << "            call.addArgument(" << arg.name << ");\n";
+            }
+            out << "\n"
+                << "            DBusMessage reply;\n"
+                << "            DBusError err = connection_.call(std::move(call), reply, timeout);\n"
+                << "            if (err)\n"
+                << "            {\n"
+                << "                return err;\n"
+                << "            }\n";
+            std::string outs;
+            for (auto const& arg : method.out)
+            {
+                outs += ", " + arg.name;
+            }
+            out << "            return decode" << id << "(reply" << outs << ");\n"
+                << "        }\n\n";
+
+            std::string decode_params;
+            for (auto const& arg : method.out)
+            {
+                decode_params += ", " + arg.type.name + "& " + arg.name;
+            }
+            out << "        static DBusError decode" << id << "(DBusMessage& reply" << decode_params << ")\n"
+                << "        {\n";
+            decode(out, "            ", method.name, "reply", method.out);
+            out << "        }\n\n";
+        }
+
+        for (auto const& signal : interface.signals)
+        {
+            std::string const id = identifier(signal.name, "signal");
+            if (not signal.skipped.empty())
+            {
+                out << "        // " << signal.name << ": skipped, " << signal.skipped << ".\n\n";
+                continue;
+            }
+
+            std::string handler_params;
+            for (auto const& arg : signal.out)
+            {
+                handler_params += (handler_params.empty() ? "" : ", ") + arg.type.name + " const&";
+            }
+            std::string args;
+            for (auto const& arg : signal.out)
+            {
+                args += (args.empty() ? "" : ", ") + arg.name;
+            }
+
+            out << "        DBusError on" << id << "(std::function<void(" << handler_params << ")> handler, uint32_t& id)\n"
+                << "        {\n"
+                << "            MatchRule rule;\n"
+                << "            rule.sender = destination_;\n"
+                << "            rule.path = path_.data();\n"
+                << "            rule.interface = INTERFACE;\n"
+                << "            rule.member = \"" << signal.name << "\";\n"
+                << "            return connection_.addMatch(rule, [handler](DBusMessage& signal)\n"
+                << "            {\n";
+            for (auto const& arg : signal.out)
+            {
+                out << "                " << arg.type.name << " " << arg.name << "{};\n";
+            }
+            out << "                if (not decode" << id << "(signal" << (args.empty() ? "" : ", ") << args << "))\n"
+                << "                {\n"
+                << "                    handler(" << args << ");\n"
+                << "                }\n"
+                << "            }, id);\n"
+                << "        }\n\n";
+
+            std::string decode_params;
+            for (auto const& arg : signal.out)
+            {
+                decode_params += ", " + arg.type.name + "& " + arg.name;
+            }
+            out << "        static DBusError decode" << id << "(DBusMessage& signal" << decode_params << ")\n"
+                << "        {\n";
+            decode(out, "            ", signal.name, "signal", signal.out);
+            out << "        }\n\n";
+        }
+
+        for (auto const& property : interface.properties)
+        {
+            std::string const id = identifier(property.name, "property");
+            if (not property.skipped.empty())
+            {
+                out << "        // " << property.name << " property: skipped, " << property.skipped << ".\n\n";
+                continue;
+            }
+
+            if (property.readable)
+            {
+                out << "        DBusError get" << id << "(" << property.type.name << "& value, milliseconds timeout = 1000ms)\n"
+                    << "        {\n"
+                    << "            DBusMessage call;\n"
+                    << "            call.prepareFromTemplate(getTemplate());\n"
+                    << "            call.addArgument(std::string{INTERFACE});\n"
+                    << "            call.addArgument(std::string{\"" << property.name << "\"});\n\n"
+                    << "            DBusMessage reply;\n"
+                    << "            DBusError err = connection_.call(std::move(call), reply, timeout);\n"
+                    << "            if (err)\n"
+                    << "            {\n"
+                    << "                return err;\n"
+                    << "            }\n\n"
+                    << "            DBusVariant variant;\n"
+                    << "            err = reply.extractArgument(variant);\n"
+                    << "            if (err)\n"
+                    << "            {\n"
+                    << "                return err;\n"
+                    << "            }\n"
+                    << "            if (variant.type() != dbusType<" << property.type.name << ">())\n"
+                    << "            {\n"
+                    << "                return EERROR(\"" << property.name << ": unexpected type '\" + prettyStr(variant.type()) + \"'\");\n"
+                    << "            }\n"
+                    << "            value = variant.get<" << property.type.name << ">();\n"
+                    << "            return ESUCCESS;\n"
+                    << "        }\n\n";
+            }
+
+            if (property.writable)
+            {
+                Arg arg{"value", property.signature, property.type};
+                out << "        DBusError set" << id << "(" << inParameter(arg) << ", milliseconds timeout = 1000ms)\n"
+                    << "        {\n"
+                    << "            DBusMessage call;\n"
+                    << "            call.prepareCall(destination_, path_.data(), \"org.freedesktop.DBus.Properties\", \"Set\");\n"
+                    << "            call.addArgument(std::string{INTERFACE});\n"
+                    << "            call.addArgument(std::string{\"" << property.name << "\"});\n"
+                    << "            call.addArgument(DBusVariant{value});\n\n"
+                    << "            DBusMessage reply;\n"
+                    << "            return connection_.call(std::move(call), reply, timeout);\n"
+                    << "        }\n\n";
+            }
+        }
+
+        out << "    private:\n";
+        bool has_get = false;
+        for (auto const& property : interface.properties)
+        {
+            has_get = has_get or (property.skipped.empty() and property.readable);
+        }
+        if (has_get)
+        {
+            out << "        DBusMessage::HeaderTemplate const& getTemplate()\n"
+                << "        {\n"
+                << "            if (not getTemplate_)\n"
+                << "            {\n"
+                << "                getTemplate_ = DBusMessage::callTemplate(destination_, path_.data(), \"org.freedesktop.DBus.Properties\", \"Get\", \"ss\");\n"
+                << "            }\n"
+                << "            return getTemplate_;\n"
+                << "        }\n\n";
+        }
+        out << "        DBusConnection& connection_;\n"
+            << "        std::string destination_;\n"
+            << "        ObjectPath path_;\n";
+        for (auto const& method : interface.methods)
+        {
+            if (method.skipped.empty())
+            {
+                out << "        DBusMessage::HeaderTemplate " << identifier(method.name, "method") << "Template_;\n";
+            }
+        }
+        if (has_get)
+        {
+            out << "        DBusMessage::HeaderTemplate getTemplate_;\n";
+        }
+        out << "    };\n\n\n";
+    }
+
+    void generateSkeleton(std::ostream& out, Interface const& interface)
+    {
+        std::string const name = interface.className + "Skeleton";
+        out << "    // Service side of " << interface.name << ": implement the pure virtual methods, then give\n"
+            << "    // incoming method calls to dispatch().\n"
+            << "    class " << name << "\n"
+            << "    {\n"
+            << "    public:\n"
+            << "        static constexpr char const* INTERFACE = \"" << interface.name << "\";\n\n"
+            << "        virtual ~" << name << "() = default;\n\n"
+            << "        // Return true if the call is for this interface (the reply, if expected, has been sent).\n"
+            << "        bool dispatch(DBusConnection& connection, DBusMessage& call)\n"
+            << "        {\n"
+            << "            if (not call.isCall() or not call.hasField(FIELD::INTERFACE) or not call.hasField(FIELD::MEMBER))\n"
+            << "            {\n"
+            << "                return false;\n"
+            << "            }\n\n"
+            << "            if (call.interface() == \"org.freedesktop.DBus.Properties\")\n"
+            << "            {\n"
+            << "                return dispatchProperties(connection, call);\n"
+            << "            }\n\n"
+            << "            if (call.interface() != INTERFACE)\n"
+            << "            {\n"
+            << "                return false;\n"
+            << "            }\n\n"
+            << "            DBusMessage reply;\n"
+            << "            std::string const& member = call.member();\n";
+
+        bool first = true;
+        for (auto const& method : interface.methods)
+        {
+            if (not method.skipped.empty())
+            {
+                continue;
+            }
+
+            std::string const id = identifier(method.name, "method");
+            out << "            " << (first ? "if" : "else if") << " (member == \"" << method.name << "\")\n"
+                << "            {\n";
+            first = false;
+            for (auto const& arg : method.in)
+            {
+                out << "                " << arg.type.name << " " << arg.name << "{};\n";
+            }
+            for (auto const& arg : method.out)
+            {
+                out << "                " << arg.type.name << " " << arg.name << "{};\n";
+            }
+
+            std::string in_args;
+            for (auto const& arg : method.in)
+            {
+                in_args += ", " + arg.name;
+            }
+            std::string all_args;
+            for (auto const& arg : method.in)
+            {
+                all_args += (all_args.empty() ? "" : ", ") + arg.name;
+            }
+            for (auto const& arg : method.out)
+            {
+                all_args += (all_args.empty() ? "" : ", ") + arg.name;
+            }
+
+            out << "                if (decode" << id << "(call" << in_args << "))\n"
+                << "                {\n"
+                << "                    reply.prepareError(call, \"org.freedesktop.DBus.Error.InvalidArgs\");\n"
+                << "                }\n"
+                << "                else if (" << id << "(" << all_args << "))\n"
+                << "                {\n"
+                << "                    reply.prepareError(call, \"org.freedesktop.DBus.Error.Failed\");\n"
+                << "                }\n"
+                << "                else\n"
+                << "                {\n"
+                << "                    reply.prepareReply(call);\n";
+            for (auto const& arg : method.out)
+            {
+                out << "                    reply.addArgument(" << arg.name << ");\n";
+            }
+            out << "                }\n"
+                << "            }\n";
+        }
+        out << "            " << (first ? "" : "else\n            ") << "{\n"
+            << "                reply.prepareError(call, \"org.freedesktop.DBus.Error.UnknownMethod\");\n"
+            << "            }\n\n"
+            << "            if (call.expectReply())\n"
+            << "            {\n"
+            << "                connection.send(std::move(reply));\n"
+            << "            }\n"
+            << "            return true;\n"
+            << "        }\n\n";
+
+        for (auto const& signal : interface.signals)
+        {
+            if (not signal.skipped.empty())
+            {
+                continue;
+            }
+
+            std::string params = parameters(signal, false);
+            for (auto const& arg : signal.out)
+            {
+                params += (params.empty() ? "" : ", ") + inParameter(arg);
+            }
+            out << "        DBusError emit" << identifier(signal.name, "signal") << "(DBusConnection& connection, ObjectPath const& path"
+                << (params.empty() ? "" : ", ") << params << ")\n"
+                << "        {\n"
+                << "            DBusMessage signal;\n"
+                << "            signal.prepareSignal(path.data(), INTERFACE, \"" << signal.name << "\");\n";
+            for (auto const& arg : signal.out)
+            {
+                out << "            signal.addArgument(" << arg.name << ");\n";
+            }
+            out << "            return connection.send(std::move(signal));\n"
+                << "        }\n\n";
+        }
+
+        out << "    protected:\n";
+        for (auto const& method : interface.methods)
+        {
+            if (method.skipped.empty())
+            {
+                out << "        virtual DBusError " << identifier(method.name, "method") << "(" << parameters(method, true) << ") = 0;\n";
+            }
+        }
+        for (auto const& property : interface.properties)
+        {
+            if (not property.skipped.empty())
+            {
+                continue;
+            }
+
+            std::string const id = identifier(property.name, "property");
+            if (property.readable)
+            {
+                out << "        virtual DBusError get" << id << "(" << property.type.name << "& value) = 0;\n";
+            }
+            if (property.writable)
+            {
+                Arg arg{"value", property.signature, property.type};
+                out << "        virtual DBusError set" << id << "(" << inParameter(arg) << ") = 0;\n";
+            }
+        }
+
+        out << "\n"
+            << "    private:\n";
+        for (auto const& method : interface.methods)
+        {
+            if (not method.skipped.empty())
+            {
+                continue;
+            }
+
+            std::string decode_params;
+            for (auto const& arg : method.in)
+            {
+                decode_params += ", " + arg.type.name + "& " + arg.name;
+            }
+            out << "        static DBusError decode" << identifier(method.name, "method") << "(DBusMessage& call" << decode_params << ")\n"
+                << "        {\n";
+            decode(out, "            ", method.name, "call", method.in);
+            out << "        }\n\n";
+        }
+
+        // Properties: Get(ss), GetAll(s), Set(ssv) for this interface.
+        out << "        bool dispatchProperties(DBusConnection& connection, DBusMessage& call)\n"
+            << "        {\n"
+            << "            std::string interface;\n"
+            << "            std::string name;\n"
+            << "            if (call.extractArgument(interface) or (interface != INTERFACE))\n"
+            << "            {\n"
+            << "                call.rewind();\n"
+            << "                return false; // another interface of the object.\n"
+            << "            }\n\n"
+            << "            DBusMessage reply;\n"
+            << "            reply.prepareReply(call);\n"
+            << "            DBusVariant value;\n"
+            << "            DBusError err;\n"
+            << "            std::string const& member = call.member();\n"
+            << "            if (member == \"GetAll\")\n"
+            << "            {\n"
+            << "                Dict<std::string, DBusVariant> all;\n";
+        for (auto const& property : interface.properties)
+        {
+            if (property.skipped.empty() and property.readable)
+            {
+                out << "                if (not err)\n"
+                    << "                {\n"
+                    << "                    " << property.type.name << " v{};\n"
+                    << "                    err = get" << identifier(property.name, "property") << "(v);\n"
+                    << "                    all[\"" << property.name << "\"] = v;\n"
+                    << "                }\n";
+            }
+        }
+        out << "                if (not err)\n"
+            << "                {\n"
+            << "                    reply.addArgument(all);\n"
+            << "                }\n"
+            << "            }\n"
+            << "            else if ((member == \"Get\") and not call.extractArgument(name))\n"
+            << "            {\n"
+            << "                err = EERROR(\"Unknown property \" + name);\n";
+        for (auto const& property : interface.properties)
+        {
+            if (property.skipped.empty() and property.readable)
+            {
+                out << "                if (name == \"" << property.name << "\")\n"
+                    << "                {\n"
+                    << "                    " << property.type.name << " v{};\n"
+                    << "                    err = get" << identifier(property.name, "property") << "(v);\n"
+                    << "                    value = v;\n"
+                    << "                }\n";
+            }
+        }
+        out << "                if (not err)\n"
+            << "                {\n"
+            << "                    reply.addArgument(value);\n"
+            << "                }\n"
+            << "            }\n"
+            << "            else if ((member == \"Set\") and not call.extractArgument(name) and not call.extractArgument(value))\n"
+            << "            {\n"
+            << "                err = EERROR(\"Unknown or read only property \" + name);\n";
+        for (auto const& property : interface.properties)
+        {
+            if (property.skipped.empty() and property.writable)
+            {
+                out << "                if ((name == \"" << property.name << "\") and (value.type() == dbusType<" << property.type.name << ">()))\n"
+                    << "                {\n"
+                    << "                    err = set" << identifier(property.name, "property") << "(value.get<" << property.type.name << ">());\n"
+                    << "                }\n";
+            }
+        }
+        out << "            }\n"
+            << "            else\n"
+            << "            {\n"
+            << "                err = EERROR(\"Unknown method \" + member);\n"
+            << "            }\n\n"
+            << "            if (err)\n"
+            << "            {\n"
+            << "                reply.prepareError(call, \"org.freedesktop.DBus.Error.InvalidArgs\");\n"
+            << "            }\n"
+            << "            if (call.expectReply())\n"
+            << "            {\n"
+            << "                connection.send(std::move(reply));\n"
+            << "            }\n"
+            << "            return true;\n"
+            << "        }\n"
+            << "    };\n\n\n";
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "usage: " << argv[0] << " <introspection.xml> <output.h> [--namespace name]" << std::endl;
+        return 1;
+    }
+
+    std::string space = "generated";
+    for (int i = 3; (i + 1) < argc; i += 2)
+    {
+        if (std::string(argv[i]) == "--namespace")
+        {
+            space = argv[i + 1];
+        }
+    }
+
+    std::ifstream input(argv[1]);
+    if (not input)
+    {
+        std::cerr << "cannot read " << argv[1] << std::endl;
+        return 1;
+    }
+    std::stringstream text;
+    text << input.rdbuf();
+
+    Element document;
+    std::string error;
+    if (not parseXml(text.str(), document, error))
+    {
+        std::cerr << argv[1] << ": " << error << std::endl;
+        return 1;
+    }
+
+    std::vector<Interface> interfaces;
+    std::vector<Element const*> nodes{&document};
+    while (not nodes.empty())
+    {
+        Element const* node = nodes.back();
+        nodes.pop_back();
+        for (auto const& child : node->children)
+        {
+            if (child->name == "node")
+            {
+                nodes.push_back(child.get());
+            }
+            else if ((child->name == "interface") and (child->attribute("name").compare(0, 20, "org.freedesktop.DBus") != 0))
+            {
+                Interface interface;
+                readInterface(*child, interface);
+                interfaces.push_back(interface);
+            }
+        }
+    }
+
+    std::stringstream out;
+    out << "// Generated by dbus_codegen from " << argv[1] << ": do not edit.\n"
+        << "#pragma once\n\n"
+        << "// C++\n"
+        << "#include <functional>\n\n"
+        << "#include \"DBusConnection.h\"\n\n"
+        << "namespace " << space << "\n"
+        << "{\n"
+        << "    using namespace dbus;\n\n";
+    for (auto const& interface : interfaces)
+    {
+        generateProxy(out, interface);
+        generateSkeleton(out, interface);
+    }
+    out << "}\n";
+
+    // Do not touch the output when unchanged (no useless rebuilds).
+    std::ifstream previous(argv[2]);
+    std::stringstream previous_text;
+    previous_text << previous.rdbuf();
+    if (previous and (previous_text.str() == out.str()))
+    {
+        return 0;
+    }
+
+    std::ofstream output(argv[2], std::ios::trunc);
+    output << out.str();
+    if (not output)
+    {
+        std::cerr << "cannot write " << argv[2] << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+// Feed a wire capture (see DBusConnection::startCapture()) through the message parser at full speed.
+//
+// usage: dbus_replay <trace file> [--loops N] [--direction in|out|all] [--dump]
+
+// C++
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include "DBusMessage.h"
+#include "WireCapture.h"
+
+using namespace dbus;
+using namespace std::chrono;
+
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: " << argv[0] << " <trace file> [--loops N] [--direction in|out|all] [--dump]" << std::endl;
+        return 1;
+    }
+
+    uint64_t loops = 1;
+    std::string direction = "all";
+    bool dump = false;
+    for (int i = 2; i < argc; ++i)
+    {
+        if ((std::strcmp(argv[i], "--loops") == 0) and (i + 1 < argc))
+        {
+            loops = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if ((std::strcmp(argv[i], "--direction") == 0) and (i + 1 < argc))
+        {
+            direction = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--dump") == 0)
+        {
+            dump = true;
+        }
+    }
+
+    TraceReader reader;
+    DBusError err = reader.open(argv[1]);
+    if (err)
+    {
+        err.what();
+        return 1;
+    }
+
+    std::array<uint64_t, 5> per_type{};
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    uint64_t errors = 0;
+
+    auto start = steady_clock::now();
+    for (uint64_t loop = 0; loop < loops; ++loop)
+    {
+        reader.rewind();
+        TraceReader::Record record;
+        while (reader.next(record))
+        {
+            if (((direction == "in")  and (record.direction != trace::DIRECTION::IN)) or
+                ((direction == "out") and (record.direction != trace::DIRECTION::OUT)))
+            {
+                continue;
+            }
+
+            DBusMessage msg;
+            err = msg.deserialize(record.data, record.size);
+            if (err)
+            {
+                errors++;
+                continue;
+            }
+
+            frames++;
+            bytes += record.size;
+            per_type[static_cast<uint8_t>(msg.type()) % per_type.size()]++;
+
+            if (dump and (loop == 0))
+            {
+                std::cout << "[" << record.timestamp << " ns] "
+                          << ((record.direction == trace::DIRECTION::IN) ? "<<< in" : ">>> out") << std::endl;
+                std::cout << msg.dump() << std::endl;
+            }
+        }
+    }
+    double const seconds = duration_cast<duration<double>>(steady_clock::now() - start).count();
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "frames: " << frames << " (" << bytes << " bytes), errors: " << errors << std::endl;
+    for (uint32_t i = 1; i < per_type.size(); ++i)
+    {
+        std::cout << "  " << str(static_cast<MESSAGE_TYPE>(i)) << ": " << per_type[i] << std::endl;
+    }
+    std::cout << "parse rate: " << (frames / seconds) << " frames/s, "
+              << (bytes / seconds / (1024 * 1024)) << " MiB/s" << std::endl;
+
+    return 0;
+}